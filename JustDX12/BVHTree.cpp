@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+
+#include "BVHTree.h"
+
+BVHTree::BVHTree(float fatMargin) : fatMargin(fatMargin) {
+}
+
+BVHNodeHandle BVHTree::insert(const AABB& box, const Model* model, UINT instance) {
+	BVHNodeHandle leaf = allocateNode();
+	Node& node = nodes[leaf];
+	node.box = box;
+	node.fatBox = fatten(box);
+	node.height = 0;
+	node.model = model;
+	node.instance = instance;
+	insertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void BVHTree::remove(BVHNodeHandle leaf) {
+	removeLeaf(leaf);
+	freeNode(leaf);
+	leafCount--;
+}
+
+void BVHTree::move(BVHNodeHandle leaf, const AABB& box) {
+	AABB fatBox = fatten(box);
+	nodes[leaf].box = box;
+	// Also reinsert if the object shrank a lot, otherwise the stale fat box keeps it visible for no reason.
+	if (contains(nodes[leaf].fatBox, box) && surfaceArea(nodes[leaf].fatBox) <= 4.0f * surfaceArea(fatBox)) {
+		return;
+	}
+	removeLeaf(leaf);
+	nodes[leaf].fatBox = fatBox;
+	insertLeaf(leaf);
+}
+
+void BVHTree::query(const std::array<std::array<float, 4>, 6>& planes, std::vector<SceneBVHResult>& results) const {
+	results.clear();
+	if (root == INVALID_BVH_NODE) {
+		return;
+	}
+	// Each stage queries from its own thread, so each thread keeps its own stack around.
+	thread_local std::vector<BVHNodeHandle> stack;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		BVHNodeHandle index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+
+		PlaneResult result = classify(node.isLeaf() ? node.box : node.fatBox, planes);
+		if (result == PLANE_RESULT_OUTSIDE) {
+			continue;
+		}
+		if (result == PLANE_RESULT_INSIDE) {
+			// Everything below is inside too, no more testing needed.
+			addSubtree(index, results);
+			continue;
+		}
+		if (node.isLeaf()) {
+			results.push_back({ node.model, node.instance, false });
+		}
+		else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+UINT BVHTree::getLeafCount() const {
+	return leafCount;
+}
+
+int BVHTree::getHeight() const {
+	return root == INVALID_BVH_NODE ? 0 : nodes[root].height;
+}
+
+BVHTree::AABB BVHTree::fatten(const AABB& box) const {
+	// Margin scales with the box since models in a scene can be anywhere from a few units to thousands across.
+	AABB result;
+	for (int axis = 0; axis < 3; axis++) {
+		float margin = (box.maximum[axis] - box.minimum[axis]) * fatMargin;
+		result.minimum[axis] = box.minimum[axis] - margin;
+		result.maximum[axis] = box.maximum[axis] + margin;
+	}
+	return result;
+}
+
+BVHTree::AABB BVHTree::merge(const AABB& a, const AABB& b) {
+	AABB result;
+	for (int axis = 0; axis < 3; axis++) {
+		result.minimum[axis] = std::min(a.minimum[axis], b.minimum[axis]);
+		result.maximum[axis] = std::max(a.maximum[axis], b.maximum[axis]);
+	}
+	return result;
+}
+
+float BVHTree::surfaceArea(const AABB& box) {
+	float x = box.maximum[0] - box.minimum[0];
+	float y = box.maximum[1] - box.minimum[1];
+	float z = box.maximum[2] - box.minimum[2];
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+bool BVHTree::contains(const AABB& outer, const AABB& inner) {
+	for (int axis = 0; axis < 3; axis++) {
+		if (outer.minimum[axis] > inner.minimum[axis] || outer.maximum[axis] < inner.maximum[axis]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+BVHTree::PlaneResult BVHTree::classify(const AABB& box, const std::array<std::array<float, 4>, 6>& planes) {
+	float center[3];
+	float extent[3];
+	for (int axis = 0; axis < 3; axis++) {
+		center[axis] = (box.maximum[axis] + box.minimum[axis]) * 0.5f;
+		extent[axis] = (box.maximum[axis] - box.minimum[axis]) * 0.5f;
+	}
+	PlaneResult result = PLANE_RESULT_INSIDE;
+	for (const auto& plane : planes) {
+		float distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+		float radius = fabsf(plane[0]) * extent[0] + fabsf(plane[1]) * extent[1] + fabsf(plane[2]) * extent[2];
+		if (distance > radius) {
+			return PLANE_RESULT_OUTSIDE;
+		}
+		if (distance > -radius) {
+			result = PLANE_RESULT_INTERSECTS;
+		}
+	}
+	return result;
+}
+
+BVHNodeHandle BVHTree::allocateNode() {
+	if (!freeNodes.empty()) {
+		BVHNodeHandle node = freeNodes.back();
+		freeNodes.pop_back();
+		nodes[node] = Node();
+		return node;
+	}
+	nodes.emplace_back();
+	return (BVHNodeHandle)nodes.size() - 1;
+}
+
+void BVHTree::freeNode(BVHNodeHandle node) {
+	nodes[node] = Node();
+	freeNodes.push_back(node);
+}
+
+void BVHTree::insertLeaf(BVHNodeHandle leaf) {
+	if (root == INVALID_BVH_NODE) {
+		root = leaf;
+		nodes[leaf].parent = INVALID_BVH_NODE;
+		return;
+	}
+
+	// Walk down picking whichever side grows the least in surface area, stopping when pairing up here is cheaper than going further.
+	AABB leafBox = nodes[leaf].fatBox;
+	BVHNodeHandle sibling = root;
+	while (!nodes[sibling].isLeaf()) {
+		const Node& node = nodes[sibling];
+		float area = surfaceArea(node.fatBox);
+		float combinedArea = surfaceArea(merge(node.fatBox, leafBox));
+		float pairCost = 2.0f * combinedArea;
+		// Every node on the way down grows by the same amount, whichever child is picked.
+		float inheritedCost = 2.0f * (combinedArea - area);
+		auto descendCost = [&](BVHNodeHandle child) {
+			float mergedArea = surfaceArea(merge(leafBox, nodes[child].fatBox));
+			if (nodes[child].isLeaf()) {
+				return mergedArea + inheritedCost;
+			}
+			return mergedArea - surfaceArea(nodes[child].fatBox) + inheritedCost;
+		};
+		float leftCost = descendCost(node.left);
+		float rightCost = descendCost(node.right);
+		if (pairCost < leftCost && pairCost < rightCost) {
+			break;
+		}
+		sibling = leftCost < rightCost ? node.left : node.right;
+	}
+
+	BVHNodeHandle oldParent = nodes[sibling].parent;
+	BVHNodeHandle newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].fatBox = merge(leafBox, nodes[sibling].fatBox);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == INVALID_BVH_NODE) {
+		root = newParent;
+	}
+	else if (nodes[oldParent].left == sibling) {
+		nodes[oldParent].left = newParent;
+	}
+	else {
+		nodes[oldParent].right = newParent;
+	}
+	refitUpwards(oldParent);
+}
+
+void BVHTree::removeLeaf(BVHNodeHandle leaf) {
+	if (leaf == root) {
+		root = INVALID_BVH_NODE;
+		return;
+	}
+	BVHNodeHandle parent = nodes[leaf].parent;
+	BVHNodeHandle grandParent = nodes[parent].parent;
+	BVHNodeHandle sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	nodes[sibling].parent = grandParent;
+	if (grandParent == INVALID_BVH_NODE) {
+		root = sibling;
+	}
+	else if (nodes[grandParent].left == parent) {
+		nodes[grandParent].left = sibling;
+	}
+	else {
+		nodes[grandParent].right = sibling;
+	}
+	freeNode(parent);
+	nodes[leaf].parent = INVALID_BVH_NODE;
+	refitUpwards(grandParent);
+}
+
+void BVHTree::refitUpwards(BVHNodeHandle node) {
+	while (node != INVALID_BVH_NODE) {
+		node = balance(node);
+		Node& current = nodes[node];
+		current.height = 1 + std::max(nodes[current.left].height, nodes[current.right].height);
+		current.fatBox = merge(nodes[current.left].fatBox, nodes[current.right].fatBox);
+		node = current.parent;
+	}
+}
+
+BVHNodeHandle BVHTree::balance(BVHNodeHandle node) {
+	if (nodes[node].isLeaf() || nodes[node].height < 2) {
+		return node;
+	}
+	BVHNodeHandle left = nodes[node].left;
+	BVHNodeHandle right = nodes[node].right;
+	int difference = nodes[right].height - nodes[left].height;
+	if (difference > 1) {
+		return rotateUp(node, right);
+	}
+	if (difference < -1) {
+		return rotateUp(node, left);
+	}
+	return node;
+}
+
+BVHNodeHandle BVHTree::rotateUp(BVHNodeHandle node, BVHNodeHandle child) {
+	Node& current = nodes[node];
+	Node& up = nodes[child];
+	BVHNodeHandle taller = nodes[up.left].height > nodes[up.right].height ? up.left : up.right;
+	BVHNodeHandle shorter = taller == up.left ? up.right : up.left;
+
+	// 'child' takes the place of 'node' in the tree.
+	up.parent = current.parent;
+	if (up.parent == INVALID_BVH_NODE) {
+		root = child;
+	}
+	else if (nodes[up.parent].left == node) {
+		nodes[up.parent].left = child;
+	}
+	else {
+		nodes[up.parent].right = child;
+	}
+
+	// 'node' keeps its other child and takes the shorter grandchild, 'child' keeps the taller one and adopts 'node'.
+	if (current.left == child) {
+		current.left = shorter;
+	}
+	else {
+		current.right = shorter;
+	}
+	nodes[shorter].parent = node;
+	current.parent = child;
+	up.left = node;
+	up.right = taller;
+
+	current.height = 1 + std::max(nodes[current.left].height, nodes[current.right].height);
+	current.fatBox = merge(nodes[current.left].fatBox, nodes[current.right].fatBox);
+	up.height = 1 + std::max(current.height, nodes[taller].height);
+	up.fatBox = merge(current.fatBox, nodes[taller].fatBox);
+	return child;
+}
+
+void BVHTree::addSubtree(BVHNodeHandle node, std::vector<SceneBVHResult>& results) const {
+	const Node& current = nodes[node];
+	if (current.isLeaf()) {
+		results.push_back({ current.model, current.instance, true });
+		return;
+	}
+	addSubtree(current.left, results);
+	addSubtree(current.right, results);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the tree can be built and checked off Windows too.
+typedef unsigned int UINT;
+#endif
+
+class Model;
+
+typedef int BVHNodeHandle;
+#define INVALID_BVH_NODE -1
+
+// One visible model instance returned from a frustum query.
+// fullyInside is set when the instance was accepted without being tested, because a node above it was entirely in the frustum.
+struct SceneBVHResult {
+	const Model* model;
+	UINT instance;
+	bool fullyInside;
+};
+
+// Dynamic AABB tree over model instances, the plain float half of SceneBVH (which adds the DirectXMath conversions and locking).
+// Leaves are stored with a fattened box so small movements don't touch the tree, bigger ones reinsert the single leaf.
+// The tree is kept balanced with rotations on the way back up from inserts/removes, so queries stay logarithmic as it changes.
+class BVHTree {
+public:
+	struct AABB {
+		std::array<float, 3> minimum;
+		std::array<float, 3> maximum;
+	};
+
+	// Leaf boxes are grown by 'fatMargin' of their size on each side.
+	explicit BVHTree(float fatMargin);
+
+	BVHNodeHandle insert(const AABB& box, const Model* model, UINT instance);
+	void remove(BVHNodeHandle leaf);
+	// Updates the bounds of 'leaf', only touches the tree if the new box escaped the fattened one.
+	void move(BVHNodeHandle leaf, const AABB& box);
+
+	// Clears 'results' and fills it with every instance whose bounds touch the volume. 'planes' are (normal, distance)
+	// facing out of the volume, like BoundingFrustum's.
+	void query(const std::array<std::array<float, 4>, 6>& planes, std::vector<SceneBVHResult>& results) const;
+
+	UINT getLeafCount() const;
+	int getHeight() const;
+
+private:
+	struct Node {
+		AABB fatBox;
+		// Leaves keep the real bounds too, so the final test isn't against the fattened box.
+		AABB box;
+		BVHNodeHandle parent = INVALID_BVH_NODE;
+		BVHNodeHandle left = INVALID_BVH_NODE;
+		BVHNodeHandle right = INVALID_BVH_NODE;
+		// Leaves are height 0, -1 marks a free node.
+		int height = -1;
+		const Model* model = nullptr;
+		UINT instance = 0;
+
+		bool isLeaf() const {
+			return left == INVALID_BVH_NODE;
+		}
+	};
+	enum PlaneResult {
+		PLANE_RESULT_OUTSIDE,
+		PLANE_RESULT_INTERSECTS,
+		PLANE_RESULT_INSIDE
+	};
+
+	AABB fatten(const AABB& box) const;
+	static AABB merge(const AABB& a, const AABB& b);
+	static float surfaceArea(const AABB& box);
+	static bool contains(const AABB& outer, const AABB& inner);
+	static PlaneResult classify(const AABB& box, const std::array<std::array<float, 4>, 6>& planes);
+
+	BVHNodeHandle allocateNode();
+	void freeNode(BVHNodeHandle node);
+	void insertLeaf(BVHNodeHandle leaf);
+	void removeLeaf(BVHNodeHandle leaf);
+	// Refits and rebalances every node from 'node' up to the root.
+	void refitUpwards(BVHNodeHandle node);
+	BVHNodeHandle balance(BVHNodeHandle node);
+	// Swaps 'child' into the place of 'node' when 'child' is the taller side, returns the new subtree root.
+	BVHNodeHandle rotateUp(BVHNodeHandle node, BVHNodeHandle child);
+	void addSubtree(BVHNodeHandle node, std::vector<SceneBVHResult>& results) const;
+
+	float fatMargin;
+
+	std::vector<Node> nodes;
+	std::vector<BVHNodeHandle> freeNodes;
+	BVHNodeHandle root = INVALID_BVH_NODE;
+	UINT leafCount = 0;
+};
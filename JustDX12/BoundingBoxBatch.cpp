@@ -0,0 +1,58 @@
+#include "BoundingBoxBatch.h"
+#include "SoftwareOcclusion.h"
+
+void BoundingBoxBatch::clear() {
+	boxes.clear();
+}
+
+UINT BoundingBoxBatch::add(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world) {
+	DirectX::XMFLOAT4X4 worldStored;
+	DirectX::XMStoreFloat4x4(&worldStored, world);
+	return boxes.add(&box.Center.x, &box.Extents.x, worldStored.m);
+}
+
+UINT BoundingBoxBatch::size() const {
+	return boxes.size();
+}
+
+void BoundingBoxBatch::cull(const DirectX::BoundingFrustum& frustum) {
+	// BoundingFrustum planes face outwards, which is what the batch expects.
+	DirectX::XMVECTOR planeVectors[6];
+	frustum.GetPlanes(&planeVectors[0], &planeVectors[1], &planeVectors[2], &planeVectors[3], &planeVectors[4], &planeVectors[5]);
+	std::array<std::array<float, 4>, 6> planes;
+	for (int i = 0; i < 6; i++) {
+		DirectX::XMFLOAT4 plane;
+		DirectX::XMStoreFloat4(&plane, planeVectors[i]);
+		planes[i] = { plane.x, plane.y, plane.z, plane.w };
+	}
+	boxes.cull(planes);
+}
+
+void BoundingBoxBatch::occlusionCull(const SoftwareOcclusion& occlusion, std::span<const UINT> skip) {
+	auto nextSkip = skip.begin();
+	for (UINT i = 0; i < boxes.size(); i++) {
+		if (!boxes.isVisible(i)) {
+			continue;
+		}
+		while (nextSkip != skip.end() && *nextSkip < i) {
+			nextSkip++;
+		}
+		if (nextSkip != skip.end() && *nextSkip == i) {
+			continue;
+		}
+		DirectX::BoundingBox box;
+		DirectX::XMFLOAT4X4 world;
+		boxes.getBox(i, &box.Center.x, &box.Extents.x, world.m);
+		if (occlusion.isOccluded(box, DirectX::XMLoadFloat4x4(&world))) {
+			boxes.hide(i);
+		}
+	}
+}
+
+bool BoundingBoxBatch::isVisible(UINT index) const {
+	return boxes.isVisible(index);
+}
+
+bool BoundingBoxBatch::anyVisible(UINT first, UINT boxCount) const {
+	return boxes.anyVisible(first, boxCount);
+}
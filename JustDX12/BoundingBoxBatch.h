@@ -0,0 +1,31 @@
+#pragma once
+#include <span>
+#include <DirectXCollision.h>
+
+#include "BoxCullBatch.h"
+#include "Settings.h"
+
+class SoftwareOcclusion;
+
+// Bounding boxes and the transforms that take each into world space, frustum culled together in one SSE pass
+// by the BoxCullBatch underneath, which writes one visibility bit per box. This only converts from DirectXMath
+// and adds the occlusion test.
+// Storage is kept between frames, so after the first few frames filling and culling the batch doesn't allocate.
+class BoundingBoxBatch {
+public:
+	// Drops all boxes, keeps the memory.
+	void clear();
+	// Returns the index of the box in the batch, which is also its bit in the visibility mask.
+	UINT add(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world);
+	UINT size() const;
+
+	void cull(const DirectX::BoundingFrustum& frustum);
+	// Clears the bit of every visible box hidden behind the occluders, has to run after cull().
+	// 'skip' (sorted) lists boxes that stay visible untested, the occluders themselves would otherwise hide their own boxes.
+	void occlusionCull(const SoftwareOcclusion& occlusion, std::span<const UINT> skip);
+	bool isVisible(UINT index) const;
+	bool anyVisible(UINT first, UINT boxCount) const;
+
+private:
+	BoxCullBatch boxes;
+};
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "BoxCullBatch.h"
+
+static inline __m128 multiplyAdd(__m128 a, __m128 b, __m128 c) {
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+void BoxCullBatch::clear() {
+	count = 0;
+	blocks.clear();
+}
+
+UINT BoxCullBatch::add(const float center[3], const float extents[3], const float world[4][4]) {
+	if (count % 4 == 0) {
+		blocks.push_back({});
+	}
+	Block& block = blocks.back();
+	const UINT lane = count % 4;
+	for (int axis = 0; axis < 3; axis++) {
+		block.centers[axis][lane] = center[axis];
+		block.extents[axis][lane] = extents[axis];
+	}
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 3; column++) {
+			block.transform[row][column][lane] = world[row][column];
+		}
+	}
+	return count++;
+}
+
+UINT BoxCullBatch::size() const {
+	return count;
+}
+
+void BoxCullBatch::getBox(UINT index, float center[3], float extents[3], float world[4][4]) const {
+	const Block& block = blocks[index / 4];
+	const UINT lane = index % 4;
+	for (int axis = 0; axis < 3; axis++) {
+		center[axis] = block.centers[axis][lane];
+		extents[axis] = block.extents[axis][lane];
+	}
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 3; column++) {
+			world[row][column] = block.transform[row][column][lane];
+		}
+		world[row][3] = row == 3 ? 1.0f : 0.0f;
+	}
+}
+
+void BoxCullBatch::cull(const std::array<std::array<float, 4>, 6>& planes) {
+	visibility.assign((count + 63) / 64, 0);
+	if (count == 0) {
+		return;
+	}
+
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for (UINT i = 0; i < count; i += 4) {
+		// The last block's unused lanes are zero, their bits get masked off at the end.
+		const Block& block = blocks[i / 4];
+		__m128 m[4][3];
+		for (int row = 0; row < 4; row++) {
+			for (int column = 0; column < 3; column++) {
+				m[row][column] = _mm_load_ps(block.transform[row][column]);
+			}
+		}
+		__m128 cx = _mm_load_ps(block.centers[0]);
+		__m128 cy = _mm_load_ps(block.centers[1]);
+		__m128 cz = _mm_load_ps(block.centers[2]);
+		__m128 ex = _mm_load_ps(block.extents[0]);
+		__m128 ey = _mm_load_ps(block.extents[1]);
+		__m128 ez = _mm_load_ps(block.extents[2]);
+
+		// Center goes through the whole transform, the extents through the absolute value of the rotation/scale,
+		// which gives the world space box that encloses the transformed local box.
+		__m128 worldCenter[3];
+		__m128 worldExtent[3];
+		for (int column = 0; column < 3; column++) {
+			worldCenter[column] = multiplyAdd(cx, m[0][column], multiplyAdd(cy, m[1][column], multiplyAdd(cz, m[2][column], m[3][column])));
+			worldExtent[column] = multiplyAdd(ex, _mm_and_ps(m[0][column], absMask),
+				multiplyAdd(ey, _mm_and_ps(m[1][column], absMask), _mm_mul_ps(ez, _mm_and_ps(m[2][column], absMask))));
+		}
+
+		__m128 outside = _mm_setzero_ps();
+		for (const auto& plane : planes) {
+			__m128 distance = multiplyAdd(worldCenter[0], _mm_set1_ps(plane[0]),
+				multiplyAdd(worldCenter[1], _mm_set1_ps(plane[1]), multiplyAdd(worldCenter[2], _mm_set1_ps(plane[2]), _mm_set1_ps(plane[3]))));
+			__m128 radius = multiplyAdd(worldExtent[0], _mm_set1_ps(fabsf(plane[0])),
+				multiplyAdd(worldExtent[1], _mm_set1_ps(fabsf(plane[1])), _mm_mul_ps(worldExtent[2], _mm_set1_ps(fabsf(plane[2])))));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(distance, radius));
+		}
+
+		UINT64 visibleBits = (UINT64)(~_mm_movemask_ps(outside) & 0xF);
+		visibility[i / 64] |= visibleBits << (i % 64);
+	}
+
+	if (count % 64 != 0) {
+		visibility.back() &= (1ull << (count % 64)) - 1;
+	}
+}
+
+bool BoxCullBatch::isVisible(UINT index) const {
+	return (visibility[index / 64] >> (index % 64)) & 1;
+}
+
+bool BoxCullBatch::anyVisible(UINT first, UINT boxCount) const {
+	const UINT last = first + boxCount;
+	UINT index = first;
+	while (index < last) {
+		UINT bit = index % 64;
+		UINT bitsInWord = std::min(64 - bit, last - index);
+		UINT64 mask = bitsInWord == 64 ? ~0ull : ((1ull << bitsInWord) - 1) << bit;
+		if (visibility[index / 64] & mask) {
+			return true;
+		}
+		index += bitsInWord;
+	}
+	return false;
+}
+
+void BoxCullBatch::hide(UINT index) {
+	visibility[index / 64] &= ~(1ull << (index % 64));
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the kernel can be built and checked off Windows too.
+typedef unsigned int UINT;
+typedef unsigned long long UINT64;
+#endif
+
+// List of local space boxes (center and half extents) along with the transform that takes each into world space, the plain
+// float half of BoundingBoxBatch. Boxes are stored in blocks of 4, each value of a block's boxes next to each other, so
+// cull() transforms and tests a block per iteration with SSE loads straight from it, writing one visibility bit per box.
+// Transforms are row vector affine matrices like DirectXMath's, their 4th column is always (0,0,0,1) so only the other 3
+// are stored. Storage is kept between frames, so after the first few frames filling and culling the batch doesn't allocate.
+class BoxCullBatch {
+public:
+	// Drops all boxes, keeps the memory.
+	void clear();
+	// Returns the index of the box in the batch, which is also its bit in the visibility mask.
+	UINT add(const float center[3], const float extents[3], const float world[4][4]);
+	UINT size() const;
+	// Local box and transform of box 'index', as they were added.
+	void getBox(UINT index, float center[3], float extents[3], float world[4][4]) const;
+
+	// 'planes' are (normal, distance) facing out of the volume, like BoundingFrustum's. A box is culled if the world space
+	// box enclosing it is entirely in front of any of them, so the result is conservative.
+	void cull(const std::array<std::array<float, 4>, 6>& planes);
+	bool isVisible(UINT index) const;
+	bool anyVisible(UINT first, UINT boxCount) const;
+	// Clears the bit of a box some later test found hidden, has to run after cull().
+	void hide(UINT index);
+
+private:
+	UINT count = 0;
+
+	struct alignas(16) Block {
+		float centers[3][4];
+		float extents[3][4];
+		// Rows 0-2 hold the rotation/scale, row 3 the translation.
+		float transform[4][3][4];
+	};
+	std::vector<Block> blocks;
+
+	std::vector<UINT64> visibility;
+};
@@ -45,28 +45,6 @@ public:
 };
 
 
-class PerObjectConstants : public ConstantBufferData {
-public:
-	struct PerObjectConstantsStruct {
-		DirectX::XMFLOAT4X4 World[MAX_INSTANCES] = { Identity() };
-		UINT instanceCount = 0;
-		DirectX::XMFLOAT3 padding;
-	};
-
-	PerObjectConstantsStruct data;
-
-	virtual UINT byteSize() const override {
-		return sizeof(PerObjectConstantsStruct);
-	}
-	virtual std::unique_ptr<ConstantBufferData> clone() const override {
-		return std::make_unique<PerObjectConstants>(*this);
-	}
-	void* getData() override {
-		return &data;
-	};
-	virtual ~PerObjectConstants() override {}
-};
-
 class PerPassConstants : public ConstantBufferData {
 public:
 	struct PerPassConstantsStruct {
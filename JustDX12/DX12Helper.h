@@ -1,5 +1,4 @@
 #pragma once
-#define NOMINMAX
 #include <windows.h>
 #include <wrl.h>
 #include <dxgi1_4.h>
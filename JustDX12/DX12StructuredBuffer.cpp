@@ -0,0 +1,86 @@
+#include <algorithm>
+
+#include "DX12StructuredBuffer.h"
+#include "ResourceDecay.h"
+
+DX12StructuredBuffer::DX12StructuredBuffer(UINT elementByteSize, UINT initialCapacity, ID3D12Device5* device) {
+	this->device = device;
+	this->elementByteSize = elementByteSize;
+	mappedData.fill(nullptr);
+	capacity.fill(0);
+	for (UINT i = 0; i < CPU_FRAME_COUNT; i++) {
+		createBuffer(i, std::max(initialCapacity, 1u));
+	}
+}
+
+DX12StructuredBuffer::~DX12StructuredBuffer() {
+	for (UINT i = 0; i < CPU_FRAME_COUNT; i++) {
+		if (uploadBuffer[i].get() != nullptr) {
+			uploadBuffer[i].get()->Unmap(0, nullptr);
+			ResourceDecay::destroyAfterDelay(uploadBuffer[i].get());
+		}
+	}
+}
+
+ID3D12Resource* DX12StructuredBuffer::get(UINT index) {
+	return uploadBuffer[index].get();
+}
+
+DX12Resource* DX12StructuredBuffer::getDX12Resource(UINT index) {
+	return &uploadBuffer[index];
+}
+
+UINT DX12StructuredBuffer::getElementByteSize() const {
+	return elementByteSize;
+}
+
+UINT DX12StructuredBuffer::getCapacity(UINT index) const {
+	return capacity[index];
+}
+
+void DX12StructuredBuffer::updateBuffer(UINT index, const void* src, UINT elementCount) {
+	reserve(index, elementCount);
+	std::unique_lock<std::mutex> lk(dataUpdate);
+	if (elementCount > 0) {
+		memcpy(mappedData[index], src, (size_t)elementCount * elementByteSize);
+	}
+}
+
+bool DX12StructuredBuffer::reserve(UINT index, UINT elementCount) {
+	std::unique_lock<std::mutex> lk(dataUpdate);
+	if (elementCount <= capacity[index]) {
+		return false;
+	}
+	// Grow geometrically so a slider dragging the instance count up doesn't reallocate every frame.
+	createBuffer(index, std::max(elementCount, capacity[index] * 2));
+	return true;
+}
+
+BYTE* DX12StructuredBuffer::getMappedData(UINT index) {
+	return mappedData[index];
+}
+
+void DX12StructuredBuffer::createBuffer(UINT index, UINT elementCount) {
+	if (uploadBuffer[index].get() != nullptr) {
+		// Frames in flight could still be reading from the old buffer.
+		uploadBuffer[index].get()->Unmap(0, nullptr);
+		ResourceDecay::destroyAfterDelay(uploadBuffer[index].get());
+	}
+
+	ComPtr<ID3D12Resource> uploadBuffTemp = nullptr;
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)elementCount * elementByteSize);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&gUploadHeapDesc,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&uploadBuffTemp)));
+	SetName(uploadBuffTemp.Get(), L"Structured Buffer");
+
+	uploadBuffTemp->Map(0, nullptr, reinterpret_cast<void**>(&mappedData[index]));
+
+	uploadBuffer[index] = DX12Resource(DESCRIPTOR_TYPE_SRV, uploadBuffTemp.Get(), D3D12_RESOURCE_STATE_GENERIC_READ);
+	capacity[index] = elementCount;
+}
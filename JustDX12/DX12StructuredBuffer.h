@@ -0,0 +1,43 @@
+#pragma once
+#include <mutex>
+
+#include "ResourceClasses\DX12Resource.h"
+
+#include "DX12Helper.h"
+#include "Settings.h"
+
+using namespace Microsoft::WRL;
+
+// Growable array of fixed size elements that's bound as a StructuredBuffer SRV
+// Same cyclical buffering as DX12ConstantBuffer so we never overwrite data that's in use,
+// but the size isn't fixed at creation, each frame's buffer grows (and is replaced) the first time it's written past capacity.
+class DX12StructuredBuffer {
+public:
+	DX12StructuredBuffer(UINT elementByteSize, UINT initialCapacity, ID3D12Device5* device);
+	~DX12StructuredBuffer();
+
+	ID3D12Resource* get(UINT index);
+	DX12Resource* getDX12Resource(UINT index);
+	UINT getElementByteSize() const;
+	UINT getCapacity(UINT index) const;
+
+	// Copies 'elementCount' elements from 'src' into the buffer used by frame 'index', growing it if needed.
+	void updateBuffer(UINT index, const void* src, UINT elementCount);
+	// Makes sure the buffer used by frame 'index' can hold 'elementCount' elements.
+	// Returns true if the buffer had to be replaced, in which case its contents are undefined.
+	bool reserve(UINT index, UINT elementCount);
+	// Persistently mapped pointer to the start of the buffer used by frame 'index', for callers doing partial writes.
+	BYTE* getMappedData(UINT index);
+
+private:
+	void createBuffer(UINT index, UINT elementCount);
+
+	ID3D12Device5* device;
+	std::array<DX12Resource, CPU_FRAME_COUNT> uploadBuffer;
+	std::array<BYTE*, CPU_FRAME_COUNT> mappedData;
+	std::array<UINT, CPU_FRAME_COUNT> capacity;
+
+	UINT elementByteSize = 0;
+
+	std::mutex dataUpdate;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <climits>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the key packing and bind tracking can be built and checked off Windows too.
+#include <cstdint>
+typedef std::uint32_t UINT32;
+typedef std::uint64_t UINT64;
+#endif
+
+// Draw sort key layout, most significant first: pipeline state (shading rate), texture table, depth bucket, model.
+#define DRAW_KEY_PIPELINE_SHIFT 60
+#define DRAW_KEY_PIPELINE_MASK 0xFull
+#define DRAW_KEY_TEXTURE_SHIFT 40
+#define DRAW_KEY_TEXTURE_MASK 0xFFFFFull
+#define DRAW_KEY_DEPTH_SHIFT 24
+#define DRAW_KEY_DEPTH_MASK 0xFFFFull
+#define DRAW_KEY_MODEL_MASK 0xFFFFFFull
+
+// Sorting on this groups draws by the state that's most expensive to change first, and front to back within that.
+// 'shadingRate' is the D3D12_SHADING_RATE value and 'textureTable' the table's index in its heap, so nothing here needs d3d12.h.
+// Each field is masked to its bits, anything wider wraps instead of spilling into the field above it.
+inline UINT64 MakeDrawSortKey(UINT32 shadingRate, UINT64 textureTable, UINT32 depthBucket, UINT32 model) {
+	UINT64 pipeline = (UINT64)shadingRate & DRAW_KEY_PIPELINE_MASK;
+	UINT64 table = textureTable & DRAW_KEY_TEXTURE_MASK;
+	UINT64 depth = (UINT64)depthBucket & DRAW_KEY_DEPTH_MASK;
+	return (pipeline << DRAW_KEY_PIPELINE_SHIFT) | (table << DRAW_KEY_TEXTURE_SHIFT) | (depth << DRAW_KEY_DEPTH_SHIFT) | ((UINT64)model & DRAW_KEY_MODEL_MASK);
+}
+
+// The state recordDraws last bound, so each draw only sets what differs from the draw before it.
+// Every set returns whether the value changed and has to be bound, it's remembered as bound either way.
+// Models and meshes are only compared by address, so they're kept as plain pointers.
+class DrawBindState {
+public:
+	bool setShadingRate(UINT32 rate) {
+		if (shadingRateBound && rate == shadingRate) {
+			return false;
+		}
+		shadingRate = rate;
+		shadingRateBound = true;
+		return true;
+	}
+	// A null table is never valid, so nothing is bound to start with.
+	bool setTextureTable(UINT64 table) {
+		return change(textureTable, table);
+	}
+	// The DXGI_FORMAT of the index buffer, which starts out as DXGI_FORMAT_UNKNOWN (0).
+	bool setIndexFormat(UINT32 format) {
+		return change(indexFormat, format);
+	}
+	bool setObject(const void* model) {
+		return change(object, model);
+	}
+	bool setMeshInstanceCount(UINT32 count) {
+		return change(meshInstanceCount, count);
+	}
+	bool setDequantize(const void* mesh) {
+		return change(dequantize, mesh);
+	}
+	// Instance groups bind their own object transforms and a mesh instance count of 1, so they leave no object bound.
+	void setGroup() {
+		object = nullptr;
+		meshInstanceCount = 1;
+	}
+
+private:
+	template <typename T>
+	static bool change(T& bound, T value) {
+		if (bound == value) {
+			return false;
+		}
+		bound = value;
+		return true;
+	}
+
+	bool shadingRateBound = false;
+	UINT32 shadingRate = 0;
+	UINT64 textureTable = 0;
+	UINT32 indexFormat = 0;
+	const void* object = nullptr;
+	UINT32 meshInstanceCount = UINT_MAX;
+	const void* dequantize = nullptr;
+};
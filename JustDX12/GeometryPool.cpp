@@ -0,0 +1,350 @@
+#include <algorithm>
+
+#include "GeometryPool.h"
+#include "DX12App.h"
+#include "DX12Helper.h"
+#include "ResourceDecay.h"
+
+GeometryPool::GeometryPool(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice) {
+	device = d3dDevice.Get();
+	current = createBuffers(GEOMETRY_POOL_INITIAL_VERTICES, GEOMETRY_POOL_INITIAL_INDICES);
+	vertexRanges.reset(current.vertexCapacity, 0);
+	indexRanges.reset(current.indexCapacity, 0);
+}
+
+GeometryPool& GeometryPool::getInstance() {
+	static GeometryPool instance(DX12App::getDevice());
+	return instance;
+}
+
+void GeometryPool::destroyAll() {
+	auto& instance = GeometryPool::getInstance();
+	std::lock_guard<std::mutex> lk(instance.poolLock);
+	instance.current = PoolBuffers();
+	instance.pending = PoolBuffers();
+}
+
+void GeometryPool::reserve(ID3D12GraphicsCommandList* cmdList, const std::vector<std::pair<UINT, UINT>>& blockSizes) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	// Allocated on copies first, so fragmentation is accounted for the same way the uploads will see it.
+	RangeAllocator vertices = vertexRanges;
+	RangeAllocator indices = indexRanges;
+	bool fits = true;
+	UINT totalVertices = 0;
+	UINT totalIndices = 0;
+	for (const auto& [vertexCount, indexCount] : blockSizes) {
+		fits = fits && vertices.canAllocate(vertexCount) && indices.canAllocate(indexCount);
+		if (fits) {
+			vertices.allocate(vertexCount);
+			indices.allocate(indexCount);
+		}
+		totalVertices += vertexCount;
+		totalIndices += indexCount;
+	}
+	if (!fits) {
+		// A rebuild packs every live block, leaving one free range big enough for the whole batch.
+		rebuild(cmdList, std::max(vertexRanges.capacity * 2, vertexRanges.used + totalVertices),
+			std::max(indexRanges.capacity * 2, indexRanges.used + totalIndices));
+	}
+}
+
+GeometryHandle GeometryPool::upload(ID3D12GraphicsCommandList* cmdList, const std::vector<GpuVertex>& vertices, const std::vector<BYTE>& indexData,
+	Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer) {
+	if (indexData.size() % sizeof(UINT) != 0) {
+		throw "Geometry Pool index data isn't whole words";
+	}
+	std::lock_guard<std::mutex> lk(poolLock);
+	Block block;
+	block.vertexCount = (UINT)vertices.size();
+	block.indexCount = (UINT)(indexData.size() / sizeof(UINT));
+	if (!vertexRanges.canAllocate(block.vertexCount) || !indexRanges.canAllocate(block.indexCount)) {
+		// Doubling so a scene streaming in model by model doesn't rebuild the pool for every one of them.
+		UINT vertexCapacity = std::max(vertexRanges.capacity * 2, vertexRanges.used + block.vertexCount);
+		UINT indexCapacity = std::max(indexRanges.capacity * 2, indexRanges.used + block.indexCount);
+		rebuild(cmdList, vertexCapacity, indexCapacity);
+	}
+	block.layoutVertexOffset = vertexRanges.allocate(block.vertexCount);
+	block.layoutIndexOffset = indexRanges.allocate(block.indexCount);
+	block.state = BLOCK_STATE_UPLOADING;
+
+	// One upload buffer for both, so the whole model goes up in two copies.
+	UINT64 vertexBytes = sizeof(GpuVertex) * (UINT64)block.vertexCount;
+	UINT64 indexBytes = indexData.size();
+	uploadBuffer = CreateBlankBuffer(device, nullptr, std::max(vertexBytes + indexBytes, 1ull), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, gUploadHeapDesc);
+	BYTE* mapped = nullptr;
+	ThrowIfFailed(uploadBuffer->Map(0, nullptr, (void**)&mapped));
+	memcpy(mapped, vertices.data(), vertexBytes);
+	memcpy(mapped + vertexBytes, indexData.data(), indexBytes);
+	uploadBuffer->Unmap(0, nullptr);
+
+	PoolBuffers& target = pending.vertices ? pending : current;
+	if (vertexBytes > 0) {
+		cmdList->CopyBufferRegion(target.vertices.Get(), sizeof(GpuVertex) * (UINT64)block.layoutVertexOffset, uploadBuffer.Get(), 0, vertexBytes);
+	}
+	if (indexBytes > 0) {
+		cmdList->CopyBufferRegion(target.indices.Get(), sizeof(UINT) * (UINT64)block.layoutIndexOffset, uploadBuffer.Get(), vertexBytes, indexBytes);
+	}
+
+	GeometryHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		blocks[handle] = block;
+	}
+	else {
+		handle = (GeometryHandle)blocks.size();
+		blocks.push_back(block);
+	}
+	return handle;
+}
+
+void GeometryPool::release(GeometryHandle handle) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	releasedBlocks[gFrameIndex].push_back(handle);
+}
+
+bool GeometryPool::compact(ID3D12GraphicsCommandList* cmdList) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	if (!shouldCompact()) {
+		return false;
+	}
+	// Leaves room to grow so loading something right after doesn't immediately rebuild again.
+	rebuild(cmdList, std::max(vertexRanges.used * 2, (UINT)GEOMETRY_POOL_INITIAL_VERTICES),
+		std::max(indexRanges.used * 2, (UINT)GEOMETRY_POOL_INITIAL_INDICES));
+	return true;
+}
+
+void GeometryPool::uploadsComplete() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	for (auto& block : blocks) {
+		if (block.state == BLOCK_STATE_UPLOADING) {
+			block.state = BLOCK_STATE_UPLOADED;
+		}
+	}
+	if (pending.vertices) {
+		rebuildReady = true;
+	}
+}
+
+void GeometryPool::beginFrame() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	for (GeometryHandle handle : releasedBlocks[gFrameIndex]) {
+		Block& block = blocks[handle];
+		vertexRanges.release(block.layoutVertexOffset, block.vertexCount);
+		indexRanges.release(block.layoutIndexOffset, block.indexCount);
+		block = Block();
+		freeHandles.push_back(handle);
+	}
+	releasedBlocks[gFrameIndex].clear();
+
+	if (pending.vertices && rebuildReady) {
+		ResourceDecay::destroyAfterDelay(current.vertices);
+		ResourceDecay::destroyAfterDelay(current.indices);
+		current = std::move(pending);
+		pending = PoolBuffers();
+		rebuildReady = false;
+		bufferGeneration++;
+		for (auto& block : blocks) {
+			if (block.state == BLOCK_STATE_RESIDENT) {
+				block.vertexOffset = block.layoutVertexOffset;
+				block.indexOffset = block.layoutIndexOffset;
+			}
+		}
+	}
+	// Uploads into a pending rebuild's buffers have to wait for it to be swapped in.
+	if (!pending.vertices) {
+		for (auto& block : blocks) {
+			if (block.state == BLOCK_STATE_UPLOADED) {
+				block.vertexOffset = block.layoutVertexOffset;
+				block.indexOffset = block.layoutIndexOffset;
+				block.state = BLOCK_STATE_RESIDENT;
+			}
+		}
+	}
+}
+
+bool GeometryPool::wantsCompaction() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return shouldCompact();
+}
+
+bool GeometryPool::isResident(GeometryHandle handle) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return blocks[handle].state == BLOCK_STATE_RESIDENT;
+}
+
+UINT GeometryPool::getVertexOffset(GeometryHandle handle) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return blocks[handle].vertexOffset;
+}
+
+UINT GeometryPool::getIndexOffset(GeometryHandle handle) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return blocks[handle].indexOffset;
+}
+
+D3D12_VERTEX_BUFFER_VIEW GeometryPool::getVertexBufferView() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	vbv.BufferLocation = current.vertices->GetGPUVirtualAddress();
+	vbv.StrideInBytes = sizeof(GpuVertex);
+	vbv.SizeInBytes = sizeof(GpuVertex) * current.vertexCapacity;
+	return vbv;
+}
+
+D3D12_INDEX_BUFFER_VIEW GeometryPool::getIndexBufferView(DXGI_FORMAT format) {
+	std::lock_guard<std::mutex> lk(poolLock);
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	ibv.BufferLocation = current.indices->GetGPUVirtualAddress();
+	ibv.Format = format;
+	ibv.SizeInBytes = sizeof(UINT) * current.indexCapacity;
+	return ibv;
+}
+
+DX12Resource* GeometryPool::getVertexResource() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return current.vertexResource.get();
+}
+
+DX12Resource* GeometryPool::getIndexResource() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return current.indexResource.get();
+}
+
+UINT64 GeometryPool::getBufferGeneration() {
+	std::lock_guard<std::mutex> lk(poolLock);
+	return bufferGeneration;
+}
+
+GeometryPool::PoolBuffers GeometryPool::createBuffers(UINT vertexCapacity, UINT indexCapacity) {
+	PoolBuffers buffers;
+	buffers.vertexCapacity = vertexCapacity;
+	buffers.indexCapacity = indexCapacity;
+	buffers.vertices = CreateBlankBuffer(device, nullptr, sizeof(GpuVertex) * (UINT64)buffers.vertexCapacity, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, gDefaultHeapDesc);
+	buffers.indices = CreateBlankBuffer(device, nullptr, sizeof(UINT) * (UINT64)buffers.indexCapacity, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, gDefaultHeapDesc);
+	SetName(buffers.vertices.Get(), L"Geometry Pool Vertices");
+	SetName(buffers.indices.Get(), L"Geometry Pool Indices");
+	buffers.vertexResource = std::make_unique<DX12Resource>(DESCRIPTOR_TYPE_CBV, buffers.vertices.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	buffers.indexResource = std::make_unique<DX12Resource>(DESCRIPTOR_TYPE_CBV, buffers.indices.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	return buffers;
+}
+
+void GeometryPool::rebuild(ID3D12GraphicsCommandList* cmdList, UINT vertexCapacity, UINT indexCapacity) {
+	PoolBuffers& source = pending.vertices ? pending : current;
+	PoolBuffers rebuilt = createBuffers(vertexCapacity, indexCapacity);
+
+	// Blocks are packed in the order they sit in the source, so neighbours stay neighbours and go over in a single copy.
+	std::vector<Block*> liveBlocks;
+	for (auto& block : blocks) {
+		if (block.state != BLOCK_STATE_FREE) {
+			liveBlocks.push_back(&block);
+		}
+	}
+	auto copyPacked = [&](ID3D12Resource* dest, ID3D12Resource* src, UINT64 stride, UINT Block::* layoutOffset, UINT Block::* count) {
+		std::sort(liveBlocks.begin(), liveBlocks.end(), [&](const Block* a, const Block* b) { return a->*layoutOffset < b->*layoutOffset; });
+		UINT packedOffset = 0;
+		UINT runSource = 0;
+		UINT runDest = 0;
+		UINT runCount = 0;
+		for (Block* block : liveBlocks) {
+			if (runCount > 0 && runSource + runCount != block->*layoutOffset) {
+				cmdList->CopyBufferRegion(dest, stride * runDest, src, stride * runSource, stride * runCount);
+				runCount = 0;
+			}
+			if (runCount == 0) {
+				runSource = block->*layoutOffset;
+				runDest = packedOffset;
+			}
+			runCount += block->*count;
+			block->*layoutOffset = packedOffset;
+			packedOffset += block->*count;
+		}
+		if (runCount > 0) {
+			cmdList->CopyBufferRegion(dest, stride * runDest, src, stride * runSource, stride * runCount);
+		}
+		return packedOffset;
+	};
+	UINT usedVertices = copyPacked(rebuilt.vertices.Get(), source.vertices.Get(), sizeof(GpuVertex), &Block::layoutVertexOffset, &Block::vertexCount);
+	UINT usedIndices = copyPacked(rebuilt.indices.Get(), source.indices.Get(), sizeof(UINT), &Block::layoutIndexOffset, &Block::indexCount);
+	vertexRanges.reset(rebuilt.vertexCapacity, usedVertices);
+	indexRanges.reset(rebuilt.indexCapacity, usedIndices);
+
+	// A rebuild that never got swapped in was only ever read by the copy that just got recorded.
+	if (pending.vertices) {
+		ResourceDecay::destroyAfterDelay(pending.vertices);
+		ResourceDecay::destroyAfterDelay(pending.indices);
+	}
+	pending = std::move(rebuilt);
+	rebuildReady = false;
+}
+
+bool GeometryPool::shouldCompact() const {
+	if (pending.vertices) {
+		return false;
+	}
+	bool vertexWaste = vertexRanges.capacity > GEOMETRY_POOL_INITIAL_VERTICES && vertexRanges.used < vertexRanges.capacity / 4;
+	bool indexWaste = indexRanges.capacity > GEOMETRY_POOL_INITIAL_INDICES && indexRanges.used < indexRanges.capacity / 4;
+	return vertexWaste || indexWaste;
+}
+
+void GeometryPool::RangeAllocator::reset(UINT capacity, UINT used) {
+	this->capacity = capacity;
+	this->used = used;
+	freeRanges.clear();
+	if (used < capacity) {
+		freeRanges.push_back({ used, capacity - used });
+	}
+}
+
+bool GeometryPool::RangeAllocator::canAllocate(UINT count) const {
+	if (count == 0) {
+		return true;
+	}
+	for (const auto& range : freeRanges) {
+		if (range.capacity >= count) {
+			return true;
+		}
+	}
+	return false;
+}
+
+UINT GeometryPool::RangeAllocator::allocate(UINT count) {
+	if (count == 0) {
+		return 0;
+	}
+	for (auto iter = freeRanges.begin(); iter != freeRanges.end(); iter++) {
+		if (iter->capacity >= count) {
+			UINT offset = iter->offset;
+			iter->offset += count;
+			iter->capacity -= count;
+			if (iter->capacity == 0) {
+				freeRanges.erase(iter);
+			}
+			used += count;
+			return offset;
+		}
+	}
+	throw "Geometry Pool out of space";
+}
+
+void GeometryPool::RangeAllocator::release(UINT offset, UINT count) {
+	if (count == 0) {
+		return;
+	}
+	used -= count;
+	auto iter = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const FreeRange& range, UINT value) { return range.offset < value; });
+	iter = freeRanges.insert(iter, { offset, count });
+	// Merge with the following range, then the preceding one.
+	auto next = iter + 1;
+	if (next != freeRanges.end() && iter->offset + iter->capacity == next->offset) {
+		iter->capacity += next->capacity;
+		freeRanges.erase(next);
+	}
+	if (iter != freeRanges.begin()) {
+		auto prev = iter - 1;
+		if (prev->offset + prev->capacity == iter->offset) {
+			prev->capacity += iter->capacity;
+			freeRanges.erase(iter);
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <mutex>
+#include <memory>
+
+#include "ModelLoading\Mesh.h"
+#include "ResourceClasses\DX12Resource.h"
+#include "Settings.h"
+
+// Vertex format stored in the pool.
+#ifdef COMPACT_VERTICES
+typedef CompactVertex GpuVertex;
+#else
+typedef Vertex GpuVertex;
+#endif
+
+// Stable reference to a model's block of vertices and indices in the GeometryPool.
+// The block may move when the pool grows or compacts, the handle stays valid until it's released.
+typedef UINT GeometryHandle;
+#define INVALID_GEOMETRY_HANDLE UINT_MAX
+
+// Singleton holding the geometry of every SimpleModel in one vertex buffer and one index buffer,
+// so models can be drawn back to back without rebinding either.
+// The index buffer is allocated in 32 bit words, 16 bit indices are packed two to a word and read through an R16_UINT view of the same buffer.
+// Uploads are recorded on the ModelLoader's copy list straight into free space. D3D12 buffers need no barrier to be copied
+// into one part while the GPU reads another, what keeps the two apart is the poolLock every method takes: space is only
+// handed out under it, released blocks only go back to the allocator in beginFrame, CPU_FRAME_COUNT frames later,
+// and offsets only point readers at a block once beginFrame has made it resident. When there's no room the pool is rebuilt:
+// every live block is copied (compacted) into new, bigger buffers, which only replace the ones in use at the next beginFrame.
+// The same rebuild shrinks the pool once enough has been unloaded.
+class GeometryPool {
+private:
+	GeometryPool(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice);
+	GeometryPool(GeometryPool const&) = delete;
+	void operator=(GeometryPool const&) = delete;
+
+public:
+	static GeometryPool& getInstance();
+	// Releases the GPU buffers, has to be called before ResourceDecay::destroyAll().
+	static void destroyAll();
+
+	// Makes room for blocks of the given sizes (vertices, 32 bit index words) with at most one rebuild, recorded on 'cmdList'.
+	// Lists uploading several models call it first: a rebuild copies out of the pool's buffers, and without a barrier
+	// that can't come after copies into them recorded earlier in the same list.
+	void reserve(ID3D12GraphicsCommandList* cmdList, const std::vector<std::pair<UINT, UINT>>& blockSizes);
+	// Suballocates a block for the geometry and records its copy on 'cmdList' (a copy list).
+	// 'uploadBuffer' holds the data until the list has executed. 'indexData' can mix 16 and 32 bit indices (each aligned to its size),
+	// relative to the block's first vertex, and is padded to a whole number of words.
+	// Rebuilds the pool if there's no room, which is only safe if nothing before it on 'cmdList' copied into the pool, see reserve.
+	GeometryHandle upload(ID3D12GraphicsCommandList* cmdList, const std::vector<GpuVertex>& vertices, const std::vector<BYTE>& indexData,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
+	// The block's space is only reused once every frame that could still be drawing it is done.
+	void release(GeometryHandle handle);
+	// Rebuilds the pool into smaller buffers if most of it is unused, recording the copies on 'cmdList'.
+	// Returns false without recording anything if there's nothing worth compacting.
+	bool compact(ID3D12GraphicsCommandList* cmdList);
+	// Has to be called once every list passed to upload or compact has finished executing.
+	void uploadsComplete();
+	// Frees blocks released CPU_FRAME_COUNT frames ago, switches to rebuilt buffers once their copies are done,
+	// and makes finished uploads resident. Must be called at the start of every frame, before any stage records draws.
+	void beginFrame();
+	bool wantsCompaction();
+
+	// A block can only be drawn once it's resident, until then its offsets don't point at its data.
+	bool isResident(GeometryHandle handle);
+	UINT getVertexOffset(GeometryHandle handle);
+	// In 32 bit words, see Mesh::getPoolStartIndexLocation.
+	UINT getIndexOffset(GeometryHandle handle);
+
+	D3D12_VERTEX_BUFFER_VIEW getVertexBufferView();
+	// 'format' is R32_UINT or R16_UINT.
+	D3D12_INDEX_BUFFER_VIEW getIndexBufferView(DXGI_FORMAT format = DXGI_FORMAT_R32_UINT);
+	DX12Resource* getVertexResource();
+	DX12Resource* getIndexResource();
+	// Incremented whenever the buffers are replaced, anyone holding descriptors into them needs to rebuild them.
+	UINT64 getBufferGeneration();
+
+private:
+	enum BLOCK_STATE {
+		BLOCK_STATE_FREE,
+		// Copy recorded, but the list hasn't finished.
+		BLOCK_STATE_UPLOADING,
+		// Copy finished, waiting for beginFrame.
+		BLOCK_STATE_UPLOADED,
+		BLOCK_STATE_RESIDENT
+	};
+	struct Block {
+		BLOCK_STATE state = BLOCK_STATE_FREE;
+		// Where readers find the block, in the buffers in use.
+		UINT vertexOffset = 0;
+		UINT indexOffset = 0;
+		// Where the block is in the buffers new data goes to (the rebuilt ones while a rebuild is pending).
+		UINT layoutVertexOffset = 0;
+		UINT layoutIndexOffset = 0;
+		UINT vertexCount = 0;
+		// In 32 bit words.
+		UINT indexCount = 0;
+	};
+	struct FreeRange {
+		UINT offset;
+		UINT capacity;
+	};
+	// First fit allocator over one of the buffers, kept sorted by offset so neighbours merge on release.
+	struct RangeAllocator {
+		std::vector<FreeRange> freeRanges;
+		UINT capacity = 0;
+		UINT used = 0;
+
+		void reset(UINT capacity, UINT used);
+		bool canAllocate(UINT count) const;
+		UINT allocate(UINT count);
+		void release(UINT offset, UINT count);
+	};
+	struct PoolBuffers {
+		Microsoft::WRL::ComPtr<ID3D12Resource> vertices;
+		Microsoft::WRL::ComPtr<ID3D12Resource> indices;
+		std::unique_ptr<DX12Resource> vertexResource;
+		std::unique_ptr<DX12Resource> indexResource;
+		UINT vertexCapacity = 0;
+		UINT indexCapacity = 0;
+	};
+
+	PoolBuffers createBuffers(UINT vertexCapacity, UINT indexCapacity);
+	// Copies every live block, packed, into new buffers of the given capacity, which become the pending buffers.
+	void rebuild(ID3D12GraphicsCommandList* cmdList, UINT vertexCapacity, UINT indexCapacity);
+	bool shouldCompact() const;
+
+	ID3D12Device5* device;
+	std::mutex poolLock;
+
+	std::vector<Block> blocks;
+	std::vector<GeometryHandle> freeHandles;
+	std::array<std::vector<GeometryHandle>, CPU_FRAME_COUNT> releasedBlocks;
+
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+
+	PoolBuffers current;
+	// Only has buffers while a rebuild is waiting to replace 'current'.
+	PoolBuffers pending;
+	bool rebuildReady = false;
+	UINT64 bufferGeneration = 0;
+};
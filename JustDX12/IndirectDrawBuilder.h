@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the packing can be built and checked off Windows too.
+#include <cstdint>
+typedef std::uint32_t UINT32;
+typedef std::uint64_t UINT64;
+#endif
+
+// Packs a sorted draw list into an ExecuteIndirect argument stream, entirely on the CPU so it doesn't need a device.
+// Descriptor tables and shading rates can't be changed from an argument buffer, so the stream is split into runs
+// that share both, each run is one ExecuteIndirect with the table and rate set before it.
+// 'Command' is the packed argument struct (IndirectDrawCommand for the renderer), the table is kept as the
+// D3D12_GPU_DESCRIPTOR_HANDLE's ptr and the rate as the D3D12_SHADING_RATE value, so nothing here needs d3d12.h.
+template <typename Command>
+class IndirectDrawBuilder {
+public:
+	struct Run {
+		UINT32 firstCommand;
+		UINT32 commandCount;
+		UINT64 textureTable;
+		UINT32 shadingRate;
+	};
+
+	void clear() {
+		commands.clear();
+		runs.clear();
+	}
+
+	// Starts a new run if the table or rate differ from the last draw added.
+	void addDraw(const Command& command, UINT64 textureTable, UINT32 shadingRate) {
+		if (runs.empty() || runs.back().textureTable != textureTable || runs.back().shadingRate != shadingRate) {
+			runs.push_back({ (UINT32)commands.size(), 0, textureTable, shadingRate });
+		}
+		runs.back().commandCount++;
+		commands.push_back(command);
+	}
+
+	const std::vector<Command>& getCommands() const {
+		return commands;
+	}
+	const std::vector<Run>& getRuns() const {
+		return runs;
+	}
+
+private:
+	std::vector<Command> commands;
+	std::vector<Run> runs;
+};
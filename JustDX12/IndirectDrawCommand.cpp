@@ -0,0 +1,43 @@
+#include <cstddef>
+
+#include "IndirectDrawCommand.h"
+
+// The command signature reads the arguments tightly packed, any padding the compiler adds would shift everything after it.
+static_assert(offsetof(IndirectDrawCommand, indexBuffer) == sizeof(D3D12_VERTEX_BUFFER_VIEW));
+static_assert(offsetof(IndirectDrawCommand, objectTransforms) == offsetof(IndirectDrawCommand, indexBuffer) + sizeof(D3D12_INDEX_BUFFER_VIEW));
+static_assert(offsetof(IndirectDrawCommand, meshTransforms) == offsetof(IndirectDrawCommand, objectTransforms) + sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+static_assert(offsetof(IndirectDrawCommand, instanceCounts) == offsetof(IndirectDrawCommand, meshTransforms) + sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+#ifdef COMPACT_VERTICES
+static_assert(offsetof(IndirectDrawCommand, vertexDequantize) == offsetof(IndirectDrawCommand, instanceCounts) + 2 * sizeof(UINT));
+static_assert(offsetof(IndirectDrawCommand, draw) == offsetof(IndirectDrawCommand, vertexDequantize) + 8 * sizeof(float));
+#else
+static_assert(offsetof(IndirectDrawCommand, draw) == offsetof(IndirectDrawCommand, instanceCounts) + 2 * sizeof(UINT));
+#endif
+static_assert(sizeof(IndirectDrawCommand) % 4 == 0);
+
+std::vector<D3D12_INDIRECT_ARGUMENT_DESC> GetIndirectArgumentDescs(UINT objectTransformSlot, UINT meshTransformSlot, UINT instanceCountSlot, UINT vertexDequantizeSlot) {
+	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> descs(5);
+	descs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	descs[0].VertexBuffer.Slot = 0;
+	descs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	descs[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+	descs[2].ShaderResourceView.RootParameterIndex = objectTransformSlot;
+	descs[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+	descs[3].ShaderResourceView.RootParameterIndex = meshTransformSlot;
+	descs[4].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	descs[4].Constant.RootParameterIndex = instanceCountSlot;
+	descs[4].Constant.DestOffsetIn32BitValues = 0;
+	descs[4].Constant.Num32BitValuesToSet = 2;
+#ifdef COMPACT_VERTICES
+	D3D12_INDIRECT_ARGUMENT_DESC dequantize = {};
+	dequantize.Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	dequantize.Constant.RootParameterIndex = vertexDequantizeSlot;
+	dequantize.Constant.DestOffsetIn32BitValues = 0;
+	dequantize.Constant.Num32BitValuesToSet = 8;
+	descs.push_back(dequantize);
+#endif
+	D3D12_INDIRECT_ARGUMENT_DESC draw = {};
+	draw.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+	descs.push_back(draw);
+	return descs;
+}
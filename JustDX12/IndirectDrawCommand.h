@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <d3d12.h>
+
+#include "IndirectDrawBuilder.h"
+#include "Settings.h"
+
+// One draw of the argument stream, members are in the order of the descs from GetIndirectArgumentDescs
+// with no padding between them, so the struct can be copied into the argument buffer as is.
+struct IndirectDrawCommand {
+	D3D12_VERTEX_BUFFER_VIEW vertexBuffer;
+	D3D12_INDEX_BUFFER_VIEW indexBuffer;
+	D3D12_GPU_VIRTUAL_ADDRESS objectTransforms;
+	D3D12_GPU_VIRTUAL_ADDRESS meshTransforms;
+	UINT instanceCounts[2];
+#ifdef COMPACT_VERTICES
+	// Mesh::positionOffset and positionScale, each padded to a float4.
+	float vertexDequantize[8];
+#endif
+	D3D12_DRAW_INDEXED_ARGUMENTS draw;
+};
+
+typedef IndirectDrawBuilder<IndirectDrawCommand> IndirectDrawCommandBuilder;
+
+// Argument layout of IndirectDrawCommand for a command signature, slots are the root parameter indices.
+// The instance counts are 2 root constants starting at the first one of 'instanceCountSlot'.
+// 'vertexDequantizeSlot' is only used with COMPACT_VERTICES.
+std::vector<D3D12_INDIRECT_ARGUMENT_DESC> GetIndirectArgumentDescs(UINT objectTransformSlot, UINT meshTransformSlot, UINT instanceCountSlot, UINT vertexDequantizeSlot);
@@ -22,9 +22,14 @@
 #include "ModelLoading/TextureLoader.h"
 #include "SceneCsv.h"
 #include "FileSelect.h"
+#include "ModelLoading/MappedFile.h"
+#include "ModelLoading/MeshletCompression.h"
 
 #include <random>
 #include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <ResourceDecay.h>
 
 std::string baseDir = "..\\Models";
@@ -104,8 +109,6 @@ private:
 	KeyboardWrapper keyboard;
 
 	PerPassConstants mainPassCB;
-	PerObjectConstants perObjCB;
-	PerObjectConstants perMeshletObjCB;
 	VrsConstants vrsCB;
 	SSAOConstants ssaoConstantCB;
 	LightData lightDataCB;
@@ -125,7 +128,31 @@ private:
 	POINT lastMousePos;
 };
 
+// "-convertMeshlets <input> <output> [-quantize]" rewrites a meshlet .bin as a chunked, compressed one instead of running.
+static int convertMeshletFile(const std::string& arguments) {
+	std::istringstream stream(arguments);
+	std::string command, input, output, option;
+	stream >> command >> std::quoted(input) >> std::quoted(output) >> option;
+	MappedFile file;
+	if (input.empty() || output.empty() || !file.open(input)) {
+		OutputDebugStringA(("Couldn't open meshlet file to convert: " + input + "\n").c_str());
+		return 1;
+	}
+	std::ofstream outputFile(output, std::ios::binary);
+	std::string error;
+	if (!CompressMeshletFile(file.bytes(), outputFile, option == "-quantize", error)) {
+		OutputDebugStringA(("Couldn't convert " + input + ": " + error + "\n").c_str());
+		return 1;
+	}
+	OutputDebugStringA(("Converted " + input + ", " + std::to_string(file.bytes().size() / 1024) + " KB to "
+		+ std::to_string((UINT64)outputFile.tellp() / 1024) + " KB\n").c_str());
+	return 0;
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd) {
+	if (std::string(cmdLine).rfind("-convertMeshlets", 0) == 0) {
+		return convertMeshletFile(cmdLine);
+	}
 #if defined(DEBUG) | defined(_DEBUG) || GPU_DEBUG
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
@@ -170,6 +197,8 @@ DemoApp::~DemoApp() {
 	WaitForMultipleObjects(threadsOngoing.size(), threadsOngoing.data(), true, INFINITE);
 	// Have to explicitly call ModelLoader clear first since it dumps resources into ResourceDecay.
 	ModelLoader::destroyAll();
+	TransformArena::destroyAll();
+	GeometryPool::destroyAll();
 	ResourceDecay::destroyAll();
 	TextureLoader::getInstance().destroyAll();
 	ImGui_ImplDX12_Shutdown();
@@ -207,16 +236,24 @@ bool DemoApp::initialize() {
 		rasterDesc.resourceJobs.push_back(ResourceJob("emissive", DESCRIPTOR_TYPE_SRV | DESCRIPTOR_TYPE_RTV | DESCRIPTOR_TYPE_FLAG_SIMULTANEOUS_ACCESS));
 		rasterDesc.resourceJobs.push_back(ResourceJob("depthTex", DESCRIPTOR_TYPE_SRV | DESCRIPTOR_TYPE_DSV, DEPTH_TEXTURE_FORMAT));
 
-		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerObjectConstants", ROOT_PARAMETER_TYPE_CONSTANT_BUFFER, 0, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
-		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerMeshConstants", ROOT_PARAMETER_TYPE_CONSTANT_BUFFER, 1, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
+		// Transforms live in space1 so the texture table keeps t0-t3.
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerObjectTransforms", ROOT_PARAMETER_TYPE_SRV, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_SYSTEM_DEFINED, 1));
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerMeshTransforms", ROOT_PARAMETER_TYPE_SRV, 1, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_SYSTEM_DEFINED, 1));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("texture_diffuse", ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, 2, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerPassConstants", ROOT_PARAMETER_TYPE_CONSTANT_BUFFER, 3, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, DESCRIPTOR_USAGE_PER_PASS));
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("InstanceCounts", ROOT_PARAMETER_TYPE_CONSTANTS, 4, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
+#ifdef COMPACT_VERTICES
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("VertexDequantize", ROOT_PARAMETER_TYPE_CONSTANTS, 5, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 8, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
+#endif
 
 		std::vector<DXDefine> defines;
 		defines.push_back(DXDefine(L"VRS", L""));
 		if (vrsSupport.AdditionalShadingRatesSupported == true) {
 			defines.push_back(DXDefine(L"VRS_4X4", L""));
 		}
+#ifdef COMPACT_VERTICES
+		defines.push_back(DXDefine(L"COMPACT_VERTICES", L""));
+#endif
 
 		rasterDesc.shaderFiles.push_back(ShaderDesc("Default.hlsl", "Vertex Shader", "VS", SHADER_TYPE_VS, defines));
 		rasterDesc.shaderFiles.push_back(ShaderDesc("Default.hlsl", "Pixel Shader", "PS", SHADER_TYPE_PS, defines));
@@ -235,6 +272,10 @@ bool DemoApp::initialize() {
 		rDesc.perObjTransformCBSlot = 0;
 		rDesc.perMeshTransformCBSlot = 1;
 		rDesc.perMeshTextureSlot = 2;
+		rDesc.instanceCountSlot = 4;
+#ifdef COMPACT_VERTICES
+		rDesc.vertexDequantizeSlot = 5;
+#endif
 		rDesc.supportsCulling = true;
 		rDesc.supportsVRS = true;
 
@@ -258,8 +299,6 @@ bool DemoApp::initialize() {
 		PipeLineStageDesc rasterDesc;
 		rasterDesc.name = "Meshlet Forward Pass";
 
-		rasterDesc.constantBufferJobs.push_back(ConstantBufferJob("PerObjectConstantsMeshlet", new PerObjectConstants(), 0));
-
 		rasterDesc.externalConstantBuffers.push_back(std::make_pair(IndexedName("PerPassConstants", 0), renderStage->getConstantBuffer(IndexedName("PerPassConstants", 0))));
 
 		rasterDesc.externalResources.push_back(std::make_pair("depthTex", renderStage->getResource("depthTex")));
@@ -285,9 +324,10 @@ bool DemoApp::initialize() {
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("UniqueVertexIndices", ROOT_PARAMETER_TYPE_SRV, 3, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_PER_MESHLET));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("PrimitiveIndices", ROOT_PARAMETER_TYPE_SRV, 4, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_PER_MESHLET));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("MeshletCullData", ROOT_PARAMETER_TYPE_SRV, 5, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_PER_MESHLET));
-		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerObjectConstantsMeshlet", ROOT_PARAMETER_TYPE_CONSTANT_BUFFER, 6, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, DESCRIPTOR_USAGE_PER_OBJECT));
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerObjectTransformsMeshlet", ROOT_PARAMETER_TYPE_SRV, 6, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, DESCRIPTOR_USAGE_SYSTEM_DEFINED, 1));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("mesh_texture_diffuse", ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, 7, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, DESCRIPTOR_USAGE_PER_OBJECT));
 		rasterDesc.rootSigDesc.push_back(RootParamDesc("PerPassConstants", ROOT_PARAMETER_TYPE_CONSTANT_BUFFER, 8, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, DESCRIPTOR_USAGE_PER_PASS));
+		rasterDesc.rootSigDesc.push_back(RootParamDesc("MeshletInstances", ROOT_PARAMETER_TYPE_CONSTANTS, 9, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, DESCRIPTOR_USAGE_SYSTEM_DEFINED));
 
 		std::vector<DXDefine> defines;
 		defines.push_back(DXDefine(L"VRS", L""));
@@ -314,6 +354,7 @@ bool DemoApp::initialize() {
 		rDesc.perObjTransformCBSlot = 6;
 		rDesc.perMeshTransformCBSlot = -1;
 		rDesc.perMeshTextureSlot = 7;
+		rDesc.instanceCountSlot = 9;
 		rDesc.clearDepthTex = false;
 		rDesc.clearRenderTargets = false;
 		rDesc.supportsCulling = true;
@@ -340,6 +381,10 @@ bool DemoApp::initialize() {
 			DXDefine(L"MAX_LIGHTS", std::to_wstring(MAX_LIGHTS)),
 			DXDefine(L"RT_SUPPORT", std::to_wstring((int)supportsRt()))
 		};
+#ifdef COMPACT_VERTICES
+		// RT hits read the model's vertices straight out of the GeometryPool.
+		defines.push_back(DXDefine(L"COMPACT_VERTICES", L""));
+#endif
 
 		PipeLineStageDesc stageDesc;
 		stageDesc.name = "Deferred Shading";
@@ -601,6 +646,7 @@ bool DemoApp::initialize() {
 	// Have to wait for at least one model to be in each RenderPipelineStage or some issues arise.
 	while (modelLoader.isEmpty()) {
 		ResourceDecay::checkDestroy();
+		ModelLoader::updateGeometry();
 	}
 
 	mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr);
@@ -659,6 +705,7 @@ void DemoApp::update() {
 	}
 
 	ResourceDecay::checkDestroy();
+	ModelLoader::updateGeometry();
 	ModelLoader::getInstance().isEmpty();
 
 	UpdateObjectCBs();
@@ -803,7 +850,14 @@ void DemoApp::ImGuiPrepareUI() {
 	ImGui::Text("Position: %.3f %.3f %.3f", eyePos.x, eyePos.y, eyePos.z);
 	ImGui::Checkbox("Frustrum Culling", &renderStage->frustrumCull);
 	ImGui::Checkbox("Freeze Culling", &freezeCull);
-	ImGui::Checkbox("Occlusion Predication Culling", &renderStage->occlusionCull);
+	ImGui::Checkbox("Occlusion Culling", &renderStage->occlusionCull);
+	ImGui::Checkbox("Sort Draws", &renderStage->sortDraws);
+	ImGui::Checkbox("Indirect Draws", &renderStage->indirectDraws);
+	ImGui::Checkbox("Auto Instancing", &renderStage->autoInstance);
+	ImGui::Checkbox("Mesh LODs", &renderStage->meshLods);
+	ImGui::Text("Draws: %u Indirect: %u Geometry: %u Textures: %u Shading Rates: %u Record: %.3fms", renderStage->drawStats.draws, renderStage->drawStats.indirectCalls,
+		renderStage->drawStats.geometryChanges, renderStage->drawStats.textureChanges, renderStage->drawStats.shadingRateChanges, renderStage->drawStats.recordTime);
+	ImGui::Text("Triangles: %u (%u drawn at a coarser LOD)", renderStage->drawStats.triangles, renderStage->drawStats.lodDraws);
 	ImGui::Checkbox("Meshlet Normal Cone Culling", (bool*)&mainPassCB.data.meshletCull);
 	ImGui::Checkbox("VRS", &VRS);
 	ImGui::Checkbox("Render VRS", &renderVRS);
@@ -856,7 +910,8 @@ void DemoApp::ImGuiPrepareUI() {
 			ImGui::Text(("Name: " + data.first).c_str());
 			bool requiresUpdate = false;
 			int instanceCount = data.second.instances.size();
-			requiresUpdate |= ImGui::SliderInt((data.first + " Instances: ").c_str(), &instanceCount, 1, MAX_INSTANCES);
+			requiresUpdate |= ImGui::InputInt((data.first + " Instances: ").c_str(), &instanceCount);
+			instanceCount = std::max(instanceCount, 1);
 			ImGui::BeginTabBar(("Instance Params" + data.first).c_str());
 			if (requiresUpdate) {
 				data.second.instances.resize(instanceCount);
@@ -1105,8 +1160,11 @@ void DemoApp::UpdateMainPassCB() {
 	if (!freezeCull) {
 		renderStage->frustrum = DirectX::BoundingFrustum(proj);
 		renderStage->frustrum.Transform(renderStage->frustrum, invView);
+		meshletStage->frustrum = renderStage->frustrum;
+		XMStoreFloat4x4(&renderStage->viewProj, viewProj);
 	}
 	renderStage->eyePos = DirectX::XMFLOAT3(eyePos.x, eyePos.y, eyePos.z);
+	renderStage->pixelsPerUnit = this->proj._22 * gScreenHeight * 0.5f;
 	renderStage->VRS = VRS;
 	deferStage->VRS = VRS;
 }
\ No newline at end of file
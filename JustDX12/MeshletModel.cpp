@@ -7,9 +7,19 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <atomic>
 #include <ModelLoading\TextureLoader.h>
 
 #include "ModelLoading/ModelLoader.h"
+#include "ModelLoading/MeshletBuilder.h"
+#include "ModelLoading/MeshletCompression.h"
+#include "ModelLoading/MeshletFile.h"
+#include "ModelLoading/MeshletHierarchy.h"
+#include "ModelLoading/MeshOptimizer.h"
+#include "ThreadPool.h"
+#include "Tasks/Task.h"
+#include "Settings.h"
 
 const D3D12_INPUT_ELEMENT_DESC elementDescs[Attribute::Count] = {
 	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 1 },
@@ -27,204 +37,234 @@ const UINT32 sizeMap[] = {
 	12  // Bitangent
 };
 
-const UINT32 prolog = 'MSHL';
+static_assert(MESHLET_MAX_VERTICES <= MESHLET_GROUP_SIZE && MESHLET_MAX_PRIMITIVES <= MESHLET_GROUP_SIZE, "Built meshlets have to fit MeshletMS's thread group");
 
-enum FileVersion {
-	FILE_VERSION_INITIAL = 0,
-	CURRENT_FILE_VERSION = FILE_VERSION_INITIAL
+// Meshes of an imported .obj being turned into meshlets, shared by every thread taking part.
+struct MeshletBuildJob {
+	const aiScene* scene;
+	std::vector<MeshletMeshData> meshes;
+	std::vector<MeshletCullStats> cullStats;
+	std::atomic<UINT> nextMesh = 0;
+	std::atomic<UINT> meshesDone = 0;
 };
 
-struct FileHeader {
-	UINT32 Prolog;
-	UINT32 Version;
-
-	UINT32 MeshCount;
-	UINT32 AccessorCount;
-	UINT32 BufferViewCount;
-	UINT32 BufferSize;
-};
-
-struct MeshHeader {
-	UINT32 Indices;
-	UINT32 IndexSubsets;
-	UINT32 Attributes[Attribute::Count];
-
-	UINT32 Meshlets;
-	UINT32 MeshletSubsets;
-	UINT32 UniqueVertexIndices;
-	UINT32 PrimitiveIndices;
-	UINT32 CullData;
-};
-
-struct BufferView {
-	UINT32 Offset;
-	UINT32 Size;
-};
+static MeshletCullStats buildMeshletMesh(const aiMesh* source, MeshletMeshData& mesh) {
+	std::vector<Vertex> vertices(source->mNumVertices);
+	for (UINT i = 0; i < source->mNumVertices; i++) {
+		Vertex& vertex = vertices[i];
+		vertex.pos = { source->mVertices[i].x, source->mVertices[i].y, source->mVertices[i].z };
+		if (source->HasNormals()) {
+			vertex.norm = { source->mNormals[i].x, source->mNormals[i].y, source->mNormals[i].z };
+		}
+		if (source->HasTangentsAndBitangents()) {
+			vertex.tan = { source->mTangents[i].x, source->mTangents[i].y, source->mTangents[i].z };
+			vertex.biTan = { source->mBitangents[i].x, source->mBitangents[i].y, source->mBitangents[i].z };
+		}
+		if (source->mTextureCoords[0]) {
+			vertex.texC = { source->mTextureCoords[0][i].x, source->mTextureCoords[0][i].y };
+		}
+		else {
+			vertex.texC = { 0.0f, 0.0f };
+		}
+	}
+	std::vector<UINT> indices;
+	indices.reserve((size_t)source->mNumFaces * 3);
+	for (UINT i = 0; i < source->mNumFaces; i++) {
+		// Triangulate leaves points and lines behind, meshlets only hold triangles.
+		if (source->mFaces[i].mNumIndices != 3) {
+			continue;
+		}
+		indices.insert(indices.end(), source->mFaces[i].mIndices, source->mFaces[i].mIndices + 3);
+	}
+	if (indices.empty()) {
+		return MeshletCullStats();
+	}
 
-struct Accessor {
-	UINT32 BufferView;
-	UINT32 Offset;
-	UINT32 Size;
-	UINT32 Stride;
-	UINT32 Count;
-};
+	UINT vertexCount = (UINT)vertices.size();
+	if (WELD_VERTICES) {
+		WeldTolerance tolerance;
+		tolerance.position = WELD_POSITION_EPSILON;
+		tolerance.normal = WELD_NORMAL_EPSILON;
+		tolerance.tangent = WELD_TANGENT_EPSILON;
+		tolerance.texC = WELD_TEXCOORD_EPSILON;
+		vertexCount = WeldVertices(vertices.data(), vertexCount, indices.data(), (UINT)indices.size(), tolerance);
+	}
+	// Meshlets are built in index order, so a cache friendly order also keeps them compact.
+	OptimizeMesh(vertices.data(), vertexCount, indices.data(), (UINT)indices.size());
 
-MeshletModel::MeshletModel(std::string name, std::string dir, bool usesRT, ID3D12Device5* device) 
-	: Model(device, name, dir, usesRT) {
-	loaded = false;
-	name.replace(name.size() - 3, 3, "obj");
-	rtModel = dynamic_pointer_cast<SimpleModel>(ModelLoader::loadModelTakeOwnership(name, dir, usesRT));
+	mesh.vertices.resize(vertexCount);
+	for (UINT i = 0; i < vertexCount; i++) {
+		mesh.vertices[i] = { vertices[i].pos, vertices[i].norm, vertices[i].tan, vertices[i].biTan, vertices[i].texC };
+	}
+	mesh.indices.assign(indices.begin(), indices.end());
+	BuildMeshlets(mesh, MESHLET_MAX_VERTICES, MESHLET_MAX_PRIMITIVES, MESHLET_CONE_WEIGHT);
+	ComputeMeshletCullData(mesh);
+	if (MESHLET_BUILD_LODS) {
+		BuildMeshletHierarchy(mesh, MESHLET_MAX_VERTICES, MESHLET_MAX_PRIMITIVES, MESHLET_LOD_GROUP_SIZE, MESHLET_CONE_WEIGHT);
+	}
+	return MeasureMeshletCulling(mesh, MESHLET_CULL_VIEW_SAMPLES);
 }
 
-HRESULT MeshletModel::LoadFromFile(const std::string fileName) {
-	std::ifstream stream(fileName, std::ios::binary);
-	if (!stream.is_open()) {
-		return E_INVALIDARG;
+static void processMeshletBuildJob(MeshletBuildJob& job) {
+	UINT meshIndex;
+	const UINT meshCount = (UINT)job.meshes.size();
+	while ((meshIndex = job.nextMesh.fetch_add(1)) < meshCount) {
+		job.cullStats[meshIndex] = buildMeshletMesh(job.scene->mMeshes[meshIndex], job.meshes[meshIndex]);
+		if (job.meshesDone.fetch_add(1) + 1 == meshCount) {
+			job.meshesDone.notify_all();
+		}
 	}
+}
 
-	std::vector<MeshHeader> meshes;
-	std::vector<BufferView> bufferViews;
-	std::vector<Accessor> accessors;
-
-	FileHeader header;
-	stream.read(reinterpret_cast<char*>(&header), sizeof(header));
-
-	if (header.Prolog != prolog) {
-		return E_FAIL; // Incorrect File Format
+class MeshletBuildTask : public Task {
+public:
+	MeshletBuildTask(std::shared_ptr<MeshletBuildJob> job) : Task() {
+		this->job = job;
 	}
-	if (header.Version != CURRENT_FILE_VERSION) {
-		return E_FAIL; // Version Mismatch
+	void execute() override {
+		processMeshletBuildJob(*job);
 	}
-	
-	// Start loading the materials once we're sure the model is valid.
-	LoadSimpleMtl();
-
-	meshes.resize(header.MeshCount);
-	stream.read(reinterpret_cast<char*>(meshes.data()), meshes.size() * sizeof(meshes[0]));
-
-	accessors.resize(header.AccessorCount);
-	stream.read(reinterpret_cast<char*>(accessors.data()), accessors.size() * sizeof(accessors[0]));
-
-	bufferViews.resize(header.BufferViewCount);
-	stream.read(reinterpret_cast<char*>(bufferViews.data()), bufferViews.size() * sizeof(bufferViews[0]));
+	~MeshletBuildTask() override = default;
+private:
+	std::shared_ptr<MeshletBuildJob> job;
+};
 
-	m_buffer.resize(header.BufferSize);
-	stream.read(reinterpret_cast<char*>(m_buffer.data()), header.BufferSize);
+MeshletModel::MeshletModel(std::string name, std::string dir, bool usesRT) 
+	: Model(name, dir, usesRT) {
+	loaded = false;
+}
 
-	char eofbyte;
-	stream.read(&eofbyte, 1);
+// Points 'mesh' at mesh 'i' of a parsed file and builds its input layout.
+static void fillMesh(const MeshletFileView& view, UINT32 i, MeshletMesh& mesh) {
+	auto& meshView = view.meshes[i];
 
-	assert(stream.eof());
+	// Index Data
+	mesh.IndexSize = view.accessors[meshView.Indices].Size;
+	mesh.IndexCount = view.accessors[meshView.Indices].Count;
+	mesh.Indices = view.viewBytes(meshView.Indices);
+	mesh.IndexSubsets = view.elements<Subset>(meshView.IndexSubsets);
 
-	// Fill mesh sources
-	m_meshes.resize(meshes.size());
-	for (UINT32 i = 0; i < static_cast<UINT32>(meshes.size()); i++) {
-		auto& meshView = meshes[i];
-		auto& mesh = m_meshes[i];
+	// Vertex data & layout
 
-		// Index Data
-		{
-			Accessor& accessor = accessors[meshView.Indices];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+	std::vector<UINT32> vbMap;
 
-			mesh.IndexSize = accessor.Size;
-			mesh.IndexCount = accessor.Count;
+	mesh.LayoutDesc.pInputElementDescs = mesh.LayoutElems;
+	mesh.LayoutDesc.NumElements = 0;
 
-			mesh.Indices = std::span(m_buffer.data() + bufferView.Offset, bufferView.Size);
+	for (UINT32 j = 0; j < Attribute::Count; j++) {
+		if (meshView.Attributes[j] == -1) {
+			continue;
 		}
 
-		// Index Subsets
-		{
-			Accessor& accessor = accessors[meshView.IndexSubsets];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+		const Accessor& accessor = view.accessors[meshView.Attributes[j]];
 
-			mesh.IndexSubsets = std::span(reinterpret_cast<Subset*>(m_buffer.data() + bufferView.Offset), accessor.Count);
+		auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
+		if (it != vbMap.end()) {
+			continue;
 		}
 
-		// Vertex data & layout
-
-		std::vector<UINT32> vbMap;
-
-		mesh.LayoutDesc.pInputElementDescs = mesh.LayoutElems;
-		mesh.LayoutDesc.NumElements = 0;
-
-		for (UINT32 j = 0; j < Attribute::Count; j++) {
-			if (meshView.Attributes[j] == -1) {
-				continue;
-			}
+		// New BufferView, so add it to the list
+		vbMap.push_back(accessor.BufferView);
 
-			Accessor& accessor = accessors[meshView.Attributes[j]];
+		std::span<const UINT8> verts = view.viewBytes(meshView.Attributes[j]);
 
-			auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
-			if (it != vbMap.end()) {
-				continue;
-			}
-
-			// New BufferView, so add it to the list
-			vbMap.push_back(accessor.BufferView);
-			BufferView& bufferView = bufferViews[accessor.BufferView];
-
-			std::span<UINT8> verts = std::span(m_buffer.data() + bufferView.Offset, bufferView.Size);
-
-			mesh.VertStrides.push_back(accessor.Stride);
-			mesh.Verts.push_back(verts);
-			mesh.VertCount = static_cast<UINT32>(verts.size()) / accessor.Stride;
-		}
-
-		// Vertex Buffer Metadata from Accessors
-		for (uint32_t j = 0; j < Attribute::Count; ++j) {
-			if (meshView.Attributes[j] == -1)
-				continue;
-
-			Accessor& accessor = accessors[meshView.Attributes[j]];
-
-			// Determine which vertex buffer index holds this attribute's data
-			auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
+		mesh.VertStrides.push_back(accessor.Stride);
+		mesh.Verts.push_back(verts);
+		mesh.VertCount = static_cast<UINT32>(verts.size()) / accessor.Stride;
+	}
 
-			D3D12_INPUT_ELEMENT_DESC desc = elementDescs[j];
-			desc.InputSlot = static_cast<uint32_t>(std::distance(vbMap.begin(), it));
+	// Vertex Buffer Metadata from Accessors
+	for (uint32_t j = 0; j < Attribute::Count; ++j) {
+		mesh.AttributeSlots[j] = UINT32(-1);
+		mesh.AttributeOffsets[j] = 0;
+		if (meshView.Attributes[j] == -1)
+			continue;
 
-			mesh.LayoutElems[mesh.LayoutDesc.NumElements++] = desc;
-		}
+		const Accessor& accessor = view.accessors[meshView.Attributes[j]];
 
-		// Meshlet data
-		{
-			Accessor& accessor = accessors[meshView.Meshlets];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+		// Determine which vertex buffer index holds this attribute's data
+		auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
 
-			mesh.Meshlets = std::span(reinterpret_cast<Meshlet*>(m_buffer.data() + bufferView.Offset), accessor.Count);
-		}
+		// Attributes aren't stored in Attribute::EType order, so the offsets come from the file rather than appending.
+		D3D12_INPUT_ELEMENT_DESC desc = elementDescs[j];
+		desc.InputSlot = static_cast<uint32_t>(std::distance(vbMap.begin(), it));
+		desc.AlignedByteOffset = accessor.Offset;
+		mesh.AttributeSlots[j] = desc.InputSlot;
+		mesh.AttributeOffsets[j] = accessor.Offset;
 
-		// Meshlet Subset data
-		{
-			Accessor& accessor = accessors[meshView.MeshletSubsets];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+		mesh.LayoutElems[mesh.LayoutDesc.NumElements++] = desc;
+	}
 
-			mesh.MeshletSubsets = std::span(reinterpret_cast<Subset*>(m_buffer.data() + bufferView.Offset), accessor.Count);
-		}
+	// Meshlet data
+	mesh.Meshlets = view.elements<Meshlet>(meshView.Meshlets);
+	mesh.MeshletSubsets = view.elements<Subset>(meshView.MeshletSubsets);
+	mesh.UniqueVertexIndices = view.viewBytes(meshView.UniqueVertexIndices);
+	mesh.PrimitiveIndices = view.elements<PackedTriangle>(meshView.PrimitiveIndices);
+	mesh.CullingData = view.elements<CullData>(meshView.CullData);
+
+	// Cluster hierarchy
+	auto& lodView = view.lodHeaders[i];
+	if (lodView.ClusterLods != -1) {
+		mesh.LodMeshlets = view.elements<Meshlet>(lodView.Meshlets);
+		mesh.LodUniqueVertexIndices = view.viewBytes(lodView.UniqueVertexIndices);
+		mesh.LodPrimitiveIndices = view.elements<PackedTriangle>(lodView.PrimitiveIndices);
+		mesh.LodCullData = view.elements<CullData>(lodView.CullData);
+		mesh.ClusterLods = view.elements<ClusterLod>(lodView.ClusterLods);
+	}
+}
 
-		// Unique Vertex Index data
-		{
-			Accessor& accessor = accessors[meshView.UniqueVertexIndices];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+HRESULT MeshletModel::LoadFromFile(const std::string fileName) {
+	if (!m_file.open(fileName)) {
+		return E_INVALIDARG;
+	}
+	return LoadFromMemory(m_file.bytes());
+}
 
-			mesh.UniqueVertexIndices = std::span(m_buffer.data() + bufferView.Offset, bufferView.Size);
+HRESULT MeshletModel::LoadFromMemory(std::span<const UINT8> file) {
+	// Nothing is kept from a file that fails to load, whichever buffer held it goes with it.
+	auto fail = [this](const std::string& error) {
+		OutputDebugStringA(("Invalid meshlet file " + name + ": " + error + "\n").c_str());
+		m_file.close();
+		m_buffer.clear();
+		m_meshBuffers.clear();
+		return E_FAIL;
+	};
+
+	MeshletFileView view;
+	std::string error;
+	if (!ParseMeshletFile(file, view, error)) {
+		return fail(error);
+	}
+	
+	// Chunked files decode each mesh into a single mesh file of its own.
+	std::vector<MeshletFileView> meshViews;
+	if (view.header->Version >= FILE_VERSION_CHUNKED) {
+		m_meshBuffers.resize(view.chunks.size());
+		meshViews.resize(view.chunks.size());
+		for (UINT32 i = 0; i < static_cast<UINT32>(view.chunks.size()); i++) {
+			if (!DecodeMeshletChunk(view.chunkBytes(i), view.chunks[i].DecodedSize, m_meshBuffers[i], error)
+				|| !ParseMeshletFile(m_meshBuffers[i], meshViews[i], error)) {
+				return fail("mesh " + std::to_string(i) + ", " + error);
+			}
 		}
+		// Nothing points into the file itself.
+		m_file.close();
+	}
 
-		// Primitive Index data
-		{
-			Accessor& accessor = accessors[meshView.PrimitiveIndices];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
+	// Start loading the materials once we're sure the model is valid.
+	LoadSimpleMtl();
 
-			mesh.PrimitiveIndices = std::span(reinterpret_cast<PackedTriangle*>(m_buffer.data() + bufferView.Offset), accessor.Count);
+	// Fill mesh sources, everything points into 'file' or the decoded chunks.
+	if (meshViews.empty()) {
+		m_meshes.resize(view.meshes.size());
+		for (UINT32 i = 0; i < static_cast<UINT32>(view.meshes.size()); i++) {
+			fillMesh(view, i, m_meshes[i]);
 		}
-
-		// Cull data
-		{
-			Accessor& accessor = accessors[meshView.CullData];
-			BufferView& bufferView = bufferViews[accessor.BufferView];
-
-			mesh.CullingData = std::span(reinterpret_cast<CullData*>(m_buffer.data() + bufferView.Offset), accessor.Count);
+	}
+	else {
+		m_meshes.resize(meshViews.size());
+		for (UINT32 i = 0; i < static_cast<UINT32>(meshViews.size()); i++) {
+			fillMesh(meshViews[i], 0, m_meshes[i]);
 		}
 	}
 
@@ -232,33 +272,8 @@ HRESULT MeshletModel::LoadFromFile(const std::string fileName) {
 	for (UINT32 i = 0; i < static_cast<UINT32>(m_meshes.size()); i++) {
 		auto& m = m_meshes[i];
 
-		UINT32 vbIndexPos = 0;
-
-		// Find the index of the vertex buffer of the position attribute
-		for (UINT32 j = 1; j < m.LayoutDesc.NumElements; ++j) {
-			auto& desc = m.LayoutElems[j];
-			if (strcmp(desc.SemanticName, "POSITION") == 0) {
-				vbIndexPos = j;
-				break;
-			}
-		}
-
-		// Find the byte offset of the position attribute with its vertex buffer
-		UINT32 positionOffset = 0;
-
-		for (UINT32 j = 0; j < m.LayoutDesc.NumElements; ++j) {
-			auto& desc = m.LayoutElems[j];
-			if (strcmp(desc.SemanticName, "POSITION") == 0) {
-				break;
-			}
-
-			if (desc.InputSlot == vbIndexPos) {
-				positionOffset += GetFormatSize(m.LayoutElems[j].Format);
-			}
-		}
-
-		DirectX::XMFLOAT3* v0 = reinterpret_cast<DirectX::XMFLOAT3*>(m.Verts[vbIndexPos].data() + positionOffset);
-		UINT32 stride = m.VertStrides[vbIndexPos];
+		const DirectX::XMFLOAT3* v0 = reinterpret_cast<const DirectX::XMFLOAT3*>(m.GetAttribute(Attribute::Position, 0));
+		UINT32 stride = m.VertStrides[m.AttributeSlots[Attribute::Position]];
 
 		DirectX::BoundingSphere::CreateFromPoints(m.BoundingSphere, m.VertCount, v0, stride);
 		DirectX::BoundingBox::CreateFromPoints(m.BoundingBox, m.VertCount, v0, stride);
@@ -275,198 +290,266 @@ HRESULT MeshletModel::LoadFromFile(const std::string fileName) {
 	return S_OK;
 }
 
-HRESULT MeshletModel::UploadGpuResources(ID3D12Device5* device, ID3D12CommandQueue* cmdQueue, ID3D12CommandAllocator* cmdAlloc, ID3D12GraphicsCommandList* cmdList) {
-	for (UINT32 i = 0; i < m_meshes.size(); ++i) {
-		auto& m = m_meshes[i];
-
-		// Create committed D3D resources of proper sizes
-		auto indexDesc = CD3DX12_RESOURCE_DESC::Buffer(m.Indices.size());
-		auto meshletDesc = CD3DX12_RESOURCE_DESC::Buffer(m.Meshlets.size() * sizeof(m.Meshlets[0]));
-		auto cullDataDesc = CD3DX12_RESOURCE_DESC::Buffer(m.CullingData.size() * sizeof(m.CullingData[0]));
-		auto vertexIndexDesc = CD3DX12_RESOURCE_DESC::Buffer(DivRoundUp(m.UniqueVertexIndices.size(), 4) * 4);
-		auto primitiveDesc = CD3DX12_RESOURCE_DESC::Buffer(m.PrimitiveIndices.size() * sizeof(m.PrimitiveIndices[0]));
-		auto meshInfoDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(MeshInfo));
-
-		auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &indexDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.IndexResource)));
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &meshletDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.MeshletResource)));
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &cullDataDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.CullDataResource)));
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &vertexIndexDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.UniqueVertexIndexResource)));
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &primitiveDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.PrimitiveIndexResource)));
-		ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &meshInfoDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.MeshInfoResource)));
-
-
-		m.IBView.BufferLocation = m.IndexResource->GetGPUVirtualAddress();
-		m.IBView.Format = m.IndexSize == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
-		m.IBView.SizeInBytes = m.IndexCount * m.IndexSize;
-
-		m.VertexResources.resize(m.Verts.size());
-		m.VBViews.resize(m.Verts.size());
+// Vertex 'v' of 'm' the way the RT model holds it.
+static Vertex rtVertex(const MeshletMesh& m, UINT32 v) {
+	Vertex vertex = {};
+	vertex.pos = *reinterpret_cast<const DirectX::XMFLOAT3*>(m.GetAttribute(Attribute::Position, v));
+	if (const UINT8* normal = m.GetAttribute(Attribute::Normal, v)) {
+		vertex.norm = *reinterpret_cast<const DirectX::XMFLOAT3*>(normal);
+	}
+	if (const UINT8* tangent = m.GetAttribute(Attribute::Tangent, v)) {
+		vertex.tan = *reinterpret_cast<const DirectX::XMFLOAT3*>(tangent);
+	}
+	// The RT shaders sample like every SimpleModel, whose UVs assimp flipped (and the bitangents with them).
+	if (const UINT8* bitangent = m.GetAttribute(Attribute::Bitangent, v)) {
+		const DirectX::XMFLOAT3* b = reinterpret_cast<const DirectX::XMFLOAT3*>(bitangent);
+		vertex.biTan = { -b->x, -b->y, -b->z };
+	}
+	if (const UINT8* texCoord = m.GetAttribute(Attribute::TexCoord, v)) {
+		const DirectX::XMFLOAT2* t = reinterpret_cast<const DirectX::XMFLOAT2*>(texCoord);
+		vertex.texC = { t->x, 1.0f - t->y };
+	}
+	return vertex;
+}
 
-		for (UINT32 j = 0; j < m.Verts.size(); ++j) {
-			auto vertexDesc = CD3DX12_RESOURCE_DESC::Buffer(m.Verts[j].size());
-			device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &vertexDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m.VertexResources[j]));
+#if defined(DEBUG) || defined(_DEBUG)
+static bool sameFloat3(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
 
-			m.VBViews[j].BufferLocation = m.VertexResources[j]->GetGPUVirtualAddress();
-			m.VBViews[j].SizeInBytes = static_cast<UINT32>(m.Verts[j].size());
-			m.VBViews[j].StrideInBytes = m.VertStrides[j];
+// Every vertex the RT model would be built from reads back what the meshes were built with.
+static bool rtVerticesMatch(const std::vector<MeshletMesh>& loaded, const std::vector<MeshletMeshData>& source) {
+	if (loaded.size() != source.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < loaded.size(); i++) {
+		if (loaded[i].VertCount != source[i].vertices.size()) {
+			return false;
 		}
-
-		// Create upload resources
-		std::vector<ComPtr<ID3D12Resource>> vertexUploads;
-		ComPtr<ID3D12Resource>				indexUpload;
-		ComPtr<ID3D12Resource>				meshletUpload;
-		ComPtr<ID3D12Resource>				cullDataUpload;
-		ComPtr<ID3D12Resource>				uniqueVertexIndexUpload;
-		ComPtr<ID3D12Resource>				primitiveIndexUpload;
-		ComPtr<ID3D12Resource>				meshInfoUpload;
-
-		auto uploadHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &indexDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&indexUpload)));
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &meshletDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&meshletUpload)));
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &cullDataDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&cullDataUpload)));
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &vertexIndexDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uniqueVertexIndexUpload)));
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &primitiveDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&primitiveIndexUpload)));
-		ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &meshInfoDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&meshInfoUpload)));
-
-		// Map & copy memory to upload heap
-		vertexUploads.resize(m.Verts.size());
-		for (UINT32 j = 0; j < m.Verts.size(); ++j) {
-			auto vertexDesc = CD3DX12_RESOURCE_DESC::Buffer(m.Verts[j].size());
-			ThrowIfFailed(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &vertexDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&vertexUploads[j])));
-
-			UINT8* memory = nullptr;
-			vertexUploads[j]->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.Verts[j].data(), m.Verts[j].size());
-			vertexUploads[j]->Unmap(0, nullptr);
+		for (UINT32 v = 0; v < loaded[i].VertCount; v++) {
+			Vertex vertex = rtVertex(loaded[i], v);
+			const MeshletVertex& expected = source[i].vertices[v];
+			DirectX::XMFLOAT3 biTan = { -expected.bitangent.x, -expected.bitangent.y, -expected.bitangent.z };
+			if (!sameFloat3(vertex.pos, expected.position) || !sameFloat3(vertex.norm, expected.normal) || !sameFloat3(vertex.tan, expected.tangent)
+				|| !sameFloat3(vertex.biTan, biTan) || vertex.texC.x != expected.texCoord.x || vertex.texC.y != 1.0f - expected.texCoord.y) {
+				return false;
+			}
 		}
+	}
+	return true;
+}
+#endif
+
+HRESULT MeshletModel::BuildFromSource() {
+	std::string sourceName = name;
+	sourceName.replace(sourceName.size() - 3, 3, "obj");
+
+	// Same space as the cooked files, the .obj as is: no handedness conversion, winding flip or UV flip.
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(dir + "\\" + sourceName, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+		aiProcess_CalcTangentSpace | aiProcess_GenUVCoords | aiProcess_PreTransformVertices);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+		OutputDebugStringA(("ERROR::ASSIMP::" + std::string(importer.GetErrorString()) + "\n").c_str());
+		return E_FAIL;
+	}
 
-		{
-			UINT8* memory = nullptr;
-			indexUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.Indices.data(), m.Indices.size());
-			indexUpload->Unmap(0, nullptr);
-		}
+	auto job = std::make_shared<MeshletBuildJob>();
+	job->scene = scene;
+	job->meshes.resize(scene->mNumMeshes);
+	job->cullStats.resize(scene->mNumMeshes);
+	// The loading thread takes meshes too, so a ThreadPool that's busy only makes this slower, never stuck.
+	for (UINT i = 1; i < scene->mNumMeshes; i++) {
+		ThreadPool::enqueue(new MeshletBuildTask(job));
+	}
+	processMeshletBuildJob(*job);
+	UINT done = job->meshesDone.load();
+	while (done < scene->mNumMeshes) {
+		job->meshesDone.wait(done);
+		done = job->meshesDone.load();
+	}
 
-		{
-			UINT8* memory = nullptr;
-			meshletUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.Meshlets.data(), m.Meshlets.size() * sizeof(m.Meshlets[0]));
-			meshletUpload->Unmap(0, nullptr);
+	std::vector<MeshletMeshData> meshes;
+	size_t meshletCount = 0;
+	size_t lodMeshletCount = 0;
+	UINT lodLevels = 0;
+	MeshletCullStats cullStats;
+	for (UINT i = 0; i < scene->mNumMeshes; i++) {
+		if (!job->meshes[i].meshlets.empty()) {
+			meshletCount += job->meshes[i].meshlets.size();
+			lodMeshletCount += job->meshes[i].lodMeshlets.size();
+			for (const auto& lod : job->meshes[i].clusterLods) {
+				if (lod.Level > lodLevels) {
+					lodLevels = lod.Level;
+				}
+			}
+			cullStats.add(job->cullStats[i]);
+			meshes.push_back(std::move(job->meshes[i]));
 		}
-
-		{
-			UINT8* memory = nullptr;
-			cullDataUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.CullingData.data(), m.CullingData.size() * sizeof(m.CullingData[0]));
-			cullDataUpload->Unmap(0, nullptr);
+	}
+	if (meshes.empty()) {
+		OutputDebugStringA(("No triangles to build meshlets from: " + sourceName + "\n").c_str());
+		return E_FAIL;
+	}
+	OutputDebugStringA((name + " built " + std::to_string(meshletCount) + " meshlets from " + sourceName + ", plus "
+		+ std::to_string(lodMeshletCount) + " in " + std::to_string(lodLevels) + " coarser LOD levels\n").c_str());
+	OutputDebugStringA((name + " cull data: " + std::to_string(100.0f * cullStats.degenerateFraction()) + "% degenerate cones, "
+		+ std::to_string(100.0f * cullStats.meshletCullRate()) + "% of meshlets (" + std::to_string(100.0f * cullStats.triangleCullRate())
+		+ "% of triangles) backface culled over " + std::to_string(MESHLET_CULL_VIEW_SAMPLES) + " views\n").c_str());
+
+	std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+	WriteMeshletFile(file, meshes);
+	std::string bytes = file.str();
+	// Nothing to map, so the built file is kept in m_buffer instead.
+	m_buffer.assign(bytes.begin(), bytes.end());
+	if (SAVE_BUILT_MESHLETS) {
+		std::ofstream output(dir + "\\" + name, std::ios::binary);
+		std::string error;
+		if (COMPRESS_BUILT_MESHLETS) {
+			CompressMeshletFile(m_buffer, output, QUANTIZE_BUILT_MESHLETS, error);
 		}
-
-		{
-			UINT8* memory = nullptr;
-			uniqueVertexIndexUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.UniqueVertexIndices.data(), m.UniqueVertexIndices.size());
-			uniqueVertexIndexUpload->Unmap(0, nullptr);
+		else {
+			output.write(bytes.data(), bytes.size());
 		}
-
-		{
-			UINT8* memory = nullptr;
-			primitiveIndexUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, m.PrimitiveIndices.data(), m.PrimitiveIndices.size() * sizeof(m.PrimitiveIndices[0]));
-			primitiveIndexUpload->Unmap(0, nullptr);
+		if (!output || !error.empty()) {
+			OutputDebugStringA(("Couldn't save built meshlets: " + name + " " + error + "\n").c_str());
 		}
+	}
+	HRESULT result = LoadFromMemory(m_buffer);
+#if defined(DEBUG) || defined(_DEBUG)
+	if (SUCCEEDED(result) && !rtVerticesMatch(m_meshes, meshes)) {
+		OutputDebugStringA(("Meshlet vertices don't read back as they were built: " + name + "\n").c_str());
+	}
+#endif
+	return result;
+}
 
-		{
-			MeshInfo info = {};
-			info.IndexSize = m.IndexSize;
-			info.MeshletCount = static_cast<UINT32>(m.Meshlets.size());
-			info.LastMeshletVert = m.Meshlets.back().VertCount;
-			info.LastMesheltPrim = m.Meshlets.back().PrimCount;
+// A destination buffer of a mesh and the bytes that fill it, 'resourceSize' can be larger than the data.
+struct MeshletUpload {
+	Microsoft::WRL::ComPtr<ID3D12Resource>* resource;
+	const void* data;
+	UINT64 size;
+	UINT64 resourceSize;
+};
 
+// Everything UploadGpuResources copies for a mesh, in the order it's packed into the staging buffer.
+static std::vector<MeshletUpload> getMeshUploads(MeshletMesh& m, const MeshInfo& info) {
+	std::vector<MeshletUpload> uploads;
+	m.VertexResources.resize(m.Verts.size());
+	for (UINT32 j = 0; j < m.Verts.size(); ++j) {
+		uploads.push_back({ &m.VertexResources[j], m.Verts[j].data(), m.Verts[j].size(), m.Verts[j].size() });
+	}
+	uploads.push_back({ &m.IndexResource, m.Indices.data(), m.Indices.size(), m.Indices.size() });
+	uploads.push_back({ &m.MeshletResource, m.Meshlets.data(), m.Meshlets.size_bytes(), m.Meshlets.size_bytes() });
+	uploads.push_back({ &m.CullDataResource, m.CullingData.data(), m.CullingData.size_bytes(), m.CullingData.size_bytes() });
+	uploads.push_back({ &m.UniqueVertexIndexResource, m.UniqueVertexIndices.data(), m.UniqueVertexIndices.size(), DivRoundUp(m.UniqueVertexIndices.size(), 4) * 4 });
+	uploads.push_back({ &m.PrimitiveIndexResource, m.PrimitiveIndices.data(), m.PrimitiveIndices.size_bytes(), m.PrimitiveIndices.size_bytes() });
+	uploads.push_back({ &m.MeshInfoResource, &info, sizeof(MeshInfo), sizeof(MeshInfo) });
+	return uploads;
+}
 
-			UINT8* memory = nullptr;
-			meshInfoUpload->Map(0, nullptr, reinterpret_cast<void**>(&memory));
-			std::memcpy(memory, &info, sizeof(MeshInfo));
-			meshInfoUpload->Unmap(0, nullptr);
+UINT64 MeshletModel::GetUploadSize() {
+	UINT64 size = 0;
+	MeshInfo info = {};
+	for (auto& m : m_meshes) {
+		for (const MeshletUpload& upload : getMeshUploads(m, info)) {
+			size += CalcBufferByteSize(upload.size, MESHLET_UPLOAD_ALIGNMENT);
 		}
+	}
+	return size;
+}
 
-		// Populate our command list
-
-		for (uint32_t j = 0; j < m.Verts.size(); ++j) {
-			cmdList->CopyResource(m.VertexResources[j].Get(), vertexUploads[j].Get());
-			//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.VertexResources[j].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+void MeshletModel::UploadGpuResources(ID3D12Device5* device, ID3D12GraphicsCommandList* cmdList, ID3D12Resource* staging, UINT8* stagingMemory, UINT64& stagingOffset) {
+	auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	for (auto& m : m_meshes) {
+		MeshInfo info = {};
+		info.IndexSize = m.IndexSize;
+		info.MeshletCount = static_cast<UINT32>(m.Meshlets.size());
+		info.LastMeshletVert = m.Meshlets.back().VertCount;
+		info.LastMesheltPrim = m.Meshlets.back().PrimCount;
+
+		// Since our modelLoader only uses a copy command list, we'll have to transition the resources somewhere else.
+		for (const MeshletUpload& upload : getMeshUploads(m, info)) {
+			auto desc = CD3DX12_RESOURCE_DESC::Buffer(upload.resourceSize);
+			ThrowIfFailed(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(upload.resource)));
+
+			std::memcpy(stagingMemory + stagingOffset, upload.data, upload.size);
+			cmdList->CopyBufferRegion(upload.resource->Get(), 0, staging, stagingOffset, upload.size);
+			stagingOffset += CalcBufferByteSize(upload.size, MESHLET_UPLOAD_ALIGNMENT);
 		}
 
-		// Since our modelLoader only uses a copy command list, we'll have to transition the resource somewhere else.
-
-		cmdList->CopyResource(m.IndexResource.Get(), indexUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.IndexResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-		cmdList->CopyResource(m.MeshletResource.Get(), meshletUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.MeshletResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-		cmdList->CopyResource(m.CullDataResource.Get(), cullDataUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.CullDataResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-		cmdList->CopyResource(m.UniqueVertexIndexResource.Get(), uniqueVertexIndexUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.UniqueVertexIndexResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-		cmdList->CopyResource(m.PrimitiveIndexResource.Get(), primitiveIndexUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.PrimitiveIndexResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-		cmdList->CopyResource(m.MeshInfoResource.Get(), meshInfoUpload.Get());
-		//cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m.MeshInfoResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
+		m.IBView.BufferLocation = m.IndexResource->GetGPUVirtualAddress();
+		m.IBView.Format = m.IndexSize == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		m.IBView.SizeInBytes = m.IndexCount * m.IndexSize;
 
-		ThrowIfFailed(cmdList->Close());
+		m.VBViews.resize(m.Verts.size());
+		for (UINT32 j = 0; j < m.Verts.size(); ++j) {
+			m.VBViews[j].BufferLocation = m.VertexResources[j]->GetGPUVirtualAddress();
+			m.VBViews[j].SizeInBytes = static_cast<UINT32>(m.Verts[j].size());
+			m.VBViews[j].StrideInBytes = m.VertStrides[j];
+		}
+	}
+}
 
-		ID3D12CommandList* ppCommandLists[] = { cmdList };
-		cmdQueue->ExecuteCommandLists(1, ppCommandLists);
+void MeshletModel::SetUploadFence(Microsoft::WRL::ComPtr<ID3D12Fence> fence, UINT64 value) {
+	m_uploadFence = fence;
+	m_uploadFenceValue = value;
+}
 
-		// Create our sync fence
-		ComPtr<ID3D12Fence> fence;
-		ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+bool MeshletModel::UploadComplete() const {
+	return m_uploadFence && m_uploadFence->GetCompletedValue() >= m_uploadFenceValue;
+}
 
-		cmdQueue->Signal(fence.Get(), 1);
+void MeshletModel::BuildRtModel(DX12TaskQueueThread* thread) {
+	auto model = std::make_shared<SimpleModel>(name, dir, usesRT);
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (const auto& m : m_meshes) {
+		Mesh mesh;
+		mesh.baseVertexLocation = (INT)vertices.size();
+		mesh.startIndexLocation = (UINT)indices.size();
+		mesh.vertexCount = m.VertCount;
+		mesh.boundingBox = m.BoundingBox;
+		mesh.textures = textures;
+		mesh.typeFlags = MODEL_FORMAT_POSITON;
+		for (const auto& texture : textures) {
+			mesh.typeFlags |= texture.first;
+		}
 
-		// Wait for GPU
-		if (fence->GetCompletedValue() != 1) {
-			HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-			fence->SetEventOnCompletion(1, event);
+		mesh.typeFlags |= (m.AttributeSlots[Attribute::Normal] != UINT32(-1) ? MODEL_FORMAT_NORMAL : 0)
+			| (m.AttributeSlots[Attribute::TexCoord] != UINT32(-1) ? MODEL_FORMAT_TEXCOORD : 0);
+		for (UINT32 v = 0; v < m.VertCount; v++) {
+			vertices.push_back(rtVertex(m, v));
+		}
 
-			WaitForSingleObjectEx(event, INFINITE, false);
-			CloseHandle(event);
+		// The meshlets are what gets rasterized, so their triangles are what rays should hit too.
+		for (const Meshlet& meshlet : m.Meshlets) {
+			for (UINT32 p = 0; p < meshlet.PrimCount; p++) {
+				UINT32 i0, i1, i2;
+				m.GetPrimitive(meshlet.PrimOffset + p, i0, i1, i2);
+				indices.push_back(m.GetVertexIndex(meshlet.VertOffset + i0));
+				indices.push_back(m.GetVertexIndex(meshlet.VertOffset + i1));
+				indices.push_back(m.GetVertexIndex(meshlet.VertOffset + i2));
+			}
 		}
+		mesh.indexCount = (UINT)indices.size() - mesh.startIndexLocation;
+		model->meshes.push_back(mesh);
 	}
-
-	return S_OK;
+	model->setupFromGeometry(thread, vertices, indices);
+	rtModel = model;
 }
 
 void MeshletModel::setInstanceCount(UINT count) {
-	if (count == 1) {
-		TransformData::setInstanceCount(1);
-		if (rtModel) {
-			rtModel->setInstanceCount(1);
-		}
-	}
-	else {
-		MessageBoxA(nullptr, "Can't instance meshlets.", "Might come in future", MB_OK);
+	Model::setInstanceCount(count);
+	if (rtModel) {
+		rtModel->setInstanceCount(count);
 	}
 }
 
 void MeshletModel::setTransform(UINT index, DirectX::XMFLOAT4X4 newTransform) {
-	if (index == 0) {
-		TransformData::setTransform(index, newTransform);
-		if (rtModel) {
-			// At import time the obj has a different +x direction, so we just scale in the -1.0 to X (looks like it's on the Z axis, but that's because the matrix is transposed
-			// before being fed to GPU, and that operation has already occured.
-			// Reason for this is that the Model Loader does this conversion to make the coordinate space left handed, while the meshlet loader has no such compensation.
-			DirectX::XMFLOAT4X4 twistedTransform;
-			DirectX::XMStoreFloat4x4(&twistedTransform, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&newTransform), DirectX::XMMatrixScaling(1.0f, 1.0f, -1.0f)));
-			rtModel->setTransform(index, twistedTransform);
-		}
-	}
-	else {
-		MessageBoxA(nullptr, "Can't instance meshlets. So can't move index > 0.", "Might come in future", MB_OK);
+	Model::setTransform(index, newTransform);
+	if (rtModel) {
+		// Built from the meshlets' own vertices, so it's in the same space and takes the same transform.
+		rtModel->setTransform(index, newTransform);
 	}
 }
 
@@ -4,78 +4,41 @@
 #include <unordered_map>
 
 #include "ModelLoading/SimpleModel.h"
+#include "ModelLoading/MeshletFormat.h"
+#include "ModelLoading/MappedFile.h"
 
 #include "ModelLoading/TextureLoader.h"
 
-// This is mostly a copy of Meshlet Representation from the DirectXMesh library
-// But with minor simplifications/convention changes
-
-struct Attribute {
-	enum EType : UINT32 {
-		Position,
-		Normal,
-		TexCoord,
-		Tangent,
-		Bitangent,
-		Count
-	};
-
-	EType Type;
-	UINT32 Offset;
-};
-
-struct Subset {
-	UINT32 Offset;
-	UINT32 Count;
-};
-
-struct MeshInfo {
-	UINT32 IndexSize;
-	UINT32 MeshletCount;
-
-	UINT32 LastMeshletVert;
-	UINT32 LastMesheltPrim;
-};
-
-struct Meshlet {
-	UINT32 VertCount;
-	UINT32 VertOffset;
-	UINT32 PrimCount;
-	UINT32 PrimOffset;
-};
-
-struct PackedTriangle {
-	UINT32 i0 : 10;
-	UINT32 i1 : 10;
-	UINT32 i2 : 10;
-};
-
-struct CullData {
-	DirectX::XMFLOAT4 BoundingSphere; // xyz = center, w = radius
-	UINT8 NormalCone[4]; /// xyz = axis, w = -cos(a + 90)
-	FLOAT ApexOffset; // apex = center - axis * offset
-};
-
 struct MeshletMesh {
 	D3D12_INPUT_ELEMENT_DESC LayoutElems[Attribute::Count];
 	D3D12_INPUT_LAYOUT_DESC LayoutDesc;
 
-	std::vector<std::span<UINT8>> Verts;
+	std::vector<std::span<const UINT8>> Verts;
 	std::vector<UINT32> VertStrides;
+	// Vertex buffer and byte offset inside its stride of each Attribute::EType, the slot is UINT32(-1) if the mesh doesn't have it.
+	UINT32 AttributeSlots[Attribute::Count];
+	UINT32 AttributeOffsets[Attribute::Count];
 	UINT32 VertCount;
 	DirectX::BoundingSphere BoundingSphere;
 	DirectX::BoundingBox BoundingBox;
 
-	std::span<Subset> IndexSubsets;
-	std::span<UINT8> Indices;
+	std::span<const Subset> IndexSubsets;
+	std::span<const UINT8> Indices;
 	UINT32 IndexSize;
 	UINT32 IndexCount;
 
-	std::span<Subset> MeshletSubsets;
-	std::span<Meshlet> Meshlets;
-	std::span<UINT8> UniqueVertexIndices;
-	std::span<PackedTriangle> PrimitiveIndices;
-	std::span<CullData> CullingData;
+	std::span<const Subset> MeshletSubsets;
+	std::span<const Meshlet> Meshlets;
+	std::span<const UINT8> UniqueVertexIndices;
+	std::span<const PackedTriangle> PrimitiveIndices;
+	std::span<const CullData> CullingData;
+
+	// Coarser levels of the cluster hierarchy, empty if the file has none. ClusterLods covers Meshlets, then LodMeshlets.
+	std::span<const Meshlet> LodMeshlets;
+	std::span<const UINT8> LodUniqueVertexIndices;
+	std::span<const PackedTriangle> LodPrimitiveIndices;
+	std::span<const CullData> LodCullData;
+	std::span<const ClusterLod> ClusterLods;
 
 	// D3D resource references
 	std::vector<D3D12_VERTEX_BUFFER_VIEW>  VBViews;
@@ -108,6 +71,15 @@ struct MeshletMesh {
 		i2 = prim.i2;
 	}
 
+	// The attribute of vertex 'index', nullptr if the mesh doesn't have it.
+	const UINT8* GetAttribute(UINT32 attribute, UINT32 index) const {
+		UINT32 slot = AttributeSlots[attribute];
+		if (slot == UINT32(-1)) {
+			return nullptr;
+		}
+		return Verts[slot].data() + (UINT64)index * VertStrides[slot] + AttributeOffsets[attribute];
+	}
+
 	UINT32 GetVertexIndex(UINT32 index) const {
 		const UINT8* addr = UniqueVertexIndices.data() + (UINT64)index * IndexSize;
 		if (IndexSize == 4) {
@@ -121,9 +93,23 @@ struct MeshletMesh {
 
 class MeshletModel : public Model {
 public:
-	MeshletModel(std::string name, std::string dir, bool usesRT, ID3D12Device5* device);
+	MeshletModel(std::string name, std::string dir, bool usesRT);
+	// Maps the file and points the meshes straight into it, nothing is copied until UploadGpuResources.
 	HRESULT LoadFromFile(const std::string fileName);
-	HRESULT UploadGpuResources(ID3D12Device5* device, ID3D12CommandQueue* cmdQueue, ID3D12CommandAllocator* cmdAlloc, ID3D12GraphicsCommandList* cmdList);
+	// 'file' has to outlive the model, and be 4 byte aligned.
+	HRESULT LoadFromMemory(std::span<const UINT8> file);
+	// Builds meshlets from the .obj the cooked .bin would have come from, for models that don't have one.
+	HRESULT BuildFromSource();
+	// Staging bytes UploadGpuResources needs for every mesh, MeshletUploadBatch packs several models into one buffer with it.
+	UINT64 GetUploadSize();
+	// Creates the mesh resources and records their copies from 'staging', filling it from 'stagingOffset' on through
+	// 'stagingMemory' (its mapped pointer). Nothing is submitted, the caller executes the list and calls SetUploadFence.
+	void UploadGpuResources(ID3D12Device5* device, ID3D12GraphicsCommandList* cmdList, ID3D12Resource* staging, UINT8* stagingMemory, UINT64& stagingOffset);
+	void SetUploadFence(Microsoft::WRL::ComPtr<ID3D12Fence> fence, UINT64 value);
+	// Whether the GPU has finished the submission with this model's copies, never blocks.
+	bool UploadComplete() const;
+	// Fills rtModel from the loaded meshlets' vertices and triangles and records its upload on the thread's command list.
+	void BuildRtModel(DX12TaskQueueThread* thread);
 	
 	UINT32 GetMeshCount() const { return static_cast<UINT32>(m_meshes.size()); }
 	const MeshletMesh& GetMesh(UINT32 i) const { return m_meshes[i]; }
@@ -136,6 +122,7 @@ public:
 
 	void setInstanceCount(UINT count) override;
 	void setTransform(UINT index, DirectX::XMFLOAT4X4 newTransform) override;
+	const DirectX::BoundingBox& getLocalBoundingBox() const override { return m_boundingBox; }
 
 	std::unordered_map<MODEL_FORMAT, std::shared_ptr<DX12Texture>> textures;
 
@@ -143,8 +130,8 @@ public:
 
 	bool texturesBound = false;
 
-	// To get a meshlet into the RT structure we just store the fallback model...
-	// TODO: Find a way to not have such a heavy method.
+	// The RT structures and shaders only know SimpleModels, so models that use RT get their meshlet geometry
+	// copied into the GeometryPool as one by BuildRtModel. Null until then, and always without usesRT.
 	std::shared_ptr<SimpleModel> rtModel;
 
 private:
@@ -158,6 +145,13 @@ private:
 	DirectX::BoundingSphere m_boundingSphere;
 	DirectX::BoundingBox m_boundingBox;
 
+	// Whichever holds the file the meshes point into, m_buffer only for meshlets built from source
+	// and m_meshBuffers, one per mesh, for chunked files.
+	MappedFile m_file;
 	std::vector<UINT8> m_buffer;
+	std::vector<std::vector<UINT8>> m_meshBuffers;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_uploadFence;
+	UINT64 m_uploadFenceValue = 0;
 };
 
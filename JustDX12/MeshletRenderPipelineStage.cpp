@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "MeshletRenderPipelineStage.h"
 #include "MeshletModel.h"
 
@@ -80,6 +82,11 @@ void MeshletRenderPipelineStage::draw() {
 	if (renderStageDesc.supportsVRS && VRS && (vrsSupport.VariableShadingRateTier == D3D12_VARIABLE_SHADING_RATE_TIER_2)) {
 		mCommandList->RSSetShadingRateImage(resourceManager.getResource(renderStageDesc.VrsTextureName)->get());
 	}
+	if (frustrumCull) {
+		PIXScopedEvent(PIX_COLOR(0, 255, 0), "Frustum Cull");
+		SceneBVH::getInstance().query(frustrum, visibleInstances);
+		SceneBVH::groupByModel(visibleInstances);
+	}
 	int modelIndex = 0;
 	for (auto& pWeakModel : meshletRenderObjects) {
 		auto model = pWeakModel.lock();
@@ -88,11 +95,9 @@ void MeshletRenderPipelineStage::draw() {
 			modelIndex++;
 			continue;
 		}
-		DirectX::BoundingBox modelBB;
-		auto transform = model->getTransform(modelIndex);
-		model->GetBoundingBox().Transform(modelBB, DirectX::XMLoadFloat4x4(&transform));
-		DirectX::ContainmentType containType = frustrum.Contains(modelBB);
-		if (containType == DirectX::ContainmentType::DISJOINT) {
+		UINT instanceCount = model->getInstanceCount();
+		// Only whole models are culled here, the amplification shader culls each instance's meshlets individually.
+		if (frustrumCull && SceneBVH::findInstances(visibleInstances, model.get()).empty()) {
 			modelIndex++;
 			continue;
 		}
@@ -102,8 +107,15 @@ void MeshletRenderPipelineStage::draw() {
 		}
 
 		model->bindTransformToRoot(renderStageDesc.perObjTransformCBSlot, gFrameIndex, mCommandList.Get());
+		if (renderStageDesc.instanceCountSlot > -1) {
+			mCommandList->SetGraphicsRoot32BitConstant(renderStageDesc.instanceCountSlot, instanceCount, 0);
+		}
 
 		for (auto& mesh : *model) {
+			UINT groupsPerInstance = DivRoundUp((UINT32)mesh.Meshlets.size(), 32);
+			if (groupsPerInstance == 0) {
+				continue;
+			}
 			mCommandList->SetGraphicsRootConstantBufferView(0, mesh.MeshInfoResource->GetGPUVirtualAddress());
 			mCommandList->SetGraphicsRootShaderResourceView(1, mesh.VertexResources[0]->GetGPUVirtualAddress());
 			mCommandList->SetGraphicsRootShaderResourceView(2, mesh.MeshletResource->GetGPUVirtualAddress());
@@ -111,7 +123,14 @@ void MeshletRenderPipelineStage::draw() {
 			mCommandList->SetGraphicsRootShaderResourceView(4, mesh.PrimitiveIndexResource->GetGPUVirtualAddress());
 			mCommandList->SetGraphicsRootShaderResourceView(5, mesh.CullDataResource->GetGPUVirtualAddress());
 
-			mCommandList->DispatchMesh(DivRoundUp((UINT32)mesh.Meshlets.size(), 32), 1, 1);
+			// One row of amplification groups per instance, only split up if the instance count goes past the dispatch limits.
+			UINT instancesPerDispatch = std::max(1u, std::min<UINT>(D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION, MAX_AS_DISPATCH_GROUPS / groupsPerInstance));
+			for (UINT baseInstance = 0; baseInstance < instanceCount; baseInstance += instancesPerDispatch) {
+				if (renderStageDesc.instanceCountSlot > -1) {
+					mCommandList->SetGraphicsRoot32BitConstant(renderStageDesc.instanceCountSlot, baseInstance, 1);
+				}
+				mCommandList->DispatchMesh(groupsPerInstance, std::min(instancesPerDispatch, instanceCount - baseInstance), 1);
+			}
 		}
 		modelIndex++;
 	}
@@ -1,5 +1,6 @@
 #pragma once
 #include "PipelineStage/RenderPipelineStage.h"
+#include "SceneBVH.h"
 
 class MeshletRenderPipelineStage : public RenderPipelineStage, public ModelListener {
 public:
@@ -17,5 +18,7 @@ protected:
     UINT meshletIndex = 0;
     std::vector<DX12Descriptor> meshletTexDescs;
     std::vector<std::weak_ptr<MeshletModel>> meshletRenderObjects;
+    // Reused every frame so culling doesn't allocate.
+    std::vector<SceneBVHResult> visibleInstances;
 };
 
@@ -0,0 +1,35 @@
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#include "ModelLoading/GeometryPacking.h"
+
+UINT PoolIndexSize(UINT vertexCount, bool shortIndices) {
+	return shortIndices && vertexCount <= 65536 ? 2 : 4;
+}
+
+UINT AppendPackedIndices(const UINT32* indices, UINT indexCount, UINT indexSize, std::vector<UINT8>& indexData) {
+	indexData.resize((indexData.size() + indexSize - 1) / indexSize * indexSize);
+	UINT location = (UINT)(indexData.size() / indexSize);
+	indexData.resize(indexData.size() + (size_t)indexCount * indexSize);
+	if (indexSize == 2) {
+		UINT16* packed = reinterpret_cast<UINT16*>(indexData.data() + (size_t)location * indexSize);
+		for (UINT i = 0; i < indexCount; i++) {
+			packed[i] = (UINT16)indices[i];
+		}
+	}
+	else {
+		std::memcpy(indexData.data() + (size_t)location * indexSize, indices, (size_t)indexCount * indexSize);
+	}
+	return location;
+}
+
+void PadPackedIndices(std::vector<UINT8>& indexData) {
+	indexData.resize((indexData.size() + sizeof(UINT32) - 1) / sizeof(UINT32) * sizeof(UINT32));
+}
+
+UINT64 HashMeshGeometry(const Vertex* vertices, UINT vertexCount, const UINT32* indices, UINT indexCount) {
+	std::string_view vertexBytes(reinterpret_cast<const char*>(vertices), vertexCount * sizeof(Vertex));
+	std::string_view indexBytes(reinterpret_cast<const char*>(indices), indexCount * sizeof(UINT32));
+	return std::hash<std::string_view>{}(vertexBytes) ^ (std::hash<std::string_view>{}(indexBytes) * 0x9E3779B97F4A7C15ull);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+#include "ModelLoading/Vertex.h"
+#ifndef _WIN32
+typedef std::uint8_t UINT8;
+typedef std::uint64_t UINT64;
+#endif
+
+// The plain CPU parts of packing a SimpleModel's geometry for the GeometryPool, kept free of d3d12.h so loading can be
+// timed off Windows too. SimpleModel::packIndices lays its meshes out with these.
+
+// Bytes per index of a mesh with 'vertexCount' vertices in the pool: 2 when 'shortIndices' and they fit, otherwise 4.
+// Indices are relative to the mesh's first vertex, so only its own vertex count matters.
+UINT PoolIndexSize(UINT vertexCount, bool shortIndices);
+// Appends 'indexCount' indices at 'indexSize' bytes each, aligned to that size, and returns where they start in elements of it.
+UINT AppendPackedIndices(const UINT32* indices, UINT indexCount, UINT indexSize, std::vector<UINT8>& indexData);
+// Pads the packed indices to the whole number of 32 bit words the GeometryPool allocates in.
+void PadPackedIndices(std::vector<UINT8>& indexData);
+
+// Hash of a mesh's vertices and indices, meshes with the same geometry get the same one.
+UINT64 HashMeshGeometry(const Vertex* vertices, UINT vertexCount, const UINT32* indices, UINT indexCount);
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read only view of a whole file through the OS's file mapping, pages are only read from disk when touched.
+// Empty files open fine with no data, since there's nothing to map.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	// False if the file couldn't be opened or mapped, anything mapped before is closed either way.
+	bool open(const std::string& path);
+	void close();
+
+	std::span<const std::uint8_t> bytes() const { return std::span<const std::uint8_t>(data, size); }
+
+private:
+	const std::uint8_t* data = nullptr;
+	std::size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
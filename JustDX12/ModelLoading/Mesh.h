@@ -1,5 +1,4 @@
 #pragma once
-#define NOMINMAX
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -13,37 +12,23 @@
 #include "SceneNode.h"
 #include "DescriptorClasses/DX12Descriptor.h"
 
+#include "ModelLoading\Vertex.h"
 #include "TransformData.h"
 #include <DX12ConstantBuffer.h>
 
-struct CompactBoundingBox {
-	DirectX::XMFLOAT3 center;
-	DirectX::XMFLOAT3 bounds;
-	CompactBoundingBox(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 bounds) {
-		this->center = center;
-		this->bounds = bounds;
-	}
-};
-
-struct Vertex {
-	DirectX::XMFLOAT2 texC;
-	DirectX::XMFLOAT3 pos;
-	DirectX::XMFLOAT3 norm;
-	DirectX::XMFLOAT3 tan;
-	DirectX::XMFLOAT3 biTan;
-};
-
 class SimpleModel;
 class PipelineStage;
 
+// Mesh::geometryId of a mesh the ModelLoader never compared against the others.
+#define UNIQUE_GEOMETRY UINT_MAX
+
 // Represents a subset of a BasicModel
 // Also holds descriptors needed to render the mesh (textures), which PipelineStages can register for retreival later
 // Unique: can be instanced, which does cause some headaches, and isn't typically supported in most engines
 class Mesh : public TransformData {
 public:
-	Mesh(ID3D12Device5* device) : TransformData(device) {
+	Mesh() : TransformData() {
 		parent = nullptr;
-		instanceNodes.fill(nullptr);
 	}
 
 	bool allTexturesLoaded() {
@@ -74,9 +59,12 @@ public:
 	}
 
 	void registerInstance(SceneNode* node) {
-		UINT instanceCount = getInstanceCount();
-		instanceNodes[instanceCount] = node;
-		setInstanceCount(instanceCount + 1);
+		instanceNodes.push_back(node);
+		setInstanceCount((UINT)instanceNodes.size());
+	}
+
+	const std::vector<SceneNode*>& getInstanceNodes() const {
+		return instanceNodes;
 	}
 
 	void registerPipelineStage(PipelineStage* stage, std::vector<DX12Descriptor> descriptors) {
@@ -98,6 +86,7 @@ public:
 	UINT typeFlags = 0;
 	UINT indexCount = 0;
 	UINT vertexCount = 0;
+	// Into the model's CPU index list (SimpleModel::occluderIndices), which is always 32 bit.
 	UINT startIndexLocation = 0;
 	INT baseVertexLocation = 0;
 	INT boundingBoxVertexLocation = 0;
@@ -105,6 +94,53 @@ public:
 
 	DirectX::BoundingBox boundingBox;
 
+	// Format of the mesh's indices in the GeometryPool, R16_UINT if SHORT_INDICES and it has few enough vertices.
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+	// Where the mesh's indices start in its model's GeometryPool block, in indexFormat sized elements.
+	UINT poolIndexLocation = 0;
+
+	UINT getIndexSize() const {
+		return indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	}
+	// StartIndexLocation for draws using a view of the GeometryPool's indices in indexFormat,
+	// 'blockIndexOffset' is the model's SimpleModel::getIndexOffset.
+	UINT getPoolStartIndexLocation(UINT blockIndexOffset, UINT lod = 0) const {
+		return blockIndexOffset * (sizeof(UINT) / getIndexSize()) + (lod == 0 ? poolIndexLocation : lods[lod - 1].poolIndexLocation);
+	}
+
+	// Simplified index lists over the mesh's vertices, coarsest last. Level 0 is the mesh itself, level i is lods[i - 1].
+	struct Lod {
+		UINT indexCount = 0;
+		// Same spaces as the mesh's own startIndexLocation and poolIndexLocation.
+		UINT startIndexLocation = 0;
+		UINT poolIndexLocation = 0;
+		// How far the surface can be from the full detail one, over the radius of boundingBox.
+		float relativeError = 0.0f;
+	};
+	std::vector<Lod> lods;
+
+	UINT getLodIndexCount(UINT lod) const {
+		return lod == 0 ? indexCount : lods[lod - 1].indexCount;
+	}
+	// Coarsest level whose error stays under 'maxPixelError' when the bounding box's radius covers 'projectedRadius' pixels.
+	UINT selectLod(float projectedRadius, float maxPixelError) const {
+		UINT lod = 0;
+		while (lod < lods.size() && lods[lod].relativeError * projectedRadius <= maxPixelError) {
+			lod++;
+		}
+		return lod;
+	}
+
+	// Compact vertex positions are in [-1, 1] across the mesh's bounds, the real position is offset + pos * scale.
+	// Left as the identity when COMPACT_VERTICES isn't defined.
+	DirectX::XMFLOAT3 positionOffset = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 positionScale = { 1.0f, 1.0f, 1.0f };
+
+	// Hash of the mesh's vertices and indices, set during SimpleModel::process.
+	UINT64 geometryHash = 0;
+	// Same for every loaded mesh with identical geometry and textures (even across models), assigned by the ModelLoader.
+	UINT geometryId = UNIQUE_GEOMETRY;
+
 	std::unordered_map<MODEL_FORMAT, std::shared_ptr<DX12Texture>> textures;
 
 	SimpleModel* parent;
@@ -113,7 +149,7 @@ private:
 	// Trying to make repeated checks faster
 	bool texturesLoaded = false;
 
-	std::array<SceneNode*, MAX_INSTANCES> instanceNodes;
+	std::vector<SceneNode*> instanceNodes;
 
 	std::vector<std::vector<DX12Descriptor>> pipelineStageBindings;
 	std::vector<PipelineStage*> pipelineStageMappings;
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <DirectXMath.h>
+
+#include "ModelLoading\MeshOptimizer.h"
+
+#define NO_VERTEX UINT_MAX
+
+void VertexCacheStats::add(const VertexCacheStats& other) {
+	triangles += other.triangles;
+	transforms += other.transforms;
+	vertices += other.vertices;
+}
+
+float VertexCacheStats::acmr() const {
+	return triangles ? (float)transforms / (float)triangles : 0.0f;
+}
+
+float VertexCacheStats::atvr() const {
+	return vertices ? (float)transforms / (float)vertices : 0.0f;
+}
+
+// A vertex is in the cache if fewer than VERTEX_CACHE_SIZE misses happened since it was last missed,
+// so a timestamp per vertex is enough to simulate the FIFO. Timestamps start at 0, which is never in the cache.
+static bool cacheMiss(std::vector<UINT>& cacheTime, UINT& time, UINT vertex) {
+	if (time - cacheTime[vertex] > VERTEX_CACHE_SIZE) {
+		cacheTime[vertex] = time++;
+		return true;
+	}
+	return false;
+}
+
+VertexCacheStats AnalyzeVertexCache(const UINT* indices, UINT indexCount, UINT vertexCount) {
+	VertexCacheStats stats;
+	stats.triangles = indexCount / 3;
+	std::vector<UINT> cacheTime(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	UINT time = VERTEX_CACHE_SIZE + 1;
+	for (UINT i = 0; i < indexCount; i++) {
+		UINT vertex = indices[i];
+		if (cacheMiss(cacheTime, time, vertex)) {
+			stats.transforms++;
+		}
+		if (!referenced[vertex]) {
+			referenced[vertex] = true;
+			stats.vertices++;
+		}
+	}
+	return stats;
+}
+
+// Triangles using each vertex, vertex v's are triangles[offsets[v]] up to triangles[offsets[v + 1]].
+struct TriangleAdjacency {
+	std::vector<UINT> offsets;
+	std::vector<UINT> triangles;
+};
+
+static TriangleAdjacency buildAdjacency(const UINT* indices, UINT indexCount, UINT vertexCount) {
+	TriangleAdjacency adjacency;
+	adjacency.offsets.assign(vertexCount + 1, 0);
+	for (UINT i = 0; i < indexCount; i++) {
+		adjacency.offsets[indices[i] + 1]++;
+	}
+	std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+	adjacency.triangles.resize(indexCount);
+	std::vector<UINT> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+	for (UINT i = 0; i < indexCount; i++) {
+		adjacency.triangles[fill[indices[i]]++] = i / 3;
+	}
+	return adjacency;
+}
+
+// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al. 2007).
+// Fans around a vertex at a time, moving to the neighbour that'll still be cached after its own fan.
+// Every time it runs out of neighbours it has to jump, those points are the hard cluster starts (in triangles).
+static void tipsify(const UINT* indices, UINT indexCount, UINT vertexCount, UINT* output, std::vector<UINT>& clusterStarts) {
+	TriangleAdjacency adjacency = buildAdjacency(indices, indexCount, vertexCount);
+	std::vector<UINT> liveTriangles(vertexCount);
+	for (UINT v = 0; v < vertexCount; v++) {
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+	std::vector<UINT> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(indexCount / 3, false);
+	std::vector<UINT> deadEnd;
+	std::vector<UINT> candidates;
+	UINT time = VERTEX_CACHE_SIZE + 1;
+	UINT cursor = 0;
+	UINT outputTriangles = 0;
+
+	// Recently used vertices first since they're likely still cached, then the first vertex with anything left.
+	auto skipDeadEnd = [&]() {
+		while (!deadEnd.empty()) {
+			UINT vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0) {
+				return vertex;
+			}
+		}
+		for (; cursor < vertexCount; cursor++) {
+			if (liveTriangles[cursor] > 0) {
+				return cursor;
+			}
+		}
+		return (UINT)NO_VERTEX;
+	};
+
+	clusterStarts.clear();
+	UINT fanning = skipDeadEnd();
+	while (fanning != NO_VERTEX) {
+		candidates.clear();
+		for (UINT a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+			UINT triangle = adjacency.triangles[a];
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = true;
+			for (UINT corner = 0; corner < 3; corner++) {
+				UINT vertex = indices[triangle * 3 + corner];
+				output[outputTriangles * 3 + corner] = vertex;
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				cacheMiss(cacheTime, time, vertex);
+			}
+			outputTriangles++;
+		}
+
+		// Prefers the candidate that's been cached longest, as long as fanning around it won't push it out.
+		UINT next = NO_VERTEX;
+		int bestPriority = -1;
+		for (UINT vertex : candidates) {
+			if (liveTriangles[vertex] == 0) {
+				continue;
+			}
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE) {
+				priority = (int)(time - cacheTime[vertex]);
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+		if (next == NO_VERTEX) {
+			next = skipDeadEnd();
+			if (next != NO_VERTEX) {
+				clusterStarts.push_back(outputTriangles);
+			}
+		}
+		fanning = next;
+	}
+	if (clusterStarts.empty() || clusterStarts.front() != 0) {
+		clusterStarts.insert(clusterStarts.begin(), 0);
+	}
+}
+
+// Splits the hard clusters further wherever the cluster so far, starting from a cold cache, is already
+// within OVERDRAW_CLUSTER_THRESHOLD of the mesh's ACMR. Smaller clusters give the overdraw sort more to work with,
+// the threshold bounds how much cache locality that costs.
+static void splitClusters(const UINT* indices, UINT indexCount, UINT vertexCount, std::vector<UINT>& clusterStarts) {
+	const UINT triangleCount = indexCount / 3;
+	const float threshold = AnalyzeVertexCache(indices, indexCount, vertexCount).acmr() * OVERDRAW_CLUSTER_THRESHOLD;
+	std::vector<UINT> cacheTime(vertexCount, 0);
+	std::vector<UINT> splitStarts;
+	UINT time = VERTEX_CACHE_SIZE + 1;
+	for (size_t c = 0; c < clusterStarts.size(); c++) {
+		UINT clusterEnd = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+		UINT start = clusterStarts[c];
+		UINT misses = 0;
+		// Jumping the clock past the cache size empties the cache.
+		time += VERTEX_CACHE_SIZE + 1;
+		splitStarts.push_back(start);
+		for (UINT triangle = start; triangle < clusterEnd; triangle++) {
+			for (UINT corner = 0; corner < 3; corner++) {
+				misses += cacheMiss(cacheTime, time, indices[triangle * 3 + corner]);
+			}
+			if (triangle + 1 < clusterEnd && (float)misses / (float)(triangle + 1 - start) <= threshold) {
+				start = triangle + 1;
+				misses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+				splitStarts.push_back(start);
+			}
+		}
+	}
+	clusterStarts = std::move(splitStarts);
+}
+
+// Clusters facing away from the mesh's center are most likely to be in front of the rest of it, so they're drawn first.
+static void sortClustersForOverdraw(const Vertex* vertices, const UINT* indices, UINT indexCount, const std::vector<UINT>& clusterStarts, UINT* output) {
+	const UINT triangleCount = indexCount / 3;
+	std::vector<DirectX::XMFLOAT3> clusterCentroids(clusterStarts.size());
+	std::vector<DirectX::XMFLOAT3> clusterNormals(clusterStarts.size());
+	DirectX::XMVECTOR meshCentroid = DirectX::XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterStarts.size(); c++) {
+		UINT clusterEnd = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+		DirectX::XMVECTOR centroid = DirectX::XMVectorZero();
+		DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+		float area = 0.0f;
+		for (UINT triangle = clusterStarts[c]; triangle < clusterEnd; triangle++) {
+			DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3]].pos);
+			DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].pos);
+			DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].pos);
+			// Clockwise winding is front facing, so this points out of the front face. Its length is twice the area.
+			DirectX::XMVECTOR faceNormal = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+			float faceArea = DirectX::XMVectorGetX(DirectX::XMVector3Length(faceNormal)) * 0.5f;
+			DirectX::XMVECTOR faceCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+			centroid = DirectX::XMVectorAdd(centroid, DirectX::XMVectorScale(faceCenter, faceArea));
+			normal = DirectX::XMVectorAdd(normal, faceNormal);
+			area += faceArea;
+		}
+		meshCentroid = DirectX::XMVectorAdd(meshCentroid, centroid);
+		meshArea += area;
+		DirectX::XMStoreFloat3(&clusterCentroids[c], area > 0.0f ? DirectX::XMVectorScale(centroid, 1.0f / area) : centroid);
+		DirectX::XMStoreFloat3(&clusterNormals[c], DirectX::XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid = DirectX::XMVectorScale(meshCentroid, 1.0f / meshArea);
+	}
+
+	std::vector<float> facing(clusterStarts.size());
+	for (size_t c = 0; c < clusterStarts.size(); c++) {
+		DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&clusterCentroids[c]), meshCentroid);
+		facing[c] = DirectX::XMVectorGetX(DirectX::XMVector3Dot(offset, DirectX::XMLoadFloat3(&clusterNormals[c])));
+	}
+	std::vector<UINT> order(clusterStarts.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b) { return facing[a] > facing[b]; });
+
+	UINT outputIndex = 0;
+	for (UINT c : order) {
+		UINT clusterEnd = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+		for (UINT i = clusterStarts[c] * 3; i < clusterEnd * 3; i++) {
+			output[outputIndex++] = indices[i];
+		}
+	}
+}
+
+static void optimizeVertexFetch(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount) {
+	std::vector<UINT> remap(vertexCount, NO_VERTEX);
+	UINT nextVertex = 0;
+	for (UINT i = 0; i < indexCount; i++) {
+		if (remap[indices[i]] == NO_VERTEX) {
+			remap[indices[i]] = nextVertex++;
+		}
+	}
+	for (UINT v = 0; v < vertexCount; v++) {
+		if (remap[v] == NO_VERTEX) {
+			remap[v] = nextVertex++;
+		}
+	}
+	std::vector<Vertex> original(vertices, vertices + vertexCount);
+	for (UINT v = 0; v < vertexCount; v++) {
+		vertices[remap[v]] = original[v];
+	}
+	for (UINT i = 0; i < indexCount; i++) {
+		indices[i] = remap[indices[i]];
+	}
+}
+
+void OptimizeTriangleOrder(const Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount) {
+	if (indexCount < 3 || indexCount % 3 != 0) {
+		return;
+	}
+	std::vector<UINT> reordered(indexCount);
+	std::vector<UINT> clusterStarts;
+	tipsify(indices, indexCount, vertexCount, reordered.data(), clusterStarts);
+	splitClusters(reordered.data(), indexCount, vertexCount, clusterStarts);
+	sortClustersForOverdraw(vertices, reordered.data(), indexCount, clusterStarts, indices);
+}
+
+void OptimizeMesh(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount) {
+	if (indexCount < 3 || indexCount % 3 != 0) {
+		return;
+	}
+	OptimizeTriangleOrder(vertices, vertexCount, indices, indexCount);
+	optimizeVertexFetch(vertices, vertexCount, indices, indexCount);
+}
+
+// Grid cell of every vertex component, texC(2) pos(3) norm(3) tan(3) biTan(3) like Vertex.
+struct WeldKey {
+	INT64 cells[14];
+
+	bool operator==(const WeldKey& other) const {
+		return memcmp(cells, other.cells, sizeof(cells)) == 0;
+	}
+};
+
+struct WeldKeyHash {
+	size_t operator()(const WeldKey& key) const {
+		UINT64 hash = 0xCBF29CE484222325ull;
+		for (INT64 cell : key.cells) {
+			hash = (hash ^ (UINT64)cell) * 0x100000001B3ull;
+		}
+		return (size_t)hash;
+	}
+};
+
+static INT64 weldCell(float value, float tolerance) {
+	if (tolerance > 0.0f && std::isfinite(value)) {
+		return (INT64)std::floor((double)value / tolerance + 0.5);
+	}
+	// Exact matching, adding 0 turns -0 into +0 so they weld.
+	value += 0.0f;
+	UINT bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static WeldKey makeWeldKey(const Vertex& vertex, const WeldTolerance& tolerance) {
+	WeldKey key;
+	const float* components = &vertex.texC.x;
+	static_assert(sizeof(Vertex) == sizeof(float) * 14, "WeldKey expects Vertex to be 14 tightly packed floats");
+	for (UINT i = 0; i < 14; i++) {
+		float componentTolerance = i < 2 ? tolerance.texC : i < 5 ? tolerance.position : i < 8 ? tolerance.normal : tolerance.tangent;
+		key.cells[i] = weldCell(components[i], componentTolerance);
+	}
+	return key;
+}
+
+UINT WeldVertices(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount, const WeldTolerance& tolerance) {
+	std::unordered_map<WeldKey, UINT, WeldKeyHash> cells;
+	cells.reserve(vertexCount);
+	std::vector<UINT> remap(vertexCount);
+	UINT keptVertices = 0;
+	for (UINT v = 0; v < vertexCount; v++) {
+		auto inserted = cells.try_emplace(makeWeldKey(vertices[v], tolerance), keptVertices);
+		if (inserted.second) {
+			vertices[keptVertices++] = vertices[v];
+		}
+		remap[v] = inserted.first->second;
+	}
+	for (UINT i = 0; i < indexCount; i++) {
+		indices[i] = remap[indices[i]];
+	}
+	return keptVertices;
+}
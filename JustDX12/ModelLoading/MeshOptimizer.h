@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+
+#include "ModelLoading\Mesh.h"
+#include "Settings.h"
+
+// Raw counts from simulating a FIFO post transform cache of VERTEX_CACHE_SIZE over an index buffer.
+// Counts from several meshes can be summed before working out the ratios.
+struct VertexCacheStats {
+	UINT triangles = 0;
+	// Cache misses, each one is a vertex shader invocation.
+	UINT transforms = 0;
+	// Vertices referenced by at least one triangle.
+	UINT vertices = 0;
+
+	void add(const VertexCacheStats& other);
+	// Average cache miss ratio, transforms per triangle (0.5 is ideal for big regular meshes, 3 is the worst).
+	float acmr() const;
+	// Average transform to vertex ratio, 1 means every vertex is transformed exactly once.
+	float atvr() const;
+};
+
+VertexCacheStats AnalyzeVertexCache(const UINT* indices, UINT indexCount, UINT vertexCount);
+
+// Per component, how far apart two vertices' attributes can be and still get welded. 0 only welds exact duplicates.
+struct WeldTolerance {
+	float position = 0.0f;
+	float normal = 0.0f;
+	// Also used for bitangents.
+	float tangent = 0.0f;
+	float texC = 0.0f;
+};
+
+// Merges vertices whose attributes snap to the same point on a grid sized by 'tolerance' and remaps the indices to them.
+// Hashing grid cells keeps this linear, at the cost of missing near duplicates that straddle a cell boundary.
+// Kept vertices are packed at the front in their original order, returns how many there are.
+UINT WeldVertices(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount, const WeldTolerance& tolerance);
+
+// Reorders triangles for the post transform cache (Tipsify), then orders clusters of them so the ones facing
+// out from the mesh's center draw first, which cuts overdraw without giving back much of the cache locality.
+// Finally renumbers vertices in the order they're first used so fetches walk the vertex buffer front to back.
+// Indices are relative to 'vertices', the vertex count doesn't change (unused vertices are moved to the end).
+void OptimizeMesh(Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount);
+
+// Just the triangle reordering of OptimizeMesh, for index lists sharing vertices that were already ordered for another one.
+void OptimizeTriangleOrder(const Vertex* vertices, UINT vertexCount, UINT* indices, UINT indexCount);
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+#include "ModelLoading/MeshSimplifier.h"
+#ifndef _WIN32
+typedef std::uint64_t UINT64;
+#endif
+
+// Symmetric 4x4 error matrix, evaluating it at a point gives the summed squared distance to the planes added to it.
+struct Quadric {
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+
+	// Plane through 'point' with unit normal 'normal'.
+	void addPlane(const double normal[3], const double point[3]) {
+		double d = -(normal[0] * point[0] + normal[1] * point[1] + normal[2] * point[2]);
+		a00 += normal[0] * normal[0];
+		a01 += normal[0] * normal[1];
+		a02 += normal[0] * normal[2];
+		a11 += normal[1] * normal[1];
+		a12 += normal[1] * normal[2];
+		a22 += normal[2] * normal[2];
+		b0 += normal[0] * d;
+		b1 += normal[1] * d;
+		b2 += normal[2] * d;
+		c += d * d;
+	}
+
+	void add(const Quadric& other) {
+		a00 += other.a00;
+		a01 += other.a01;
+		a02 += other.a02;
+		a11 += other.a11;
+		a12 += other.a12;
+		a22 += other.a22;
+		b0 += other.b0;
+		b1 += other.b1;
+		b2 += other.b2;
+		c += other.c;
+	}
+
+	double evaluate(const double p[3]) const {
+		double value = a00 * p[0] * p[0] + a11 * p[1] * p[1] + a22 * p[2] * p[2]
+			+ 2.0 * (a01 * p[0] * p[1] + a02 * p[0] * p[2] + a12 * p[1] * p[2])
+			+ 2.0 * (b0 * p[0] + b1 * p[1] + b2 * p[2]) + c;
+		// Rounding can take a perfect fit slightly negative.
+		return std::max(value, 0.0);
+	}
+};
+
+// Sum of squared distances in attribute space from every vertex merged into a vertex, stored as
+// the weight, the per attribute sums and the summed squared lengths so two can be merged by adding them.
+struct AttributeQuadrics {
+	UINT attributeCount;
+	std::vector<double> data;
+
+	AttributeQuadrics(const float* attributes, UINT attributeCount, UINT vertexCount) : attributeCount(attributeCount) {
+		if (attributeCount == 0) {
+			return;
+		}
+		data.resize((size_t)vertexCount * (attributeCount + 2));
+		for (UINT v = 0; v < vertexCount; v++) {
+			double* quadric = get(v);
+			const float* vertexAttributes = attributes + (size_t)v * attributeCount;
+			quadric[0] = 1.0;
+			quadric[attributeCount + 1] = 0.0;
+			for (UINT i = 0; i < attributeCount; i++) {
+				quadric[i + 1] = vertexAttributes[i];
+				quadric[attributeCount + 1] += (double)vertexAttributes[i] * vertexAttributes[i];
+			}
+		}
+	}
+
+	double* get(UINT vertex) {
+		return data.data() + (size_t)vertex * (attributeCount + 2);
+	}
+
+	void add(UINT to, UINT from) {
+		double* target = get(to);
+		const double* source = get(from);
+		for (UINT i = 0; i < attributeCount + 2; i++) {
+			target[i] += source[i];
+		}
+	}
+
+	// Error of moving everything merged into 'a' and 'b' to 'values'.
+	double evaluate(UINT a, UINT b, const float* values) {
+		if (attributeCount == 0) {
+			return 0.0;
+		}
+		const double* qa = get(a);
+		const double* qb = get(b);
+		double value = qa[attributeCount + 1] + qb[attributeCount + 1];
+		for (UINT i = 0; i < attributeCount; i++) {
+			value += (qa[0] + qb[0]) * values[i] * values[i] - 2.0 * values[i] * (qa[i + 1] + qb[i + 1]);
+		}
+		return std::max(value, 0.0);
+	}
+};
+
+// Moving 'from' onto 'to', only valid while neither vertex has changed since it was queued.
+struct Collapse {
+	double cost;
+	UINT from;
+	UINT to;
+	UINT fromVersion;
+	UINT toVersion;
+
+	bool operator>(const Collapse& other) const {
+		return cost > other.cost;
+	}
+};
+
+static void cross(const double a[3], const double b[3], double out[3]) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double dot(const double a[3], const double b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void triangleNormal(const double p0[3], const double p1[3], const double p2[3], double out[3]) {
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	cross(e1, e2, out);
+}
+
+void LockBorderVertices(const UINT* indices, UINT indexCount, std::vector<bool>& lockedVertices) {
+	std::unordered_map<UINT64, UINT> edgeUses;
+	for (UINT i = 0; i + 2 < indexCount; i += 3) {
+		for (UINT k = 0; k < 3; k++) {
+			UINT a = indices[i + k];
+			UINT b = indices[i + (k + 1) % 3];
+			edgeUses[((UINT64)std::min(a, b) << 32) | std::max(a, b)]++;
+		}
+	}
+	for (const auto& edge : edgeUses) {
+		if (edge.second == 1) {
+			lockedVertices[(UINT)(edge.first >> 32)] = true;
+			lockedVertices[(UINT)edge.first] = true;
+		}
+	}
+}
+
+UINT SimplifyMesh(const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount, UINT* indices, UINT indexCount,
+	UINT targetIndexCount, const std::vector<bool>& lockedVertices, float& error, const float* attributes, UINT attributeCount) {
+	error = 0.0f;
+	const UINT triangleCount = indexCount / 3;
+	std::vector<double> points((size_t)vertexCount * 3);
+	for (UINT v = 0; v < vertexCount; v++) {
+		const DirectX::XMFLOAT3* position = (const DirectX::XMFLOAT3*)((const char*)positions + v * positionStride);
+		points[v * 3] = position->x;
+		points[v * 3 + 1] = position->y;
+		points[v * 3 + 2] = position->z;
+	}
+	auto point = [&](UINT vertex) { return &points[(size_t)vertex * 3]; };
+
+	std::vector<Quadric> quadrics(vertexCount);
+	AttributeQuadrics attributeQuadrics(attributes, attributeCount, vertexCount);
+	std::vector<std::vector<UINT>> vertexTriangles(vertexCount);
+	for (UINT t = 0; t < triangleCount; t++) {
+		UINT* triangle = indices + t * 3;
+		double normal[3];
+		triangleNormal(point(triangle[0]), point(triangle[1]), point(triangle[2]), normal);
+		double length = std::sqrt(dot(normal, normal));
+		for (UINT k = 0; k < 3; k++) {
+			if (length > 0.0) {
+				double unitNormal[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+				quadrics[triangle[k]].addPlane(unitNormal, point(triangle[0]));
+			}
+			vertexTriangles[triangle[k]].push_back(t);
+		}
+	}
+
+	std::vector<bool> triangleRemoved(triangleCount, false);
+	std::vector<bool> vertexRemoved(vertexCount, false);
+	std::vector<UINT> version(vertexCount, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	auto locked = [&](UINT vertex) { return vertex < lockedVertices.size() && lockedVertices[vertex]; };
+	auto pushCollapse = [&](UINT from, UINT to) {
+		if (from == to || locked(from)) {
+			return;
+		}
+		Quadric merged = quadrics[from];
+		merged.add(quadrics[to]);
+		double cost = merged.evaluate(point(to)) + attributeQuadrics.evaluate(from, to, attributes + (size_t)to * attributeCount);
+		queue.push({ cost, from, to, version[from], version[to] });
+	};
+	auto pushEdges = [&](UINT vertex) {
+		for (UINT t : vertexTriangles[vertex]) {
+			for (UINT k = 0; k < 3; k++) {
+				UINT other = indices[t * 3 + k];
+				pushCollapse(vertex, other);
+				pushCollapse(other, vertex);
+			}
+		}
+	};
+	for (UINT t = 0; t < triangleCount; t++) {
+		for (UINT k = 0; k < 3; k++) {
+			pushCollapse(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3]);
+			pushCollapse(indices[t * 3 + (k + 1) % 3], indices[t * 3 + k]);
+		}
+	}
+
+	UINT liveTriangles = triangleCount;
+	double worstCost = 0.0;
+	while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+		Collapse collapse = queue.top();
+		queue.pop();
+		if (vertexRemoved[collapse.from] || vertexRemoved[collapse.to]
+			|| version[collapse.from] != collapse.fromVersion || version[collapse.to] != collapse.toVersion) {
+			continue;
+		}
+
+		// Every triangle that keeps its area has to keep facing the same way once 'from' moves.
+		bool flips = false;
+		bool shared = false;
+		for (UINT t : vertexTriangles[collapse.from]) {
+			UINT* triangle = indices + t * 3;
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+				shared = true;
+				continue;
+			}
+			const double* before[3] = { point(triangle[0]), point(triangle[1]), point(triangle[2]) };
+			const double* after[3] = { before[0], before[1], before[2] };
+			for (UINT k = 0; k < 3; k++) {
+				if (triangle[k] == collapse.from) {
+					after[k] = point(collapse.to);
+				}
+			}
+			double normalBefore[3];
+			double normalAfter[3];
+			triangleNormal(before[0], before[1], before[2], normalBefore);
+			triangleNormal(after[0], after[1], after[2], normalAfter);
+			if (dot(normalBefore, normalAfter) <= 0.0) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips || !shared) {
+			continue;
+		}
+
+		for (UINT t : vertexTriangles[collapse.from]) {
+			UINT* triangle = indices + t * 3;
+			if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+				triangleRemoved[t] = true;
+				liveTriangles--;
+				for (UINT k = 0; k < 3; k++) {
+					if (triangle[k] != collapse.from) {
+						std::vector<UINT>& neighbourTriangles = vertexTriangles[triangle[k]];
+						neighbourTriangles.erase(std::remove(neighbourTriangles.begin(), neighbourTriangles.end(), t), neighbourTriangles.end());
+					}
+				}
+				continue;
+			}
+			for (UINT k = 0; k < 3; k++) {
+				if (triangle[k] == collapse.from) {
+					triangle[k] = collapse.to;
+				}
+			}
+			vertexTriangles[collapse.to].push_back(t);
+		}
+		vertexRemoved[collapse.from] = true;
+		vertexTriangles[collapse.from].clear();
+		quadrics[collapse.to].add(quadrics[collapse.from]);
+		if (attributeCount > 0) {
+			attributeQuadrics.add(collapse.to, collapse.from);
+		}
+		worstCost = std::max(worstCost, collapse.cost);
+
+		version[collapse.to]++;
+		pushEdges(collapse.to);
+	}
+
+	UINT written = 0;
+	for (UINT t = 0; t < triangleCount; t++) {
+		if (!triangleRemoved[t]) {
+			std::copy(indices + t * 3, indices + t * 3 + 3, indices + written);
+			written += 3;
+		}
+	}
+	error = (float)std::sqrt(worstCost);
+	return written;
+}
+
+std::vector<MeshLod> BuildMeshLods(const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount, const UINT* indices, UINT indexCount,
+	UINT levelCount, float reduction, float minReduction, const std::vector<bool>& lockedVertices, const float* attributes, UINT attributeCount) {
+	std::vector<MeshLod> lods;
+	std::vector<UINT> levelIndices(indices, indices + indexCount);
+	float error = 0.0f;
+	for (UINT lod = 0; lod < levelCount; lod++) {
+		const UINT lastCount = (UINT)levelIndices.size();
+		float stepError = 0.0f;
+		UINT simplifiedCount = SimplifyMesh(positions, positionStride, vertexCount, levelIndices.data(), lastCount,
+			(UINT)(lastCount / 3 * reduction) * 3, lockedVertices, stepError, attributes, attributeCount);
+		if (simplifiedCount == 0 || simplifiedCount > lastCount * minReduction) {
+			break;
+		}
+		levelIndices.resize(simplifiedCount);
+		error += stepError;
+
+		MeshLod level;
+		level.indices = levelIndices;
+		level.error = error;
+		lods.push_back(std::move(level));
+	}
+	return lods;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+// Only for UINT and DirectX::XMFLOAT3, which Vertex.h has stand-ins for off Windows.
+#include "ModelLoading/Vertex.h"
+
+// Collapses edges onto existing vertices, cheapest first by quadric error (the summed squared distance to the planes
+// of every triangle merged into a vertex), until at most 'targetIndexCount' indices remain or nothing more can collapse.
+// Locked vertices never move, though other vertices can collapse onto them. Collapses that would flip a triangle are skipped.
+// 'positions' is read with 'positionStride' bytes between vertices so it can point into any vertex struct.
+// 'attributes' optionally holds 'attributeCount' floats per vertex that collapses should also keep, their squared distance
+// to the kept vertex's is added to the cost, so they have to be prescaled to how many model units a difference is worth.
+// Indices are rewritten in place and the new count returned, 'error' gets the distance (model units) of the worst collapse.
+UINT SimplifyMesh(const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount, UINT* indices, UINT indexCount,
+	UINT targetIndexCount, const std::vector<bool>& lockedVertices, float& error, const float* attributes = nullptr, UINT attributeCount = 0);
+
+// Locks both ends of every edge used by only one triangle, nothing on the other side holds those in place.
+// Vertices split by welding (UV seams, hard edges) leave open edges too, so this keeps those from tearing as well.
+void LockBorderVertices(const UINT* indices, UINT indexCount, std::vector<bool>& lockedVertices);
+
+// A coarser level of a mesh from BuildMeshLods.
+struct MeshLod {
+	std::vector<UINT> indices;
+	// Each level is simplified from the last, so its error is at most the sum of every step's (model units).
+	float error = 0.0f;
+};
+
+// Up to 'levelCount' coarser levels of a mesh, each simplified from the last to 'reduction' of its triangles.
+// Stops at the first level that can't get below 'minReduction' of the last one's indices, past that a level isn't worth its memory.
+std::vector<MeshLod> BuildMeshLods(const DirectX::XMFLOAT3* positions, size_t positionStride, UINT vertexCount, const UINT* indices, UINT indexCount,
+	UINT levelCount, float reduction, float minReduction, const std::vector<bool>& lockedVertices, const float* attributes = nullptr, UINT attributeCount = 0);
@@ -0,0 +1,586 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <cfloat>
+
+#include "ModelLoading/MeshletBuilder.h"
+
+#define NO_VERTEX UINT_MAX
+// PackedTriangle has 10 bits per index.
+#define MAX_MESHLET_VERTICES 1024
+// Normal cones with a minimum dot product below this are wide enough that they'd almost never cull anything.
+#define DEGENERATE_CONE_DOT 0.1f
+// How many of the mesh's bounding radii from its center MeasureMeshletCulling puts its views.
+#define CULL_VIEW_DISTANCE 3.0f
+
+UINT32 MeshletMeshData::indexSize() const {
+	return vertices.size() <= 65536 ? 2 : 4;
+}
+
+static DirectX::XMFLOAT3 add(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+static DirectX::XMFLOAT3 subtract(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static DirectX::XMFLOAT3 scale(const DirectX::XMFLOAT3& v, float s) {
+	return { v.x * s, v.y * s, v.z * s };
+}
+
+static float dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static DirectX::XMFLOAT3 cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float length(const DirectX::XMFLOAT3& v) {
+	return std::sqrt(dot(v, v));
+}
+
+// Zero vectors stay zero, like XMVector3Normalize.
+static DirectX::XMFLOAT3 normalize(const DirectX::XMFLOAT3& v) {
+	float len = length(v);
+	return len > 0.0f ? scale(v, 1.0f / len) : DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
+}
+
+static const DirectX::XMFLOAT3& loadPosition(const MeshletMeshData& mesh, UINT32 vertex) {
+	return mesh.vertices[vertex].position;
+}
+
+static DirectX::XMFLOAT3 sphereCenter(const DirectX::XMFLOAT4& sphere) {
+	return { sphere.x, sphere.y, sphere.z };
+}
+
+// Points this close to the boundary (relative to the radius) count as inside, so rounding can't make Welzl recurse forever.
+#define SPHERE_EPSILON 1e-5f
+
+static bool sphereContains(const DirectX::XMFLOAT4& sphere, const DirectX::XMFLOAT3& point) {
+	float distance = length(subtract(point, sphereCenter(sphere)));
+	return distance <= sphere.w * (1.0f + SPHERE_EPSILON);
+}
+
+static DirectX::XMFLOAT4 makeSphere(const DirectX::XMFLOAT3& center, float radius) {
+	return { center.x, center.y, center.z, radius };
+}
+
+static DirectX::XMFLOAT4 diameterSphere(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return makeSphere(scale(add(a, b), 0.5f), length(subtract(b, a)) * 0.5f);
+}
+
+// Smallest sphere of the pairs, for boundaries too flat to have a circumsphere.
+static DirectX::XMFLOAT4 widestPairSphere(const DirectX::XMFLOAT3* points, UINT count) {
+	DirectX::XMFLOAT4 widest = makeSphere(points[0], 0.0f);
+	for (UINT i = 0; i < count; i++) {
+		for (UINT j = i + 1; j < count; j++) {
+			DirectX::XMFLOAT4 sphere = diameterSphere(points[i], points[j]);
+			if (sphere.w > widest.w) {
+				widest = sphere;
+			}
+		}
+	}
+	return widest;
+}
+
+// Sphere with every boundary point on its surface, radius -1 (holds nothing) for no points.
+static DirectX::XMFLOAT4 sphereThrough(const DirectX::XMFLOAT3* boundary, UINT count) {
+	using namespace DirectX;
+	switch (count) {
+	case 0:
+		return makeSphere({ 0.0f, 0.0f, 0.0f }, -1.0f);
+	case 1:
+		return makeSphere(boundary[0], 0.0f);
+	case 2:
+		return diameterSphere(boundary[0], boundary[1]);
+	case 3: {
+		XMFLOAT3 a = subtract(boundary[1], boundary[0]);
+		XMFLOAT3 b = subtract(boundary[2], boundary[0]);
+		XMFLOAT3 normal = cross(a, b);
+		float denominator = 2.0f * dot(normal, normal);
+		if (denominator <= FLT_EPSILON * dot(a, a) * dot(b, b)) {
+			return widestPairSphere(boundary, 3);
+		}
+		XMFLOAT3 offset = add(scale(cross(normal, a), dot(b, b)), scale(cross(b, normal), dot(a, a)));
+		offset = scale(offset, 1.0f / denominator);
+		return makeSphere(add(boundary[0], offset), length(offset));
+	}
+	default: {
+		XMFLOAT3 a = subtract(boundary[1], boundary[0]);
+		XMFLOAT3 b = subtract(boundary[2], boundary[0]);
+		XMFLOAT3 c = subtract(boundary[3], boundary[0]);
+		float denominator = 2.0f * dot(a, cross(b, c));
+		float scaleSize = length(a) * length(b) * length(c);
+		if (std::abs(denominator) <= FLT_EPSILON * scaleSize) {
+			// Coplanar, the smallest circle through three of them that holds the fourth.
+			XMFLOAT4 best = widestPairSphere(boundary, 4);
+			for (UINT skip = 0; skip < 4; skip++) {
+				XMFLOAT3 triangle[3];
+				for (UINT i = 0, j = 0; i < 4; i++) {
+					if (i != skip) {
+						triangle[j++] = boundary[i];
+					}
+				}
+				XMFLOAT4 sphere = sphereThrough(triangle, 3);
+				if (sphere.w < best.w && sphereContains(sphere, boundary[skip])) {
+					best = sphere;
+				}
+			}
+			return best;
+		}
+		XMFLOAT3 offset = add(add(scale(cross(b, c), dot(a, a)), scale(cross(c, a), dot(b, b))), scale(cross(a, b), dot(c, c)));
+		offset = scale(offset, 1.0f / denominator);
+		return makeSphere(add(boundary[0], offset), length(offset));
+	}
+	}
+}
+
+// Welzl's algorithm with the move to front heuristic, points outside the sphere so far are moved to the front
+// so later spheres are tested against them first. Recursion is at most 4 deep since each level adds a boundary point.
+static DirectX::XMFLOAT4 minimalSphere(std::vector<DirectX::XMFLOAT3>& points, size_t end, DirectX::XMFLOAT3* boundary, UINT boundaryCount) {
+	DirectX::XMFLOAT4 sphere = sphereThrough(boundary, boundaryCount);
+	if (boundaryCount == 4) {
+		return sphere;
+	}
+	for (size_t i = 0; i < end; i++) {
+		if (!sphereContains(sphere, points[i])) {
+			boundary[boundaryCount] = points[i];
+			sphere = minimalSphere(points, i, boundary, boundaryCount + 1);
+			std::rotate(points.begin(), points.begin() + i, points.begin() + i + 1);
+		}
+	}
+	return sphere;
+}
+
+// Smallest sphere holding every point, xyz = center, w = radius.
+static DirectX::XMFLOAT4 boundingSphere(std::vector<DirectX::XMFLOAT3> points) {
+	DirectX::XMFLOAT3 boundary[4];
+	DirectX::XMFLOAT4 sphere = minimalSphere(points, points.size(), boundary, 0);
+	// SPHERE_EPSILON lets points sit a hair outside, grow to take them in exactly.
+	DirectX::XMFLOAT3 center = sphereCenter(sphere);
+	for (const auto& point : points) {
+		sphere.w = std::max(sphere.w, length(subtract(point, center)));
+	}
+	return sphere;
+}
+
+void BuildMeshlets(MeshletMeshData& mesh, UINT maxVertices, UINT maxPrimitives, float coneWeight) {
+	using namespace DirectX;
+	if (maxVertices < 3 || maxVertices > MAX_MESHLET_VERTICES || maxPrimitives < 1) {
+		throw "Meshlet limits out of range";
+	}
+	mesh.meshlets.clear();
+	mesh.uniqueVertexIndices.clear();
+	mesh.primitiveIndices.clear();
+	const UINT vertexCount = (UINT)mesh.vertices.size();
+	const UINT triangleCount = (UINT)mesh.indices.size() / 3;
+	const UINT32* indices = mesh.indices.data();
+
+	// Triangles using each vertex, packed by vertex.
+	std::vector<UINT> adjacencyOffsets(vertexCount + 1, 0);
+	for (UINT i = 0; i < triangleCount * 3; i++) {
+		adjacencyOffsets[indices[i] + 1]++;
+	}
+	for (UINT v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<UINT> adjacency(triangleCount * 3);
+	std::vector<UINT> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (UINT i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	// Unit face normals, zero for degenerate triangles so they fit any cone.
+	std::vector<XMFLOAT3> triangleNormals(triangleCount);
+	for (UINT t = 0; t < triangleCount; t++) {
+		const XMFLOAT3& p0 = loadPosition(mesh, indices[t * 3]);
+		triangleNormals[t] = normalize(cross(subtract(loadPosition(mesh, indices[t * 3 + 1]), p0), subtract(loadPosition(mesh, indices[t * 3 + 2]), p0)));
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	// Which meshlet last queued the triangle as a candidate, so it's only queued once per meshlet.
+	std::vector<UINT> queuedFor(triangleCount, NO_VERTEX);
+	// Position of the vertex in the current meshlet, NO_VERTEX if it isn't in it.
+	std::vector<UINT> localIndex(vertexCount, NO_VERTEX);
+	std::vector<UINT> candidates;
+	Meshlet current = {};
+	// Sum of the current meshlet's face normals, its direction is the axis candidates are compared against.
+	XMFLOAT3 normalSum = { 0.0f, 0.0f, 0.0f };
+	UINT nextSeed = 0;
+
+	auto newVertexCount = [&](UINT triangle) {
+		UINT count = 0;
+		for (UINT k = 0; k < 3; k++) {
+			UINT32 vertex = indices[triangle * 3 + k];
+			// Degenerate triangles can repeat a vertex, it only needs one slot.
+			bool repeated = (k > 0 && vertex == indices[triangle * 3]) || (k > 1 && vertex == indices[triangle * 3 + 1]);
+			count += localIndex[vertex] == NO_VERTEX && !repeated;
+		}
+		return count;
+	};
+	auto flush = [&]() {
+		for (UINT i = 0; i < current.VertCount; i++) {
+			localIndex[mesh.uniqueVertexIndices[current.VertOffset + i]] = NO_VERTEX;
+		}
+		mesh.meshlets.push_back(current);
+		current = {};
+		current.VertOffset = (UINT32)mesh.uniqueVertexIndices.size();
+		current.PrimOffset = (UINT32)mesh.primitiveIndices.size();
+		normalSum = { 0.0f, 0.0f, 0.0f };
+		candidates.clear();
+	};
+
+	for (UINT emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		UINT best = NO_VERTEX;
+		UINT bestNewVertices = 4;
+		float bestScore = FLT_MAX;
+		XMFLOAT3 axis = normalize(normalSum);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			UINT candidate = candidates[i];
+			if (emitted[candidate]) {
+				candidates[i--] = candidates.back();
+				candidates.pop_back();
+				continue;
+			}
+			// Spread is 0 for a triangle facing along the axis and 2 for one facing against it.
+			UINT newVertices = newVertexCount(candidate);
+			float spread = 1.0f - dot(axis, triangleNormals[candidate]);
+			float score = newVertices + coneWeight * spread;
+			if (score < bestScore || (score == bestScore && candidate < best)) {
+				best = candidate;
+				bestNewVertices = newVertices;
+				bestScore = score;
+			}
+		}
+		if (best == NO_VERTEX) {
+			while (emitted[nextSeed]) {
+				nextSeed++;
+			}
+			best = nextSeed;
+			bestNewVertices = newVertexCount(best);
+		}
+		if (current.VertCount + bestNewVertices > maxVertices || current.PrimCount + 1 > maxPrimitives) {
+			flush();
+			bestNewVertices = newVertexCount(best);
+		}
+
+		UINT32 local[3];
+		for (UINT k = 0; k < 3; k++) {
+			UINT32 vertex = indices[best * 3 + k];
+			if (localIndex[vertex] == NO_VERTEX) {
+				localIndex[vertex] = current.VertCount++;
+				mesh.uniqueVertexIndices.push_back(vertex);
+			}
+			local[k] = localIndex[vertex];
+			for (UINT a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+				UINT neighbour = adjacency[a];
+				if (!emitted[neighbour] && queuedFor[neighbour] != (UINT)mesh.meshlets.size()) {
+					queuedFor[neighbour] = (UINT)mesh.meshlets.size();
+					candidates.push_back(neighbour);
+				}
+			}
+		}
+		PackedTriangle triangle;
+		triangle.i0 = local[0];
+		triangle.i1 = local[1];
+		triangle.i2 = local[2];
+		mesh.primitiveIndices.push_back(triangle);
+		current.PrimCount++;
+		normalSum = add(normalSum, triangleNormals[best]);
+		emitted[best] = true;
+	}
+	if (current.PrimCount > 0) {
+		flush();
+	}
+}
+
+// Axis the shader's UnpackCone gets out of the quantized bytes, not normalized.
+static DirectX::XMFLOAT3 unpackConeAxis(const UINT8 code[3]) {
+	return { code[0] / 255.0f * 2.0f - 1.0f, code[1] / 255.0f * 2.0f - 1.0f, code[2] / 255.0f * 2.0f - 1.0f };
+}
+
+static float minNormalDot(const DirectX::XMFLOAT3& direction, const std::vector<DirectX::XMFLOAT3>& normals) {
+	float minDot = 1.0f;
+	for (const auto& normal : normals) {
+		minDot = std::min(minDot, dot(direction, normal));
+	}
+	return minDot;
+}
+
+void ComputeMeshletCullData(MeshletMeshData& mesh) {
+	using namespace DirectX;
+	mesh.cullData.resize(mesh.meshlets.size());
+	std::vector<XMFLOAT3> points;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT3> trianglePoints;
+	for (size_t m = 0; m < mesh.meshlets.size(); m++) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		CullData& cull = mesh.cullData[m];
+
+		points.clear();
+		for (UINT i = 0; i < meshlet.VertCount; i++) {
+			points.push_back(loadPosition(mesh, mesh.uniqueVertexIndices[meshlet.VertOffset + i]));
+		}
+		cull.BoundingSphere = boundingSphere(points);
+		XMFLOAT3 center = sphereCenter(cull.BoundingSphere);
+
+		// Face normals with the files' winding (counter clockwise, like the .obj files they come from).
+		normals.clear();
+		trianglePoints.clear();
+		for (UINT i = 0; i < meshlet.PrimCount; i++) {
+			const PackedTriangle& triangle = mesh.primitiveIndices[meshlet.PrimOffset + i];
+			const XMFLOAT3& p0 = points[triangle.i0];
+			XMFLOAT3 normal = cross(subtract(points[triangle.i1], p0), subtract(points[triangle.i2], p0));
+			if (dot(normal, normal) > 0.0f) {
+				normals.push_back(normalize(normal));
+				trianglePoints.push_back(p0);
+			}
+		}
+
+		// Degenerate cones always pass the test in MeshletAS.hlsl.
+		cull.NormalCone[0] = 0;
+		cull.NormalCone[1] = 0;
+		cull.NormalCone[2] = 0;
+		cull.NormalCone[3] = 0xFF;
+		cull.ApexOffset = 0.0f;
+		if (normals.empty()) {
+			continue;
+		}
+		// The smallest sphere around the normals points along the narrowest cone. Rounding its axis to bytes can cost
+		// more than the cone has to spare, so the codes around it are tried too and the one the shader unpacks best is kept.
+		XMFLOAT4 normalBounds = boundingSphere(normals);
+		XMFLOAT3 axis = sphereCenter(normalBounds);
+		if (dot(axis, axis) < 1e-8f) {
+			continue;
+		}
+		XMFLOAT3 axisValues = normalize(axis);
+		const float* axisComponents = &axisValues.x;
+		long rounded[3];
+		for (UINT k = 0; k < 3; k++) {
+			rounded[k] = std::lround((axisComponents[k] * 0.5f + 0.5f) * 255.0f);
+		}
+		UINT8 quantized[3] = {};
+		float minDot = -FLT_MAX;
+		for (long dx = -1; dx <= 1; dx++) {
+			for (long dy = -1; dy <= 1; dy++) {
+				for (long dz = -1; dz <= 1; dz++) {
+					UINT8 code[3] = { (UINT8)std::clamp(rounded[0] + dx, 0l, 255l), (UINT8)std::clamp(rounded[1] + dy, 0l, 255l), (UINT8)std::clamp(rounded[2] + dz, 0l, 255l) };
+					XMFLOAT3 unpacked = unpackConeAxis(code);
+					if (dot(unpacked, unpacked) < 1e-8f) {
+						continue;
+					}
+					float codeMinDot = minNormalDot(normalize(unpacked), normals);
+					if (codeMinDot > minDot) {
+						minDot = codeMinDot;
+						std::copy(code, code + 3, quantized);
+					}
+				}
+			}
+		}
+		if (minDot < DEGENERATE_CONE_DOT) {
+			continue;
+		}
+		XMFLOAT3 unpackedAxis = unpackConeAxis(quantized);
+
+		// The apex sits behind every triangle's plane along the axis, the shader moves it by the unnormalized axis.
+		float apexOffset = 0.0f;
+		for (size_t i = 0; i < normals.size(); i++) {
+			float centerDistance = dot(subtract(center, trianglePoints[i]), normals[i]);
+			float axisDistance = dot(unpackedAxis, normals[i]);
+			apexOffset = std::max(apexOffset, centerDistance / axisDistance);
+		}
+
+		// The cone of view directions that only sees back faces is the normal cone widened by 90 degrees and flipped,
+		// its cutoff is -cos(a + 90) = sin(a). Rounding up makes it narrower, so it only culls less.
+		float cutoff = std::sqrt(std::max(1.0f - minDot * minDot, 0.0f));
+		cull.NormalCone[0] = quantized[0];
+		cull.NormalCone[1] = quantized[1];
+		cull.NormalCone[2] = quantized[2];
+		cull.NormalCone[3] = (UINT8)std::min(std::ceil(cutoff * 255.0f), 255.0f);
+		cull.ApexOffset = apexOffset;
+	}
+}
+
+void MeshletCullStats::add(const MeshletCullStats& other) {
+	meshlets += other.meshlets;
+	degenerateCones += other.degenerateCones;
+	meshletTests += other.meshletTests;
+	culledMeshlets += other.culledMeshlets;
+	triangleTests += other.triangleTests;
+	culledTriangles += other.culledTriangles;
+}
+
+float MeshletCullStats::degenerateFraction() const {
+	return meshlets ? (float)degenerateCones / (float)meshlets : 0.0f;
+}
+
+float MeshletCullStats::meshletCullRate() const {
+	return meshletTests ? (float)culledMeshlets / (float)meshletTests : 0.0f;
+}
+
+float MeshletCullStats::triangleCullRate() const {
+	return triangleTests ? (float)culledTriangles / (float)triangleTests : 0.0f;
+}
+
+MeshletCullStats MeasureMeshletCulling(const MeshletMeshData& mesh, UINT viewCount) {
+	using namespace DirectX;
+	MeshletCullStats stats;
+	stats.meshlets = (UINT)mesh.meshlets.size();
+	if (mesh.vertices.empty() || mesh.cullData.size() != mesh.meshlets.size()) {
+		return stats;
+	}
+	XMFLOAT3 minPoint = loadPosition(mesh, 0);
+	XMFLOAT3 maxPoint = minPoint;
+	for (UINT32 v = 1; v < (UINT32)mesh.vertices.size(); v++) {
+		const XMFLOAT3& position = loadPosition(mesh, v);
+		minPoint = { std::min(minPoint.x, position.x), std::min(minPoint.y, position.y), std::min(minPoint.z, position.z) };
+		maxPoint = { std::max(maxPoint.x, position.x), std::max(maxPoint.y, position.y), std::max(maxPoint.z, position.z) };
+	}
+	XMFLOAT3 meshCenter = scale(add(minPoint, maxPoint), 0.5f);
+	float meshRadius = std::max(length(subtract(maxPoint, meshCenter)), FLT_EPSILON);
+
+	for (const CullData& cull : mesh.cullData) {
+		stats.degenerateCones += cull.NormalCone[3] == 0xFF;
+	}
+	for (UINT view = 0; view < viewCount; view++) {
+		// Fibonacci sphere, evenly spread directions without clumping at the poles.
+		float z = 1.0f - (2.0f * view + 1.0f) / viewCount;
+		float ring = std::sqrt(std::max(1.0f - z * z, 0.0f));
+		float angle = view * 2.39996323f;
+		XMFLOAT3 viewPos = add(meshCenter, scale({ ring * std::cos(angle), ring * std::sin(angle), z }, meshRadius * CULL_VIEW_DISTANCE));
+		for (size_t m = 0; m < mesh.meshlets.size(); m++) {
+			const CullData& cull = mesh.cullData[m];
+			const UINT primitives = mesh.meshlets[m].PrimCount;
+			stats.meshletTests++;
+			stats.triangleTests += primitives;
+			if (cull.NormalCone[3] == 0xFF) {
+				continue;
+			}
+			// Same test as IsVisible in MeshletAS.hlsl.
+			XMFLOAT3 axis = unpackConeAxis(cull.NormalCone);
+			XMFLOAT3 apex = subtract(sphereCenter(cull.BoundingSphere), scale(axis, cull.ApexOffset));
+			XMFLOAT3 toView = normalize(subtract(viewPos, apex));
+			if (-dot(toView, normalize(axis)) > cull.NormalCone[3] / 255.0f) {
+				stats.culledMeshlets++;
+				stats.culledTriangles += primitives;
+			}
+		}
+	}
+	return stats;
+}
+
+// Appends 'count' elements of 'size' bytes to the file's data, 4 byte aligned, and returns its BufferView.
+static UINT32 addBufferView(std::vector<UINT8>& buffer, std::vector<BufferView>& bufferViews, const void* data, size_t size) {
+	BufferView view;
+	view.Offset = (UINT32)buffer.size();
+	view.Size = (UINT32)size;
+	buffer.insert(buffer.end(), (const UINT8*)data, (const UINT8*)data + size);
+	buffer.resize((buffer.size() + 3) & ~(size_t)3, 0);
+	bufferViews.push_back(view);
+	return (UINT32)bufferViews.size() - 1;
+}
+
+static UINT32 addAccessor(std::vector<Accessor>& accessors, UINT32 bufferView, UINT32 offset, UINT32 size, UINT32 stride, UINT32 count) {
+	accessors.push_back({ bufferView, offset, size, stride, count });
+	return (UINT32)accessors.size() - 1;
+}
+
+// Narrows to 16 bits when 'indexSize' is 2.
+static std::vector<UINT8> packIndices(const std::vector<UINT32>& indices, UINT32 indexSize) {
+	std::vector<UINT8> packed(indices.size() * indexSize);
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indexSize == 2) {
+			UINT16 index = (UINT16)indices[i];
+			memcpy(packed.data() + i * 2, &index, 2);
+		}
+		else {
+			memcpy(packed.data() + i * 4, &indices[i], 4);
+		}
+	}
+	return packed;
+}
+
+void WriteMeshletFile(std::ostream& stream, const std::vector<MeshletMeshData>& meshes) {
+	std::vector<MeshHeader> headers;
+	std::vector<MeshLodHeader> lodHeaders;
+	std::vector<Accessor> accessors;
+	std::vector<BufferView> bufferViews;
+	std::vector<UINT8> buffer;
+	for (const auto& mesh : meshes) {
+		MeshHeader header;
+		const UINT32 indexSize = mesh.indexSize();
+
+		std::vector<UINT8> indices = packIndices(mesh.indices, indexSize);
+		UINT32 view = addBufferView(buffer, bufferViews, indices.data(), indices.size());
+		header.Indices = addAccessor(accessors, view, 0, indexSize, indexSize, (UINT32)mesh.indices.size());
+
+		Subset indexSubset = { 0, (UINT32)mesh.indices.size() };
+		view = addBufferView(buffer, bufferViews, &indexSubset, sizeof(indexSubset));
+		header.IndexSubsets = addAccessor(accessors, view, 0, sizeof(Subset), sizeof(Subset), 1);
+
+		view = addBufferView(buffer, bufferViews, mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshletVertex));
+		const UINT32 vertexCount = (UINT32)mesh.vertices.size();
+		header.Attributes[Attribute::Position] = addAccessor(accessors, view, offsetof(MeshletVertex, position), sizeof(DirectX::XMFLOAT3), sizeof(MeshletVertex), vertexCount);
+		header.Attributes[Attribute::Normal] = addAccessor(accessors, view, offsetof(MeshletVertex, normal), sizeof(DirectX::XMFLOAT3), sizeof(MeshletVertex), vertexCount);
+		header.Attributes[Attribute::TexCoord] = addAccessor(accessors, view, offsetof(MeshletVertex, texCoord), sizeof(DirectX::XMFLOAT2), sizeof(MeshletVertex), vertexCount);
+		header.Attributes[Attribute::Tangent] = addAccessor(accessors, view, offsetof(MeshletVertex, tangent), sizeof(DirectX::XMFLOAT3), sizeof(MeshletVertex), vertexCount);
+		header.Attributes[Attribute::Bitangent] = addAccessor(accessors, view, offsetof(MeshletVertex, bitangent), sizeof(DirectX::XMFLOAT3), sizeof(MeshletVertex), vertexCount);
+
+		view = addBufferView(buffer, bufferViews, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+		header.Meshlets = addAccessor(accessors, view, 0, sizeof(Meshlet), sizeof(Meshlet), (UINT32)mesh.meshlets.size());
+
+		Subset meshletSubset = { 0, (UINT32)mesh.meshlets.size() };
+		view = addBufferView(buffer, bufferViews, &meshletSubset, sizeof(meshletSubset));
+		header.MeshletSubsets = addAccessor(accessors, view, 0, sizeof(Subset), sizeof(Subset), 1);
+
+		std::vector<UINT8> uniqueVertexIndices = packIndices(mesh.uniqueVertexIndices, indexSize);
+		view = addBufferView(buffer, bufferViews, uniqueVertexIndices.data(), uniqueVertexIndices.size());
+		header.UniqueVertexIndices = addAccessor(accessors, view, 0, indexSize, indexSize, (UINT32)mesh.uniqueVertexIndices.size());
+
+		view = addBufferView(buffer, bufferViews, mesh.primitiveIndices.data(), mesh.primitiveIndices.size() * sizeof(PackedTriangle));
+		header.PrimitiveIndices = addAccessor(accessors, view, 0, sizeof(PackedTriangle), sizeof(PackedTriangle), (UINT32)mesh.primitiveIndices.size());
+
+		view = addBufferView(buffer, bufferViews, mesh.cullData.data(), mesh.cullData.size() * sizeof(CullData));
+		header.CullData = addAccessor(accessors, view, 0, sizeof(CullData), sizeof(CullData), (UINT32)mesh.cullData.size());
+
+		MeshLodHeader lodHeader = { UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1) };
+		if (!mesh.clusterLods.empty()) {
+			view = addBufferView(buffer, bufferViews, mesh.lodMeshlets.data(), mesh.lodMeshlets.size() * sizeof(Meshlet));
+			lodHeader.Meshlets = addAccessor(accessors, view, 0, sizeof(Meshlet), sizeof(Meshlet), (UINT32)mesh.lodMeshlets.size());
+
+			std::vector<UINT8> lodUniqueVertexIndices = packIndices(mesh.lodUniqueVertexIndices, indexSize);
+			view = addBufferView(buffer, bufferViews, lodUniqueVertexIndices.data(), lodUniqueVertexIndices.size());
+			lodHeader.UniqueVertexIndices = addAccessor(accessors, view, 0, indexSize, indexSize, (UINT32)mesh.lodUniqueVertexIndices.size());
+
+			view = addBufferView(buffer, bufferViews, mesh.lodPrimitiveIndices.data(), mesh.lodPrimitiveIndices.size() * sizeof(PackedTriangle));
+			lodHeader.PrimitiveIndices = addAccessor(accessors, view, 0, sizeof(PackedTriangle), sizeof(PackedTriangle), (UINT32)mesh.lodPrimitiveIndices.size());
+
+			view = addBufferView(buffer, bufferViews, mesh.lodCullData.data(), mesh.lodCullData.size() * sizeof(CullData));
+			lodHeader.CullData = addAccessor(accessors, view, 0, sizeof(CullData), sizeof(CullData), (UINT32)mesh.lodCullData.size());
+
+			view = addBufferView(buffer, bufferViews, mesh.clusterLods.data(), mesh.clusterLods.size() * sizeof(ClusterLod));
+			lodHeader.ClusterLods = addAccessor(accessors, view, 0, sizeof(ClusterLod), sizeof(ClusterLod), (UINT32)mesh.clusterLods.size());
+		}
+
+		headers.push_back(header);
+		lodHeaders.push_back(lodHeader);
+	}
+
+	FileHeader fileHeader;
+	fileHeader.Prolog = MESHLET_FILE_PROLOG;
+	fileHeader.Version = FILE_VERSION_CLUSTER_LOD;
+	fileHeader.MeshCount = (UINT32)headers.size();
+	fileHeader.AccessorCount = (UINT32)accessors.size();
+	fileHeader.BufferViewCount = (UINT32)bufferViews.size();
+	fileHeader.BufferSize = (UINT32)buffer.size();
+	stream.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+	stream.write(reinterpret_cast<const char*>(headers.data()), headers.size() * sizeof(headers[0]));
+	stream.write(reinterpret_cast<const char*>(lodHeaders.data()), lodHeaders.size() * sizeof(lodHeaders[0]));
+	stream.write(reinterpret_cast<const char*>(accessors.data()), accessors.size() * sizeof(accessors[0]));
+	stream.write(reinterpret_cast<const char*>(bufferViews.data()), bufferViews.size() * sizeof(bufferViews[0]));
+	stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+}
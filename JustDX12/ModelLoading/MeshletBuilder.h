@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <ostream>
+
+#include "ModelLoading/MeshletFormat.h"
+// MeshletVertex uses the same DirectXMath float types as Vertex, this brings in their stand-ins off Windows.
+#include "ModelLoading/Vertex.h"
+
+// Vertex of built meshlet files, stored interleaved in the layout of Vertex in MeshletCommon.hlsl.
+struct MeshletVertex {
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT3 tangent;
+	DirectX::XMFLOAT3 bitangent;
+	DirectX::XMFLOAT2 texCoord;
+};
+
+// One mesh in the form MeshletModel loads it, everything here is plain CPU data so it can be built and checked without a device.
+struct MeshletMeshData {
+	std::vector<MeshletVertex> vertices;
+	std::vector<UINT32> indices;
+	std::vector<Meshlet> meshlets;
+	// Meshlet::VertOffset indexes into these, each one is an index into 'vertices'.
+	std::vector<UINT32> uniqueVertexIndices;
+	// Indices into the meshlet's unique vertices.
+	std::vector<PackedTriangle> primitiveIndices;
+	std::vector<CullData> cullData;
+
+	// Coarser levels from BuildMeshletHierarchy, they index 'vertices' the same way the full detail meshlets do.
+	std::vector<Meshlet> lodMeshlets;
+	std::vector<UINT32> lodUniqueVertexIndices;
+	std::vector<PackedTriangle> lodPrimitiveIndices;
+	std::vector<CullData> lodCullData;
+	// One per meshlet then one per lod meshlet, empty without a hierarchy.
+	std::vector<ClusterLod> clusterLods;
+
+	// 2 if every vertex can be addressed with 16 bits, the file stores 'indices' and both unique vertex index lists at this size.
+	UINT32 indexSize() const;
+};
+
+// Raw counts from running MeshletAS.hlsl's normal cone test on every meshlet from views spread evenly around the mesh.
+// Counts from several meshes can be summed before working out the ratios.
+struct MeshletCullStats {
+	UINT meshlets = 0;
+	// Meshlets the shader can never backface cull.
+	UINT degenerateCones = 0;
+	UINT64 meshletTests = 0;
+	UINT64 culledMeshlets = 0;
+	UINT64 triangleTests = 0;
+	UINT64 culledTriangles = 0;
+
+	void add(const MeshletCullStats& other);
+	float degenerateFraction() const;
+	// Fraction of meshlets, or of the triangles in them, the cone test removes from an average view.
+	float meshletCullRate() const;
+	float triangleCullRate() const;
+};
+
+// Splits 'indices' into meshlets of at most 'maxVertices' unique vertices and 'maxPrimitives' triangles.
+// Each meshlet grows from the adjacent triangle that needs the fewest new vertices, plus 'coneWeight' times how far
+// its normal is from the meshlet's average (0 to 2), so meshlets keep to one side of curved surfaces and their cones stay usable.
+// A full meshlet seeds the next one with that triangle so neighbouring meshlets stay spatially close.
+// Throws if the limits can't be packed into PackedTriangle.
+void BuildMeshlets(MeshletMeshData& mesh, UINT maxVertices, UINT maxPrimitives, float coneWeight);
+
+// Minimal bounding sphere and tightest normal cone of every meshlet, in the format MeshletAS.hlsl tests.
+// The cone is worked out against its quantized axis and rounded outwards, so quantization never culls a visible meshlet.
+void ComputeMeshletCullData(MeshletMeshData& mesh);
+
+// Cull data quality of a built mesh, 'viewCount' views are placed a few bounding radii out from its center.
+MeshletCullStats MeasureMeshletCulling(const MeshletMeshData& mesh, UINT viewCount);
+
+// Writes the meshes as an uncompressed FILE_VERSION_CLUSTER_LOD 'MSHL' file, one subset per mesh, with their
+// cluster hierarchies if they have one. CompressMeshletFile turns it into a chunked one.
+void WriteMeshletFile(std::ostream& stream, const std::vector<MeshletMeshData>& meshes);
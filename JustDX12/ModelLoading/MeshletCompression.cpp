@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "ModelLoading/MeshletCompression.h"
+#include "ModelLoading/MeshletFile.h"
+
+static UINT32 zigzag(INT32 value) {
+	return ((UINT32)value << 1) ^ (UINT32)(value >> 31);
+}
+
+static INT32 unzigzag(UINT32 value) {
+	return (INT32)(value >> 1) ^ -(INT32)(value & 1);
+}
+
+static void writeVarint(std::vector<UINT8>& out, UINT32 value) {
+	while (value >= 0x80) {
+		out.push_back((UINT8)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((UINT8)value);
+}
+
+// Reads an encoded stream, every read fails instead of running past the end.
+struct StreamReader {
+	const UINT8* data;
+	size_t size;
+	size_t position = 0;
+
+	bool readVarint(UINT32& value) {
+		value = 0;
+		for (UINT32 shift = 0; shift < 35; shift += 7) {
+			if (position >= size) {
+				return false;
+			}
+			UINT8 byte = data[position++];
+			value |= (UINT32)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool readBytes(void* out, size_t count) {
+		if (count > size - position) {
+			return false;
+		}
+		memcpy(out, data + position, count);
+		position += count;
+		return true;
+	}
+
+	bool finished() const {
+		return position == size;
+	}
+};
+
+static UINT32 loadWord(const UINT8* data, UINT32 wordSize) {
+	UINT32 word = 0;
+	memcpy(&word, data, wordSize);
+	return word;
+}
+
+// Difference between two words, wrapped to the word size so a 16 bit drop doesn't cost a 32 bit varint.
+static INT32 wordDelta(UINT32 word, UINT32 previous, UINT32 wordSize) {
+	return wordSize == 2 ? (INT32)(INT16)(UINT16)(word - previous) : (INT32)(word - previous);
+}
+
+static void encodeWordDelta(const UINT8* data, size_t size, UINT32 wordSize, UINT32 stride, std::vector<UINT8>& out) {
+	const size_t wordCount = size / wordSize;
+	for (size_t i = 0; i < wordCount; i++) {
+		UINT32 previous = i >= stride ? loadWord(data + (i - stride) * wordSize, wordSize) : 0;
+		writeVarint(out, zigzag(wordDelta(loadWord(data + i * wordSize, wordSize), previous, wordSize)));
+	}
+}
+
+static bool decodeWordDelta(StreamReader& reader, UINT8* out, size_t size, UINT32 wordSize, UINT32 stride) {
+	const size_t wordCount = size / wordSize;
+	for (size_t i = 0; i < wordCount; i++) {
+		UINT32 delta;
+		if (!reader.readVarint(delta)) {
+			return false;
+		}
+		UINT32 previous = i >= stride ? loadWord(out + (i - stride) * wordSize, wordSize) : 0;
+		UINT32 word = previous + (UINT32)unzigzag(delta);
+		memcpy(out + i * wordSize, &word, wordSize);
+	}
+	return true;
+}
+
+static bool encodeTriangles(const UINT8* data, size_t size, std::vector<UINT8>& out) {
+	const size_t triangleCount = size / sizeof(PackedTriangle);
+	const PackedTriangle* triangles = reinterpret_cast<const PackedTriangle*>(data);
+	UINT32 largest = 0;
+	for (size_t i = 0; i < triangleCount; i++) {
+		largest = std::max({ largest, (UINT32)triangles[i].i0, (UINT32)triangles[i].i1, (UINT32)triangles[i].i2 });
+	}
+	UINT8 width = 1;
+	while ((1u << width) <= largest) {
+		width++;
+	}
+	out.push_back(width);
+
+	UINT64 bits = 0;
+	UINT32 bitCount = 0;
+	for (size_t i = 0; i < triangleCount; i++) {
+		for (UINT32 index : { (UINT32)triangles[i].i0, (UINT32)triangles[i].i1, (UINT32)triangles[i].i2 }) {
+			bits |= (UINT64)index << bitCount;
+			bitCount += width;
+			while (bitCount >= 8) {
+				out.push_back((UINT8)bits);
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+	}
+	if (bitCount > 0) {
+		out.push_back((UINT8)bits);
+	}
+	return true;
+}
+
+static bool decodeTriangles(StreamReader& reader, UINT8* out, size_t size) {
+	UINT8 width;
+	if (!reader.readBytes(&width, 1) || width == 0 || width > 10) {
+		return false;
+	}
+	const size_t triangleCount = size / sizeof(PackedTriangle);
+	UINT64 bits = 0;
+	UINT32 bitCount = 0;
+	const UINT32 mask = (1u << width) - 1;
+	for (size_t i = 0; i < triangleCount; i++) {
+		UINT32 index[3];
+		for (UINT32 k = 0; k < 3; k++) {
+			while (bitCount < width) {
+				UINT8 byte;
+				if (!reader.readBytes(&byte, 1)) {
+					return false;
+				}
+				bits |= (UINT64)byte << bitCount;
+				bitCount += 8;
+			}
+			index[k] = (UINT32)bits & mask;
+			bits >>= width;
+			bitCount -= width;
+		}
+		PackedTriangle triangle = {};
+		triangle.i0 = index[0];
+		triangle.i1 = index[1];
+		triangle.i2 = index[2];
+		memcpy(out + i * sizeof(PackedTriangle), &triangle, sizeof(PackedTriangle));
+	}
+	return true;
+}
+
+// Quantizes every component over its own range, fails on streams with values that have no range (NaN, infinity).
+static bool encodeQuantized(const UINT8* data, size_t size, UINT32 stride, std::vector<UINT8>& out) {
+	const size_t elementCount = size / (stride * sizeof(FLOAT));
+	std::vector<FLOAT> ranges(stride * 2);
+	for (UINT32 c = 0; c < stride; c++) {
+		FLOAT minimum = FLT_MAX;
+		FLOAT maximum = -FLT_MAX;
+		for (size_t i = 0; i < elementCount; i++) {
+			FLOAT value;
+			memcpy(&value, data + (i * stride + c) * sizeof(FLOAT), sizeof(FLOAT));
+			if (!std::isfinite(value)) {
+				return false;
+			}
+			minimum = std::min(minimum, value);
+			maximum = std::max(maximum, value);
+		}
+		ranges[c * 2] = elementCount > 0 ? minimum : 0.0f;
+		ranges[c * 2 + 1] = elementCount > 0 ? (maximum - minimum) / 65535.0f : 0.0f;
+	}
+	out.resize(ranges.size() * sizeof(FLOAT));
+	memcpy(out.data(), ranges.data(), out.size());
+
+	std::vector<UINT16> quantized(elementCount * stride);
+	for (size_t i = 0; i < quantized.size(); i++) {
+		FLOAT value;
+		memcpy(&value, data + i * sizeof(FLOAT), sizeof(FLOAT));
+		const FLOAT step = ranges[(i % stride) * 2 + 1];
+		const FLOAT q = step > 0.0f ? std::round((value - ranges[(i % stride) * 2]) / step) : 0.0f;
+		quantized[i] = (UINT16)std::clamp(q, 0.0f, 65535.0f);
+	}
+	encodeWordDelta(reinterpret_cast<const UINT8*>(quantized.data()), quantized.size() * sizeof(UINT16), sizeof(UINT16), stride, out);
+	return true;
+}
+
+static bool decodeQuantized(StreamReader& reader, UINT8* out, size_t size, UINT32 stride) {
+	std::vector<FLOAT> ranges(stride * 2);
+	if (!reader.readBytes(ranges.data(), ranges.size() * sizeof(FLOAT))) {
+		return false;
+	}
+	std::vector<UINT16> quantized(size / sizeof(FLOAT));
+	if (!decodeWordDelta(reader, reinterpret_cast<UINT8*>(quantized.data()), quantized.size() * sizeof(UINT16), sizeof(UINT16), stride)) {
+		return false;
+	}
+	for (size_t i = 0; i < quantized.size(); i++) {
+		FLOAT value = ranges[(i % stride) * 2] + quantized[i] * ranges[(i % stride) * 2 + 1];
+		memcpy(out + i * sizeof(FLOAT), &value, sizeof(FLOAT));
+	}
+	return true;
+}
+
+static bool decodeStream(const StreamHeader& header, const UINT8* encoded, UINT8* out, size_t size) {
+	StreamReader reader = { encoded, header.EncodedSize };
+	bool decoded = false;
+	switch (header.Codec) {
+	case STREAM_CODEC_RAW:
+		decoded = reader.readBytes(out, size);
+		break;
+	case STREAM_CODEC_WORD_DELTA:
+		decoded = (header.WordSize == 2 || header.WordSize == 4) && header.Stride > 0 && size % header.WordSize == 0
+			&& decodeWordDelta(reader, out, size, header.WordSize, header.Stride);
+		break;
+	case STREAM_CODEC_TRIANGLES:
+		decoded = size % sizeof(PackedTriangle) == 0 && decodeTriangles(reader, out, size);
+		break;
+	case STREAM_CODEC_QUANTIZED:
+		decoded = header.WordSize == sizeof(FLOAT) && header.Stride > 0 && header.Stride <= size / sizeof(FLOAT)
+			&& size % (header.Stride * sizeof(FLOAT)) == 0 && decodeQuantized(reader, out, size, header.Stride);
+		break;
+	}
+	return decoded && reader.finished();
+}
+
+// How a BufferView is encoded, picked from what the first accessor reading it is used for.
+struct StreamPlan {
+	UINT32 codec = STREAM_CODEC_RAW;
+	UINT32 wordSize = 1;
+	UINT32 stride = 1;
+};
+
+static void encodeStream(const StreamPlan& plan, std::span<const UINT8> data, StreamHeader& header, std::vector<UINT8>& out) {
+	std::vector<UINT8> encoded;
+	bool fits = false;
+	switch (plan.codec) {
+	case STREAM_CODEC_WORD_DELTA:
+		if (data.size() % plan.wordSize == 0) {
+			encodeWordDelta(data.data(), data.size(), plan.wordSize, plan.stride, encoded);
+			fits = true;
+		}
+		break;
+	case STREAM_CODEC_TRIANGLES:
+		fits = data.size() % sizeof(PackedTriangle) == 0 && encodeTriangles(data.data(), data.size(), encoded);
+		break;
+	case STREAM_CODEC_QUANTIZED:
+		fits = plan.stride > 0 && data.size() >= plan.stride * sizeof(FLOAT) && data.size() % (plan.stride * sizeof(FLOAT)) == 0
+			&& encodeQuantized(data.data(), data.size(), plan.stride, encoded);
+		break;
+	}
+	if (!fits || encoded.size() >= data.size()) {
+		header = { STREAM_CODEC_RAW, 1, 1, (UINT32)data.size() };
+		out.insert(out.end(), data.begin(), data.end());
+		return;
+	}
+	header = { plan.codec, plan.wordSize, plan.stride, (UINT32)encoded.size() };
+	out.insert(out.end(), encoded.begin(), encoded.end());
+}
+
+template <typename T>
+static void appendBytes(std::vector<UINT8>& out, const T* data, size_t count) {
+	const UINT8* bytes = reinterpret_cast<const UINT8*>(data);
+	out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+// The mesh's own accessors and BufferViews as a single mesh file's tables, followed by its encoded streams.
+static void writeChunk(const MeshletFileView& view, UINT32 mesh, bool quantizeVertices, std::vector<UINT8>& chunk, UINT32& decodedSize) {
+	MeshHeader header = view.meshes[mesh];
+	MeshLodHeader lodHeader = view.lodHeaders[mesh];
+	std::vector<UINT32> accessorMap(view.accessors.size(), UINT32(-1));
+	std::vector<UINT32> bufferViewMap(view.bufferViews.size(), UINT32(-1));
+	std::vector<Accessor> accessors;
+	std::vector<BufferView> bufferViews;
+	std::vector<UINT32> sourceViews;
+	std::vector<StreamPlan> plans;
+	UINT32 bufferSize = 0;
+	auto remap = [&](UINT32& accessor, StreamPlan plan) {
+		if (accessor == UINT32(-1)) {
+			return;
+		}
+		if (accessorMap[accessor] == UINT32(-1)) {
+			Accessor copy = view.accessors[accessor];
+			if (bufferViewMap[copy.BufferView] == UINT32(-1)) {
+				const BufferView& source = view.bufferViews[copy.BufferView];
+				bufferViewMap[copy.BufferView] = (UINT32)bufferViews.size();
+				bufferViews.push_back({ bufferSize, source.Size });
+				sourceViews.push_back(copy.BufferView);
+				plans.push_back(plan);
+				bufferSize += (source.Size + 3) & ~3u;
+			}
+			copy.BufferView = bufferViewMap[copy.BufferView];
+			accessorMap[accessor] = (UINT32)accessors.size();
+			accessors.push_back(copy);
+		}
+		accessor = accessorMap[accessor];
+	};
+
+	const UINT32 indexSize = view.accessors[header.Indices].Size;
+	const StreamPlan indices = { STREAM_CODEC_WORD_DELTA, indexSize, 1 };
+	const StreamPlan meshlets = { STREAM_CODEC_WORD_DELTA, sizeof(UINT32), sizeof(Meshlet) / sizeof(UINT32) };
+	const StreamPlan triangles = { STREAM_CODEC_TRIANGLES, sizeof(UINT32), 1 };
+	remap(header.Indices, indices);
+	remap(header.IndexSubsets, StreamPlan());
+	for (UINT32 j = 0; j < Attribute::Count; j++) {
+		StreamPlan vertices;
+		if (quantizeVertices && header.Attributes[j] != UINT32(-1) && view.accessors[header.Attributes[j]].Stride % sizeof(FLOAT) == 0) {
+			vertices = { STREAM_CODEC_QUANTIZED, sizeof(FLOAT), view.accessors[header.Attributes[j]].Stride / (UINT32)sizeof(FLOAT) };
+		}
+		remap(header.Attributes[j], vertices);
+	}
+	remap(header.Meshlets, meshlets);
+	remap(header.MeshletSubsets, StreamPlan());
+	remap(header.UniqueVertexIndices, indices);
+	remap(header.PrimitiveIndices, triangles);
+	remap(header.CullData, StreamPlan());
+	remap(lodHeader.Meshlets, meshlets);
+	remap(lodHeader.UniqueVertexIndices, indices);
+	remap(lodHeader.PrimitiveIndices, triangles);
+	remap(lodHeader.CullData, StreamPlan());
+	remap(lodHeader.ClusterLods, StreamPlan());
+
+	FileHeader fileHeader = { MESHLET_FILE_PROLOG, FILE_VERSION_CLUSTER_LOD, 1, (UINT32)accessors.size(), (UINT32)bufferViews.size(), bufferSize };
+	chunk.clear();
+	appendBytes(chunk, &fileHeader, 1);
+	appendBytes(chunk, &header, 1);
+	appendBytes(chunk, &lodHeader, 1);
+	appendBytes(chunk, accessors.data(), accessors.size());
+	appendBytes(chunk, bufferViews.data(), bufferViews.size());
+	decodedSize = (UINT32)chunk.size() + bufferSize;
+
+	std::vector<StreamHeader> streamHeaders(bufferViews.size());
+	std::vector<UINT8> streams;
+	for (size_t i = 0; i < bufferViews.size(); i++) {
+		const BufferView& source = view.bufferViews[sourceViews[i]];
+		encodeStream(plans[i], view.buffer.subspan(source.Offset, source.Size), streamHeaders[i], streams);
+	}
+	appendBytes(chunk, streamHeaders.data(), streamHeaders.size());
+	chunk.insert(chunk.end(), streams.begin(), streams.end());
+}
+
+bool CompressMeshletFile(std::span<const UINT8> file, std::ostream& stream, bool quantizeVertices, std::string& error) {
+	MeshletFileView view;
+	if (!ParseMeshletFile(file, view, error)) {
+		return false;
+	}
+	if (view.header->Version >= FILE_VERSION_CHUNKED) {
+		error = "already chunked";
+		return false;
+	}
+
+	std::vector<std::vector<UINT8>> chunks(view.meshes.size());
+	std::vector<MeshChunk> chunkTable(view.meshes.size());
+	const UINT64 tablesSize = sizeof(FileHeader) + chunkTable.size() * sizeof(MeshChunk);
+	UINT64 offset = tablesSize;
+	for (UINT32 i = 0; i < (UINT32)view.meshes.size(); i++) {
+		writeChunk(view, i, quantizeVertices, chunks[i], chunkTable[i].DecodedSize);
+		chunkTable[i].Offset = (UINT32)offset;
+		chunkTable[i].Size = (UINT32)chunks[i].size();
+		offset += chunks[i].size();
+		if (offset > UINT32(-1)) {
+			error = "compressed file is over 4GB";
+			return false;
+		}
+	}
+
+	FileHeader header = { MESHLET_FILE_PROLOG, FILE_VERSION_CHUNKED, (UINT32)view.meshes.size(), 0, 0, (UINT32)(offset - tablesSize) };
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(chunkTable.data()), chunkTable.size() * sizeof(chunkTable[0]));
+	for (const auto& chunk : chunks) {
+		stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+	if (!stream) {
+		error = "couldn't write the compressed file";
+		return false;
+	}
+	return true;
+}
+
+bool DecodeMeshletChunk(std::span<const UINT8> chunk, UINT32 decodedSize, std::vector<UINT8>& decoded, std::string& error) {
+	FileHeader header;
+	if (chunk.size() < sizeof(header)) {
+		error = "chunk is too small for a header";
+		return false;
+	}
+	memcpy(&header, chunk.data(), sizeof(header));
+	if (header.Prolog != MESHLET_FILE_PROLOG || header.Version != FILE_VERSION_CLUSTER_LOD || header.MeshCount != 1) {
+		error = "chunk doesn't hold a single mesh";
+		return false;
+	}
+	const UINT64 tablesSize = sizeof(FileHeader) + sizeof(MeshHeader) + sizeof(MeshLodHeader)
+		+ (UINT64)header.AccessorCount * sizeof(Accessor) + (UINT64)header.BufferViewCount * sizeof(BufferView);
+	const UINT64 streamsOffset = tablesSize + (UINT64)header.BufferViewCount * sizeof(StreamHeader);
+	if (tablesSize + header.BufferSize != decodedSize || streamsOffset > chunk.size()) {
+		error = "chunk tables don't match its size";
+		return false;
+	}
+
+	// Zeroed so the padding between BufferViews decodes the same every time.
+	decoded.assign(decodedSize, 0);
+	memcpy(decoded.data(), chunk.data(), tablesSize);
+	const UINT8* bufferViews = decoded.data() + tablesSize - (UINT64)header.BufferViewCount * sizeof(BufferView);
+	UINT8* buffer = decoded.data() + tablesSize;
+	UINT64 encodedOffset = streamsOffset;
+	for (UINT32 i = 0; i < header.BufferViewCount; i++) {
+		StreamHeader streamHeader;
+		BufferView bufferView;
+		memcpy(&streamHeader, chunk.data() + tablesSize + i * sizeof(StreamHeader), sizeof(StreamHeader));
+		memcpy(&bufferView, bufferViews + i * sizeof(BufferView), sizeof(BufferView));
+		if ((UINT64)bufferView.Offset + bufferView.Size > header.BufferSize || streamHeader.EncodedSize > chunk.size() - encodedOffset) {
+			error = "stream " + std::to_string(i) + " is out of range";
+			return false;
+		}
+		if (!decodeStream(streamHeader, chunk.data() + encodedOffset, buffer + bufferView.Offset, bufferView.Size)) {
+			error = "stream " + std::to_string(i) + " doesn't decode to its buffer view";
+			return false;
+		}
+		encodedOffset += streamHeader.EncodedSize;
+	}
+	if (encodedOffset != chunk.size()) {
+		error = "chunk has bytes after its streams";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ModelLoading/MeshletFormat.h"
+
+// Rewrites a FILE_VERSION_INITIAL or FILE_VERSION_CLUSTER_LOD file as FILE_VERSION_CHUNKED, one chunk per mesh.
+// Indices and meshlets are delta coded, primitives bit packed, everything else stored raw, and any stream a codec
+// doesn't shrink is stored raw too. 'quantizeVertices' stores vertex streams with STREAM_CODEC_QUANTIZED, which is lossy.
+bool CompressMeshletFile(std::span<const UINT8> file, std::ostream& stream, bool quantizeVertices, std::string& error);
+
+// Decodes one MeshChunk of a FILE_VERSION_CHUNKED file into the single mesh file it holds, for ParseMeshletFile to check.
+// Every read is bounds checked, so a damaged chunk fails with 'error' set instead of decoding garbage past its end.
+bool DecodeMeshletChunk(std::span<const UINT8> chunk, UINT32 decodedSize, std::vector<UINT8>& decoded, std::string& error);
@@ -0,0 +1,256 @@
+#include <cstdint>
+
+#include "ModelLoading/MeshletFile.h"
+
+// Size of each attribute as MeshletModel's input layout reads it, in Attribute::EType order.
+static const UINT32 attributeSizes[Attribute::Count] = { 12, 12, 8, 12, 12 };
+
+static bool fail(std::string& error, UINT32 mesh, const std::string& message) {
+	error = "mesh " + std::to_string(mesh) + ": " + message;
+	return false;
+}
+
+// The accessor exists and 'Count' elements of 'elementSize' from the start of its BufferView stay inside it.
+static bool checkElements(const MeshletFileView& view, UINT32 accessor, UINT64 elementSize, UINT32 mesh, const char* name, std::string& error) {
+	if (accessor >= view.accessors.size()) {
+		return fail(error, mesh, std::string(name) + " accessor is missing");
+	}
+	const BufferView& bufferView = view.bufferViews[view.accessors[accessor].BufferView];
+	if (view.accessors[accessor].Count * elementSize > bufferView.Size) {
+		return fail(error, mesh, std::string(name) + " reads past the end of its buffer view");
+	}
+	if (bufferView.Offset % 4 != 0) {
+		return fail(error, mesh, std::string(name) + " isn't 4 byte aligned");
+	}
+	return true;
+}
+
+// Every subset of 'subsets' covers part of 'count' elements, and none is empty.
+static bool checkSubsets(std::span<const Subset> subsets, UINT64 count, UINT32 mesh, const char* name, std::string& error) {
+	for (const Subset& subset : subsets) {
+		if (subset.Count == 0 || (UINT64)subset.Offset + subset.Count > count) {
+			return fail(error, mesh, std::string(name) + " subset is empty or out of range");
+		}
+	}
+	return true;
+}
+
+static UINT32 readIndex(std::span<const UINT8> indices, UINT32 indexSize, UINT64 index) {
+	if (indexSize == 4) {
+		return reinterpret_cast<const UINT32*>(indices.data())[index];
+	}
+	return reinterpret_cast<const UINT16*>(indices.data())[index];
+}
+
+static bool checkIndices(std::span<const UINT8> indices, UINT32 indexSize, UINT32 count, UINT32 vertexCount, UINT32 mesh, const char* name, std::string& error) {
+	for (UINT32 i = 0; i < count; i++) {
+		if (readIndex(indices, indexSize, i) >= vertexCount) {
+			return fail(error, mesh, std::string(name) + " has an index past the mesh's vertices");
+		}
+	}
+	return true;
+}
+
+// Meshlets only reach their own unique vertex indices and primitives, and primitives only their meshlet's vertices.
+static bool checkMeshlets(const MeshletFileView& view, UINT32 meshletAccessor, UINT32 uniqueIndexAccessor, UINT32 primitiveAccessor,
+	UINT32 indexSize, UINT32 vertexCount, UINT32 mesh, const char* name, std::string& error) {
+	std::span<const UINT8> uniqueIndices = view.viewBytes(uniqueIndexAccessor);
+	UINT32 uniqueIndexCount = view.accessors[uniqueIndexAccessor].Count;
+	std::span<const PackedTriangle> primitives = view.elements<PackedTriangle>(primitiveAccessor);
+	if (!checkIndices(uniqueIndices, indexSize, uniqueIndexCount, vertexCount, mesh, name, error)) {
+		return false;
+	}
+	for (const Meshlet& meshlet : view.elements<Meshlet>(meshletAccessor)) {
+		if (meshlet.VertCount == 0 || meshlet.PrimCount == 0 || meshlet.VertCount > MESHLET_GROUP_SIZE || meshlet.PrimCount > MESHLET_GROUP_SIZE) {
+			return fail(error, mesh, std::string(name) + " has a meshlet that's empty or larger than MeshletMS can output");
+		}
+		if ((UINT64)meshlet.VertOffset + meshlet.VertCount > uniqueIndexCount
+			|| (UINT64)meshlet.PrimOffset + meshlet.PrimCount > primitives.size()) {
+			return fail(error, mesh, std::string(name) + " has a meshlet that's out of range");
+		}
+		for (UINT32 p = meshlet.PrimOffset; p < meshlet.PrimOffset + meshlet.PrimCount; p++) {
+			if (primitives[p].i0 >= meshlet.VertCount || primitives[p].i1 >= meshlet.VertCount || primitives[p].i2 >= meshlet.VertCount) {
+				return fail(error, mesh, std::string(name) + " has a primitive past its meshlet's vertices");
+			}
+		}
+	}
+	return true;
+}
+
+static bool checkMesh(const MeshletFileView& view, UINT32 mesh, std::string& error) {
+	const MeshHeader& header = view.meshes[mesh];
+
+	// Vertices, every attribute has the same count and its own part of its stream's stride.
+	if (header.Attributes[Attribute::Position] >= view.accessors.size()) {
+		return fail(error, mesh, "has no positions");
+	}
+	UINT32 vertexCount = view.accessors[header.Attributes[Attribute::Position]].Count;
+	for (UINT32 j = 0; j < Attribute::Count; j++) {
+		if (header.Attributes[j] == UINT32(-1)) {
+			continue;
+		}
+		if (header.Attributes[j] >= view.accessors.size()) {
+			return fail(error, mesh, "attribute accessor is missing");
+		}
+		const Accessor& accessor = view.accessors[header.Attributes[j]];
+		if (!checkElements(view, header.Attributes[j], accessor.Stride, mesh, "vertex", error)) {
+			return false;
+		}
+		if (accessor.Size != attributeSizes[j] || (UINT64)accessor.Offset + accessor.Size > accessor.Stride || accessor.Count != vertexCount) {
+			return fail(error, mesh, "attribute doesn't match the vertex layout");
+		}
+		// Attributes sharing a stream are interleaved, each in its own part of the stride.
+		for (UINT32 k = 0; k < Attribute::Count; k++) {
+			if (k == j || header.Attributes[k] >= view.accessors.size() || view.accessors[header.Attributes[k]].BufferView != accessor.BufferView) {
+				continue;
+			}
+			const Accessor& other = view.accessors[header.Attributes[k]];
+			if (other.Stride != accessor.Stride) {
+				return fail(error, mesh, "attributes in the same buffer view have different strides");
+			}
+			if ((UINT64)accessor.Offset < (UINT64)other.Offset + other.Size && (UINT64)other.Offset < (UINT64)accessor.Offset + accessor.Size) {
+				return fail(error, mesh, "attributes in the same buffer view overlap");
+			}
+		}
+	}
+
+	// Index buffer
+	if (!checkElements(view, header.Indices, 1, mesh, "index", error)) {
+		return false;
+	}
+	UINT32 indexSize = view.accessors[header.Indices].Size;
+	if (indexSize != 2 && indexSize != 4) {
+		return fail(error, mesh, "index size isn't 2 or 4 bytes");
+	}
+	if (!checkElements(view, header.Indices, indexSize, mesh, "index", error)
+		|| !checkIndices(view.viewBytes(header.Indices), indexSize, view.accessors[header.Indices].Count, vertexCount, mesh, "index buffer", error)
+		|| !checkElements(view, header.IndexSubsets, sizeof(Subset), mesh, "index subset", error)
+		|| !checkSubsets(view.elements<Subset>(header.IndexSubsets), view.accessors[header.Indices].Count, mesh, "index", error)) {
+		return false;
+	}
+
+	// Meshlets
+	if (!checkElements(view, header.Meshlets, sizeof(Meshlet), mesh, "meshlet", error)
+		|| !checkElements(view, header.MeshletSubsets, sizeof(Subset), mesh, "meshlet subset", error)
+		|| !checkElements(view, header.UniqueVertexIndices, indexSize, mesh, "unique vertex index", error)
+		|| !checkElements(view, header.PrimitiveIndices, sizeof(PackedTriangle), mesh, "primitive", error)
+		|| !checkElements(view, header.CullData, sizeof(CullData), mesh, "cull data", error)) {
+		return false;
+	}
+	UINT32 meshletCount = view.accessors[header.Meshlets].Count;
+	if (meshletCount == 0) {
+		return fail(error, mesh, "has no meshlets");
+	}
+	if (view.accessors[header.CullData].Count != meshletCount) {
+		return fail(error, mesh, "cull data count doesn't match the meshlets");
+	}
+	if (!checkSubsets(view.elements<Subset>(header.MeshletSubsets), meshletCount, mesh, "meshlet", error)
+		|| !checkMeshlets(view, header.Meshlets, header.UniqueVertexIndices, header.PrimitiveIndices, indexSize, vertexCount, mesh, "meshlets", error)) {
+		return false;
+	}
+
+	// Cluster hierarchy, all there or not at all.
+	const MeshLodHeader& lod = view.lodHeaders[mesh];
+	if (lod.Meshlets == UINT32(-1) && lod.UniqueVertexIndices == UINT32(-1) && lod.PrimitiveIndices == UINT32(-1)
+		&& lod.CullData == UINT32(-1) && lod.ClusterLods == UINT32(-1)) {
+		return true;
+	}
+	if (!checkElements(view, lod.Meshlets, sizeof(Meshlet), mesh, "LOD meshlet", error)
+		|| !checkElements(view, lod.UniqueVertexIndices, indexSize, mesh, "LOD unique vertex index", error)
+		|| !checkElements(view, lod.PrimitiveIndices, sizeof(PackedTriangle), mesh, "LOD primitive", error)
+		|| !checkElements(view, lod.CullData, sizeof(CullData), mesh, "LOD cull data", error)
+		|| !checkElements(view, lod.ClusterLods, sizeof(ClusterLod), mesh, "cluster LOD", error)) {
+		return false;
+	}
+	if (view.accessors[lod.CullData].Count != view.accessors[lod.Meshlets].Count
+		|| view.accessors[lod.ClusterLods].Count != (UINT64)meshletCount + view.accessors[lod.Meshlets].Count) {
+		return fail(error, mesh, "LOD counts don't match the meshlets");
+	}
+	return checkMeshlets(view, lod.Meshlets, lod.UniqueVertexIndices, lod.PrimitiveIndices, indexSize, vertexCount, mesh, "LOD meshlets", error);
+}
+
+bool ParseMeshletFile(std::span<const UINT8> file, MeshletFileView& view, std::string& error) {
+	error.clear();
+	view = MeshletFileView();
+	if (reinterpret_cast<std::uintptr_t>(file.data()) % 4 != 0) {
+		error = "file data isn't 4 byte aligned";
+		return false;
+	}
+	if (file.size() < sizeof(FileHeader)) {
+		error = "too small for a header";
+		return false;
+	}
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(file.data());
+	if (header->Prolog != MESHLET_FILE_PROLOG) {
+		error = "not a meshlet file";
+		return false;
+	}
+	if (header->Version > CURRENT_FILE_VERSION) {
+		error = "version " + std::to_string(header->Version) + " is newer than this loader";
+		return false;
+	}
+
+	view.header = header;
+	view.file = file;
+	if (header->Version >= FILE_VERSION_CHUNKED) {
+		const UINT64 tablesSize = sizeof(FileHeader) + (UINT64)header->MeshCount * sizeof(MeshChunk);
+		if (header->AccessorCount != 0 || header->BufferViewCount != 0 || tablesSize + header->BufferSize != file.size()) {
+			error = "chunk table doesn't match the file size";
+			return false;
+		}
+		view.chunks = std::span(reinterpret_cast<const MeshChunk*>(file.data() + sizeof(FileHeader)), header->MeshCount);
+		for (const MeshChunk& chunk : view.chunks) {
+			if (chunk.Offset < tablesSize || (UINT64)chunk.Offset + chunk.Size > file.size()) {
+				error = "chunk is out of range";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Every table is a multiple of 4 bytes, so each one and the buffer stay as aligned as the file is.
+	UINT64 lodHeaderCount = header->Version >= FILE_VERSION_CLUSTER_LOD ? header->MeshCount : 0;
+	UINT64 expectedSize = sizeof(FileHeader) + (UINT64)header->MeshCount * sizeof(MeshHeader) + lodHeaderCount * sizeof(MeshLodHeader)
+		+ (UINT64)header->AccessorCount * sizeof(Accessor) + (UINT64)header->BufferViewCount * sizeof(BufferView) + header->BufferSize;
+	if (expectedSize != file.size()) {
+		error = "header says " + std::to_string(expectedSize) + " bytes but the file has " + std::to_string(file.size());
+		return false;
+	}
+
+	const UINT8* next = file.data() + sizeof(FileHeader);
+	view.meshes = std::span(reinterpret_cast<const MeshHeader*>(next), header->MeshCount);
+	next += view.meshes.size_bytes();
+	if (lodHeaderCount > 0) {
+		const MeshLodHeader* lodHeaders = reinterpret_cast<const MeshLodHeader*>(next);
+		view.lodHeaders.assign(lodHeaders, lodHeaders + lodHeaderCount);
+		next += lodHeaderCount * sizeof(MeshLodHeader);
+	}
+	else {
+		// Older files have no hierarchy, every accessor missing reads the same as a mesh without one.
+		view.lodHeaders.resize(header->MeshCount, { UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1) });
+	}
+	view.accessors = std::span(reinterpret_cast<const Accessor*>(next), header->AccessorCount);
+	next += view.accessors.size_bytes();
+	view.bufferViews = std::span(reinterpret_cast<const BufferView*>(next), header->BufferViewCount);
+	next += view.bufferViews.size_bytes();
+	view.buffer = std::span(next, header->BufferSize);
+
+	for (const BufferView& bufferView : view.bufferViews) {
+		if ((UINT64)bufferView.Offset + bufferView.Size > header->BufferSize) {
+			error = "buffer view reads past the end of the buffer";
+			return false;
+		}
+	}
+	for (const Accessor& accessor : view.accessors) {
+		if (accessor.BufferView >= header->BufferViewCount) {
+			error = "accessor points at a missing buffer view";
+			return false;
+		}
+	}
+	for (UINT32 i = 0; i < header->MeshCount; i++) {
+		if (!checkMesh(view, i, error)) {
+			return false;
+		}
+	}
+	return true;
+}
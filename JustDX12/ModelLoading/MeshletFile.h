@@ -0,0 +1,44 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ModelLoading/MeshletFormat.h"
+
+// Tables of an 'MSHL' file, pointing straight into the bytes it was parsed from, so only valid for as long as those are.
+// FILE_VERSION_CHUNKED files only fill 'chunks', each mesh has to be decoded with DecodeMeshletChunk and parsed on its own.
+struct MeshletFileView {
+	const FileHeader* header = nullptr;
+	std::span<const UINT8> file;
+	std::span<const MeshChunk> chunks;
+	std::span<const MeshHeader> meshes;
+	// One per mesh, all UINT32(-1) for files from before FILE_VERSION_CLUSTER_LOD.
+	std::vector<MeshLodHeader> lodHeaders;
+	std::span<const Accessor> accessors;
+	std::span<const BufferView> bufferViews;
+	std::span<const UINT8> buffer;
+
+	std::span<const UINT8> chunkBytes(UINT32 mesh) const {
+		return file.subspan(chunks[mesh].Offset, chunks[mesh].Size);
+	}
+
+	// The whole BufferView the accessor reads from.
+	std::span<const UINT8> viewBytes(UINT32 accessor) const {
+		const BufferView& view = bufferViews[accessors[accessor].BufferView];
+		return buffer.subspan(view.Offset, view.Size);
+	}
+
+	// The accessor's elements from the start of its BufferView, for accessors ParseMeshletFile checked hold T.
+	template <typename T>
+	std::span<const T> elements(UINT32 accessor) const {
+		return std::span<const T>(reinterpret_cast<const T*>(viewBytes(accessor).data()), accessors[accessor].Count);
+	}
+};
+
+// Checks everything the loader and renderer index with before handing out any of it: the header and tables fit the file,
+// BufferViews fit the buffer, accessors fit their BufferView with the element size the mesh uses them for, attributes
+// sharing a stream don't overlap inside its stride, meshlets fit MESHLET_GROUP_SIZE, and every subset, meshlet and index
+// stays inside what it points into. The file has to start 4 byte aligned, like a mapping does.
+// Chunked files only get their chunk table checked here, the chunks are checked as they're decoded.
+// On failure 'error' says what was wrong and 'view' shouldn't be used.
+bool ParseMeshletFile(std::span<const UINT8> file, MeshletFileView& view, std::string& error);
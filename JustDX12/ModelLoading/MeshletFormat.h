@@ -0,0 +1,179 @@
+#pragma once
+#ifdef _WIN32
+#include <Windows.h>
+#include <DirectXMath.h>
+#else
+// Just the types the format uses, so the file parsing can be built and checked off Windows too.
+#include <cstdint>
+typedef std::uint8_t UINT8;
+typedef std::int16_t INT16;
+typedef std::uint16_t UINT16;
+typedef std::uint32_t UINT32;
+typedef std::int32_t INT32;
+typedef std::uint64_t UINT64;
+typedef float FLOAT;
+
+// DirectXMath only comes with the Windows SDK, the format only stores its types.
+namespace DirectX {
+	struct XMFLOAT4 {
+		FLOAT x;
+		FLOAT y;
+		FLOAT z;
+		FLOAT w;
+	};
+}
+#endif
+
+// This is mostly a copy of Meshlet Representation from the DirectXMesh library
+// But with minor simplifications/convention changes
+
+struct Attribute {
+	enum EType : UINT32 {
+		Position,
+		Normal,
+		TexCoord,
+		Tangent,
+		Bitangent,
+		Count
+	};
+
+	EType Type;
+	UINT32 Offset;
+};
+
+struct Subset {
+	UINT32 Offset;
+	UINT32 Count;
+};
+
+struct MeshInfo {
+	UINT32 IndexSize;
+	UINT32 MeshletCount;
+
+	UINT32 LastMeshletVert;
+	UINT32 LastMesheltPrim;
+};
+
+struct Meshlet {
+	UINT32 VertCount;
+	UINT32 VertOffset;
+	UINT32 PrimCount;
+	UINT32 PrimOffset;
+};
+
+struct PackedTriangle {
+	UINT32 i0 : 10;
+	UINT32 i1 : 10;
+	UINT32 i2 : 10;
+};
+
+struct CullData {
+	DirectX::XMFLOAT4 BoundingSphere; // xyz = center, w = radius
+	UINT8 NormalCone[4]; /// xyz = axis, w = -cos(a + 90)
+	FLOAT ApexOffset; // apex = center - axis * offset
+};
+
+// Where a cluster sits in a mesh's LOD hierarchy. A cut through the hierarchy draws a cluster when its own error is small
+// enough from the view but its parent's isn't. Every cluster simplified from the same group of clusters shares its bounds
+// and error, and those are the parent bounds and error of everything in the group, so a cut never leaves cracks.
+struct ClusterLod {
+	DirectX::XMFLOAT4 LodBounds; // Sphere the error is measured from, holds the LodBounds of everything it was simplified from
+	DirectX::XMFLOAT4 ParentLodBounds;
+	FLOAT Error; // How far (object space) the cluster can be from the full detail surface, 0 at full detail
+	FLOAT ParentError; // FLT_MAX for the roots
+	UINT32 Level;
+};
+
+// Layout of the 'MSHL' files MeshletModel loads: a FileHeader, then MeshCount MeshHeaders, MeshCount MeshLodHeaders
+// (from FILE_VERSION_CLUSTER_LOD on), AccessorCount Accessors, BufferViewCount BufferViews and finally BufferSize bytes
+// of data the BufferViews point into.
+// MeshHeader members are indices into the Accessors, UINT32(-1) for attributes the mesh doesn't have.
+// FILE_VERSION_CHUNKED files are laid out differently, see MeshChunk.
+constexpr UINT32 MESHLET_FILE_PROLOG = ('M' << 24) | ('S' << 16) | ('H' << 8) | 'L';
+
+// GROUP_SIZE in Common.hlsl, MeshletMS outputs a meshlet's vertices and primitives from one thread group of that size.
+constexpr UINT32 MESHLET_GROUP_SIZE = 32;
+
+enum FileVersion {
+	FILE_VERSION_INITIAL = 0,
+	FILE_VERSION_CLUSTER_LOD = 1,
+	FILE_VERSION_CHUNKED = 2,
+	CURRENT_FILE_VERSION = FILE_VERSION_CHUNKED
+};
+
+struct FileHeader {
+	UINT32 Prolog;
+	UINT32 Version;
+
+	UINT32 MeshCount;
+	UINT32 AccessorCount;
+	UINT32 BufferViewCount;
+	UINT32 BufferSize;
+};
+
+struct MeshHeader {
+	UINT32 Indices;
+	UINT32 IndexSubsets;
+	UINT32 Attributes[Attribute::Count];
+
+	UINT32 Meshlets;
+	UINT32 MeshletSubsets;
+	UINT32 UniqueVertexIndices;
+	UINT32 PrimitiveIndices;
+	UINT32 CullData;
+};
+
+// Coarser levels of a mesh's cluster hierarchy. They're kept apart from the full detail meshlets so a renderer that doesn't
+// pick a cut keeps drawing just those. Accessor indices like MeshHeader, all UINT32(-1) if the mesh has no hierarchy.
+struct MeshLodHeader {
+	UINT32 Meshlets;
+	UINT32 UniqueVertexIndices;
+	UINT32 PrimitiveIndices;
+	UINT32 CullData;
+	// One per full detail meshlet followed by one per coarser meshlet.
+	UINT32 ClusterLods;
+};
+
+struct BufferView {
+	UINT32 Offset;
+	UINT32 Size;
+};
+
+struct Accessor {
+	UINT32 BufferView;
+	UINT32 Offset;
+	UINT32 Size;
+	UINT32 Stride;
+	UINT32 Count;
+};
+
+// FILE_VERSION_CHUNKED files are a FileHeader (no Accessors or BufferViews, BufferSize covers the chunks), MeshCount
+// MeshChunks, then the chunks. Each chunk holds one mesh on its own so it can be read and decoded without the others.
+// A chunk is the tables of a single mesh FILE_VERSION_CLUSTER_LOD file (FileHeader to BufferViews), then a StreamHeader
+// per BufferView and the encoded streams back to back in BufferView order. Decoding the streams into their BufferViews
+// gives back that single mesh file.
+struct MeshChunk {
+	UINT32 Offset; // From the start of the file
+	UINT32 Size;
+	UINT32 DecodedSize; // Of the single mesh file
+};
+
+enum StreamCodec : UINT32 {
+	STREAM_CODEC_RAW,
+	// WordSize (2 or 4) byte words, each stored as the zigzag LEB128 varint of its difference to the word Stride words back.
+	// Offsets and indices that climb slowly shrink to a byte or two.
+	STREAM_CODEC_WORD_DELTA,
+	// PackedTriangles, a byte with the bits needed for the largest local index then every index at that width.
+	// The two unused bits of each triangle decode as 0.
+	STREAM_CODEC_TRIANGLES,
+	// FLOATs, Stride per element, each quantized to 16 bits over its component's range then stored like WORD_DELTA.
+	// Starts with a (min, step) FLOAT pair per component. Lossy, only written when asked for.
+	STREAM_CODEC_QUANTIZED
+};
+
+struct StreamHeader {
+	UINT32 Codec;
+	UINT32 WordSize;
+	UINT32 Stride; // In words
+	UINT32 EncodedSize;
+};
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+#include "ModelLoading/MeshletHierarchy.h"
+#include "ModelLoading/MeshSimplifier.h"
+
+#define NO_GROUP UINT_MAX
+// Vertex used by clusters of more than one group, simplifying either group can't move it without opening a crack.
+#define SHARED_GROUP (UINT_MAX - 1)
+// A group that can't get below this fraction of its triangles is left alone, its clusters move on to the next level
+// as they are to be grouped with different neighbours.
+#define MIN_LOD_REDUCTION 0.85f
+// Levels stop once none of their groups simplify, this is only a guard.
+#define MAX_LOD_LEVELS 32
+
+static float distance(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+static DirectX::XMFLOAT3 sphereCenter(const DirectX::XMFLOAT4& sphere) {
+	return { sphere.x, sphere.y, sphere.z };
+}
+
+// Smallest sphere holding both spheres.
+static DirectX::XMFLOAT4 mergeSpheres(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b) {
+	float centerDistance = distance(sphereCenter(a), sphereCenter(b));
+	if (centerDistance + b.w <= a.w) {
+		return a;
+	}
+	if (centerDistance + a.w <= b.w) {
+		return b;
+	}
+	float radius = (centerDistance + a.w + b.w) * 0.5f;
+	float t = (radius - a.w) / centerDistance;
+	return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, radius };
+}
+
+// Meshlets of both levels behind one index, full detail meshlets first.
+struct ClusterView {
+	const MeshletMeshData& mesh;
+
+	bool isLod(UINT32 cluster) const {
+		return cluster >= mesh.meshlets.size();
+	}
+	const Meshlet& meshlet(UINT32 cluster) const {
+		return isLod(cluster) ? mesh.lodMeshlets[cluster - mesh.meshlets.size()] : mesh.meshlets[cluster];
+	}
+	UINT32 vertex(UINT32 cluster, UINT32 local) const {
+		const Meshlet& m = meshlet(cluster);
+		return isLod(cluster) ? mesh.lodUniqueVertexIndices[m.VertOffset + local] : mesh.uniqueVertexIndices[m.VertOffset + local];
+	}
+	const PackedTriangle& triangle(UINT32 cluster, UINT32 primitive) const {
+		const Meshlet& m = meshlet(cluster);
+		return isLod(cluster) ? mesh.lodPrimitiveIndices[m.PrimOffset + primitive] : mesh.primitiveIndices[m.PrimOffset + primitive];
+	}
+};
+
+// Greedily groups clusters with the neighbours they share the most vertices with. Seeds go in cluster order,
+// which follows the mesh's surface since each level is split from the groups of the one before it.
+static std::vector<std::vector<UINT32>> groupClusters(const ClusterView& view, const std::vector<UINT32>& clusters, UINT groupSize) {
+	const UINT32 vertexCount = (UINT32)view.mesh.vertices.size();
+	// Positions in 'clusters' using each vertex, packed by vertex.
+	std::vector<UINT32> vertexOffsets(vertexCount + 1, 0);
+	for (UINT32 cluster : clusters) {
+		for (UINT32 i = 0; i < view.meshlet(cluster).VertCount; i++) {
+			vertexOffsets[view.vertex(cluster, i) + 1]++;
+		}
+	}
+	for (UINT32 v = 0; v < vertexCount; v++) {
+		vertexOffsets[v + 1] += vertexOffsets[v];
+	}
+	std::vector<UINT32> vertexClusters(vertexOffsets.back());
+	std::vector<UINT32> fill(vertexOffsets.begin(), vertexOffsets.end() - 1);
+	for (UINT32 c = 0; c < clusters.size(); c++) {
+		for (UINT32 i = 0; i < view.meshlet(clusters[c]).VertCount; i++) {
+			UINT32 v = view.vertex(clusters[c], i);
+			vertexClusters[fill[v]++] = c;
+		}
+	}
+
+	std::vector<UINT32> groupOf(clusters.size(), NO_GROUP);
+	std::vector<UINT32> sharedVertices(clusters.size(), 0);
+	std::vector<UINT32> touched;
+	std::vector<std::vector<UINT32>> groups;
+	for (UINT32 seed = 0; seed < clusters.size(); seed++) {
+		if (groupOf[seed] != NO_GROUP) {
+			continue;
+		}
+		std::vector<UINT32> group = { seed };
+		groupOf[seed] = (UINT32)groups.size();
+		auto addNeighbours = [&](UINT32 c) {
+			for (UINT32 i = 0; i < view.meshlet(clusters[c]).VertCount; i++) {
+				UINT32 v = view.vertex(clusters[c], i);
+				for (UINT32 a = vertexOffsets[v]; a < vertexOffsets[v + 1]; a++) {
+					UINT32 neighbour = vertexClusters[a];
+					if (groupOf[neighbour] == NO_GROUP) {
+						if (sharedVertices[neighbour]++ == 0) {
+							touched.push_back(neighbour);
+						}
+					}
+				}
+			}
+		};
+		addNeighbours(seed);
+		while (group.size() < groupSize) {
+			UINT32 best = NO_GROUP;
+			for (UINT32 neighbour : touched) {
+				if (groupOf[neighbour] == NO_GROUP && (best == NO_GROUP || sharedVertices[neighbour] > sharedVertices[best])) {
+					best = neighbour;
+				}
+			}
+			if (best == NO_GROUP) {
+				break;
+			}
+			groupOf[best] = groupOf[seed];
+			group.push_back(best);
+			addNeighbours(best);
+		}
+		for (UINT32 neighbour : touched) {
+			sharedVertices[neighbour] = 0;
+		}
+		touched.clear();
+		for (UINT32& c : group) {
+			c = clusters[c];
+		}
+		groups.push_back(std::move(group));
+	}
+	return groups;
+}
+
+void BuildMeshletHierarchy(MeshletMeshData& mesh, UINT maxVertices, UINT maxPrimitives, UINT groupSize, float coneWeight) {
+	mesh.lodMeshlets.clear();
+	mesh.lodUniqueVertexIndices.clear();
+	mesh.lodPrimitiveIndices.clear();
+	mesh.lodCullData.clear();
+	mesh.clusterLods.resize(mesh.meshlets.size());
+	const UINT32 vertexCount = (UINT32)mesh.vertices.size();
+	ClusterView view = { mesh };
+
+	std::vector<UINT32> current(mesh.meshlets.size());
+	for (UINT32 i = 0; i < mesh.meshlets.size(); i++) {
+		ClusterLod& lod = mesh.clusterLods[i];
+		lod.LodBounds = mesh.cullData[i].BoundingSphere;
+		lod.ParentLodBounds = lod.LodBounds;
+		lod.Error = 0.0f;
+		lod.ParentError = FLT_MAX;
+		lod.Level = 0;
+		current[i] = i;
+	}
+
+	std::vector<UINT32> vertexGroup(vertexCount);
+	std::vector<UINT32> localIndex(vertexCount, NO_GROUP);
+	for (UINT level = 1; current.size() > 1 && level < MAX_LOD_LEVELS; level++) {
+		std::vector<std::vector<UINT32>> groups = groupClusters(view, current, groupSize);
+		std::fill(vertexGroup.begin(), vertexGroup.end(), NO_GROUP);
+		for (UINT32 g = 0; g < groups.size(); g++) {
+			for (UINT32 cluster : groups[g]) {
+				for (UINT32 i = 0; i < view.meshlet(cluster).VertCount; i++) {
+					UINT32& owner = vertexGroup[view.vertex(cluster, i)];
+					owner = owner == NO_GROUP || owner == g ? g : SHARED_GROUP;
+				}
+			}
+		}
+
+		std::vector<UINT32> next;
+		bool simplified = false;
+		for (UINT32 g = 0; g < groups.size(); g++) {
+			const std::vector<UINT32>& group = groups[g];
+			// The group as its own small mesh, so simplifying and splitting it only touches its own vertices.
+			MeshletMeshData groupMesh;
+			std::vector<UINT32> globalIndex;
+			for (UINT32 cluster : group) {
+				for (UINT32 p = 0; p < view.meshlet(cluster).PrimCount; p++) {
+					const PackedTriangle& triangle = view.triangle(cluster, p);
+					UINT32 corners[3] = { view.vertex(cluster, triangle.i0), view.vertex(cluster, triangle.i1), view.vertex(cluster, triangle.i2) };
+					for (UINT32 v : corners) {
+						if (localIndex[v] == NO_GROUP) {
+							localIndex[v] = (UINT32)globalIndex.size();
+							globalIndex.push_back(v);
+							groupMesh.vertices.push_back(mesh.vertices[v]);
+						}
+						groupMesh.indices.push_back(localIndex[v]);
+					}
+				}
+			}
+			for (UINT32 v : globalIndex) {
+				localIndex[v] = NO_GROUP;
+			}
+
+			// Lock what other groups share and the open edges of the mesh, which have nothing on the other side to hold them in place.
+			std::vector<bool> locked(globalIndex.size(), false);
+			for (UINT32 v = 0; v < globalIndex.size(); v++) {
+				locked[v] = vertexGroup[globalIndex[v]] == SHARED_GROUP;
+			}
+			LockBorderVertices(groupMesh.indices.data(), (UINT)groupMesh.indices.size(), locked);
+
+			const UINT32 indexCount = (UINT32)groupMesh.indices.size();
+			float simplifyError = 0.0f;
+			UINT32 simplifiedCount = SimplifyMesh(&groupMesh.vertices[0].position, sizeof(MeshletVertex), (UINT)globalIndex.size(),
+				groupMesh.indices.data(), indexCount, indexCount / 6 * 3, locked, simplifyError);
+			if (simplifiedCount == 0 || simplifiedCount > indexCount * MIN_LOD_REDUCTION) {
+				next.insert(next.end(), group.begin(), group.end());
+				continue;
+			}
+			simplified = true;
+			groupMesh.indices.resize(simplifiedCount);
+
+			// Errors and bounds only grow going up, which is what keeps any cut through the hierarchy consistent.
+			float groupError = simplifyError;
+			DirectX::XMFLOAT4 groupBounds = mesh.clusterLods[group[0]].LodBounds;
+			for (UINT32 cluster : group) {
+				groupError = std::max(groupError, mesh.clusterLods[cluster].Error);
+				groupBounds = mergeSpheres(groupBounds, mesh.clusterLods[cluster].LodBounds);
+			}
+			for (UINT32 cluster : group) {
+				mesh.clusterLods[cluster].ParentError = groupError;
+				mesh.clusterLods[cluster].ParentLodBounds = groupBounds;
+			}
+
+			BuildMeshlets(groupMesh, maxVertices, maxPrimitives, coneWeight);
+			ComputeMeshletCullData(groupMesh);
+			for (size_t m = 0; m < groupMesh.meshlets.size(); m++) {
+				Meshlet meshlet = groupMesh.meshlets[m];
+				meshlet.VertOffset += (UINT32)mesh.lodUniqueVertexIndices.size();
+				meshlet.PrimOffset += (UINT32)mesh.lodPrimitiveIndices.size();
+				mesh.lodMeshlets.push_back(meshlet);
+				mesh.lodCullData.push_back(groupMesh.cullData[m]);
+
+				ClusterLod lod;
+				lod.LodBounds = groupBounds;
+				lod.ParentLodBounds = groupBounds;
+				lod.Error = groupError;
+				lod.ParentError = FLT_MAX;
+				lod.Level = level;
+				next.push_back((UINT32)mesh.clusterLods.size());
+				mesh.clusterLods.push_back(lod);
+			}
+			for (UINT32 v : groupMesh.uniqueVertexIndices) {
+				mesh.lodUniqueVertexIndices.push_back(globalIndex[v]);
+			}
+			mesh.lodPrimitiveIndices.insert(mesh.lodPrimitiveIndices.end(), groupMesh.primitiveIndices.begin(), groupMesh.primitiveIndices.end());
+		}
+		if (!simplified) {
+			break;
+		}
+		current = std::move(next);
+	}
+}
+
+float ProjectedClusterError(const DirectX::XMFLOAT4& bounds, float error, const DirectX::XMFLOAT3& viewPos) {
+	if (error <= 0.0f) {
+		return 0.0f;
+	}
+	if (error == FLT_MAX) {
+		return FLT_MAX;
+	}
+	float boundsDistance = distance(viewPos, sphereCenter(bounds)) - bounds.w;
+	return boundsDistance > 0.0f ? error / boundsDistance : FLT_MAX;
+}
+
+std::vector<UINT32> SelectClusterCut(const ClusterLod* clusters, UINT32 clusterCount, const DirectX::XMFLOAT3& viewPos, float threshold) {
+	std::vector<UINT32> cut;
+	for (UINT32 i = 0; i < clusterCount; i++) {
+		const ClusterLod& lod = clusters[i];
+		if (ProjectedClusterError(lod.LodBounds, lod.Error, viewPos) <= threshold
+			&& ProjectedClusterError(lod.ParentLodBounds, lod.ParentError, viewPos) > threshold) {
+			cut.push_back(i);
+		}
+	}
+	return cut;
+}
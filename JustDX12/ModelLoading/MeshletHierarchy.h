@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+
+#include "ModelLoading/MeshletBuilder.h"
+
+// Builds the coarser levels of the mesh's cluster hierarchy on top of its meshlets, which have to be built already.
+// Each level groups up to 'groupSize' neighbouring clusters, simplifies the group to half its triangles with the vertices
+// it shares with other groups locked, then splits the result back into meshlets with the same limits as BuildMeshlets.
+// Groups that can't be simplified any further become roots. Fills the lod* members and clusterLods.
+void BuildMeshletHierarchy(MeshletMeshData& mesh, UINT maxVertices, UINT maxPrimitives, UINT groupSize, float coneWeight);
+
+// Error of a cluster (or its parent) as seen from 'viewPos', in object space units per unit of distance.
+// Multiply by the projection's pixels per unit at distance 1 to get pixels. FLT_MAX when the view is inside 'bounds'.
+float ProjectedClusterError(const DirectX::XMFLOAT4& bounds, float error, const DirectX::XMFLOAT3& viewPos);
+
+// Clusters to draw for a view, indices are into 'clusters' (full detail meshlets first, then the coarser ones).
+// 'threshold' is the largest ProjectedClusterError allowed, 0 gives the full detail meshlets.
+std::vector<UINT32> SelectClusterCut(const ClusterLod* clusters, UINT32 clusterCount, const DirectX::XMFLOAT3& viewPos, float threshold);
@@ -0,0 +1,49 @@
+#include "ModelLoading\MeshletUploadBatch.h"
+#include "DX12Helper.h"
+#include "ResourceDecay.h"
+
+void MeshletUploadBatch::add(std::shared_ptr<MeshletModel> model) {
+	models.push_back(model);
+}
+
+void MeshletUploadBatch::submit(DX12TaskQueueThread* thread) {
+	UINT64 size = 0;
+	for (auto& model : models) {
+		size += model->GetUploadSize();
+	}
+
+	// Models that failed to load have nothing to copy, but still have to report their upload as done.
+	if (size == 0) {
+		thread->mCommandList->Close();
+		for (auto& model : models) {
+			model->SetUploadFence(thread->getFence(), thread->getFenceValue());
+		}
+		return;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> staging;
+	auto uploadHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto stagingDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	ThrowIfFailed(thread->md3dDevice->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &stagingDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&staging)));
+	SetName(staging.Get(), L"Meshlet Staging");
+
+	UINT8* memory = nullptr;
+	ThrowIfFailed(staging->Map(0, nullptr, reinterpret_cast<void**>(&memory)));
+	UINT64 offset = 0;
+	for (auto& model : models) {
+		model->UploadGpuResources(thread->md3dDevice.Get(), thread->mCommandList.Get(), staging.Get(), memory, offset);
+	}
+	staging->Unmap(0, nullptr);
+
+	thread->mCommandList->Close();
+	ID3D12CommandList* cmdLists[] = { thread->mCommandList.Get() };
+	thread->mCommandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+
+	int fenceVal = thread->getFenceValue() + 1;
+	ResourceDecay::destroyOnEvent(staging, EventFromFence(thread->getFence().Get(), fenceVal));
+	thread->setFence(fenceVal);
+	for (auto& model : models) {
+		model->SetUploadFence(thread->getFence(), fenceVal);
+	}
+	OutputDebugStringA(("Uploading " + std::to_string(models.size()) + " meshlet models, " + std::to_string(size / 1024) + " KB in one submission\n").c_str());
+}
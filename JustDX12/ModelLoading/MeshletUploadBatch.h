@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "MeshletModel.h"
+#include "Tasks\DX12TaskQueueThread.h"
+
+// Uploads every mesh of any number of MeshletModels through one staging buffer and a single submission.
+// Nothing waits on the GPU, each model's UploadComplete turns true once the thread's fence passes the submission.
+class MeshletUploadBatch {
+public:
+	void add(std::shared_ptr<MeshletModel> model);
+	bool empty() const { return models.empty(); }
+	const std::vector<std::shared_ptr<MeshletModel>>& getModels() const { return models; }
+
+	// Records the copies on the thread's command list, which has to be open and empty, then closes and executes it.
+	// The staging buffer is released through the ResourceDecay when the copies are done.
+	void submit(DX12TaskQueueThread* thread);
+
+private:
+	std::vector<std::shared_ptr<MeshletModel>> models;
+};
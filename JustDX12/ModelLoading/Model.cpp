@@ -1,7 +1,62 @@
 #include "Model.h"
+#include "DX12Helper.h"
 
-Model::Model(ID3D12Device5* device, std::string name, std::string dir, bool usesRT) : TransformData(device){
+Model::Model(std::string name, std::string dir, bool usesRT) : TransformData(){
 	this->name = name;
 	this->dir = dir;
 	this->usesRT = usesRT;
 }
+
+Model::~Model() {
+	std::lock_guard<std::mutex> lk(bvhLock);
+	for (BVHNodeHandle leaf : bvhLeaves) {
+		SceneBVH::getInstance().remove(leaf);
+	}
+}
+
+void Model::setInstanceCount(UINT count) {
+	TransformData::setInstanceCount(count);
+	transformVersion++;
+	std::lock_guard<std::mutex> lk(bvhLock);
+	if (!registeredToBVH) {
+		return;
+	}
+	while (bvhLeaves.size() > count) {
+		SceneBVH::getInstance().remove(bvhLeaves.back());
+		bvhLeaves.pop_back();
+	}
+	while (bvhLeaves.size() < count) {
+		UINT instance = (UINT)bvhLeaves.size();
+		bvhLeaves.push_back(SceneBVH::getInstance().insert(getInstanceBounds(instance), this, instance));
+	}
+}
+
+void Model::setTransform(UINT index, DirectX::XMFLOAT4X4 newTransform) {
+	TransformData::setTransform(index, newTransform);
+	transformVersion++;
+	std::lock_guard<std::mutex> lk(bvhLock);
+	if (registeredToBVH && index < bvhLeaves.size()) {
+		SceneBVH::getInstance().move(bvhLeaves[index], getInstanceBounds(index));
+	}
+}
+
+void Model::registerToSceneBVH() {
+	std::lock_guard<std::mutex> lk(bvhLock);
+	if (registeredToBVH) {
+		return;
+	}
+	registeredToBVH = true;
+	for (UINT i = 0; i < getInstanceCount(); i++) {
+		bvhLeaves.push_back(SceneBVH::getInstance().insert(getInstanceBounds(i), this, i));
+	}
+}
+
+UINT Model::getTransformVersion() const {
+	return transformVersion;
+}
+
+DirectX::BoundingBox Model::getInstanceBounds(UINT instance) {
+	DirectX::BoundingBox instanceBB;
+	getLocalBoundingBox().Transform(instanceBB, TransposeLoad(getTransform(instance)));
+	return instanceBB;
+}
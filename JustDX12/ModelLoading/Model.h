@@ -1,14 +1,41 @@
 #pragma once
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <vector>
+#include <DirectXCollision.h>
 
 #include "TransformData.h"
+#include "SceneBVH.h"
 
 class Model : public TransformData {
 public:
-	Model(ID3D12Device5* device, std::string name, std::string dir, bool usesRT = false);
+	Model(std::string name, std::string dir, bool usesRT = false);
+	virtual ~Model();
+
+	void setInstanceCount(UINT count) override;
+	void setTransform(UINT index, DirectX::XMFLOAT4X4 newTransform) override;
+
+	// Local space bounds of the whole model, only valid once it's loaded.
+	virtual const DirectX::BoundingBox& getLocalBoundingBox() const = 0;
+	// Adds every instance to the SceneBVH, called by the ModelLoader once the bounds are known.
+	// After that instance count and transform changes keep the BVH up to date.
+	void registerToSceneBVH();
+	// Bumped by every transform or instance count change, lets culling tell if cached results are still good.
+	UINT getTransformVersion() const;
+
 	std::string name;
 	std::string dir;
 	bool usesRT;
 	std::atomic_bool loaded;
+
+private:
+	DirectX::BoundingBox getInstanceBounds(UINT instance);
+
+	std::atomic<UINT> transformVersion = 0;
+
+	std::mutex bvhLock;
+	bool registeredToBVH = false;
+	// One leaf per instance.
+	std::vector<BVHNodeHandle> bvhLeaves;
 };
\ No newline at end of file
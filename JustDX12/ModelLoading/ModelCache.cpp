@@ -0,0 +1,241 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "ModelLoading/ModelCache.h"
+#include "ModelLoading/MappedFile.h"
+
+CachedString ModelCacheData::addString(std::string_view s) {
+	CachedString cached = { (UINT32)strings.size(), (UINT32)s.size() };
+	strings.append(s);
+	return cached;
+}
+
+static bool checkString(const ModelCacheView& view, const CachedString& s) {
+	return (UINT64)s.Offset + s.Size <= view.strings.size();
+}
+
+// Every index of the range [start, start + count) stays inside the mesh's own vertices.
+static bool checkIndices(const ModelCacheView& view, UINT32 start, UINT32 count, UINT32 vertexCount) {
+	if ((UINT64)start + count > view.indices.size()) {
+		return false;
+	}
+	for (UINT32 index : view.indices.subspan(start, count)) {
+		if (index >= vertexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool checkMesh(const ModelCacheView& view, UINT32 mesh, std::string& error) {
+	const CachedMesh& cached = view.meshes[mesh];
+	error = "mesh " + std::to_string(mesh) + ": ";
+	if ((UINT64)cached.BaseVertexLocation + cached.VertexCount > view.vertices.size()) {
+		error += "vertices are out of range";
+		return false;
+	}
+	if (!checkIndices(view, cached.StartIndexLocation, cached.IndexCount, cached.VertexCount)) {
+		error += "indices are out of range";
+		return false;
+	}
+	if ((UINT64)cached.FirstLod + cached.LodCount > view.lods.size()) {
+		error += "LODs are out of range";
+		return false;
+	}
+	for (const CachedLod& lod : view.lods.subspan(cached.FirstLod, cached.LodCount)) {
+		if (!checkIndices(view, lod.StartIndexLocation, lod.IndexCount, cached.VertexCount)) {
+			error += "LOD indices are out of range";
+			return false;
+		}
+	}
+	for (const CachedString& texture : cached.Textures) {
+		if (!checkString(view, texture)) {
+			error += "texture name is out of range";
+			return false;
+		}
+	}
+	error.clear();
+	return true;
+}
+
+bool ParseModelCache(std::span<const UINT8> file, ModelCacheView& view, std::string& error) {
+	error.clear();
+	view = ModelCacheView();
+	if (reinterpret_cast<std::uintptr_t>(file.data()) % 4 != 0) {
+		error = "file data isn't 4 byte aligned";
+		return false;
+	}
+	if (file.size() < sizeof(ModelCacheHeader)) {
+		error = "too small for a header";
+		return false;
+	}
+	const ModelCacheHeader* header = reinterpret_cast<const ModelCacheHeader*>(file.data());
+	if (header->Prolog != MODEL_CACHE_PROLOG) {
+		error = "not a model cache";
+		return false;
+	}
+	if (header->Version != MODEL_CACHE_VERSION) {
+		error = "version " + std::to_string(header->Version) + " isn't the current one";
+		return false;
+	}
+
+	// Every table but the strings is a multiple of 4 bytes, so each one stays as aligned as the file is.
+	UINT64 expectedSize = sizeof(ModelCacheHeader) + (UINT64)header->MeshCount * sizeof(CachedMesh) + (UINT64)header->LodCount * sizeof(CachedLod)
+		+ (UINT64)header->NodeCount * sizeof(CachedNode) + (UINT64)header->NodeMeshCount * sizeof(UINT32) + (UINT64)header->LightCount * sizeof(CachedLight)
+		+ (UINT64)header->VertexCount * sizeof(Vertex) + (UINT64)header->IndexCount * sizeof(UINT32) + header->StringSize;
+	if (expectedSize != file.size()) {
+		error = "header says " + std::to_string(expectedSize) + " bytes but the file has " + std::to_string(file.size());
+		return false;
+	}
+
+	const UINT8* next = file.data() + sizeof(ModelCacheHeader);
+	auto table = [&next]<typename T>(std::span<const T>& span, UINT32 count) {
+		span = std::span(reinterpret_cast<const T*>(next), count);
+		next += span.size_bytes();
+	};
+	view.header = header;
+	table(view.meshes, header->MeshCount);
+	table(view.lods, header->LodCount);
+	table(view.nodes, header->NodeCount);
+	table(view.nodeMeshes, header->NodeMeshCount);
+	table(view.lights, header->LightCount);
+	table(view.vertices, header->VertexCount);
+	table(view.indices, header->IndexCount);
+	table(view.strings, header->StringSize);
+
+	for (UINT32 i = 0; i < header->MeshCount; i++) {
+		if (!checkMesh(view, i, error)) {
+			return false;
+		}
+	}
+	if (view.nodes.empty() || view.nodes[0].Parent != UINT32(-1)) {
+		error = "root node is missing";
+		return false;
+	}
+	for (UINT32 i = 0; i < header->NodeCount; i++) {
+		const CachedNode& node = view.nodes[i];
+		if ((i > 0 && node.Parent >= i) || !checkString(view, node.Name) || (UINT64)node.FirstMesh + node.MeshCount > view.nodeMeshes.size()) {
+			error = "node " + std::to_string(i) + " is out of range";
+			return false;
+		}
+	}
+	for (UINT32 mesh : view.nodeMeshes) {
+		if (mesh >= header->MeshCount) {
+			error = "node instances a missing mesh";
+			return false;
+		}
+	}
+	for (const CachedLight& light : view.lights) {
+		if (!checkString(view, light.Name)) {
+			error = "light name is out of range";
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename T>
+static void writeTable(std::ostream& output, const std::vector<T>& table) {
+	output.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(T));
+}
+
+bool WriteModelCache(std::ostream& output, const ModelCacheHeader& stamp, const ModelCacheData& data) {
+	ModelCacheHeader header = stamp;
+	header.Prolog = MODEL_CACHE_PROLOG;
+	header.Version = MODEL_CACHE_VERSION;
+	header.MeshCount = (UINT32)data.meshes.size();
+	header.LodCount = (UINT32)data.lods.size();
+	header.NodeCount = (UINT32)data.nodes.size();
+	header.NodeMeshCount = (UINT32)data.nodeMeshes.size();
+	header.LightCount = (UINT32)data.lights.size();
+	header.VertexCount = (UINT32)data.vertices.size();
+	header.IndexCount = (UINT32)data.indices.size();
+	header.StringSize = (UINT32)data.strings.size();
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeTable(output, data.meshes);
+	writeTable(output, data.lods);
+	writeTable(output, data.nodes);
+	writeTable(output, data.nodeMeshes);
+	writeTable(output, data.lights);
+	writeTable(output, data.vertices);
+	writeTable(output, data.indices);
+	output.write(data.strings.data(), data.strings.size());
+	return (bool)output;
+}
+
+bool SaveModelCache(const std::string& cachePath, const ModelCacheHeader& stamp, const ModelCacheData& data) {
+	// Unique per thread, two loads of the same model can both be saving it.
+	const std::string tempPath = cachePath + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream output(tempPath, std::ios::binary);
+		if (!WriteModelCache(output, stamp, data)) {
+			output.close();
+			std::error_code errorCode;
+			std::filesystem::remove(tempPath, errorCode);
+			return false;
+		}
+	}
+	std::error_code errorCode;
+	std::filesystem::rename(tempPath, cachePath, errorCode);
+	if (errorCode) {
+		std::filesystem::remove(tempPath, errorCode);
+		return false;
+	}
+	return true;
+}
+
+// Size and write time, without reading the file.
+static bool sourceInfo(const std::string& sourcePath, UINT64& size, UINT64& writeTime) {
+	std::error_code errorCode;
+	size = std::filesystem::file_size(sourcePath, errorCode);
+	if (errorCode) {
+		return false;
+	}
+	writeTime = (UINT64)std::filesystem::last_write_time(sourcePath, errorCode).time_since_epoch().count();
+	return !errorCode;
+}
+
+static bool sourceHash(const std::string& sourcePath, UINT64& hash) {
+	MappedFile source;
+	if (!source.open(sourcePath)) {
+		return false;
+	}
+	std::span<const std::uint8_t> bytes = source.bytes();
+	hash = std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+	return true;
+}
+
+bool StampModelCache(const std::string& sourcePath, ModelCacheHeader& stamp) {
+	return sourceInfo(sourcePath, stamp.SourceSize, stamp.SourceWriteTime) && sourceHash(sourcePath, stamp.SourceHash);
+}
+
+bool ModelCacheMatches(const ModelCacheHeader& header, const std::string& sourcePath, UINT64 settingsHash, UINT64& sourceWriteTime) {
+	UINT64 size;
+	if (header.SettingsHash != settingsHash || !sourceInfo(sourcePath, size, sourceWriteTime) || size != header.SourceSize) {
+		return false;
+	}
+	UINT64 hash;
+	return sourceWriteTime == header.SourceWriteTime || (sourceHash(sourcePath, hash) && hash == header.SourceHash);
+}
+
+bool RestampModelCache(const std::string& cachePath, const ModelCacheHeader& mapped, UINT64 sourceWriteTime) {
+	std::fstream cache(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+	if (!cache.is_open()) {
+		return false;
+	}
+	ModelCacheHeader header;
+	if (!cache.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		return false;
+	}
+	if (std::memcmp(&header, &mapped, sizeof(header)) != 0) {
+		return true;
+	}
+	cache.seekp(offsetof(ModelCacheHeader, SourceWriteTime));
+	cache.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+	return (bool)cache;
+}
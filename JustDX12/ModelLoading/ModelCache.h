@@ -0,0 +1,157 @@
+#pragma once
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ModelLoading/Vertex.h"
+#ifndef _WIN32
+// Vertex.h has the rest, these are the types only the cache tables use, so caches can be parsed and checked off Windows too.
+typedef std::uint8_t UINT8;
+typedef std::uint64_t UINT64;
+typedef float FLOAT;
+
+namespace DirectX {
+	struct XMFLOAT4X4 {
+		float m[4][4];
+	};
+}
+#endif
+
+// Layout of the 'MDLC' files a SimpleModel's import is cached in next to its source: a ModelCacheHeader, then MeshCount
+// CachedMeshes, LodCount CachedLods, NodeCount CachedNodes, NodeMeshCount UINT32 mesh indices, LightCount CachedLights,
+// VertexCount Vertices, IndexCount UINT32 indices and finally StringSize bytes of names.
+// It holds what SimpleModel::process produces before anything is packed for the GeometryPool, so settings that only change
+// the packing (COMPACT_VERTICES, SHORT_INDICES) don't need a new cache.
+constexpr UINT32 MODEL_CACHE_PROLOG = ('M' << 24) | ('D' << 16) | ('L' << 8) | 'C';
+constexpr UINT32 MODEL_CACHE_VERSION = 1;
+
+// MODEL_FORMAT_DIFFUSE_TEX to MODEL_FORMAT_EMMISIVE_TEX, the texture bits of MODEL_FORMAT are consecutive.
+constexpr UINT32 CACHED_TEXTURE_COUNT = 5;
+
+struct ModelCacheHeader {
+	UINT32 Prolog;
+	UINT32 Version;
+
+	// Only the model file itself is stamped, not the material files or textures it names.
+	UINT64 SourceSize;
+	UINT64 SourceWriteTime;
+	UINT64 SourceHash;
+	// Hash of the import settings that wrote it, the ModelLoader's is checked against it.
+	UINT64 SettingsHash;
+
+	UINT32 MeshCount;
+	UINT32 LodCount;
+	UINT32 NodeCount;
+	UINT32 NodeMeshCount;
+	UINT32 LightCount;
+	UINT32 VertexCount;
+	UINT32 IndexCount;
+	UINT32 StringSize;
+};
+
+// Range of the string table.
+struct CachedString {
+	UINT32 Offset;
+	UINT32 Size;
+};
+
+struct CachedMesh {
+	UINT32 TypeFlags;
+	UINT32 IndexCount;
+	UINT32 VertexCount;
+	UINT32 StartIndexLocation;
+	UINT32 BaseVertexLocation;
+	UINT32 FirstLod;
+	UINT32 LodCount;
+	DirectX::XMFLOAT3 BoundsCenter;
+	DirectX::XMFLOAT3 BoundsExtents;
+	// DX12Texture::Filename of every texture bit set in TypeFlags, in MODEL_FORMAT order.
+	CachedString Textures[CACHED_TEXTURE_COUNT];
+};
+
+struct CachedLod {
+	UINT32 IndexCount;
+	UINT32 StartIndexLocation;
+	FLOAT RelativeError;
+};
+
+// Nodes are in breadth first order, so every parent comes before its children and siblings keep their order.
+struct CachedNode {
+	UINT32 Parent; // UINT32(-1) for the root, which has to be the first node
+	CachedString Name;
+	DirectX::XMFLOAT4X4 Transform; // SceneNode::transform as is
+	// Range of the mesh indices instanced on this node.
+	UINT32 FirstMesh;
+	UINT32 MeshCount;
+};
+
+// The parts of an aiLight the ModelLoader reads.
+struct CachedLight {
+	UINT32 Type;
+	CachedString Name;
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Direction;
+	DirectX::XMFLOAT3 ColorDiffuse;
+	FLOAT AngleInnerCone;
+	FLOAT AttenuationQuadratic;
+};
+
+// Tables of a cache file, pointing into the file itself.
+struct ModelCacheView {
+	const ModelCacheHeader* header = nullptr;
+	std::span<const CachedMesh> meshes;
+	std::span<const CachedLod> lods;
+	std::span<const CachedNode> nodes;
+	std::span<const UINT32> nodeMeshes;
+	std::span<const CachedLight> lights;
+	std::span<const Vertex> vertices;
+	std::span<const UINT32> indices;
+	std::span<const char> strings;
+
+	std::string_view string(const CachedString& s) const {
+		return std::string_view(strings.data() + s.Offset, s.Size);
+	}
+};
+
+// Owning version of the tables, filled by SimpleModel::process and written by SaveModelCache.
+struct ModelCacheData {
+	std::vector<CachedMesh> meshes;
+	std::vector<CachedLod> lods;
+	std::vector<CachedNode> nodes;
+	std::vector<UINT32> nodeMeshes;
+	std::vector<CachedLight> lights;
+	std::vector<Vertex> vertices;
+	std::vector<UINT32> indices;
+	std::string strings;
+
+	CachedString addString(std::string_view s);
+};
+
+// Checks the header, that the file is exactly the size it describes and that every range and index stays inside it,
+// before pointing 'view' into 'file'. Doesn't check the source stamp, see ModelCacheMatches.
+bool ParseModelCache(std::span<const UINT8> file, ModelCacheView& view, std::string& error);
+
+// 'stamp' supplies the Source and Settings members of the header, the rest is taken from 'data'.
+bool WriteModelCache(std::ostream& output, const ModelCacheHeader& stamp, const ModelCacheData& data);
+
+// Writes the cache next to 'cachePath' and renames it over whatever is there, so a load never maps a half written cache.
+// Fails without touching the old cache if it's mapped by another load.
+bool SaveModelCache(const std::string& cachePath, const ModelCacheHeader& stamp, const ModelCacheData& data);
+
+// Sets the Source members of 'stamp' from the file at 'sourcePath', false if it can't be read.
+bool StampModelCache(const std::string& sourcePath, ModelCacheHeader& stamp);
+
+// The cache is current if the settings and source size match and either the write time or the content hash does,
+// so the source is only read again after it was touched. 'sourceWriteTime' is the source's current write time, if it's
+// not the header's the cache should be restamped with RestampModelCache.
+bool ModelCacheMatches(const ModelCacheHeader& header, const std::string& sourcePath, UINT64 settingsHash, UINT64& sourceWriteTime);
+
+// Sets the SourceWriteTime of the cache at 'cachePath' in place, for a source that was touched but hashes the same.
+// 'mapped' is the header the load read. If the file's header isn't that one any more, another load saved a new cache over
+// it since, and that one is left as it is. The check and the write both go through one open handle: on Windows that keeps
+// SaveModelCache's rename from replacing the file in between, elsewhere a replaced file only takes the write on the old copy.
+// A torn write only leaves a write time that doesn't match, which falls back to the hash again.
+// False if the cache couldn't be opened or written.
+bool RestampModelCache(const std::string& cachePath, const ModelCacheHeader& mapped, UINT64 sourceWriteTime);
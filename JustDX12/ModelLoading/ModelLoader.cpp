@@ -1,4 +1,6 @@
 #include "ModelLoading\ModelLoader.h"
+#include <algorithm>
+#include <cstring>
 
 #include "DX12Helper.h"
 
@@ -7,6 +9,29 @@
 #include "RtRenderPipelineStage.h"
 #include "DX12App.h"
 
+// Assimp post processing every SimpleModel is imported with, part of modelCacheSettingsHash.
+static const UINT modelImportFlags = aiProcess_GenUVCoords | aiProcess_Triangulate | aiProcess_ConvertToLeftHanded |
+	aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_FindInstances | aiProcess_SplitLargeMeshes;
+
+// Hash of modelImportFlags and every Settings.h value SimpleModel::process's output depends on, ModelCacheHeader::SettingsHash.
+static UINT64 modelCacheSettingsHash() {
+	std::string settings = std::to_string(modelImportFlags)
+		+ " " + std::to_string(WELD_VERTICES) + " " + std::to_string(WELD_POSITION_EPSILON) + " " + std::to_string(WELD_NORMAL_EPSILON)
+		+ " " + std::to_string(WELD_TANGENT_EPSILON) + " " + std::to_string(WELD_TEXCOORD_EPSILON)
+		+ " " + std::to_string(OPTIMIZE_MESH_ORDER) + " " + std::to_string(VERTEX_CACHE_SIZE) + " " + std::to_string(OVERDRAW_CLUSTER_THRESHOLD)
+		+ " " + std::to_string(MESH_LOD_COUNT) + " " + std::to_string(MESH_LOD_REDUCTION) + " " + std::to_string(MESH_LOD_MIN_REDUCTION)
+		+ " " + std::to_string(MESH_LOD_NORMAL_WEIGHT) + " " + std::to_string(MESH_LOD_TEXCOORD_WEIGHT);
+	return std::hash<std::string>{}(settings);
+}
+
+// Milliseconds since 'start', which is moved up to now so the next stage is timed from here.
+static double lapMs(std::chrono::high_resolution_clock::time_point& start) {
+	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> elapsed = now - start;
+	start = now;
+	return elapsed.count();
+}
+
 ModelLoader::ModelLoader(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice)
 	: DX12TaskQueueThread(d3dDevice, D3D12_COMMAND_LIST_TYPE_COPY) {
 }
@@ -100,13 +125,15 @@ std::vector<std::shared_ptr<SimpleModel>> ModelLoader::getAllRTModels() {
 }
 
 void ModelLoader::updateTransforms() {
+	TransformArena::getInstance().submitUpdates(gFrameIndex);
+}
+
+void ModelLoader::updateGeometry() {
 	auto& instance = ModelLoader::getInstance();
-	std::lock_guard<std::mutex> lk(instance.databaseLock);
-	for (auto& model : instance.loadedModels) {
-		model.second->submitUpdates(gFrameIndex);
-	}
-	for (auto& meshletModel : instance.loadedMeshlets) {
-		meshletModel.second->submitUpdates(gFrameIndex);
+	GeometryPool::getInstance().beginFrame();
+	if (!instance.geometryCompactionQueued && GeometryPool::getInstance().wantsCompaction()) {
+		instance.geometryCompactionQueued = true;
+		instance.enqueue(new GeometryCompactTask());
 	}
 }
 
@@ -119,7 +146,7 @@ std::weak_ptr<Model> ModelLoader::loadModel(std::string name, std::string dir, b
 		auto findModel = instance.loadedMeshlets.find(dir + name);
 		std::shared_ptr<MeshletModel> meshletModel;
 		if (findModel == instance.loadedMeshlets.end()) {
-			meshletModel = std::make_shared<MeshletModel>(name, dir, usesRT, instance.md3dDevice.Get());
+			meshletModel = std::make_shared<MeshletModel>(name, dir, usesRT);
 			instance.enqueue(new MeshletModelLoadTask(meshletModel));
 		}
 		else {
@@ -133,9 +160,10 @@ std::weak_ptr<Model> ModelLoader::loadModel(std::string name, std::string dir, b
 		if (findModel == instance.loadedModels.end()) {
 			// Don't have tracking of loading models, have to see about making this safer, but it does
 			// keep the model loading code far simpler.
-			std::shared_ptr<SimpleModel> mPtr = std::make_shared<SimpleModel>(name, dir, instance.md3dDevice.Get(), usesRT);
+			std::shared_ptr<SimpleModel> mPtr = std::make_shared<SimpleModel>(name, dir, usesRT);
 			model = mPtr;
-			instance.enqueue(new ModelLoadTask(mPtr));
+			instance.beginModelLoad();
+			ThreadPool::enqueue(new ModelLoadTask(mPtr));
 		}
 		else {
 			model = findModel->second;
@@ -149,16 +177,17 @@ std::shared_ptr<Model> ModelLoader::loadModelTakeOwnership(std::string name, std
 	// Not checking the loaded models since the caller takes ownership and can't take ownership of cached data.
 	// Meshlet, not normal model.
 	if (name.ends_with(".bin")) {
-		std::shared_ptr<MeshletModel> meshletModel = std::make_shared<MeshletModel>(name, dir, usesRT, instance.md3dDevice.Get());
+		std::shared_ptr<MeshletModel> meshletModel = std::make_shared<MeshletModel>(name, dir, usesRT);
 
 		instance.enqueue(new MeshletModelLoadTask(meshletModel));
 
 		return meshletModel;
 	}
 	else {
-		std::shared_ptr<SimpleModel> model = std::make_shared<SimpleModel>(name, dir, instance.md3dDevice.Get(), usesRT);
+		std::shared_ptr<SimpleModel> model = std::make_shared<SimpleModel>(name, dir, usesRT);
 
-		instance.enqueue(new ModelLoadTask(model, false));
+		instance.beginModelLoad();
+		ThreadPool::enqueue(new ModelLoadTask(model, false));
 
 		return model;
 	}
@@ -217,6 +246,8 @@ void ModelLoader::buildRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Grap
 	std::vector<AccelerationStructureBuffers> blasVec;
 	std::vector<std::shared_ptr<SimpleModel>> models;
 	std::lock_guard<std::mutex> lk(databaseLock);
+	// BLAS builds read mesh transforms straight out of the arena's GPU buffer.
+	TransformArena::getInstance().submitUpdates(gFrameIndex);
 	for (auto& model : loadedModels) {
 		if (model.second->usesRT) {
 			blasVec.push_back(createBLAS(model.second.get(), cmdList));
@@ -234,6 +265,7 @@ void ModelLoader::buildRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Grap
 	for (int i = 0; i < blasVec.size(); i++) {
 		BLAS[models[i].get()] = blasVec[i].pResult;
 		ResourceDecay::destroyAfterDelay(blasVec[i].pScratch);
+		ResourceDecay::destroyAfterDelay(blasVec[i].pGeometryTransforms);
 		SetName(BLAS[models[i].get()].Get(), L"BLAS");
 	}
 
@@ -265,6 +297,8 @@ void ModelLoader::updateRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Gra
 
 	std::vector<std::shared_ptr<SimpleModel>> models;
 	std::lock_guard<std::mutex> lk(databaseLock);
+	// Models could have finished loading since updateTransforms, and BLAS builds read transforms from the GPU buffer.
+	TransformArena::getInstance().submitUpdates(gFrameIndex);
 	if (modelCountChanged || instanceCountChanged) {
 		ResourceDecay::destroyAfterDelay(tlasScratch.pResult);
 		ResourceDecay::destroyAfterDelay(tlasScratch.pScratch);
@@ -276,6 +310,7 @@ void ModelLoader::updateRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Gra
 				AccelerationStructureBuffers blasScratch = createBLAS(model.second.get(), cmdList);
 				ResourceDecay::destroyAfterDelay(blasScratch.pScratch);
 				ResourceDecay::destroyAfterDelay(blasScratch.pInstanceDesc);
+				ResourceDecay::destroyAfterDelay(blasScratch.pGeometryTransforms);
 				BLAS[model.second.get()] = blasScratch.pResult;
 			}
 		}
@@ -288,6 +323,7 @@ void ModelLoader::updateRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Gra
 				AccelerationStructureBuffers blasScratch = createBLAS(meshletModel.second->rtModel.get(), cmdList);
 				ResourceDecay::destroyAfterDelay(blasScratch.pScratch);
 				ResourceDecay::destroyAfterDelay(blasScratch.pInstanceDesc);
+				ResourceDecay::destroyAfterDelay(blasScratch.pGeometryTransforms);
 				BLAS[meshletModel.second->rtModel.get()] = blasScratch.pResult;
 			}
 		}
@@ -299,35 +335,67 @@ void ModelLoader::updateRTAccelerationStructure(Microsoft::WRL::ComPtr<ID3D12Gra
 		ResourceDecay::destroyAfterDelay(TLAS);
 		// Problem: Can't get ComPtr to play nice here. So we get stuck with the TLAS going null if this runs .GetAdressOf() gets the actual address of the underlying interface, but it also sucks.
 		ResourceDecay::destroyOnDelayAndFillPointer(nullptr, 1, newTLAS, std::addressof(TLAS));
-		if (modelCountChanged) {
-			for (auto& rtUser : rtUsers) {
-				rtUser->deferRebuildRtData(models);
-			}
-		}
 	}
 	else {
 		createTLAS(TLAS, tlasSize, models, meshletModels, cmdList);
 	}
+	// RT users hold descriptors into the TransformArena and GeometryPool buffers, so they need rebuilding if those buffers were replaced too.
+	UINT64 transformGeneration = TransformArena::getInstance().getBufferGeneration();
+	UINT64 geometryGeneration = GeometryPool::getInstance().getBufferGeneration();
+	if (modelCountChanged || transformGeneration != lastTransformGeneration || geometryGeneration != lastGeometryGeneration) {
+		for (auto& rtUser : rtUsers) {
+			rtUser->deferRebuildRtData(models);
+		}
+		lastTransformGeneration = transformGeneration;
+		lastGeometryGeneration = geometryGeneration;
+	}
 	modelCountChanged = false;
 }
 
 AccelerationStructureBuffers ModelLoader::createBLAS(SimpleModel* model, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> cmdList) {
+	AccelerationStructureBuffers buffers;
 	std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+	GeometryPool& geometryPool = GeometryPool::getInstance();
+	UINT vertexOffset = model->getVertexOffset();
+	UINT indexOffset = model->getIndexOffset();
+#ifdef COMPACT_VERTICES
+	// Compact positions are relative to the mesh's bounds, so each geometry's transform has to apply
+	// the dequantization before the mesh's own transform, which means building them here instead of pointing at the TransformArena.
+	UINT geometryCount = 0;
+	for (auto& mesh : model->meshes) {
+		geometryCount += mesh.getInstanceCount();
+	}
+	buffers.pGeometryTransforms = CreateBlankBuffer(md3dDevice.Get(), cmdList.Get(), sizeof(DirectX::XMFLOAT3X4) * (UINT64)(geometryCount > 0 ? geometryCount : 1),
+		D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, gUploadHeapDesc);
+	DirectX::XMFLOAT3X4* geometryTransforms = nullptr;
+	ThrowIfFailed(buffers.pGeometryTransforms->Map(0, nullptr, (void**)&geometryTransforms));
+#endif
 	for (auto& mesh : model->meshes) {
 		for (UINT i = 0; i < mesh.getInstanceCount(); i++) {
 			D3D12_RAYTRACING_GEOMETRY_DESC geomDesc = {};
 			geomDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
 
-			geomDesc.Triangles.IndexBuffer = model->indexBufferGPU->GetGPUVirtualAddress() + sizeof(unsigned int) * (UINT64)mesh.startIndexLocation;
+			geomDesc.Triangles.IndexBuffer = geometryPool.getIndexResource()->get()->GetGPUVirtualAddress() + (UINT64)mesh.getIndexSize() * mesh.getPoolStartIndexLocation(indexOffset);
 			geomDesc.Triangles.IndexCount = mesh.indexCount;
-			geomDesc.Triangles.IndexFormat = model->indexFormat;
+			geomDesc.Triangles.IndexFormat = mesh.indexFormat;
 
-			geomDesc.Triangles.VertexBuffer.StartAddress = model->vertexBufferGPU->GetGPUVirtualAddress() + sizeof(Vertex) * (UINT64)mesh.baseVertexLocation + offsetof(Vertex, pos);
+			geomDesc.Triangles.VertexBuffer.StartAddress = geometryPool.getVertexResource()->get()->GetGPUVirtualAddress() + sizeof(GpuVertex) * ((UINT64)vertexOffset + mesh.baseVertexLocation) + offsetof(GpuVertex, pos);
 			geomDesc.Triangles.VertexBuffer.StrideInBytes = model->vertexByteStride;
-			geomDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
 			geomDesc.Triangles.VertexCount = mesh.vertexCount;
 
+#ifdef COMPACT_VERTICES
+			// The build ignores the 4th component, which holds the bitangent sign.
+			geomDesc.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+			DirectX::XMMATRIX dequantize = DirectX::XMMatrixMultiply(
+				DirectX::XMMatrixScaling(mesh.positionScale.x, mesh.positionScale.y, mesh.positionScale.z),
+				DirectX::XMMatrixTranslation(mesh.positionOffset.x, mesh.positionOffset.y, mesh.positionOffset.z));
+			UINT geometryIndex = (UINT)geomDescs.size();
+			DirectX::XMStoreFloat3x4(&geometryTransforms[geometryIndex], DirectX::XMMatrixMultiply(dequantize, TransposeLoad(mesh.getTransform(i))));
+			geomDesc.Triangles.Transform3x4 = buffers.pGeometryTransforms->GetGPUVirtualAddress() + sizeof(DirectX::XMFLOAT3X4) * (UINT64)geometryIndex;
+#else
+			geomDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
 			geomDesc.Triangles.Transform3x4 = mesh.getFrameTransformVirtualAddress(i, gFrameIndex);
+#endif
 
 			// Optimization here would be to attach an opaque or not flag here.
 			geomDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_NONE;
@@ -335,6 +403,9 @@ AccelerationStructureBuffers ModelLoader::createBLAS(SimpleModel* model, Microso
 			geomDescs.push_back(geomDesc);
 		}
 	}
+#ifdef COMPACT_VERTICES
+	buffers.pGeometryTransforms->Unmap(0, nullptr);
+#endif
 
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
 	inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
@@ -346,7 +417,6 @@ AccelerationStructureBuffers ModelLoader::createBLAS(SimpleModel* model, Microso
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info = {};
 	md3dDevice->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &info);
 
-	AccelerationStructureBuffers buffers;
 	buffers.pScratch = CreateBlankBuffer(md3dDevice.Get(), cmdList.Get(), info.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, gDefaultHeapDesc);
 	buffers.pResult = CreateBlankBuffer(md3dDevice.Get(), cmdList.Get(), info.ResultDataMaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, gDefaultHeapDesc);
 
@@ -450,6 +520,76 @@ void ModelLoader::createTLAS(Microsoft::WRL::ComPtr<ID3D12Resource>& tlas, UINT6
 	SetName(tlas.Get(), L"TLAS Structure");
 }
 
+ModelLoader::GeometryKey ModelLoader::geometryKey(const Mesh& mesh) {
+	std::map<MODEL_FORMAT, DX12Texture*> sortedTextures;
+	for (const auto& texture : mesh.textures) {
+		sortedTextures[texture.first] = texture.second.get();
+	}
+	std::vector<DX12Texture*> textures;
+	for (const auto& texture : sortedTextures) {
+		textures.push_back(texture.second);
+	}
+	return std::make_tuple(mesh.geometryHash, mesh.vertexCount, mesh.indexCount, mesh.typeFlags, std::move(textures));
+}
+
+// The hash covers every attribute, the positions and indices (the part kept on the CPU) are compared so a collision can't merge different meshes.
+bool ModelLoader::sameGeometry(const Mesh& a, const Mesh& b) {
+	if (a.vertexCount != b.vertexCount || a.indexCount != b.indexCount) {
+		return false;
+	}
+	const SimpleModel& modelA = *a.parent;
+	const SimpleModel& modelB = *b.parent;
+	if (modelA.occluderPositions.size() < (size_t)a.baseVertexLocation + a.vertexCount || modelB.occluderPositions.size() < (size_t)b.baseVertexLocation + b.vertexCount
+		|| modelA.occluderIndices.size() < (size_t)a.startIndexLocation + a.indexCount || modelB.occluderIndices.size() < (size_t)b.startIndexLocation + b.indexCount) {
+		return false;
+	}
+	return memcmp(modelA.occluderPositions.data() + a.baseVertexLocation, modelB.occluderPositions.data() + b.baseVertexLocation, a.vertexCount * sizeof(DirectX::XMFLOAT3)) == 0
+		&& memcmp(modelA.occluderIndices.data() + a.startIndexLocation, modelB.occluderIndices.data() + b.startIndexLocation, a.indexCount * sizeof(UINT)) == 0;
+}
+
+void ModelLoader::assignGeometryIds(SimpleModel& model) {
+	std::lock_guard<std::mutex> lk(geometryIdLock);
+	for (Mesh& mesh : model.meshes) {
+		std::vector<GeometryGroup>& groups = geometryIds[geometryKey(mesh)];
+		auto group = std::find_if(groups.begin(), groups.end(), [&](const GeometryGroup& candidate) { return sameGeometry(*candidate.meshes.front(), mesh); });
+		if (group == groups.end()) {
+			groups.push_back({ nextGeometryId++, {} });
+			group = groups.end() - 1;
+		}
+		group->meshes.push_back(&mesh);
+		mesh.geometryId = group->geometryId;
+	}
+}
+
+void ModelLoader::releaseGeometryIds(SimpleModel& model) {
+	auto& instance = ModelLoader::getInstance();
+	std::lock_guard<std::mutex> lk(instance.geometryIdLock);
+	for (Mesh& mesh : model.meshes) {
+		if (mesh.geometryId == UNIQUE_GEOMETRY) {
+			continue;
+		}
+		auto findKey = instance.geometryIds.find(geometryKey(mesh));
+		if (findKey == instance.geometryIds.end()) {
+			continue;
+		}
+		std::vector<GeometryGroup>& groups = findKey->second;
+		for (auto group = groups.begin(); group != groups.end(); group++) {
+			if (group->geometryId != mesh.geometryId) {
+				continue;
+			}
+			std::erase(group->meshes, &mesh);
+			if (group->meshes.empty()) {
+				groups.erase(group);
+			}
+			break;
+		}
+		if (groups.empty()) {
+			instance.geometryIds.erase(findKey);
+		}
+		mesh.geometryId = UNIQUE_GEOMETRY;
+	}
+}
+
 void ModelLoader::notifyModelListeners(std::weak_ptr<Model> model) {
 	std::lock_guard<std::mutex> lk(modelListenerLock);
 	for (auto& listener : modelListeners) {
@@ -457,6 +597,41 @@ void ModelLoader::notifyModelListeners(std::weak_ptr<Model> model) {
 	}
 }
 
+void ModelLoader::beginModelLoad() {
+	std::lock_guard<std::mutex> lk(loadTimingLock);
+	if (loadsInFlight++ == 0) {
+		loadsStart = std::chrono::high_resolution_clock::now();
+	}
+}
+
+void ModelLoader::endModelLoad(const ModelLoadTiming* timing) {
+	std::lock_guard<std::mutex> lk(loadTimingLock);
+	if (timing) {
+		loadsFinished++;
+		loadsTotal.parseMs += timing->parseMs;
+		loadsTotal.processMs += timing->processMs;
+		loadsTotal.uploadMs += timing->uploadMs;
+	}
+	if (--loadsInFlight > 0) {
+		return;
+	}
+	// Parsing and processing summed over the models against the wall clock time shows how well they spread over the threads.
+	std::chrono::duration<double, std::milli> wallTime = std::chrono::high_resolution_clock::now() - loadsStart;
+	OutputDebugStringA(("Loaded " + std::to_string(loadsFinished) + " models in " + std::to_string(wallTime.count()) + " ms on "
+		+ std::to_string(std::thread::hardware_concurrency()) + " threads, summed over the models: parse " + std::to_string(loadsTotal.parseMs)
+		+ " ms, process " + std::to_string(loadsTotal.processMs) + " ms, upload " + std::to_string(loadsTotal.uploadMs) + " ms\n").c_str());
+	loadsFinished = 0;
+	loadsTotal = ModelLoadTiming();
+}
+
+void ModelLoader::queueModelUpload(PendingModelUpload upload) {
+	{
+		std::lock_guard<std::mutex> lk(modelUploadLock);
+		pendingModelUploads.push_back(std::move(upload));
+	}
+	enqueue(new ModelUploadTask());
+}
+
 ModelLoader::ModelLoadTask::ModelLoadTask(std::shared_ptr<SimpleModel> model, bool registerToModelLoader) {
 	this->model = model;
 	this->registerToModelLoader = registerToModelLoader;
@@ -464,47 +639,139 @@ ModelLoader::ModelLoadTask::ModelLoadTask(std::shared_ptr<SimpleModel> model, bo
 
 void ModelLoader::ModelLoadTask::execute() {
 	ModelLoader& instance = ModelLoader::getInstance();
+	ModelLoadTiming timing;
+	timing.stageStart = std::chrono::high_resolution_clock::now();
+
+	const std::string path = model->dir + "\\" + model->name;
+	if (CACHE_IMPORTED_MODELS) {
+		auto cacheFile = std::make_unique<MappedFile>();
+		ModelCacheView cache;
+		std::string error;
+		UINT64 sourceWriteTime = 0;
+		if (cacheFile->open(path + MODEL_CACHE_EXTENSION)) {
+			if (ParseModelCache(cacheFile->bytes(), cache, error) && ModelCacheMatches(*cache.header, path, modelCacheSettingsHash(), sourceWriteTime)) {
+				OutputDebugStringA(("Loading BasicModel from cache: " + model->name + "\n").c_str());
+				timing.parseMs = lapMs(timing.stageStart);
+				ThreadPool::enqueue(new ModelCacheSetupTask(model, std::move(cacheFile), cache, sourceWriteTime, registerToModelLoader, timing));
+				return;
+			}
+			OutputDebugStringA(("Model cache is out of date, importing again: " + model->name + " " + error + "\n").c_str());
+		}
+	}
 
 	// Have to alloc to pass around, will try allocating a pool of these initially at some point.
 	std::unique_ptr<Assimp::Importer> importer = std::make_unique<Assimp::Importer>();
 
 	OutputDebugStringA(("Starting to Load BasicModel: " + model->name + "\n").c_str());
-	// Trying to limit IO to a single thread.
-	importer->ReadFile(model->dir + "\\" + model->name, 0);
+	const aiScene* scene = importer->ReadFile(path, modelImportFlags);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::string error = importer->GetErrorString();
+		OutputDebugStringA(("ERROR::ASSIMP::" + error).c_str());
+		instance.endModelLoad(nullptr);
+		return;
+	}
+	timing.parseMs = lapMs(timing.stageStart);
 
-	ThreadPool::enqueue(new ModelLoadSetupTask(model, std::move(importer), registerToModelLoader));
+	ThreadPool::enqueue(new ModelLoadSetupTask(model, std::move(importer), registerToModelLoader, timing));
 }
 
-ModelLoader::ModelLoadSetupTask::ModelLoadSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<Assimp::Importer> importer, bool registerToModelLoader) {
+ModelLoader::ModelLoadSetupTask::ModelLoadSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<Assimp::Importer> importer, bool registerToModelLoader, ModelLoadTiming timing) {
 	this->model = model;
 	this->importer = std::move(importer);
 	this->registerToModelLoader = registerToModelLoader;
+	this->timing = timing;
 }
 
 void ModelLoader::ModelLoadSetupTask::execute() {
 	auto& instance = ModelLoader::getInstance();
+	timing.stageStart = std::chrono::high_resolution_clock::now();
+
+	OutputDebugStringA(("Finished load, beginning processing: " + model->name + "\n").c_str());
+	ModelCacheData cache;
+	model->process(importer->GetScene(), CACHE_IMPORTED_MODELS ? &cache : nullptr);
+	importer->FreeScene();
+	timing.processMs = lapMs(timing.stageStart);
+	instance.queueModelUpload({ model, registerToModelLoader, timing });
+
+	if (CACHE_IMPORTED_MODELS) {
+		const std::string path = model->dir + "\\" + model->name;
+		ModelCacheHeader stamp = {};
+		stamp.SettingsHash = modelCacheSettingsHash();
+		if (!StampModelCache(path, stamp) || !SaveModelCache(path + MODEL_CACHE_EXTENSION, stamp, cache)) {
+			OutputDebugStringA(("Couldn't save model cache: " + model->name + "\n").c_str());
+		}
+	}
+}
 
-	const aiScene* scene = importer->ApplyPostProcessing(aiProcess_GenUVCoords | aiProcess_Triangulate | aiProcess_ConvertToLeftHanded |
-		aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_FindInstances |
-		aiProcess_SplitLargeMeshes);
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::string error = importer->GetErrorString();
-		OutputDebugStringA(("ERROR::ASSIMP::" + error).c_str());
+ModelLoader::ModelCacheSetupTask::ModelCacheSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<MappedFile> cacheFile, ModelCacheView cache, UINT64 sourceWriteTime, bool registerToModelLoader, ModelLoadTiming timing) {
+	this->model = model;
+	this->cacheFile = std::move(cacheFile);
+	this->cache = cache;
+	this->sourceWriteTime = sourceWriteTime;
+	this->registerToModelLoader = registerToModelLoader;
+	this->timing = timing;
+}
+
+void ModelLoader::ModelCacheSetupTask::execute() {
+	timing.stageStart = std::chrono::high_resolution_clock::now();
+	model->processCache(cache);
+	const ModelCacheHeader mappedHeader = *cache.header;
+	cacheFile->close();
+	// The source was only touched, without a new stamp every later load would hash it again.
+	if (mappedHeader.SourceWriteTime != sourceWriteTime
+		&& !RestampModelCache(model->dir + "\\" + model->name + MODEL_CACHE_EXTENSION, mappedHeader, sourceWriteTime)) {
+		OutputDebugStringA(("Couldn't restamp model cache: " + model->name + "\n").c_str());
 	}
-	else {
-		OutputDebugStringA(("Finished load, beginning processing/upload: " + model->name + "\n").c_str());
-		// TODO: possibly have multiple allocators for model loading.
-		{
-			std::lock_guard<std::mutex> lk(instance.commandQueueLock);
-			instance.waitOnFence();
-			instance.mDirectCmdListAlloc->Reset();
-			instance.mCommandList->Reset(instance.mDirectCmdListAlloc.Get(), nullptr);
-			instance.mDirectCmdListAlloc->SetName(L"ModelLoad");
-			model->setup(&instance, scene->mRootNode, scene);
-			instance.waitOnFence();
-		}
-		
-		ThreadPool::enqueue(new ModelLoadFinalizeTask(model, registerToModelLoader));
+	timing.processMs = lapMs(timing.stageStart);
+	ModelLoader::getInstance().queueModelUpload({ model, registerToModelLoader, timing });
+}
+
+void ModelLoader::ModelUploadTask::execute() {
+	auto& instance = ModelLoader::getInstance();
+
+	std::lock_guard<std::mutex> lk(instance.commandQueueLock);
+
+	std::vector<PendingModelUpload> batch;
+	{
+		std::lock_guard<std::mutex> uploadLk(instance.modelUploadLock);
+		std::swap(batch, instance.pendingModelUploads);
+	}
+	if (batch.empty()) {
+		return;
+	}
+
+	instance.waitOnFence();
+	instance.mDirectCmdListAlloc->Reset();
+	instance.mCommandList->Reset(instance.mDirectCmdListAlloc.Get(), nullptr);
+	instance.mDirectCmdListAlloc->SetName(L"ModelLoad");
+	// Grows the pool once for the whole batch, so no rebuild lands between copies into the pool on this list.
+	std::vector<std::pair<UINT, UINT>> blockSizes;
+	for (auto& upload : batch) {
+		blockSizes.push_back(upload.model->getPendingGeometrySize());
+	}
+	GeometryPool::getInstance().reserve(instance.mCommandList.Get(), blockSizes);
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> uploadBuffers;
+	for (auto& upload : batch) {
+		uploadBuffers.push_back(upload.model->recordUpload(instance.mCommandList.Get()));
+	}
+	instance.mCommandList->Close();
+	ID3D12CommandList* cmdLists[] = { instance.mCommandList.Get() };
+	instance.mCommandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+
+	// The models can't be drawn until the GeometryPool says the copies are done, so only the upload buffers need to wait for them.
+	int fenceVal = instance.getFenceValue() + 1;
+	for (auto& uploadBuffer : uploadBuffers) {
+		ResourceDecay::destroyOnEvent(uploadBuffer, EventFromFence(instance.getFence().Get(), fenceVal));
+	}
+	instance.setFence(fenceVal);
+	instance.waitOnFence();
+	GeometryPool::getInstance().uploadsComplete();
+
+	OutputDebugStringA(("Uploaded " + std::to_string(batch.size()) + " models in one submission\n").c_str());
+	for (auto& upload : batch) {
+		upload.timing.uploadMs = lapMs(upload.timing.stageStart);
+		instance.endModelLoad(&upload.timing);
+		ThreadPool::enqueue(new ModelLoadFinalizeTask(upload.model, upload.registerToModelLoader));
 	}
 }
 
@@ -514,7 +781,7 @@ ModelLoader::ModelLoadFinalizeTask::ModelLoadFinalizeTask(std::shared_ptr<Simple
 }
 
 void ModelLoader::ModelLoadFinalizeTask::execute() {
-	if (!model->allTexturesLoaded()) {
+	if (!model->allTexturesLoaded() || !GeometryPool::getInstance().isResident(model->geometry)) {
 		ThreadPool::enqueue(new ModelLoadFinalizeTask(model, registerToModelLoader));
 		return;
 	}
@@ -529,8 +796,10 @@ void ModelLoader::ModelLoadFinalizeTask::execute() {
 	while (instance.loadedModels.contains(model->dir + modelName)) {
 		modelName.insert(0, "Dupe");
 	}
+	instance.assignGeometryIds(*model);
 	lk.unlock();
 	if (registerToModelLoader) {
+		model->registerToSceneBVH();
 		lk.lock();
 		instance.loadedModels[model->dir + modelName] = model;
 		instance.instanceCountChanged = true;
@@ -546,33 +815,59 @@ ModelLoader::MeshletModelLoadTask::MeshletModelLoadTask(std::shared_ptr<MeshletM
 void ModelLoader::MeshletModelLoadTask::execute() {
 	OutputDebugStringA(("Starting to Load Meshlet Model: " + model->name + "\n").c_str());
 
-	model->LoadFromFile(model->dir + "\\" + model->name);
+	HRESULT result = model->LoadFromFile(model->dir + "\\" + model->name);
+	if (result == E_INVALIDARG) {
+		OutputDebugStringA(("No cooked meshlets, building them from source: " + model->name + "\n").c_str());
+		result = model->BuildFromSource();
+	}
+	// Nothing to upload, and a model without meshes can't be drawn, so it's never registered.
+	if (FAILED(result)) {
+		OutputDebugStringA(("Failed to load meshlet model " + model->name + ": " + HrToString(result) + "\n").c_str());
+		return;
+	}
 
 	OutputDebugStringA(("Finished load: " + model->name + "\n").c_str());
 
-	ThreadPool::enqueue(new MeshletModelSetupTask(model));
-}
-
-ModelLoader::MeshletModelSetupTask::MeshletModelSetupTask(std::shared_ptr<MeshletModel> model) {
-	this->model = model;
+	auto& instance = ModelLoader::getInstance();
+	{
+		std::lock_guard<std::mutex> lk(instance.meshletUploadLock);
+		instance.pendingMeshletUploads.add(model);
+	}
+	ThreadPool::enqueue(new MeshletModelUploadTask());
 }
 
-void ModelLoader::MeshletModelSetupTask::execute() {
+void ModelLoader::MeshletModelUploadTask::execute() {
 	auto& instance = ModelLoader::getInstance();
 
 	std::lock_guard<std::mutex> lk(instance.commandQueueLock);
 
+	MeshletUploadBatch batch;
+	{
+		std::lock_guard<std::mutex> uploadLk(instance.meshletUploadLock);
+		std::swap(batch, instance.pendingMeshletUploads);
+	}
+	if (batch.empty()) {
+		return;
+	}
+
+	// Only the allocator has to wait for the last submission, the batch itself goes out without waiting on its copies.
+	instance.waitOnFence();
 	instance.mDirectCmdListAlloc->Reset();
 	instance.mCommandList->Reset(instance.mDirectCmdListAlloc.Get(), nullptr);
+	batch.submit(&instance);
 
-	// TODO: possibly have multiple allocators for model loading.
-	{
-		OutputDebugStringA(("Beginning Upload: " + model->name + "\n").c_str());
-		model->UploadGpuResources(instance.md3dDevice.Get(), instance.mCommandQueue.Get(), instance.mDirectCmdListAlloc.Get(), instance.mCommandList.Get());
-		OutputDebugStringA(("Finished Upload: " + model->name + "\n").c_str());
+	for (auto& model : batch.getModels()) {
+		if (model->usesRT) {
+			instance.waitOnFence();
+			instance.mDirectCmdListAlloc->Reset();
+			instance.mCommandList->Reset(instance.mDirectCmdListAlloc.Get(), nullptr);
+			model->BuildRtModel(&instance);
+			instance.waitOnFence();
+			GeometryPool::getInstance().uploadsComplete();
+			ThreadPool::enqueue(new ModelLoadFinalizeTask(model->rtModel, false));
+		}
+		ThreadPool::enqueue(new MeshletModelLoadFinalizeTask(model));
 	}
-
-	ThreadPool::enqueue(new MeshletModelLoadFinalizeTask(model));
 }
 
 ModelLoader::MeshletModelLoadFinalizeTask::MeshletModelLoadFinalizeTask(std::shared_ptr<MeshletModel> model) {
@@ -580,12 +875,20 @@ ModelLoader::MeshletModelLoadFinalizeTask::MeshletModelLoadFinalizeTask(std::sha
 }
 
 void ModelLoader::MeshletModelLoadFinalizeTask::execute() {
-	if (!model->allTexturesLoaded() || !model->rtModel->loaded) {
+	if (!model->allTexturesLoaded() || !model->UploadComplete() || (model->usesRT && !(model->rtModel && model->rtModel->loaded))) {
 		ThreadPool::enqueue(new MeshletModelLoadFinalizeTask(model));
 		return;
 	}
+	if (model->rtModel) {
+		// Transforms set while it was being built went nowhere.
+		model->rtModel->setInstanceCount(model->getInstanceCount());
+		for (UINT i = 0; i < model->getInstanceCount(); i++) {
+			model->rtModel->setTransform(i, model->getTransform(i));
+		}
+	}
 
 	model->loaded = true;
+	model->registerToSceneBVH();
 
 	auto& instance = ModelLoader::getInstance();
 	std::lock_guard<std::mutex> lk(instance.databaseLock);
@@ -600,6 +903,26 @@ void ModelLoader::MeshletModelLoadFinalizeTask::execute() {
 }
 
 
+void ModelLoader::GeometryCompactTask::execute() {
+	auto& instance = ModelLoader::getInstance();
+	{
+		std::lock_guard<std::mutex> lk(instance.commandQueueLock);
+		instance.waitOnFence();
+		instance.mDirectCmdListAlloc->Reset();
+		instance.mCommandList->Reset(instance.mDirectCmdListAlloc.Get(), nullptr);
+		bool compacted = GeometryPool::getInstance().compact(instance.mCommandList.Get());
+		instance.mCommandList->Close();
+		if (compacted) {
+			OutputDebugStringA("Compacting Geometry Pool\n");
+			ID3D12CommandList* cmdLists[] = { instance.mCommandList.Get() };
+			instance.mCommandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+			instance.waitOnFence();
+			GeometryPool::getInstance().uploadsComplete();
+		}
+	}
+	instance.geometryCompactionQueued = false;
+}
+
 ModelLoader::RTStructureLoadTask::RTStructureLoadTask(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> cmdList, std::vector<AccelerationStructureBuffers>& scratchBuffers) : scratchBuffers(scratchBuffers) {
 	this->cmdList = cmdList;
 }
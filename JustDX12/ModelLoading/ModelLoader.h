@@ -4,8 +4,12 @@
 #include <thread>
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
 #include <queue>
 #include <string>
+#include <map>
+#include <tuple>
+#include <chrono>
 #include <assimp/Importer.hpp>		// C++ importer interface
 #include <assimp/scene.h>			// Output data structure
 #include <assimp/postprocess.h>		// Post processing flags
@@ -15,6 +19,9 @@
 #include "Model.h"
 #include "ModelLoading\SimpleModel.h"
 #include "MeshletModel.h"
+#include "ModelLoading\MeshletUploadBatch.h"
+#include "ModelLoading\MappedFile.h"
+#include "ModelLoading\ModelCache.h"
 
 #include "Tasks\DX12TaskQueueThread.h"
 
@@ -24,6 +31,8 @@ struct AccelerationStructureBuffers {
 	Microsoft::WRL::ComPtr<ID3D12Resource> pScratch;
 	Microsoft::WRL::ComPtr<ID3D12Resource> pResult;
 	Microsoft::WRL::ComPtr<ID3D12Resource> pInstanceDesc;
+	// Per geometry transforms the BLAS build reads, only used with COMPACT_VERTICES.
+	Microsoft::WRL::ComPtr<ID3D12Resource> pGeometryTransforms;
 };
 
 class RtRenderPipelineStage;
@@ -55,10 +64,15 @@ public:
 	static std::vector<std::shared_ptr<SimpleModel>> getAllRTModels();
 	
 	static void updateTransforms();
+	// Lets the GeometryPool swap in finished rebuilds and queues a compaction if enough geometry was unloaded.
+	// Has to be called at the start of every frame, before any stage records draws.
+	static void updateGeometry();
 
 	static std::weak_ptr<Model> loadModel(std::string name, std::string dir, bool usesRT = false);
 	static std::shared_ptr<Model> loadModelTakeOwnership(std::string name, std::string dir, bool usesRT = false);
 	static void unloadModel(std::string name, std::string dir);
+	// Drops the model's meshes from the geometryIds they were given, called when the model is destroyed.
+	static void releaseGeometryIds(SimpleModel& model);
 
 	// Called in ModelListener constructor, should combine with RT user eventually.
 	static void registerModelListener(ModelListener* listener);
@@ -79,8 +93,32 @@ private:
 	AccelerationStructureBuffers createBLAS(SimpleModel* model, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> cmdList);
 	void createTLAS(Microsoft::WRL::ComPtr<ID3D12Resource>& tlas, UINT64& tlasSize, std::vector<std::shared_ptr<SimpleModel>>& models, std::vector<MeshletModel*>& meshletModels, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> cmdList);
 	
-	void notifyModelListeners(std::weak_ptr<Model> model);
+	// Time a SimpleModel load spent in each stage, the upload's includes waiting for its batch.
+	struct ModelLoadTiming {
+		std::chrono::high_resolution_clock::time_point stageStart;
+		double parseMs = 0.0;
+		double processMs = 0.0;
+		double uploadMs = 0.0;
+	};
 
+	struct PendingModelUpload {
+		std::shared_ptr<SimpleModel> model;
+		bool registerToModelLoader;
+		ModelLoadTiming timing;
+	};
+
+	void notifyModelListeners(std::weak_ptr<Model> model);
+	// Every SimpleModel load has to be matched by an endModelLoad once its upload completes, or with null 'timing' if it failed.
+	// The last one of a burst of loads logs the burst's wall clock time next to each stage's time summed over its models.
+	void beginModelLoad();
+	void endModelLoad(const ModelLoadTiming* timing);
+	// Hands a processed model to the next ModelUploadTask.
+	void queueModelUpload(PendingModelUpload upload);
+	// Gives each mesh of 'model' the geometryId of any loaded mesh with the same geometry and textures, or a new one.
+	void assignGeometryIds(SimpleModel& model);
+
+	// SimpleModels load in three stages: parsing (the assimp import, or reading a current ModelCache) and then processing
+	// each run on the ThreadPool, so separate models go through them in parallel. Uploads are batched on this thread.
 	class ModelLoadTask : public Task {
 	public:
 		ModelLoadTask(std::shared_ptr<SimpleModel> model, bool registerToModelLoader = true);
@@ -95,7 +133,7 @@ private:
 
 	class ModelLoadSetupTask : public Task {
 	public:
-		ModelLoadSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<Assimp::Importer> importer, bool registerToModelLoader);
+		ModelLoadSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<Assimp::Importer> importer, bool registerToModelLoader, ModelLoadTiming timing);
 		virtual ~ModelLoadSetupTask() override = default;
 
 		void execute() override;
@@ -104,6 +142,35 @@ private:
 		bool registerToModelLoader;
 		std::shared_ptr<SimpleModel> model;
 		std::unique_ptr<Assimp::Importer> importer;
+		ModelLoadTiming timing;
+	};
+
+	// Processes the model from a cache ModelLoadTask already found current, instead of the import.
+	class ModelCacheSetupTask : public Task {
+	public:
+		ModelCacheSetupTask(std::shared_ptr<SimpleModel> model, std::unique_ptr<MappedFile> cacheFile, ModelCacheView cache, UINT64 sourceWriteTime, bool registerToModelLoader, ModelLoadTiming timing);
+		virtual ~ModelCacheSetupTask() override = default;
+
+		void execute() override;
+
+	private:
+		bool registerToModelLoader;
+		std::shared_ptr<SimpleModel> model;
+		// Mapping 'cache' points into.
+		std::unique_ptr<MappedFile> cacheFile;
+		ModelCacheView cache;
+		// Of the source when it was checked, written to the cache if it only matched by hash.
+		UINT64 sourceWriteTime;
+		ModelLoadTiming timing;
+	};
+
+	// Uploads every SimpleModel queued in pendingModelUploads in one submission, later tasks find it empty and do nothing.
+	class ModelUploadTask : public Task {
+	public:
+		ModelUploadTask() = default;
+		virtual ~ModelUploadTask() override = default;
+
+		void execute() override;
 	};
 
 	class ModelLoadFinalizeTask : public Task {
@@ -129,15 +196,13 @@ private:
 		std::shared_ptr<MeshletModel> model;
 	};
 
-	class MeshletModelSetupTask : public Task {
+	// Uploads every MeshletModel queued in pendingMeshletUploads as one batch, later tasks find it empty and do nothing.
+	class MeshletModelUploadTask : public Task {
 	public:
-		MeshletModelSetupTask(std::shared_ptr<MeshletModel> model);
-		virtual ~MeshletModelSetupTask() override = default;
+		MeshletModelUploadTask() = default;
+		virtual ~MeshletModelUploadTask() override = default;
 
 		void execute() override;
-
-	private:
-		std::shared_ptr<MeshletModel> model;
 	};
 
 	class MeshletModelLoadFinalizeTask : public Task {
@@ -151,6 +216,14 @@ private:
 		std::shared_ptr<MeshletModel> model;
 	};
 
+	class GeometryCompactTask : public Task {
+	public:
+		GeometryCompactTask() = default;
+		virtual ~GeometryCompactTask() override = default;
+
+		void execute() override;
+	};
+
 	class RTStructureLoadTask : public Task {
 	public:
 		RTStructureLoadTask(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList6> cmdList, std::vector<AccelerationStructureBuffers>& scratchBuffers);
@@ -180,6 +253,20 @@ private:
 	// Only have a single copy queue, so have to lock access to it by the processing threads.
 	std::mutex commandQueueLock;
 
+	// MeshletModels done loading that haven't been uploaded yet, so ones finishing close together share a submission.
+	std::mutex meshletUploadLock;
+	MeshletUploadBatch pendingMeshletUploads;
+
+	// SimpleModels done processing that haven't been uploaded yet, so ones finishing close together share a submission.
+	std::mutex modelUploadLock;
+	std::vector<PendingModelUpload> pendingModelUploads;
+
+	std::mutex loadTimingLock;
+	UINT loadsInFlight = 0;
+	UINT loadsFinished = 0;
+	std::chrono::high_resolution_clock::time_point loadsStart;
+	ModelLoadTiming loadsTotal;
+
 	// Since we're storing the models in this class, we need to synchronize access.
 	std::mutex databaseLock;
 	bool modelCountChanged = false;
@@ -187,7 +274,26 @@ private:
 	std::unordered_map<std::string, std::shared_ptr<SimpleModel>> loadedModels;
 	std::unordered_map<std::string, std::shared_ptr<MeshletModel>> loadedMeshlets;
 
+	// (geometry hash, vertex count, index count, type flags, textures in MODEL_FORMAT order) to the meshes sharing a Mesh::geometryId.
+	// Textures are cached by the TextureLoader, so meshes using the same files point to the same textures.
+	// A key can hold more than one geometry if their hashes collide, meshes only share an id once their positions and indices compare equal.
+	// Entries are dropped with their last mesh, so a key never points at freed textures and ids are never reused.
+	typedef std::tuple<UINT64, UINT, UINT, UINT, std::vector<DX12Texture*>> GeometryKey;
+	struct GeometryGroup {
+		UINT geometryId;
+		std::vector<const Mesh*> meshes;
+	};
+	static GeometryKey geometryKey(const Mesh& mesh);
+	static bool sameGeometry(const Mesh& a, const Mesh& b);
+	// Separate from the databaseLock, models are destroyed (and release their ids) while it's held.
+	std::mutex geometryIdLock;
+	std::map<GeometryKey, std::vector<GeometryGroup>> geometryIds;
+	UINT nextGeometryId = 0;
+
 	std::vector<RtRenderPipelineStage*> rtUsers;
+	UINT64 lastTransformGeneration = 0;
+	UINT64 lastGeometryGeneration = 0;
+	std::atomic<bool> geometryCompactionQueued = false;
 
 	UINT64 tlasSize;
 	std::unordered_map<SimpleModel*, Microsoft::WRL::ComPtr<ID3D12Resource>> BLAS;
@@ -1,5 +1,10 @@
 #include "ModelLoading\Mesh.h"
 #include "ModelLoading\SimpleModel.h"
+#include "ModelLoading\ModelLoader.h"
+#include "ModelLoading\MeshOptimizer.h"
+#include "ModelLoading\MeshSimplifier.h"
+#include "ModelLoading\VertexCompression.h"
+#include "ModelLoading\GeometryPacking.h"
 #include "DX12Helper.h"
 #include <d3dcompiler.h>
 #include "DX12App.h"
@@ -8,63 +13,210 @@
 #include "ConstantBufferTypes.h"
 #include "ResourceDecay.h"
 #include "ResourceClasses/DX12Resource.h"
+#include "ThreadPool.h"
+#include "Tasks/Task.h"
+#include <string_view>
+#include <algorithm>
 
 #pragma comment(lib, "dxcompiler.lib")
 #pragma comment(lib, "D3D12.lib")
-SimpleModel::SimpleModel(std::string name, std::string dir, ID3D12Device5* device, bool usesRT) 
-	: Model(device, name, dir, usesRT) {
+class MeshProcessTask : public Task {
+public:
+	MeshProcessTask(std::shared_ptr<SimpleModel::MeshProcessJob> job) : Task() {
+		this->job = job;
+	}
+	void execute() override {
+		SimpleModel::processMeshJob(*job);
+	}
+	~MeshProcessTask() override = default;
+private:
+	std::shared_ptr<SimpleModel::MeshProcessJob> job;
+};
+
+SimpleModel::SimpleModel(std::string name, std::string dir, bool usesRT) 
+	: Model(name, dir, usesRT) {
 	setInstanceCount(1);
 	setTransform(0, Identity());
 }
 
 SimpleModel::~SimpleModel() {
-	ResourceDecay::destroyAfterDelay(vertexBufferGPU);
-	ResourceDecay::destroyAfterDelay(indexBufferGPU);
+	ModelLoader::releaseGeometryIds(*this);
+	if (geometry != INVALID_GEOMETRY_HANDLE) {
+		GeometryPool::getInstance().release(geometry);
+	}
 }
 
-void SimpleModel::setup(DX12TaskQueueThread* thread, aiNode* node, const aiScene* scene) {
+void SimpleModel::process(const aiScene* scene, ModelCacheData* cache) {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	processLights(scene);
-	processMeshes(scene, vertices, indices, thread->md3dDevice.Get());
+	processMeshes(scene, vertices, indices);
 	processNodes(scene);
-	this->scene.calculateFullTransform();
-	refreshAllTransforms();
-	refreshBoundingBox();
+	if (cache) {
+		fillCache(*cache, vertices, indices);
+	}
+	prepareGeometry(vertices, indices);
+}
 
-	indexCount = (UINT)indices.size();
-	vertexCount = (UINT)vertices.size();
+void SimpleModel::processCache(const ModelCacheView& cache) {
+	for (const CachedLight& cachedLight : cache.lights) {
+		aiLight light;
+		light.mName.Set(std::string(cache.string(cachedLight.Name)));
+		light.mType = (aiLightSourceType)cachedLight.Type;
+		light.mPosition = aiVector3D(cachedLight.Position.x, cachedLight.Position.y, cachedLight.Position.z);
+		light.mDirection = aiVector3D(cachedLight.Direction.x, cachedLight.Direction.y, cachedLight.Direction.z);
+		light.mColorDiffuse = aiColor3D(cachedLight.ColorDiffuse.x, cachedLight.ColorDiffuse.y, cachedLight.ColorDiffuse.z);
+		light.mAngleInnerCone = cachedLight.AngleInnerCone;
+		light.mAttenuationQuadratic = cachedLight.AttenuationQuadratic;
+		lights.push_back(light);
+	}
+
+	TextureLoader& textureLoader = TextureLoader::getInstance();
+	meshes.reserve(cache.meshes.size());
+	for (const CachedMesh& cached : cache.meshes) {
+		Mesh& mesh = meshes.emplace_back();
+		mesh.parent = this;
+		mesh.typeFlags = cached.TypeFlags;
+		mesh.indexCount = cached.IndexCount;
+		mesh.vertexCount = cached.VertexCount;
+		mesh.startIndexLocation = cached.StartIndexLocation;
+		mesh.baseVertexLocation = cached.BaseVertexLocation;
+		mesh.boundingBox = DirectX::BoundingBox(cached.BoundsCenter, cached.BoundsExtents);
+		for (const CachedLod& cachedLod : cache.lods.subspan(cached.FirstLod, cached.LodCount)) {
+			Mesh::Lod lod;
+			lod.indexCount = cachedLod.IndexCount;
+			lod.startIndexLocation = cachedLod.StartIndexLocation;
+			lod.relativeError = cachedLod.RelativeError;
+			mesh.lods.push_back(lod);
+		}
+		for (UINT i = 0; i < CACHED_TEXTURE_COUNT; i++) {
+			MODEL_FORMAT format = (MODEL_FORMAT)(MODEL_FORMAT_DIFFUSE_TEX << i);
+			if (mesh.typeFlags & format) {
+				mesh.textures[format] = textureLoader.deferLoad(std::string(cache.string(cached.Textures[i])), dir + "\\textures");
+			}
+		}
+	}
 
-	vertexByteStride = sizeof(Vertex);
-	indexFormat = DXGI_FORMAT_R32_UINT;
-	vertexBufferByteSize = vertexCount * sizeof(Vertex);
-	indexBufferByteSize = indexCount * sizeof(unsigned int);
+	// Parents come first, so replaying the nodes in order rebuilds the tree and registers every mesh's instances in the same order.
+	std::vector<SceneNode*> nodes(cache.nodes.size());
+	for (UINT i = 0; i < cache.nodes.size(); i++) {
+		const CachedNode& cached = cache.nodes[i];
+		if (i == 0) {
+			nodes[i] = &this->scene;
+			nodes[i]->name = cache.string(cached.Name);
+			nodes[i]->transform = cached.Transform;
+		}
+		else {
+			nodes[i] = nodes[cached.Parent]->addChild(cached.Transform, std::string(cache.string(cached.Name)));
+		}
+		for (UINT32 mesh : cache.nodeMeshes.subspan(cached.FirstMesh, cached.MeshCount)) {
+			meshes[mesh].registerInstance(nodes[i]);
+		}
+	}
+	this->scene.calculateFullTransform();
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> indexBufferUploader = nullptr;
+	std::vector<Vertex> vertices(cache.vertices.begin(), cache.vertices.end());
+	std::vector<unsigned int> indices(cache.indices.begin(), cache.indices.end());
+	prepareGeometry(vertices, indices);
+}
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer = CreateDefaultBuffer(thread->md3dDevice.Get(),
-		thread->mCommandList.Get(),
-		vertices.data(), vertexBufferByteSize, vertexBufferUploader);
-	Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer = CreateDefaultBuffer(thread->md3dDevice.Get(),
-		thread->mCommandList.Get(),
-		indices.data(), indexBufferByteSize, indexBufferUploader);
+void SimpleModel::setupFromGeometry(DX12TaskQueueThread* thread, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	for (Mesh& mesh : meshes) {
+		mesh.parent = this;
+		mesh.registerInstance(&scene);
+	}
+	prepareGeometry(vertices, indices);
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer = recordUpload(thread->mCommandList.Get());
 
 	thread->mCommandList->Close();
 	ID3D12CommandList* cmdLists[] = { thread->mCommandList.Get() };
 	thread->mCommandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 
-	// the ResourceDecay class will tell the model about the resource only once the copy is completed.
+	// The model can't be drawn until the GeometryPool says the copy is done, so only the upload buffer needs to wait for it.
 	int fenceVal = thread->getFenceValue() + 1;
-	vertexBufferGPU = vertexBuffer;
-	indexBufferGPU = indexBuffer;
-	this->indexBuffer = std::make_unique<DX12Resource>(DESCRIPTOR_TYPE_CBV, indexBufferGPU.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-	this->vertexBuffer = std::make_unique<DX12Resource>(DESCRIPTOR_TYPE_CBV, vertexBufferGPU.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-	ResourceDecay::destroyOnEvent(vertexBufferUploader, EventFromFence(thread->getFence().Get(), fenceVal));
-	ResourceDecay::destroyOnEvent(indexBufferUploader, EventFromFence(thread->getFence().Get(), fenceVal));
+	ResourceDecay::destroyOnEvent(uploadBuffer, EventFromFence(thread->getFence().Get(), fenceVal));
 	thread->setFence(fenceVal);
 }
 
+std::pair<UINT, UINT> SimpleModel::getPendingGeometrySize() const {
+	return { (UINT)pendingVertices.size(), (UINT)(pendingIndices.size() / sizeof(UINT)) };
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> SimpleModel::recordUpload(ID3D12GraphicsCommandList* cmdList) {
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer = nullptr;
+	geometry = GeometryPool::getInstance().upload(cmdList, pendingVertices, pendingIndices, uploadBuffer);
+	pendingVertices = std::vector<GpuVertex>();
+	pendingIndices = std::vector<BYTE>();
+	return uploadBuffer;
+}
+
+void SimpleModel::prepareGeometry(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	for (Mesh& mesh : meshes) {
+		mesh.geometryHash = HashMeshGeometry(vertices.data() + mesh.baseVertexLocation, mesh.vertexCount, indices.data() + mesh.startIndexLocation, mesh.indexCount);
+	}
+	this->scene.calculateFullTransform();
+	refreshAllTransforms();
+	refreshBoundingBox();
+
+	indexCount = (UINT)indices.size();
+	vertexCount = (UINT)vertices.size();
+
+	occluderPositions.reserve(vertices.size());
+	for (const auto& vertex : vertices) {
+		occluderPositions.push_back(vertex.pos);
+	}
+
+#ifdef COMPACT_VERTICES
+	pendingVertices = compressVertices(vertices);
+#else
+	pendingVertices = std::move(vertices);
+#endif
+	vertexByteStride = sizeof(GpuVertex);
+	pendingIndices = packIndices(indices);
+	occluderIndices = std::move(indices);
+}
+
+std::vector<CompactVertex> SimpleModel::compressVertices(const std::vector<Vertex>& vertices) {
+	std::vector<CompactVertex> compressed(vertices.size());
+	for (Mesh& mesh : meshes) {
+		SetPositionQuantization(mesh.boundingBox.Center, mesh.boundingBox.Extents, mesh.positionOffset, mesh.positionScale);
+		const Vertex* meshVertices = vertices.data() + mesh.baseVertexLocation;
+		CompactVertex* meshCompressed = compressed.data() + mesh.baseVertexLocation;
+		for (UINT i = 0; i < mesh.vertexCount; i++) {
+			meshCompressed[i] = CompressVertex(meshVertices[i], mesh.positionOffset, mesh.positionScale);
+		}
+#if defined(DEBUG) || defined(_DEBUG)
+		float maxTexC = 0.0f;
+		for (UINT i = 0; i < mesh.vertexCount; i++) {
+			maxTexC = std::max({ maxTexC, std::abs(meshVertices[i].texC.x), std::abs(meshVertices[i].texC.y) });
+		}
+		VertexCompressionError error = MeasureCompressionError(meshVertices, meshCompressed, mesh.vertexCount, mesh.positionOffset, mesh.positionScale);
+		if (!error.within(CompressionErrorBound(mesh.positionOffset, mesh.positionScale, maxTexC))) {
+			OutputDebugStringA(("Vertex compression error out of bounds: " + name + "\n").c_str());
+		}
+#endif
+	}
+	return compressed;
+}
+
+std::vector<BYTE> SimpleModel::packIndices(const std::vector<unsigned int>& indices) {
+	std::vector<BYTE> indexData;
+	for (Mesh& mesh : meshes) {
+		UINT indexSize = PoolIndexSize(mesh.vertexCount, SHORT_INDICES);
+		mesh.indexFormat = indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		mesh.poolIndexLocation = AppendPackedIndices(indices.data() + mesh.startIndexLocation, mesh.indexCount, indexSize, indexData);
+		for (Mesh::Lod& lod : mesh.lods) {
+			lod.poolIndexLocation = AppendPackedIndices(indices.data() + lod.startIndexLocation, lod.indexCount, indexSize, indexData);
+		}
+	}
+	PadPackedIndices(indexData);
+	if (LOG_MODEL_IMPORT_STATS) {
+		OutputDebugStringA((name + " indices: " + std::to_string(indices.size() * sizeof(UINT) / 1024) + " KB -> "
+			+ std::to_string(indexData.size() / 1024) + " KB\n").c_str());
+	}
+	return indexData;
+}
+
 bool SimpleModel::allTexturesLoaded() {
 	for (auto& m : meshes) {
 		if (!m.allTexturesLoaded()) {
@@ -75,27 +227,25 @@ bool SimpleModel::allTexturesLoaded() {
 }
 
 D3D12_VERTEX_BUFFER_VIEW SimpleModel::getVertexBufferView() const {
-	D3D12_VERTEX_BUFFER_VIEW vbv;
-	vbv.BufferLocation = vertexBufferGPU->GetGPUVirtualAddress();
-	vbv.StrideInBytes = vertexByteStride;
-	vbv.SizeInBytes = vertexBufferByteSize;
-	return vbv;
+	return GeometryPool::getInstance().getVertexBufferView();
+}
+
+D3D12_INDEX_BUFFER_VIEW SimpleModel::getIndexBufferView(DXGI_FORMAT format) const {
+	return GeometryPool::getInstance().getIndexBufferView(format);
 }
 
-D3D12_INDEX_BUFFER_VIEW SimpleModel::getIndexBufferView() const {
-	D3D12_INDEX_BUFFER_VIEW ibv;
-	ibv.BufferLocation = indexBufferGPU->GetGPUVirtualAddress();
-	ibv.Format = indexFormat;
-	ibv.SizeInBytes = indexBufferByteSize;
-	return ibv;
+UINT SimpleModel::getVertexOffset() const {
+	return GeometryPool::getInstance().getVertexOffset(geometry);
+}
+
+UINT SimpleModel::getIndexOffset() const {
+	return GeometryPool::getInstance().getIndexOffset(geometry);
 }
 
 void SimpleModel::refreshAllTransforms() {
 	for (Mesh& mesh : meshes) {
 		mesh.updateTransform();
-		mesh.submitUpdatesAll();
 	}
-	submitUpdatesAll();
 }
 
 void SimpleModel::refreshBoundingBox() {
@@ -119,11 +269,170 @@ void SimpleModel::processLights(const aiScene* scene) {
 	}
 }
 
-void SimpleModel::processMeshes(const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D12Device5* device) {
+void SimpleModel::processMeshes(const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
 	for (UINT i = 0; i < scene->mNumMeshes; i++) {
-		meshes.push_back(processMesh(scene->mMeshes[i], scene, vertices, indices, device));
+		meshes.push_back(processMesh(scene->mMeshes[i], scene, vertices, indices));
 		meshes.back().parent = this;
 	}
+	if ((!WELD_VERTICES && !OPTIMIZE_MESH_ORDER && MESH_LOD_COUNT < 2) || meshes.empty()) {
+		return;
+	}
+
+	auto job = std::make_shared<MeshProcessJob>();
+	job->model = this;
+	job->vertices = &vertices;
+	job->indices = &indices;
+	job->meshCount = (UINT)meshes.size();
+	job->weldedVertexCounts.resize(job->meshCount);
+	job->statsBefore.resize(job->meshCount);
+	job->statsAfter.resize(job->meshCount);
+	job->lodIndices.resize(job->meshCount);
+	// The thread processing the model takes meshes too, so a ThreadPool that's busy only makes this slower, never stuck.
+	for (UINT i = 1; i < job->meshCount; i++) {
+		ThreadPool::enqueue(new MeshProcessTask(job));
+	}
+	processMeshJob(*job);
+	UINT done = job->meshesDone.load();
+	while (done < job->meshCount) {
+		job->meshesDone.wait(done);
+		done = job->meshesDone.load();
+	}
+
+	// Welding leaves unused vertices at the end of each mesh's range, close the gaps.
+	UINT importedVertices = (UINT)vertices.size();
+	UINT packedVertices = 0;
+	VertexCacheStats statsBefore;
+	VertexCacheStats statsAfter;
+	for (UINT i = 0; i < job->meshCount; i++) {
+		Mesh& mesh = meshes[i];
+		UINT keptVertices = job->weldedVertexCounts[i];
+		if (packedVertices != (UINT)mesh.baseVertexLocation) {
+			std::copy(vertices.begin() + mesh.baseVertexLocation, vertices.begin() + mesh.baseVertexLocation + keptVertices, vertices.begin() + packedVertices);
+		}
+		mesh.baseVertexLocation = packedVertices;
+		mesh.vertexCount = keptVertices;
+		packedVertices += keptVertices;
+		statsBefore.add(job->statsBefore[i]);
+		statsAfter.add(job->statsAfter[i]);
+	}
+	vertices.resize(packedVertices);
+
+	// Levels go after every mesh's full index list, so those stay where the occluders and the geometry hash expect them.
+	std::vector<UINT> lodTriangles(MESH_LOD_COUNT, 0);
+	for (UINT i = 0; i < job->meshCount; i++) {
+		Mesh& mesh = meshes[i];
+		lodTriangles[0] += mesh.indexCount / 3;
+		for (UINT lod = 0; lod < mesh.lods.size(); lod++) {
+			mesh.lods[lod].startIndexLocation += (UINT)indices.size();
+			lodTriangles[lod + 1] += mesh.lods[lod].indexCount / 3;
+		}
+		indices.insert(indices.end(), job->lodIndices[i].begin(), job->lodIndices[i].end());
+	}
+
+	if (!LOG_MODEL_IMPORT_STATS) {
+		return;
+	}
+	if (WELD_VERTICES) {
+		OutputDebugStringA((name + " weld: " + std::to_string(importedVertices) + " -> " + std::to_string(packedVertices) + " vertices ("
+			+ std::to_string(importedVertices ? 100.0f * (importedVertices - packedVertices) / importedVertices : 0.0f) + "% removed)\n").c_str());
+	}
+	if (OPTIMIZE_MESH_ORDER) {
+		OutputDebugStringA((name + " vertex cache: ACMR " + std::to_string(statsBefore.acmr()) + " -> " + std::to_string(statsAfter.acmr())
+			+ ", ATVR " + std::to_string(statsBefore.atvr()) + " -> " + std::to_string(statsAfter.atvr()) + "\n").c_str());
+	}
+	if (MESH_LOD_COUNT > 1) {
+		std::string lodLog = name + " LOD triangles:";
+		for (UINT triangles : lodTriangles) {
+			lodLog += " " + std::to_string(triangles);
+		}
+		OutputDebugStringA((lodLog + "\n").c_str());
+	}
+}
+
+void SimpleModel::processMeshJob(MeshProcessJob& job) {
+	UINT meshIndex;
+	while ((meshIndex = job.nextMesh.fetch_add(1)) < job.meshCount) {
+		job.model->weldAndOptimizeMesh(job, meshIndex);
+		job.model->buildMeshLods(job, meshIndex);
+		if (job.meshesDone.fetch_add(1) + 1 == job.meshCount) {
+			job.meshesDone.notify_all();
+		}
+	}
+}
+
+void SimpleModel::weldAndOptimizeMesh(MeshProcessJob& job, UINT meshIndex) {
+	const Mesh& mesh = meshes[meshIndex];
+	Vertex* meshVertices = job.vertices->data() + mesh.baseVertexLocation;
+	UINT* meshIndices = job.indices->data() + mesh.startIndexLocation;
+	UINT vertexCount = mesh.vertexCount;
+	if (WELD_VERTICES) {
+		WeldTolerance tolerance;
+		tolerance.position = WELD_POSITION_EPSILON;
+		tolerance.normal = WELD_NORMAL_EPSILON;
+		tolerance.tangent = WELD_TANGENT_EPSILON;
+		tolerance.texC = WELD_TEXCOORD_EPSILON;
+		vertexCount = WeldVertices(meshVertices, vertexCount, meshIndices, mesh.indexCount, tolerance);
+	}
+	job.weldedVertexCounts[meshIndex] = vertexCount;
+	if (OPTIMIZE_MESH_ORDER) {
+		// The cache stats are only measured for the log.
+		if (LOG_MODEL_IMPORT_STATS) {
+			job.statsBefore[meshIndex] = AnalyzeVertexCache(meshIndices, mesh.indexCount, vertexCount);
+		}
+		OptimizeMesh(meshVertices, vertexCount, meshIndices, mesh.indexCount);
+		if (LOG_MODEL_IMPORT_STATS) {
+			job.statsAfter[meshIndex] = AnalyzeVertexCache(meshIndices, mesh.indexCount, vertexCount);
+		}
+	}
+}
+
+void SimpleModel::buildMeshLods(MeshProcessJob& job, UINT meshIndex) {
+	Mesh& mesh = meshes[meshIndex];
+	const Vertex* meshVertices = job.vertices->data() + mesh.baseVertexLocation;
+	const UINT* meshIndices = job.indices->data() + mesh.startIndexLocation;
+	const UINT vertexCount = job.weldedVertexCounts[meshIndex];
+	const float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMLoadFloat3(&mesh.boundingBox.Extents)));
+	if (MESH_LOD_COUNT < 2 || radius <= 0.0f || mesh.indexCount < 3) {
+		return;
+	}
+
+	// Scaled by the radius so the weights mean the same thing whatever units the model is in.
+	const bool normals = mesh.typeFlags & MODEL_FORMAT_NORMAL;
+	const bool texCoords = mesh.typeFlags & MODEL_FORMAT_TEXCOORD;
+	const UINT attributeCount = (normals ? 3 : 0) + (texCoords ? 2 : 0);
+	const float normalWeight = MESH_LOD_NORMAL_WEIGHT * radius;
+	const float texCoordWeight = MESH_LOD_TEXCOORD_WEIGHT * radius;
+	std::vector<float> attributes((size_t)vertexCount * attributeCount);
+	for (UINT v = 0; v < vertexCount; v++) {
+		float* vertexAttributes = attributes.data() + (size_t)v * attributeCount;
+		if (normals) {
+			*vertexAttributes++ = meshVertices[v].norm.x * normalWeight;
+			*vertexAttributes++ = meshVertices[v].norm.y * normalWeight;
+			*vertexAttributes++ = meshVertices[v].norm.z * normalWeight;
+		}
+		if (texCoords) {
+			*vertexAttributes++ = meshVertices[v].texC.x * texCoordWeight;
+			*vertexAttributes++ = meshVertices[v].texC.y * texCoordWeight;
+		}
+	}
+	std::vector<bool> locked(vertexCount, false);
+	LockBorderVertices(meshIndices, mesh.indexCount, locked);
+
+	// Simplification picks collapses by cost, not triangle order, so each level can be reordered after the whole chain is built.
+	std::vector<UINT>& lodIndices = job.lodIndices[meshIndex];
+	for (MeshLod& lod : BuildMeshLods(&meshVertices->pos, sizeof(Vertex), vertexCount, meshIndices, mesh.indexCount,
+		MESH_LOD_COUNT - 1, MESH_LOD_REDUCTION, MESH_LOD_MIN_REDUCTION, locked, attributes.data(), attributeCount)) {
+		if (OPTIMIZE_MESH_ORDER) {
+			OptimizeTriangleOrder(meshVertices, vertexCount, lod.indices.data(), (UINT)lod.indices.size());
+		}
+
+		Mesh::Lod level;
+		level.indexCount = (UINT)lod.indices.size();
+		level.startIndexLocation = (UINT)lodIndices.size();
+		level.relativeError = lod.error / radius;
+		mesh.lods.push_back(level);
+		lodIndices.insert(lodIndices.end(), lod.indices.begin(), lod.indices.end());
+	}
 }
 
 void SimpleModel::processNodes(const aiScene* scene) {
@@ -153,8 +462,74 @@ void SimpleModel::processNodes(const aiScene* scene) {
 	this->scene.calculateFullTransform();
 }
 
-Mesh SimpleModel::processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D12Device5* device) {
-	Mesh meshStorage(device);
+void SimpleModel::fillCache(ModelCacheData& cache, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+	for (const aiLight& light : lights) {
+		CachedLight cached;
+		cached.Type = light.mType;
+		cached.Name = cache.addString(light.mName.C_Str());
+		cached.Position = { light.mPosition.x, light.mPosition.y, light.mPosition.z };
+		cached.Direction = { light.mDirection.x, light.mDirection.y, light.mDirection.z };
+		cached.ColorDiffuse = { light.mColorDiffuse.r, light.mColorDiffuse.g, light.mColorDiffuse.b };
+		cached.AngleInnerCone = light.mAngleInnerCone;
+		cached.AttenuationQuadratic = light.mAttenuationQuadratic;
+		cache.lights.push_back(cached);
+	}
+
+	for (const Mesh& mesh : meshes) {
+		CachedMesh cached = {};
+		cached.TypeFlags = mesh.typeFlags;
+		cached.IndexCount = mesh.indexCount;
+		cached.VertexCount = mesh.vertexCount;
+		cached.StartIndexLocation = mesh.startIndexLocation;
+		cached.BaseVertexLocation = mesh.baseVertexLocation;
+		cached.FirstLod = (UINT32)cache.lods.size();
+		cached.LodCount = (UINT32)mesh.lods.size();
+		cached.BoundsCenter = mesh.boundingBox.Center;
+		cached.BoundsExtents = mesh.boundingBox.Extents;
+		for (UINT i = 0; i < CACHED_TEXTURE_COUNT; i++) {
+			auto texture = mesh.textures.find((MODEL_FORMAT)(MODEL_FORMAT_DIFFUSE_TEX << i));
+			if (texture != mesh.textures.end() && texture->second) {
+				cached.Textures[i] = cache.addString(texture->second->Filename);
+			}
+			else {
+				cached.TypeFlags &= ~(MODEL_FORMAT_DIFFUSE_TEX << i);
+			}
+		}
+		for (const Mesh::Lod& lod : mesh.lods) {
+			cache.lods.push_back({ lod.indexCount, lod.startIndexLocation, lod.relativeError });
+		}
+		cache.meshes.push_back(cached);
+	}
+
+	// Same breadth first order processNodes built the tree in.
+	std::vector<const SceneNode*> nodes = { &this->scene };
+	std::unordered_map<const SceneNode*, UINT32> nodeIndices = { { &this->scene, 0 } };
+	cache.nodes.push_back({ UINT32(-1), cache.addString(this->scene.name), this->scene.transform, 0, 0 });
+	for (UINT32 i = 0; i < nodes.size(); i++) {
+		for (const auto& child : nodes[i]->getChildren()) {
+			nodeIndices[child.get()] = (UINT32)nodes.size();
+			nodes.push_back(child.get());
+			cache.nodes.push_back({ i, cache.addString(child->name), child->transform, 0, 0 });
+		}
+	}
+	std::vector<std::vector<UINT32>> nodeMeshes(nodes.size());
+	for (UINT32 i = 0; i < meshes.size(); i++) {
+		for (const SceneNode* node : meshes[i].getInstanceNodes()) {
+			nodeMeshes[nodeIndices[node]].push_back(i);
+		}
+	}
+	for (UINT32 i = 0; i < nodes.size(); i++) {
+		cache.nodes[i].FirstMesh = (UINT32)cache.nodeMeshes.size();
+		cache.nodes[i].MeshCount = (UINT32)nodeMeshes[i].size();
+		cache.nodeMeshes.insert(cache.nodeMeshes.end(), nodeMeshes[i].begin(), nodeMeshes[i].end());
+	}
+
+	cache.vertices = vertices;
+	cache.indices.assign(indices.begin(), indices.end());
+}
+
+Mesh SimpleModel::processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	Mesh meshStorage;
 
 	DirectX::XMFLOAT3 minPoint = { std::numeric_limits<FLOAT>::max(),
 							 std::numeric_limits<FLOAT>::max(),
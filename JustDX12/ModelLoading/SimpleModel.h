@@ -6,9 +6,13 @@
 #include <assimp\scene.h>
 #include <DirectXCollision.h>
 #include <limits>
+#include <atomic>
 #include "SceneNode.h"
 
 #include "ModelLoading\Model.h"
+#include "GeometryPool.h"
+#include "ModelLoading\MeshOptimizer.h"
+#include "ModelLoading\ModelCache.h"
 
 class DX12Texture;
 
@@ -17,19 +21,38 @@ class DX12Texture;
 // Safe to delete, since Index/Vertex resources get dumped into ResourceDecay on deletion
 class SimpleModel : public Model {
 public:
-	SimpleModel(std::string name, std::string dir, ID3D12Device5* device, bool usesRT = false);
+	SimpleModel(std::string name, std::string dir, bool usesRT = false);
 	~SimpleModel();
 
-	void setup(DX12TaskQueueThread* thread, aiNode* node, const aiScene* scene);
+	// CPU side of loading, safe to run for several models at once since it records nothing. Leaves the packed geometry for recordUpload.
+	// 'cache' gets everything processCache needs to skip the import next time, if given.
+	void process(const aiScene* scene, ModelCacheData* cache = nullptr);
+	// Same result as the process that wrote 'cache', it's only read during the call.
+	void processCache(const ModelCacheView& cache);
+	// Vertices and 32 bit index words recordUpload will take from the GeometryPool, for GeometryPool::reserve.
+	std::pair<UINT, UINT> getPendingGeometrySize() const;
+	// Records the GeometryPool upload of what process left on 'cmdList', the returned buffer has to live until the list has executed.
+	Microsoft::WRL::ComPtr<ID3D12Resource> recordUpload(ID3D12GraphicsCommandList* cmdList);
+	// For geometry that didn't come from assimp, 'meshes' has to be filled in already with ranges into 'vertices' and 'indices'.
+	// Every mesh gets a single instance on the root node, nothing is welded, optimized or simplified.
+	void setupFromGeometry(DX12TaskQueueThread* thread, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
 
 	bool allTexturesLoaded();
 
+	// Views of the whole GeometryPool, mesh locations have to be offset by getVertexOffset/getIndexOffset.
 	D3D12_VERTEX_BUFFER_VIEW getVertexBufferView()const;
-	D3D12_INDEX_BUFFER_VIEW getIndexBufferView()const;
+	// Pass the mesh's indexFormat, see Mesh::getPoolStartIndexLocation.
+	D3D12_INDEX_BUFFER_VIEW getIndexBufferView(DXGI_FORMAT format)const;
+	UINT getVertexOffset()const;
+	UINT getIndexOffset()const;
 
 	void refreshAllTransforms();
 	void refreshBoundingBox();
 
+	const DirectX::BoundingBox& getLocalBoundingBox() const override {
+		return boundingBox;
+	}
+
 	std::vector<aiLight> lights;
 	std::vector<Mesh> meshes;
 	SceneNode scene;
@@ -38,24 +61,55 @@ public:
 	unsigned int indexCount;
 
 	unsigned int vertexByteStride;
-	unsigned int vertexBufferByteSize;
-	unsigned int indexBufferByteSize;
 	DXGI_FORMAT vertexFormat;
-	DXGI_FORMAT indexFormat;
 
 	DirectX::BoundingBox boundingBox;
 
-	// TODO: Redundant, but needed for RT. Should replace this later.
-	std::unique_ptr<DX12Resource> vertexBuffer;
-	std::unique_ptr<DX12Resource> indexBuffer;
+	// Block holding the model's vertices and indices in the GeometryPool.
+	GeometryHandle geometry = INVALID_GEOMETRY_HANDLE;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBufferGPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> indexBufferGPU = nullptr;
+	// CPU copies of the geometry, so meshes can be rasterized as occluders by SoftwareOcclusion.
+	std::vector<DirectX::XMFLOAT3> occluderPositions;
+	std::vector<UINT> occluderIndices;
 
 private:
+	// Shared between the thread processing the model and the ThreadPool tasks helping it weld and optimize meshes,
+	// tasks that only start after every mesh was claimed never touch the model or the vectors it points to.
+	struct MeshProcessJob {
+		SimpleModel* model;
+		std::vector<Vertex>* vertices;
+		std::vector<unsigned int>* indices;
+		UINT meshCount = 0;
+		// Per mesh, so nothing is shared between the threads.
+		std::vector<UINT> weldedVertexCounts;
+		std::vector<VertexCacheStats> statsBefore;
+		std::vector<VertexCacheStats> statsAfter;
+		// Every Mesh::Lod's indices, which start relative to the mesh's list until they're appended to the model's.
+		std::vector<std::vector<UINT>> lodIndices;
+		std::atomic<UINT> nextMesh = 0;
+		std::atomic<UINT> meshesDone = 0;
+	};
+	friend class MeshProcessTask;
+
+	// Shared end of every setup: hashes the meshes and packs the geometry into pendingVertices and pendingIndices.
+	void prepareGeometry(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	static void processMeshJob(MeshProcessJob& job);
+	// Welds and optimizes the mesh in place, the vertices it no longer uses are left at the end of its range.
+	void weldAndOptimizeMesh(MeshProcessJob& job, UINT meshIndex);
+	// Simplifies the welded mesh into up to MESH_LOD_COUNT - 1 coarser index lists, keeping its open edges and seams in place.
+	void buildMeshLods(MeshProcessJob& job, UINT meshIndex);
 	void processLights(const aiScene* scene);
-	void processMeshes(const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D12Device5* device);
+	void processMeshes(const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
 	void processNodes(const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D12Device5* device);
+	void fillCache(ModelCacheData& cache, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+	Mesh processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// Sets every mesh's position quantization and packs its vertices, checking the error against its bounds in debug builds.
+	std::vector<CompactVertex> compressVertices(const std::vector<Vertex>& vertices);
+	// Sets every mesh's (and level's) indexFormat and poolIndexLocation and packs its indices into the GeometryPool's layout.
+	std::vector<BYTE> packIndices(const std::vector<unsigned int>& indices);
 	std::shared_ptr<DX12Texture> loadMaterialTexture(aiMaterial* mat, aiTextureType type);
+
+	// Packed by prepareGeometry, emptied once recordUpload hands them to the GeometryPool.
+	std::vector<GpuVertex> pendingVertices;
+	std::vector<BYTE> pendingIndices;
 };
\ No newline at end of file
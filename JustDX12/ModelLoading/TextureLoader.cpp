@@ -20,10 +20,12 @@ TextureLoader& TextureLoader::getInstance() {
 }
 
 void TextureLoader::destroyAll() {
+	std::lock_guard<std::mutex> lk(cacheLock);
 	textureCache.clear();
 }
 
 std::shared_ptr<DX12Texture> TextureLoader::deferLoad(std::string fileName, std::string dir) {
+	std::lock_guard<std::mutex> lk(cacheLock);
 	auto cached = textureCache.find(fileName);
 	if (cached != textureCache.end()) {
 		if (auto tex = cached->second.lock()) {
@@ -33,7 +35,6 @@ std::shared_ptr<DX12Texture> TextureLoader::deferLoad(std::string fileName, std:
 			textureCache.erase(cached);
 		}
 	}
-	// Can't cause race condition because we only call from one thread.
 	auto t = std::make_shared<DX12Texture>();
 	t->Filename = fileName;
 	t->dir = dir;
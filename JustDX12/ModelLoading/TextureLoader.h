@@ -1,5 +1,6 @@
 #pragma once
 #include <unordered_map>
+#include <mutex>
 
 #include "Texture.h"
 #include "ModelLoading\Mesh.h"
@@ -18,6 +19,7 @@ public:
 	void destroyAll();
 
 	// Returns pointer to texture, returnedValue->resource will remain nullptr until texture has completed loading
+	// Safe to call from any thread, SimpleModels processing in parallel all request their textures through this.
 	std::shared_ptr<DX12Texture> deferLoad(std::string fileName, std::string dir = "..\\Models\\");
 	// Will be made private once TextureLoadTask is integrated into this class
 	void loadTexture(DX12Texture* tex);
@@ -26,6 +28,7 @@ public:
 private:
 	UINT usageIndex = 0;
 	std::array<UINT, CPU_FRAME_COUNT> fenceValueForWait = { 0 };
+	std::mutex cacheLock;
 	std::unordered_map<std::string, std::weak_ptr<DX12Texture>> textureCache;
 };
 
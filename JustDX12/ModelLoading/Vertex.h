@@ -0,0 +1,45 @@
+#pragma once
+#ifdef _WIN32
+#include <Windows.h>
+#include <DirectXMath.h>
+#else
+// Just the types the vertex formats use, so vertex compression can be built and checked off Windows too.
+#include <cstdint>
+typedef std::int16_t INT16;
+typedef std::uint16_t UINT16;
+typedef std::uint32_t UINT32;
+typedef unsigned int UINT;
+
+// DirectXMath only comes with the Windows SDK, the vertices only store its types.
+namespace DirectX {
+	struct XMFLOAT2 {
+		float x;
+		float y;
+	};
+	struct XMFLOAT3 {
+		float x;
+		float y;
+		float z;
+	};
+}
+#endif
+
+struct Vertex {
+	DirectX::XMFLOAT2 texC;
+	DirectX::XMFLOAT3 pos;
+	DirectX::XMFLOAT3 norm;
+	DirectX::XMFLOAT3 tan;
+	DirectX::XMFLOAT3 biTan;
+};
+
+// 20 byte version of Vertex used in the GeometryPool when COMPACT_VERTICES is defined, built by CompressVertex.
+// Bitangents aren't stored, the shader rebuilds them from the normal, tangent and sign.
+struct CompactVertex {
+	// SNORM16 position inside the mesh's bounds (see Mesh::positionOffset), w is the bitangent's sign.
+	INT16 pos[4];
+	// Octahedral encoded unit vectors, SNORM16.
+	INT16 norm[2];
+	INT16 tan[2];
+	// Half floats.
+	UINT16 texC[2];
+};
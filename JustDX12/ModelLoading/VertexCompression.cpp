@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+#include "ModelLoading/VertexCompression.h"
+
+#define SNORM16_MAX 32767.0f
+#define HALF_MAX 65504.0f
+// Worst distance between a unit vector and its 16 bit octahedral encoding, from a dense sweep of the sphere plus some headroom.
+#define OCTAHEDRAL_ERROR_BOUND 5e-5f
+
+static float length(const DirectX::XMFLOAT3& v) {
+	return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+}
+
+static float distance(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return length({ a.x - b.x, a.y - b.y, a.z - b.z });
+}
+
+static DirectX::XMFLOAT3 cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// False (and 'v' untouched) for vectors that can't be normalized, assimp leaves those behind for tangents of meshes without UVs.
+static bool normalize(DirectX::XMFLOAT3& v) {
+	float len = length(v);
+	if (!(len > 0.0f) || !std::isfinite(len)) {
+		return false;
+	}
+	v = { v.x / len, v.y / len, v.z / len };
+	return true;
+}
+
+static INT16 quantizeSnorm16(float value) {
+	return (INT16)std::lround(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX);
+}
+
+// Matches the GPU's SNORM conversion, -32768 and -32767 both become -1.
+static float dequantizeSnorm16(INT16 value) {
+	return std::max((float)value / SNORM16_MAX, -1.0f);
+}
+
+static float signNotZero(float value) {
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static DirectX::XMFLOAT3 octDecode(INT16 x, INT16 y) {
+	DirectX::XMFLOAT3 v = { dequantizeSnorm16(x), dequantizeSnorm16(y), 0.0f };
+	v.z = 1.0f - std::abs(v.x) - std::abs(v.y);
+	float t = std::max(-v.z, 0.0f);
+	v.x += v.x >= 0.0f ? -t : t;
+	v.y += v.y >= 0.0f ? -t : t;
+	normalize(v);
+	return v;
+}
+
+// Projects the unit vector onto the octahedron and folds the lower half over the upper. Instead of rounding,
+// all 4 quantized points around the result are decoded and the closest is kept, which roughly halves the error.
+static void octEncode(const DirectX::XMFLOAT3& n, INT16 out[2]) {
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	float x = n.x / l1;
+	float y = n.y / l1;
+	if (n.z < 0.0f) {
+		float foldedX = (1.0f - std::abs(y)) * signNotZero(x);
+		y = (1.0f - std::abs(x)) * signNotZero(y);
+		x = foldedX;
+	}
+	float floorX = std::floor(std::clamp(x, -1.0f, 1.0f) * SNORM16_MAX);
+	float floorY = std::floor(std::clamp(y, -1.0f, 1.0f) * SNORM16_MAX);
+	float bestDistance = FLT_MAX;
+	for (int dx = 0; dx < 2; dx++) {
+		for (int dy = 0; dy < 2; dy++) {
+			INT16 qx = (INT16)std::clamp(floorX + dx, -SNORM16_MAX, SNORM16_MAX);
+			INT16 qy = (INT16)std::clamp(floorY + dy, -SNORM16_MAX, SNORM16_MAX);
+			float d = distance(octDecode(qx, qy), n);
+			if (d < bestDistance) {
+				bestDistance = d;
+				out[0] = qx;
+				out[1] = qy;
+			}
+		}
+	}
+}
+
+// IEEE half with round to nearest even, what the GPU's R16G16_FLOAT read expects. Kept here instead of DirectXPackedVector
+// so the conversion is the same (and checked) everywhere. Magnitudes past HALF_MAX become infinity.
+static UINT16 floatToHalf(float value) {
+	UINT32 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const UINT16 sign = (UINT16)((bits >> 16) & 0x8000);
+	const UINT32 magnitude = bits & 0x7fffffff;
+	if (magnitude > 0x7f800000) {
+		return (UINT16)(sign | 0x7e00);
+	}
+	// Rounds up past HALF_MAX, and infinity itself.
+	if (magnitude >= 0x477ff000) {
+		return (UINT16)(sign | 0x7c00);
+	}
+	// Under the smallest normal half, a multiple of 2^-24. The default rounding mode is to nearest even.
+	if (magnitude < 0x38800000) {
+		float scaled;
+		std::memcpy(&scaled, &magnitude, sizeof(scaled));
+		return (UINT16)(sign | (UINT16)std::nearbyint(scaled * 16777216.0f));
+	}
+	// Rebias the exponent and round off the 13 mantissa bits a half doesn't have, a carry moves into the exponent as it should.
+	return (UINT16)(sign | ((magnitude - 0x38000000 + 0xfff + ((magnitude >> 13) & 1)) >> 13));
+}
+
+static float halfToFloat(UINT16 half) {
+	const UINT32 sign = (UINT32)(half & 0x8000) << 16;
+	const UINT32 exponent = (half >> 10) & 0x1f;
+	const UINT32 mantissa = half & 0x3ff;
+	UINT32 bits;
+	if (exponent == 0) {
+		float value = std::ldexp((float)mantissa, -24);
+		std::memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 0x1f) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+bool VertexCompressionError::within(const VertexCompressionError& bound) const {
+	return position <= bound.position && normal <= bound.normal && tangent <= bound.tangent && texC <= bound.texC;
+}
+
+void SetPositionQuantization(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, DirectX::XMFLOAT3& positionOffset, DirectX::XMFLOAT3& positionScale) {
+	// Flat (or empty) axes quantize everything to 0, any scale works as long as it isn't 0.
+	auto axisScale = [](float extent) { return extent > 0.0f && std::isfinite(extent) ? extent : 1.0f; };
+	auto axisOffset = [](float value) { return std::isfinite(value) ? value : 0.0f; };
+	positionOffset = { axisOffset(center.x), axisOffset(center.y), axisOffset(center.z) };
+	positionScale = { axisScale(extents.x), axisScale(extents.y), axisScale(extents.z) };
+}
+
+CompactVertex CompressVertex(const Vertex& vertex, const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale) {
+	CompactVertex compact;
+	compact.pos[0] = quantizeSnorm16((vertex.pos.x - positionOffset.x) / positionScale.x);
+	compact.pos[1] = quantizeSnorm16((vertex.pos.y - positionOffset.y) / positionScale.y);
+	compact.pos[2] = quantizeSnorm16((vertex.pos.z - positionOffset.z) / positionScale.z);
+
+	DirectX::XMFLOAT3 normal = vertex.norm;
+	if (!normalize(normal)) {
+		normal = { 0.0f, 0.0f, 1.0f };
+	}
+	DirectX::XMFLOAT3 tangent = vertex.tan;
+	if (!normalize(tangent)) {
+		tangent = { 1.0f, 0.0f, 0.0f };
+	}
+	octEncode(normal, compact.norm);
+	octEncode(tangent, compact.tan);
+	DirectX::XMFLOAT3 rebuiltBiTan = cross(normal, tangent);
+	float handedness = rebuiltBiTan.x * vertex.biTan.x + rebuiltBiTan.y * vertex.biTan.y + rebuiltBiTan.z * vertex.biTan.z;
+	compact.pos[3] = handedness < 0.0f ? (INT16)-SNORM16_MAX : (INT16)SNORM16_MAX;
+
+	compact.texC[0] = floatToHalf(std::clamp(vertex.texC.x, -HALF_MAX, HALF_MAX));
+	compact.texC[1] = floatToHalf(std::clamp(vertex.texC.y, -HALF_MAX, HALF_MAX));
+	return compact;
+}
+
+Vertex DecompressVertex(const CompactVertex& vertex, const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale) {
+	Vertex decoded;
+	decoded.pos.x = positionOffset.x + dequantizeSnorm16(vertex.pos[0]) * positionScale.x;
+	decoded.pos.y = positionOffset.y + dequantizeSnorm16(vertex.pos[1]) * positionScale.y;
+	decoded.pos.z = positionOffset.z + dequantizeSnorm16(vertex.pos[2]) * positionScale.z;
+	decoded.norm = octDecode(vertex.norm[0], vertex.norm[1]);
+	decoded.tan = octDecode(vertex.tan[0], vertex.tan[1]);
+	DirectX::XMFLOAT3 biTan = cross(decoded.norm, decoded.tan);
+	float handedness = dequantizeSnorm16(vertex.pos[3]);
+	decoded.biTan = { biTan.x * handedness, biTan.y * handedness, biTan.z * handedness };
+	decoded.texC.x = halfToFloat(vertex.texC[0]);
+	decoded.texC.y = halfToFloat(vertex.texC[1]);
+	return decoded;
+}
+
+VertexCompressionError MeasureCompressionError(const Vertex* vertices, const CompactVertex* compressed, UINT count,
+	const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale) {
+	VertexCompressionError error;
+	for (UINT i = 0; i < count; i++) {
+		const Vertex& original = vertices[i];
+		Vertex decoded = DecompressVertex(compressed[i], positionOffset, positionScale);
+		error.position = std::max(error.position, distance(original.pos, decoded.pos));
+		// Vectors that couldn't be normalized were replaced, there's nothing to compare them to.
+		DirectX::XMFLOAT3 normal = original.norm;
+		if (normalize(normal)) {
+			error.normal = std::max(error.normal, distance(normal, decoded.norm));
+		}
+		DirectX::XMFLOAT3 tangent = original.tan;
+		if (normalize(tangent)) {
+			error.tangent = std::max(error.tangent, distance(tangent, decoded.tan));
+		}
+		error.texC = std::max(error.texC, std::abs(original.texC.x - decoded.texC.x));
+		error.texC = std::max(error.texC, std::abs(original.texC.y - decoded.texC.y));
+	}
+	return error;
+}
+
+VertexCompressionError CompressionErrorBound(const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale, float maxTexC) {
+	VertexCompressionError bound;
+	// Half a quantization step per axis, plus float rounding in the offset + pos * scale reconstruction.
+	bound.position = length(positionScale) / (2.0f * SNORM16_MAX) + 4.0f * FLT_EPSILON * (length(positionOffset) + length(positionScale));
+	bound.normal = OCTAHEDRAL_ERROR_BOUND;
+	bound.tangent = OCTAHEDRAL_ERROR_BOUND;
+	// Halfs round to 11 significant bits, anything past HALF_MAX was clamped.
+	bound.texC = maxTexC * std::ldexp(1.0f, -11) + std::ldexp(1.0f, -25) + std::max(maxTexC - HALF_MAX, 0.0f);
+	return bound;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "ModelLoading/Vertex.h"
+
+// Largest round trip error of each attribute over a set of vertices.
+// Positions are in model units, unit vectors are the distance between the original (normalized) and decoded vector,
+// texture coordinates are per component.
+struct VertexCompressionError {
+	float position = 0.0f;
+	float normal = 0.0f;
+	float tangent = 0.0f;
+	float texC = 0.0f;
+
+	bool within(const VertexCompressionError& bound) const;
+};
+
+// Fits a mesh's positionOffset and positionScale to its bounding box.
+void SetPositionQuantization(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, DirectX::XMFLOAT3& positionOffset, DirectX::XMFLOAT3& positionScale);
+CompactVertex CompressVertex(const Vertex& vertex, const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale);
+// Rebuilds the bitangent from the normal, tangent and sign the same way the shaders do.
+Vertex DecompressVertex(const CompactVertex& vertex, const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale);
+
+VertexCompressionError MeasureCompressionError(const Vertex* vertices, const CompactVertex* compressed, UINT count,
+	const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale);
+// Worst case error the encoding allows, 'maxTexC' is the largest texture coordinate magnitude being compressed.
+VertexCompressionError CompressionErrorBound(const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale, float maxTexC);
@@ -1,7 +1,9 @@
 #include "ModelRenderPipelineStage.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "ModelLoading\SimpleModel.h"
-#include <ResourceDecay.h>
 
 ModelRenderPipelineStage::ModelRenderPipelineStage(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice, RenderPipelineDesc renderDesc, D3D12_VIEWPORT viewport, D3D12_RECT scissorRect)
 	: RenderPipelineStage(d3dDevice, renderDesc, viewport, scissorRect) {
@@ -11,83 +13,44 @@ ModelRenderPipelineStage::ModelRenderPipelineStage(Microsoft::WRL::ComPtr<ID3D12
 ModelRenderPipelineStage::~ModelRenderPipelineStage() {
 }
 
-void ModelRenderPipelineStage::buildPSO() {
-	RenderPipelineStage::buildPSO();
-
-	if (renderStageDesc.supportsCulling) {
-		// Setting up second PSO for predication occlusion.
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC occlusionPSODesc;
-		ZeroMemory(&occlusionPSODesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-		occlusionPSODesc.pRootSignature = rootSignature.Get();
-		occlusionPSODesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-		occlusionPSODesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-		occlusionPSODesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-		occlusionPSODesc.DepthStencilState.DepthEnable = renderStageDesc.usesDepthTex;
-		occlusionPSODesc.SampleMask = UINT_MAX;
-		occlusionPSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		occlusionPSODesc.NumRenderTargets = (UINT)renderStageDesc.renderTargets.size();
-		for (int i = 0; i < renderStageDesc.renderTargets.size(); i++) {
-			occlusionPSODesc.RTVFormats[i] = descriptorManager.getDescriptor(IndexedName(renderStageDesc.renderTargets[i].descriptorName, 0), DESCRIPTOR_TYPE_RTV)->resourceTarget->getFormat();
-			occlusionPSODesc.BlendState.RenderTarget[i].RenderTargetWriteMask = 0;
-		}
-		occlusionPSODesc.SampleDesc.Count = 1;
-		occlusionPSODesc.SampleDesc.Quality = 0;
-		occlusionPSODesc.DSVFormat = renderStageDesc.usesDepthTex ? DEPTH_TEXTURE_DSV_FORMAT : DXGI_FORMAT_UNKNOWN;
-		occlusionPSODesc.InputLayout = { occlusionInputLayout.data(),(UINT)occlusionInputLayout.size() };
-		occlusionPSODesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-		occlusionPSODesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-		occlusionPSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
-
-		// Need a different set of shaders
-		occlusionVS = compileShader(L"..\\Shaders\\BoundingBox.hlsl", {}, L"VS", getCompileTargetFromType(SHADER_TYPE_VS));
-		occlusionGS = compileShader(L"..\\Shaders\\BoundingBox.hlsl", {}, L"GS", getCompileTargetFromType(SHADER_TYPE_GS));
-		occlusionPS = compileShader(L"..\\Shaders\\BoundingBox.hlsl", {}, L"PS", getCompileTargetFromType(SHADER_TYPE_PS));
-		occlusionPSODesc.VS.pShaderBytecode = occlusionVS->GetBufferPointer();
-		occlusionPSODesc.VS.BytecodeLength = occlusionVS->GetBufferSize();
-		occlusionPSODesc.GS.pShaderBytecode = occlusionGS->GetBufferPointer();
-		occlusionPSODesc.GS.BytecodeLength = occlusionGS->GetBufferSize();
-		occlusionPSODesc.PS = { 0 };
-		occlusionPSODesc.PS.pShaderBytecode = occlusionPS->GetBufferPointer();
-		occlusionPSODesc.PS.BytecodeLength = occlusionPS->GetBufferSize();
-		if (FAILED(md3dDevice->CreateGraphicsPipelineState(&occlusionPSODesc, IID_PPV_ARGS(&occlusionPSO)))) {
-			OutputDebugStringA("Occlusion PSO Setup Failed\n");
-			throw "PSO FAIL";
-		}
-	}
-}
-
-void ModelRenderPipelineStage::buildInputLayout() {
-	RenderPipelineStage::buildInputLayout();
-	occlusionInputLayout = {
-		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0 , 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA}
-	};
+// Layout of VertexDequantize in Common.hlsl.
+static void getVertexDequantize(const Mesh& mesh, float vertexDequantize[8]) {
+	vertexDequantize[0] = mesh.positionOffset.x;
+	vertexDequantize[1] = mesh.positionOffset.y;
+	vertexDequantize[2] = mesh.positionOffset.z;
+	vertexDequantize[3] = 0.0f;
+	vertexDequantize[4] = mesh.positionScale.x;
+	vertexDequantize[5] = mesh.positionScale.y;
+	vertexDequantize[6] = mesh.positionScale.z;
+	vertexDequantize[7] = 0.0f;
 }
 
-void ModelRenderPipelineStage::buildQueryHeap() {
-	if (renderStageDesc.supportsCulling) {
-		// Due to the occlusion query being used from the previous frame it has a lifetime of 1 more than other resources.
-		ResourceDecay::destroyAfterSpecificDelay(occlusionQueryResultBuffer, CPU_FRAME_COUNT + 1);
-		ResourceDecay::destroyAfterSpecificDelay(occlusionQueryHeap, CPU_FRAME_COUNT + 1);
-		occlusionQueryResultBuffer.Reset();
-		occlusionQueryHeap.Reset();
-
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer((renderObjects.size()) * 8);
-		md3dDevice->CreateCommittedResource(&gDefaultHeapDesc,
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_PREDICATION,
-			nullptr,
-			IID_PPV_ARGS(&occlusionQueryResultBuffer));
-		D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
-		queryHeapDesc.NodeMask = 0;
-		queryHeapDesc.Count = (UINT)renderObjects.size();
-		queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_OCCLUSION;
-		md3dDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&occlusionQueryHeap));
-
-		SetName(occlusionQueryResultBuffer.Get(), L"Occlusion Query Result");
-		SetName(occlusionQueryHeap.Get(), L"Occlusion Query Heap");
+void ModelRenderPipelineStage::setup(PipeLineStageDesc stageDesc) {
+	RenderPipelineStage::setup(stageDesc);
+	groupTransforms = std::make_unique<DX12StructuredBuffer>((UINT)sizeof(DirectX::XMFLOAT4X4A), INITIAL_INSTANCE_GROUP_CAPACITY, md3dDevice.Get());
+	// The argument stream sets every per draw root parameter, stages missing one of them or binding
+	// per object descriptors just keep recording draws directly.
+	if (renderStageDesc.perObjTransformCBSlot < 0 || renderStageDesc.perMeshTransformCBSlot < 0
+		|| renderStageDesc.perMeshTextureSlot < 0 || renderStageDesc.instanceCountSlot < 0
+		|| !rootParameterDescs[DESCRIPTOR_USAGE_PER_OBJECT].empty()) {
+		return;
 	}
+#ifdef COMPACT_VERTICES
+	if (renderStageDesc.vertexDequantizeSlot < 0) {
+		return;
+	}
+#endif
+	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> argumentDescs = GetIndirectArgumentDescs(renderStageDesc.perObjTransformCBSlot,
+		renderStageDesc.perMeshTransformCBSlot, renderStageDesc.instanceCountSlot, renderStageDesc.vertexDequantizeSlot);
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(IndirectDrawCommand);
+	signatureDesc.NumArgumentDescs = (UINT)argumentDescs.size();
+	signatureDesc.pArgumentDescs = argumentDescs.data();
+	if (FAILED(md3dDevice->CreateCommandSignature(&signatureDesc, rootSignature.Get(), IID_PPV_ARGS(&commandSignature)))) {
+		OutputDebugStringA("Indirect Draw Command Signature Setup Failed");
+		throw "Command Signature FAIL";
+	}
+	indirectArguments = std::make_unique<DX12StructuredBuffer>((UINT)sizeof(IndirectDrawCommand), INITIAL_INDIRECT_DRAW_CAPACITY, md3dDevice.Get());
 }
 
 void ModelRenderPipelineStage::processModel(std::weak_ptr<Model> model) {
@@ -96,12 +59,31 @@ void ModelRenderPipelineStage::processModel(std::weak_ptr<Model> model) {
 		// this only gets run once per object per time loaded anyway.
 		if (auto basicModel = dynamic_pointer_cast<SimpleModel>(ptr)) {
 			for (auto& mesh : basicModel->meshes) {
-				auto meshDescriptors = descriptorManager.makeDescriptors(buildMeshTexturesDescriptorJobs(&mesh),
-					&resourceManager, &constantBufferManager, false);
+				// Meshes with the same textures share one table, so sorted draws can skip rebinding it.
+				std::vector<DX12Texture*> textureKey;
+				for (const auto& texMap : renderStageDesc.textureToDescriptor) {
+					textureKey.push_back((mesh.typeFlags & texMap.first) != 0 ? mesh.textures.at(texMap.first).get() : nullptr);
+				}
+				TextureTable& table = textureTables[textureKey];
+				bool expired = table.descriptors.empty();
+				for (const auto& texture : table.textures) {
+					expired |= texture.expired();
+				}
+				if (expired) {
+					table.textures.clear();
+					for (const auto& texMap : renderStageDesc.textureToDescriptor) {
+						if ((mesh.typeFlags & texMap.first) != 0) {
+							table.textures.push_back(mesh.textures.at(texMap.first));
+						}
+					}
+					table.descriptors = descriptorManager.makeDescriptors(buildMeshTexturesDescriptorJobs(&mesh),
+						&resourceManager, &constantBufferManager, false);
+				}
 				// Register the descriptors to easily fetch them later
-				mesh.registerPipelineStage(this, meshDescriptors);
+				mesh.registerPipelineStage(this, table.descriptors);
 			}
 			renderObjects.push_back(basicModel);
+			visibilityCache.addModel();
 		}
 	}
 }
@@ -109,158 +91,487 @@ void ModelRenderPipelineStage::processModel(std::weak_ptr<Model> model) {
 void ModelRenderPipelineStage::draw() {
 	drawModels();
 
-	bool modelAmountChanged = processNewModels();
-
-	// TODO: either reintegrate these code sections or pull out into a seperate culling stage (preferable)
-	if (false && modelAmountChanged && renderStageDesc.supportsCulling) {
-		setupOcclusionBoundingBoxes();
-		buildQueryHeap();
-	}
-
-	if (false && renderStageDesc.supportsCulling && occlusionCull) {
-		drawOcclusionQuery();
-	}
+	processNewModels();
 }
 
 void ModelRenderPipelineStage::drawModels() {
 	PIXScopedEvent(mCommandList.Get(), PIX_COLOR(0, 255, 0), "Draw Calls");
-	int modelIndex = 0;
 	if (renderStageDesc.supportsVRS && VRS && (vrsSupport.VariableShadingRateTier == D3D12_VARIABLE_SHADING_RATE_TIER_2)) {
 		D3D12_SHADING_RATE_COMBINER combiners[2] = { D3D12_SHADING_RATE_COMBINER_OVERRIDE, D3D12_SHADING_RATE_COMBINER_OVERRIDE };
 		mCommandList->RSSetShadingRate(D3D12_SHADING_RATE_1X1, combiners);
 		mCommandList->RSSetShadingRateImage(resourceManager.getResource(renderStageDesc.VrsTextureName)->get());
 	}
+	buildCullBatch();
+
+	std::chrono::high_resolution_clock::time_point startRecordTime = std::chrono::high_resolution_clock::now();
+	buildDrawList();
+	DrawStats stats = {};
+	mCommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (indirectDraws && commandSignature) {
+		recordIndirectDraws(stats);
+	}
+	else {
+		recordDraws(stats);
+	}
+	drawModelRefs.clear();
+
+	std::chrono::duration<double, std::milli> recordTime = std::chrono::high_resolution_clock::now() - startRecordTime;
+	stats.recordTime = (float)recordTime.count();
+	drawStats = stats;
+}
+
+void ModelRenderPipelineStage::recordDraws(DrawStats& stats) {
+	const bool perDrawShadingRate = VRS && (vrsSupport.VariableShadingRateTier == D3D12_VARIABLE_SHADING_RATE_TIER_1);
+	// Only state that differs from the previous draw gets set, sorting makes that most of it.
+	// All geometry is in the GeometryPool, so the vertex buffer only gets bound once,
+	// and the index buffer once per change between 16 and 32 bit meshes.
+	DrawBindState bound;
+	if (!drawOrder.empty()) {
+		auto vertexBufferView = GeometryPool::getInstance().getVertexBufferView();
+		mCommandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+	}
+	for (const auto& sorted : drawOrder) {
+		const DrawItem& draw = draws[sorted.value];
+		const Mesh& m = *draw.mesh;
+		UINT instanceCount = draw.model->getInstanceCount() * m.getInstanceCount();
+		if (draw.groupTransformOffset != NOT_GROUPED) {
+			bindDescriptorsToRoot(DESCRIPTOR_USAGE_PER_OBJECT, draw.modelIndex);
+			D3D12_GPU_VIRTUAL_ADDRESS transforms = groupTransforms->get(gFrameIndex)->GetGPUVirtualAddress();
+			if (renderStageDesc.perObjTransformCBSlot > -1) {
+				mCommandList->SetGraphicsRootShaderResourceView(renderStageDesc.perObjTransformCBSlot,
+					transforms + sizeof(DirectX::XMFLOAT4X4A) * (UINT64)draw.groupTransformOffset);
+			}
+			if (renderStageDesc.perMeshTransformCBSlot > -1) {
+				mCommandList->SetGraphicsRootShaderResourceView(renderStageDesc.perMeshTransformCBSlot, transforms);
+			}
+			if (renderStageDesc.instanceCountSlot > -1) {
+				UINT instanceCounts[2] = { draw.groupInstanceCount, 1 };
+				mCommandList->SetGraphicsRoot32BitConstants(renderStageDesc.instanceCountSlot, 2, instanceCounts, 0);
+			}
+			instanceCount = draw.groupInstanceCount;
+			bound.setGroup();
+		}
+		else {
+			if (bound.setObject(draw.model)) {
+				bindDescriptorsToRoot(DESCRIPTOR_USAGE_PER_OBJECT, draw.modelIndex);
+				draw.model->bindTransformToRoot(renderStageDesc.perObjTransformCBSlot, gFrameIndex, mCommandList.Get());
+				if (renderStageDesc.instanceCountSlot > -1) {
+					mCommandList->SetGraphicsRoot32BitConstant(renderStageDesc.instanceCountSlot, draw.model->getInstanceCount(), 0);
+				}
+			}
+			m.bindTransformToRoot(renderStageDesc.perMeshTransformCBSlot, gFrameIndex, mCommandList.Get());
+			if (renderStageDesc.instanceCountSlot > -1 && bound.setMeshInstanceCount(m.getInstanceCount())) {
+				mCommandList->SetGraphicsRoot32BitConstant(renderStageDesc.instanceCountSlot, m.getInstanceCount(), 1);
+			}
+		}
+
+		if (perDrawShadingRate && bound.setShadingRate((UINT32)draw.shadingRate)) {
+			D3D12_SHADING_RATE_COMBINER combiners[2] = { D3D12_SHADING_RATE_COMBINER_OVERRIDE, D3D12_SHADING_RATE_COMBINER_OVERRIDE };
+			mCommandList->RSSetShadingRate(draw.shadingRate, combiners);
+			stats.shadingRateChanges++;
+		}
+		if (renderStageDesc.perMeshTextureSlot > -1 && bound.setTextureTable(draw.textureTable.ptr)) {
+			mCommandList->SetGraphicsRootDescriptorTable(renderStageDesc.perMeshTextureSlot, draw.textureTable);
+			stats.textureChanges++;
+		}
+		if (renderStageDesc.vertexDequantizeSlot > -1 && bound.setDequantize(draw.mesh)) {
+			float vertexDequantize[8];
+			getVertexDequantize(m, vertexDequantize);
+			mCommandList->SetGraphicsRoot32BitConstants(renderStageDesc.vertexDequantizeSlot, 8, vertexDequantize, 0);
+		}
+		if (bound.setIndexFormat((UINT32)m.indexFormat)) {
+			auto indexBufferView = GeometryPool::getInstance().getIndexBufferView(m.indexFormat);
+			mCommandList->IASetIndexBuffer(&indexBufferView);
+			stats.geometryChanges++;
+		}
+		mCommandList->DrawIndexedInstanced(draw.indexCount, instanceCount, draw.startIndexLocation, draw.baseVertexLocation, 0);
+		stats.draws++;
+		stats.triangles += draw.indexCount / 3 * instanceCount;
+		stats.lodDraws += draw.lod != 0;
+	}
+}
+
+void ModelRenderPipelineStage::recordIndirectDraws(DrawStats& stats) {
+	const bool perDrawShadingRate = VRS && (vrsSupport.VariableShadingRateTier == D3D12_VARIABLE_SHADING_RATE_TIER_1);
+	D3D12_GPU_VIRTUAL_ADDRESS transforms = groupTransforms->get(gFrameIndex)->GetGPUVirtualAddress();
+	D3D12_VERTEX_BUFFER_VIEW vertexBufferView = GeometryPool::getInstance().getVertexBufferView();
+	D3D12_INDEX_BUFFER_VIEW indexBufferViews[2] = {
+		GeometryPool::getInstance().getIndexBufferView(DXGI_FORMAT_R16_UINT),
+		GeometryPool::getInstance().getIndexBufferView(DXGI_FORMAT_R32_UINT) };
+	indirectBuilder.clear();
+	for (const auto& sorted : drawOrder) {
+		const DrawItem& draw = draws[sorted.value];
+		const Mesh& m = *draw.mesh;
+		IndirectDrawCommand command;
+		command.vertexBuffer = vertexBufferView;
+		command.indexBuffer = indexBufferViews[m.indexFormat == DXGI_FORMAT_R32_UINT];
+		if (draw.groupTransformOffset != NOT_GROUPED) {
+			command.objectTransforms = transforms + sizeof(DirectX::XMFLOAT4X4A) * (UINT64)draw.groupTransformOffset;
+			command.meshTransforms = transforms;
+			command.instanceCounts[0] = draw.groupInstanceCount;
+			command.instanceCounts[1] = 1;
+		}
+		else {
+			command.objectTransforms = draw.model->getFrameTransformVirtualAddress(0, gFrameIndex);
+			command.meshTransforms = m.getFrameTransformVirtualAddress(0, gFrameIndex);
+			command.instanceCounts[0] = draw.model->getInstanceCount();
+			command.instanceCounts[1] = m.getInstanceCount();
+		}
+#ifdef COMPACT_VERTICES
+		getVertexDequantize(m, command.vertexDequantize);
+#endif
+		command.draw.IndexCountPerInstance = draw.indexCount;
+		command.draw.InstanceCount = command.instanceCounts[0] * command.instanceCounts[1];
+		stats.triangles += draw.indexCount / 3 * command.draw.InstanceCount;
+		stats.lodDraws += draw.lod != 0;
+		command.draw.StartIndexLocation = draw.startIndexLocation;
+		command.draw.BaseVertexLocation = draw.baseVertexLocation;
+		command.draw.StartInstanceLocation = 0;
+		indirectBuilder.addDraw(command, draw.textureTable.ptr, perDrawShadingRate ? draw.shadingRate : D3D12_SHADING_RATE_1X1);
+	}
+
+	const auto& commands = indirectBuilder.getCommands();
+	if (commands.empty()) {
+		return;
+	}
+	indirectArguments->updateBuffer(gFrameIndex, commands.data(), (UINT)commands.size());
+	ID3D12Resource* argumentBuffer = indirectArguments->get(gFrameIndex);
+	for (const auto& run : indirectBuilder.getRuns()) {
+		if (perDrawShadingRate) {
+			D3D12_SHADING_RATE_COMBINER combiners[2] = { D3D12_SHADING_RATE_COMBINER_OVERRIDE, D3D12_SHADING_RATE_COMBINER_OVERRIDE };
+			mCommandList->RSSetShadingRate((D3D12_SHADING_RATE)run.shadingRate, combiners);
+			stats.shadingRateChanges++;
+		}
+		mCommandList->SetGraphicsRootDescriptorTable(renderStageDesc.perMeshTextureSlot, D3D12_GPU_DESCRIPTOR_HANDLE{ run.textureTable });
+		stats.textureChanges++;
+		mCommandList->ExecuteIndirect(commandSignature.Get(), run.commandCount, argumentBuffer,
+			(UINT64)run.firstCommand * sizeof(IndirectDrawCommand), nullptr, 0);
+		stats.indirectCalls++;
+	}
+	stats.draws = (UINT)commands.size();
+}
+
+void ModelRenderPipelineStage::buildDrawList() {
+	draws.clear();
+	drawOrder.clear();
+	groupMembers.clear();
+	int modelIndex = 0;
 	for (int i = 0; i < renderObjects.size(); i++) {
 		std::shared_ptr<SimpleModel> model = renderObjects[i].lock();
 		if (!model) {
 			renderObjects.erase(renderObjects.begin() + i);
+			visibilityCache.removeModel(i);
 			i--;
 			modelIndex++;
 			continue;
 		}
 
-		std::vector<DirectX::BoundingBox> boundingBoxes;
-		for (UINT i = 0; i < model->getInstanceCount(); i++) {
-			DirectX::BoundingBox instanceBB;
-			model->boundingBox.Transform(instanceBB, TransposeLoad(model->getTransform(i)));
-			boundingBoxes.push_back(instanceBB);
-		}
-		if (frustrumCull && std::all_of(boundingBoxes.begin(), boundingBoxes.end(), [this](DirectX::BoundingBox b) { return frustrum.Contains(b) == DirectX::ContainmentType::DISJOINT; })) {
+		UINT cullRangeIndex = modelCullRanges[modelIndex];
+		if (cullRangeIndex == CULLED_MODEL) {
 			modelIndex++;
 			continue;
 		}
 
-		bindDescriptorsToRoot(DESCRIPTOR_USAGE_PER_OBJECT, i);
-		model->bindTransformToRoot(renderStageDesc.perObjTransformCBSlot, gFrameIndex, mCommandList.Get());
-
-		auto vertexBufferView = model->getVertexBufferView();
-		auto indexBufferView = model->getIndexBufferView();
-		mCommandList->IASetVertexBuffers(0, 1, &vertexBufferView);
-		mCommandList->IASetIndexBuffer(&indexBufferView);
-		mCommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		DirectX::XMMATRIX modelTransform = TransposeLoad(model->getTransform(0));
+		// Every model lives in the GeometryPool's buffers, so its meshes are drawn at the model's offsets into them.
+		INT vertexOffset = (INT)model->getVertexOffset();
+		UINT indexOffset = model->getIndexOffset();
+		bool modelDrawn = false;
+		for (Mesh& m : model->meshes) {
+			auto meshRange = cullRanges[cullRangeIndex++];
+			if (meshRange.first != ALWAYS_VISIBLE_RANGE && !cullBatch.anyVisible(meshRange.first, meshRange.second)) {
+				continue;
+			}
 
-		if (false && renderStageDesc.supportsCulling && occlusionCull && std::all_of(boundingBoxes.begin(), boundingBoxes.end(), [this](DirectX::BoundingBox b) { return frustrum.Contains(b) != DirectX::ContainmentType::INTERSECTS; })) {
-			if (std::all_of(boundingBoxes.begin(), boundingBoxes.end(), [this](DirectX::BoundingBox b) { return frustrum.Contains(DirectX::XMLoadFloat3(&eyePos)) != DirectX::ContainmentType::CONTAINS; })) {
-				mCommandList->SetPredication(occlusionQueryResultBuffer.Get(), (UINT64)modelIndex * 8, D3D12_PREDICATION_OP_EQUAL_ZERO);
+			DrawItem draw;
+			draw.model = model.get();
+			draw.mesh = &m;
+			draw.modelIndex = i;
+			draw.baseVertexLocation = vertexOffset + m.baseVertexLocation;
+			draw.textureTable = renderStageDesc.perMeshTextureSlot > -1 ? m.getDescriptorsForStage(this)[0].gpuHandle : D3D12_GPU_DESCRIPTOR_HANDLE{ 0 };
+			draw.shadingRate = getShadingRateFromDistance(eyePos, m.boundingBox);
+
+			// Instances can be anywhere, the first of each is just a decent guess for how far away the mesh is.
+			DirectX::BoundingBox worldBox;
+			m.boundingBox.Transform(worldBox, DirectX::XMMatrixMultiply(TransposeLoad(m.getTransform(0)), modelTransform));
+			float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(
+				DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&worldBox.Center), DirectX::XMLoadFloat3(&eyePos))));
+			UINT depthBucket = (UINT)(std::min(distance / FAR_Z, 1.0f) * DRAW_KEY_DEPTH_MASK);
+
+			// Only meshes drawn once can trust that guess for their level, any other instance could be right in front of the camera.
+			draw.lod = 0;
+			if (meshLods && !m.lods.empty() && model->getInstanceCount() == 1 && m.getInstanceCount() == 1) {
+				float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMLoadFloat3(&worldBox.Extents)));
+				if (distance > radius) {
+					draw.lod = m.selectLod(radius / distance * pixelsPerUnit, MESH_LOD_PIXEL_ERROR);
+				}
 			}
-			else {
-				mCommandList->SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
+			draw.indexCount = m.getLodIndexCount(draw.lod);
+			draw.startIndexLocation = m.getPoolStartIndexLocation(indexOffset, draw.lod);
+
+			modelDrawn = true;
+			if (autoInstance && m.geometryId != UNIQUE_GEOMETRY) {
+				groupMembers.push_back({ m.geometryId, depthBucket, draw });
+				continue;
 			}
+			drawOrder.push_back({ makeSortKey(draw.shadingRate, draw.textureTable, depthBucket, i), (UINT)draws.size() });
+			draws.push_back(draw);
 		}
-		else {
-			mCommandList->SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
+		// Keeps the model alive until its draws are recorded.
+		if (modelDrawn) {
+			drawModelRefs.push_back(model);
 		}
+		modelIndex++;
+	}
+	buildInstanceGroups();
+	if (sortDraws) {
+		RadixSort(drawOrder, drawOrderScratch);
+	}
+}
 
-		for (Mesh& m : model->meshes) {
-			std::vector<DirectX::BoundingBox> meshBoundingBoxes;
-			for (UINT i = 0; i < model->getInstanceCount(); i++) {
-				DirectX::BoundingBox instanceMeshBB;
-				DirectX::BoundingBox subInstanceMeshBB;
-				for (UINT j = 0; j < m.getInstanceCount(); j++) {
-					m.boundingBox.Transform(instanceMeshBB, TransposeLoad(m.getTransform(j)));
-					instanceMeshBB.Transform(subInstanceMeshBB, TransposeLoad(model->getTransform(i)));
-					meshBoundingBoxes.push_back(subInstanceMeshBB);
+void ModelRenderPipelineStage::buildInstanceGroups() {
+	// Slot 0 is the identity every group binds as its mesh transforms, so the shader's mesh instance count is just 1.
+	groupTransformData.resize(1);
+	DirectX::XMStoreFloat4x4A(&groupTransformData[0], DirectX::XMMatrixIdentity());
+	std::sort(groupMembers.begin(), groupMembers.end(), [](const InstanceGroupMember& a, const InstanceGroupMember& b) {
+		if (a.geometryId != b.geometryId) {
+			return a.geometryId < b.geometryId;
+		}
+		if (a.draw.lod != b.draw.lod) {
+			return a.draw.lod < b.draw.lod;
+		}
+		if (a.draw.textureTable.ptr != b.draw.textureTable.ptr) {
+			return a.draw.textureTable.ptr < b.draw.textureTable.ptr;
+		}
+		return a.draw.modelIndex < b.draw.modelIndex;
+	});
+
+	for (size_t first = 0; first < groupMembers.size();) {
+		size_t last = first + 1;
+		while (last < groupMembers.size() && groupMembers[last].geometryId == groupMembers[first].geometryId
+			&& groupMembers[last].draw.lod == groupMembers[first].draw.lod
+			&& groupMembers[last].draw.textureTable.ptr == groupMembers[first].draw.textureTable.ptr) {
+			last++;
+		}
+		// Any member's buffers work since the geometry is identical, the first one's get drawn with every member's transforms.
+		DrawItem draw = groupMembers[first].draw;
+		if (last - first > 1) {
+			draw.groupTransformOffset = (UINT)groupTransformData.size();
+			for (size_t member = first; member < last; member++) {
+				const SimpleModel& model = *groupMembers[member].draw.model;
+				const Mesh& mesh = *groupMembers[member].draw.mesh;
+				for (UINT i = 0; i < model.getInstanceCount(); i++) {
+					DirectX::XMMATRIX modelTransform = TransposeLoad(model.getTransform(i));
+					for (UINT j = 0; j < mesh.getInstanceCount(); j++) {
+						DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(TransposeLoad(mesh.getTransform(j)), modelTransform);
+						DirectX::XMStoreFloat4x4A(&groupTransformData.emplace_back(), DirectX::XMMatrixTranspose(world));
+					}
 				}
 			}
-			if (frustrumCull && std::all_of(meshBoundingBoxes.begin(), meshBoundingBoxes.end(), [this](DirectX::BoundingBox b) {return frustrum.Contains(b) == DirectX::ContainmentType::DISJOINT; })) {
-				continue;
-			}
+			draw.groupInstanceCount = (UINT)groupTransformData.size() - draw.groupTransformOffset;
+		}
+		drawOrder.push_back({ makeSortKey(draw.shadingRate, draw.textureTable, groupMembers[first].depthBucket, draw.modelIndex), (UINT)draws.size() });
+		draws.push_back(draw);
+		first = last;
+	}
+	if (groupTransformData.size() > 1) {
+		groupTransforms->updateBuffer(gFrameIndex, groupTransformData.data(), (UINT)groupTransformData.size());
+	}
+}
 
-			if (VRS && (vrsSupport.VariableShadingRateTier == D3D12_VARIABLE_SHADING_RATE_TIER_1)) {
-				D3D12_SHADING_RATE_COMBINER combiners[2] = { D3D12_SHADING_RATE_COMBINER_OVERRIDE, D3D12_SHADING_RATE_COMBINER_OVERRIDE };
-				mCommandList->RSSetShadingRate(getShadingRateFromDistance(eyePos, m.boundingBox), combiners);
-			}
+UINT64 ModelRenderPipelineStage::makeSortKey(D3D12_SHADING_RATE shadingRate, D3D12_GPU_DESCRIPTOR_HANDLE textureTable, UINT depthBucket, UINT model) {
+	// The only per draw pipeline state this stage changes is the shading rate, so that takes the pipeline bits.
+	// Tables are all in one heap, so dividing by the descriptor size gives each a small unique number.
+	return MakeDrawSortKey((UINT32)shadingRate, textureTable.ptr / gCbvSrvUavDescriptorSize, depthBucket, model);
+}
 
-			m.bindTransformToRoot(renderStageDesc.perMeshTransformCBSlot, gFrameIndex, mCommandList.Get());
-			if (renderStageDesc.perMeshTextureSlot > -1) {
-				mCommandList->SetGraphicsRootDescriptorTable(renderStageDesc.perMeshTextureSlot, m.getDescriptorsForStage(this)[0].gpuHandle);
+void ModelRenderPipelineStage::buildCullBatch() {
+	PIXScopedEvent(PIX_COLOR(0, 255, 0), "Frustum Cull");
+	cullBatch.clear();
+	cullRanges.clear();
+	meshTests.clear();
+	testedInstances.clear();
+	modelCullRanges.clear();
+	modelInstances.clear();
+	const bool occlusionActive = frustrumCull && occlusionCull && renderStageDesc.supportsCulling;
+	if (frustrumCull) {
+		SceneBVH::getInstance().query(frustrum, visibleInstances);
+		SceneBVH::groupByModel(visibleInstances);
+		visibilityCache.beginFrame(viewProj, frustrum, occlusionActive);
+		// Has to happen before anything is classified, one model moving can reveal what's behind it in any other.
+		for (UINT i = 0; i < renderObjects.size(); i++) {
+			if (auto model = renderObjects[i].lock()) {
+				visibilityCache.checkModel(i, model->getTransformVersion(), model->getInstanceCount(), (UINT)model->meshes.size());
 			}
-			mCommandList->DrawIndexedInstanced(m.indexCount,
-				model->getInstanceCount() * m.getInstanceCount(), m.startIndexLocation, m.baseVertexLocation, 0);
-
 		}
-		modelIndex++;
 	}
-}
-
-void ModelRenderPipelineStage::drawOcclusionQuery() {
-	PIXScopedEvent(mCommandList.Get(), PIX_COLOR(0, 255, 0), "Draw Calls");
-	// Have to rebind if we're using meshlets.
-	mCommandList->SetPredication(nullptr, 0, D3D12_PREDICATION_OP_EQUAL_ZERO);
-	mCommandList->SetPipelineState(occlusionPSO.Get());
-	mCommandList->SetGraphicsRootSignature(rootSignature.Get());
-	bindDescriptorsToRoot(DESCRIPTOR_USAGE_ALL);
-	bindDescriptorsToRoot(DESCRIPTOR_USAGE_PER_PASS);
-	mCommandList->SetGraphicsRootSignature(rootSignature.Get());
-	mCommandList->IASetVertexBuffers(0, 1, &occlusionBoundingBoxBufferView);
-	for (int i = 0; i < renderObjects.size(); i++) {
-		auto mPtr = renderObjects[i].lock();
-		if (!mPtr) {
+	// Each visible model gets one range per mesh, covering the mesh's boxes for only the instances that need testing.
+	for (UINT i = 0; i < renderObjects.size(); i++) {
+		std::shared_ptr<SimpleModel> model = renderObjects[i].lock();
+		modelInstances.emplace_back();
+		if (!model) {
+			// Has to be skipped in the draw loop as well, can't come back once it's expired.
+			modelCullRanges.push_back(CULLED_MODEL);
+			continue;
+		}
+		if (!frustrumCull) {
+			modelCullRanges.push_back((UINT)cullRanges.size());
+			cullRanges.insert(cullRanges.end(), model->meshes.size(), { ALWAYS_VISIBLE_RANGE, 0 });
+			meshTests.insert(meshTests.end(), model->meshes.size(), MeshTest());
+			continue;
+		}
+		auto instances = SceneBVH::findInstances(visibleInstances, model.get());
+		if (instances.empty()) {
+			modelCullRanges.push_back(CULLED_MODEL);
+			continue;
+		}
+		modelCullRanges.push_back((UINT)cullRanges.size());
+		modelInstances.back() = instances;
+		// Every mesh gets drawn for an instance that's entirely in view, so there's nothing to test.
+		// Unless it could still be behind an occluder.
+		if (!occlusionActive && std::any_of(instances.begin(), instances.end(), [](const SceneBVHResult& result) { return result.fullyInside; })) {
+			cullRanges.insert(cullRanges.end(), model->meshes.size(), { ALWAYS_VISIBLE_RANGE, 0 });
+			meshTests.insert(meshTests.end(), model->meshes.size(), MeshTest());
 			continue;
 		}
-		bindDescriptorsToRoot(DESCRIPTOR_USAGE_PER_OBJECT, i);
-		mPtr->bindTransformToRoot(renderStageDesc.perObjTransformCBSlot, gFrameIndex, mCommandList.Get());
-		mCommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
-		mCommandList->BeginQuery(occlusionQueryHeap.Get(), D3D12_QUERY_TYPE_BINARY_OCCLUSION, i);
-		mCommandList->DrawInstanced(1, mPtr->getInstanceCount(), i, 0);
-		mCommandList->EndQuery(occlusionQueryHeap.Get(), D3D12_QUERY_TYPE_BINARY_OCCLUSION, i);
+		addModelBoxes(i, *model, instances);
+	}
+	if (frustrumCull) {
+		cullBatch.cull(frustrum);
+	}
+	if (occlusionActive && cullBatch.size() > 0) {
+		occlusionCullBatch();
+	}
+	if (frustrumCull) {
+		storeVisibility();
 	}
-	auto copyTransition = CD3DX12_RESOURCE_BARRIER::Transition(occlusionQueryResultBuffer.Get(), D3D12_RESOURCE_STATE_PREDICATION, D3D12_RESOURCE_STATE_COPY_DEST);
-	mCommandList->ResourceBarrier(1, &copyTransition);
-	mCommandList->ResolveQueryData(occlusionQueryHeap.Get(), D3D12_QUERY_TYPE_BINARY_OCCLUSION, 0, (UINT)(renderObjects.size()), occlusionQueryResultBuffer.Get(), 0);
-	auto predTransition = CD3DX12_RESOURCE_BARRIER::Transition(occlusionQueryResultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PREDICATION);
-	mCommandList->ResourceBarrier(1, &predTransition);
 }
 
-void ModelRenderPipelineStage::setupOcclusionBoundingBoxes() {
-	std::vector<CompactBoundingBox> boundingBoxes;
-	for (const auto& model : renderObjects) {
-		if (auto modelPtr = model.lock()) {
-			boundingBoxes.emplace_back(modelPtr->boundingBox.Center, modelPtr->boundingBox.Extents);
+void ModelRenderPipelineStage::addModelBoxes(UINT modelIndex, const SimpleModel& model, std::span<const SceneBVHResult> instances) {
+	// A mesh that any trusted instance has visible gets drawn whatever the tests say.
+	trustedMeshes.assign(DivRoundUp((UINT)model.meshes.size(), 64), 0);
+	testers.clear();
+	modelTransforms.clear();
+	for (const auto& result : instances) {
+		VisibilityCache::INSTANCE_STATE state = visibilityCache.classifyInstance(modelIndex, result.instance);
+		if (state != VisibilityCache::INSTANCE_STATE_TEST_ALL) {
+			visibilityCache.addVisibleMeshes(modelIndex, result.instance, trustedMeshes);
 		}
-		else {
-			// if the model was actually unloaded, this bogus 'padding' is necessary to keep indexing consistent when drawing BBs
-			boundingBoxes.emplace_back(CompactBoundingBox(DirectX::XMFLOAT3(), DirectX::XMFLOAT3()));
+		if (state != VisibilityCache::INSTANCE_STATE_TRUSTED) {
+			testers.emplace_back(result.instance, state);
+			modelTransforms.push_back(TransposeLoad(model.getTransform(result.instance)));
 		}
 	}
 
-	UINT byteSize = (UINT)boundingBoxes.size() * sizeof(CompactBoundingBox);
-
-	ResourceDecay::destroyAfterSpecificDelay(occlusionBoundingBoxBufferGPU, CPU_FRAME_COUNT + 1);
-	occlusionBoundingBoxBufferGPU.Reset();
-	ResourceDecay::destroyAfterSpecificDelay(occlusionBoundingBoxBufferGPUUploader, CPU_FRAME_COUNT + 1);
-	occlusionBoundingBoxBufferGPUUploader.Reset();
-
-	occlusionBoundingBoxBufferGPU = CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
-		boundingBoxes.data(), byteSize, occlusionBoundingBoxBufferGPUUploader);
+	for (UINT meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++) {
+		const Mesh& m = model.meshes[meshIndex];
+		MeshTest test = { modelIndex, meshIndex, cullBatch.size(), (UINT)testedInstances.size(), 0, m.getInstanceCount() };
+		meshTransforms.clear();
+		for (UINT j = 0; j < m.getInstanceCount(); j++) {
+			meshTransforms.push_back(TransposeLoad(m.getTransform(j)));
+		}
+		// Instances only retesting their hidden results can skip the meshes they already have visible.
+		// Boxes are stored instance by instance, so each tested instance's results are one contiguous range.
+		for (UINT t = 0; t < testers.size(); t++) {
+			if (testers[t].second == VisibilityCache::INSTANCE_STATE_TEST_HIDDEN && visibilityCache.isVisible(modelIndex, testers[t].first, meshIndex)) {
+				continue;
+			}
+			for (const auto& meshTransform : meshTransforms) {
+				cullBatch.add(m.boundingBox, DirectX::XMMatrixMultiply(meshTransform, modelTransforms[t]));
+			}
+			testedInstances.push_back(testers[t].first);
+			test.testerCount++;
+		}
+		meshTests.push_back(test);
+		if ((trustedMeshes[meshIndex / 64] >> (meshIndex % 64)) & 1) {
+			cullRanges.emplace_back(ALWAYS_VISIBLE_RANGE, 0);
+		}
+		else {
+			cullRanges.emplace_back(test.firstBox, cullBatch.size() - test.firstBox);
+		}
+	}
+}
 
-	SetName(occlusionBoundingBoxBufferGPU.Get(), L"Occlusion BB Buffer GPU");
-	SetName(occlusionBoundingBoxBufferGPUUploader.Get(), L"Occlusion BB Buffer GPU Uploader");
+void ModelRenderPipelineStage::storeVisibility() {
+	for (const auto& test : meshTests) {
+		for (UINT t = 0; t < test.testerCount; t++) {
+			bool visible = cullBatch.anyVisible(test.firstBox + t * test.meshInstanceCount, test.meshInstanceCount);
+			visibilityCache.setVisible(test.model, testedInstances[test.testerOffset + t], test.mesh, visible);
+		}
+	}
+}
 
-	auto transToVertexBuffer = CD3DX12_RESOURCE_BARRIER::Transition(occlusionBoundingBoxBufferGPU.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-	mCommandList->ResourceBarrier(1, &transToVertexBuffer);
+void ModelRenderPipelineStage::occlusionCullBatch() {
+	PIXScopedEvent(PIX_COLOR(0, 255, 0), "Occlusion Cull");
+	// Any mesh that's going to be drawn can be an occluder, trusted or tested this frame.
+	occluderCandidates.clear();
+	for (UINT i = 0; i < renderObjects.size(); i++) {
+		if (modelCullRanges[i] == CULLED_MODEL) {
+			continue;
+		}
+		std::shared_ptr<SimpleModel> model = renderObjects[i].lock();
+		if (!model) {
+			continue;
+		}
+		for (UINT meshIndex = 0; meshIndex < model->meshes.size(); meshIndex++) {
+			const Mesh& m = model->meshes[meshIndex];
+			const UINT rangeIndex = modelCullRanges[i] + meshIndex;
+			const auto& range = cullRanges[rangeIndex];
+			// Alpha tested meshes have holes the occlusion buffer can't know about.
+			if (m.typeFlags & MODEL_FORMAT_OPACITY_TEX) {
+				continue;
+			}
+			if (range.first != ALWAYS_VISIBLE_RANGE && !cullBatch.anyVisible(range.first, range.second)) {
+				continue;
+			}
+			const MeshTest& test = meshTests[rangeIndex];
+			for (const auto& result : modelInstances[i]) {
+				DirectX::XMMATRIX modelTransform = TransposeLoad(model->getTransform(result.instance));
+				auto tested = std::find(testedInstances.begin() + test.testerOffset, testedInstances.begin() + test.testerOffset + test.testerCount, result.instance);
+				UINT testerIndex = (UINT)(tested - (testedInstances.begin() + test.testerOffset));
+				for (UINT j = 0; j < m.getInstanceCount(); j++) {
+					DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(TransposeLoad(m.getTransform(j)), modelTransform);
+					DirectX::BoundingBox worldBox;
+					m.boundingBox.Transform(worldBox, world);
+					float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMLoadFloat3(&worldBox.Extents)));
+					float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(
+						DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&worldBox.Center), DirectX::XMLoadFloat3(&eyePos))));
+					float size = radius / std::max(distance, NEAR_Z);
+					if (size < OCCLUSION_MIN_OCCLUDER_SIZE) {
+						continue;
+					}
+					UINT box = testerIndex < test.testerCount ? test.firstBox + testerIndex * test.meshInstanceCount + j : UNTESTED_BOX;
+					if (box != UNTESTED_BOX && !cullBatch.isVisible(box)) {
+						continue;
+					}
+					OccluderCandidate candidate = { model, &m, {}, box, size };
+					DirectX::XMStoreFloat4x4(&candidate.world, world);
+					occluderCandidates.push_back(candidate);
+				}
+			}
+		}
+	}
+	if (occluderCandidates.empty()) {
+		return;
+	}
+	// Biggest on screen go first until the budget runs out.
+	std::sort(occluderCandidates.begin(), occluderCandidates.end(),
+		[](const OccluderCandidate& a, const OccluderCandidate& b) { return a.size > b.size; });
+
+	occlusion.beginFrame(DirectX::XMLoadFloat4x4(&viewProj));
+	occluderBoxes.clear();
+	for (const auto& candidate : occluderCandidates) {
+		const Mesh* m = candidate.mesh;
+		std::span<const DirectX::XMFLOAT3> positions(candidate.model->occluderPositions.data() + m->baseVertexLocation, m->vertexCount);
+		std::span<const UINT> indices(candidate.model->occluderIndices.data() + m->startIndexLocation, m->indexCount);
+		if (occlusion.addOccluder(positions, indices, DirectX::XMLoadFloat4x4(&candidate.world)) && candidate.box != UNTESTED_BOX) {
+			occluderBoxes.push_back(candidate.box);
+		}
+	}
+	// Don't hold on to the models past the cull.
+	occluderCandidates.clear();
 
-	occlusionBoundingBoxBufferView.BufferLocation = occlusionBoundingBoxBufferGPU->GetGPUVirtualAddress();
-	occlusionBoundingBoxBufferView.StrideInBytes = sizeof(CompactBoundingBox);
-	occlusionBoundingBoxBufferView.SizeInBytes = byteSize;
-}
+	occlusion.rasterize();
+	std::sort(occluderBoxes.begin(), occluderBoxes.end());
+	cullBatch.occlusionCull(occlusion, occluderBoxes);
+}
\ No newline at end of file
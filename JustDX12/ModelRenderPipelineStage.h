@@ -1,39 +1,163 @@
 #pragma once
+#include <map>
+
 #include "PipelineStage/RenderPipelineStage.h"
 
 #include "ModelListener.h"
+#include "BoundingBoxBatch.h"
+#include "SceneBVH.h"
+#include "SoftwareOcclusion.h"
+#include "VisibilityCache.h"
+#include "RadixSort.h"
+#include "DrawSortKey.h"
+#include "IndirectDrawCommand.h"
+#include "DX12StructuredBuffer.h"
+
+// modelCullRanges entry for a model that isn't drawn this frame.
+#define CULLED_MODEL UINT_MAX
+// cullRanges entry for a mesh that's drawn without testing.
+#define ALWAYS_VISIBLE_RANGE UINT_MAX
+// OccluderCandidate box for an instance that wasn't in cullBatch this frame.
+#define UNTESTED_BOX UINT_MAX
+
+// DrawItem::groupTransformOffset of a draw that isn't an instance group.
+#define NOT_GROUPED UINT_MAX
 
 class ModelRenderPipelineStage : public RenderPipelineStage, public ModelListener {
 public:
 	ModelRenderPipelineStage(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice, RenderPipelineDesc renderDesc, D3D12_VIEWPORT viewport, D3D12_RECT scissorRect);
 	~ModelRenderPipelineStage();
 
+	// Draws get sorted by their key before recording, off records them in the order the models were loaded.
+	bool sortDraws = true;
+	// Records the sorted draws as one ExecuteIndirect per texture table/shading rate run instead of one draw call each.
+	bool indirectDraws = true;
+	// Visible meshes with the same geometry and textures (see Mesh::geometryId) get merged into one instanced draw, even across models.
+	bool autoInstance = true;
+	// Draws each mesh at the coarsest of its Mesh::lods whose error stays under MESH_LOD_PIXEL_ERROR on screen.
+	bool meshLods = true;
+	// What the last drawModels recorded, the changes are how many times that state had to be set.
+	struct DrawStats {
+		UINT draws = 0;
+		UINT geometryChanges = 0;
+		UINT textureChanges = 0;
+		UINT shadingRateChanges = 0;
+		UINT indirectCalls = 0;
+		// Per instance, and how many draws used a level other than the full mesh.
+		UINT triangles = 0;
+		UINT lodDraws = 0;
+		float recordTime = 0.0f;
+	} drawStats;
+
+	void setup(PipeLineStageDesc stageDesc) override;
+
 protected:
-	virtual void buildPSO() override;
-	virtual void buildInputLayout() override;
-	void buildQueryHeap();
 	// Inherited via ModelListener
 	virtual void processModel(std::weak_ptr<Model> model) override;
 
 	virtual void draw() override;
 	virtual void drawModels();
-	void drawOcclusionQuery();
-
-	void setupOcclusionBoundingBoxes();
+	// Fills draws with every visible mesh and drawOrder with their keys, sorted if sortDraws is set.
+	void buildDrawList();
+	// Turns groupMembers into draws, one per geometry/texture table, with every member's world transforms in groupTransforms.
+	void buildInstanceGroups();
+	void recordDraws(DrawStats& stats);
+	void recordIndirectDraws(DrawStats& stats);
+	static UINT64 makeSortKey(D3D12_SHADING_RATE shadingRate, D3D12_GPU_DESCRIPTOR_HANDLE textureTable, UINT depthBucket, UINT model);
+	// Culls models per instance through the SceneBVH, then fills cullBatch with the mesh boxes
+	// of the visible instances that visibilityCache can't answer for and frustum culls them all in one go.
+	void buildCullBatch();
+	void addModelBoxes(UINT modelIndex, const SimpleModel& model, std::span<const SceneBVHResult> instances);
+	// Writes this frame's test results back to visibilityCache.
+	void storeVisibility();
+	// Rasterizes the biggest frustum visible meshes as occluders and clears the cullBatch bits of everything behind them.
+	void occlusionCullBatch();
 
 	// ModelLoader still 'owns' models, so as long as we process all the unloads in a thread-safe way
 	// the RenderPipelineStage should be aware of when a renderObject is no longer available
 	std::vector<std::weak_ptr<SimpleModel>> renderObjects;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> occlusionQueryResultBuffer;
-	Microsoft::WRL::ComPtr<ID3D12QueryHeap> occlusionQueryHeap;
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> occlusionPSO = nullptr;
-	Microsoft::WRL::ComPtr<IDxcBlob> occlusionVS = nullptr;
-	Microsoft::WRL::ComPtr<IDxcBlob> occlusionGS = nullptr;
-	Microsoft::WRL::ComPtr<IDxcBlob> occlusionPS = nullptr;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> occlusionBoundingBoxBufferGPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> occlusionBoundingBoxBufferGPUUploader = nullptr;
-	D3D12_VERTEX_BUFFER_VIEW occlusionBoundingBoxBufferView = { 0 };
-	std::vector<D3D12_INPUT_ELEMENT_DESC> occlusionInputLayout;
+	// Reused every frame so culling doesn't allocate, cullRanges holds a (first box, box count) pair per mesh
+	// and modelCullRanges the index of each renderObject's first mesh range.
+	std::vector<SceneBVHResult> visibleInstances;
+	BoundingBoxBatch cullBatch;
+	std::vector<std::pair<UINT, UINT>> cullRanges;
+	std::vector<UINT> modelCullRanges;
+	std::vector<std::span<const SceneBVHResult>> modelInstances;
+	std::vector<DirectX::XMMATRIX> modelTransforms;
+	std::vector<DirectX::XMMATRIX> meshTransforms;
+
+	// One per cullRanges entry, says which instances were tested for the mesh.
+	// Each one has meshInstanceCount boxes starting at firstBox + (tester index) * meshInstanceCount.
+	struct MeshTest {
+		UINT model = 0;
+		UINT mesh = 0;
+		UINT firstBox = 0;
+		UINT testerOffset = 0;
+		UINT testerCount = 0;
+		UINT meshInstanceCount = 0;
+	};
+	VisibilityCache visibilityCache;
+	std::vector<MeshTest> meshTests;
+	// Model instance of every tester, MeshTest::testerOffset indexes into it.
+	std::vector<UINT> testedInstances;
+	std::vector<std::pair<UINT, VisibilityCache::INSTANCE_STATE>> testers;
+	std::vector<UINT64> trustedMeshes;
+
+	// One per drawn mesh instance that's big enough on screen to be worth rasterizing.
+	struct OccluderCandidate {
+		std::shared_ptr<SimpleModel> model;
+		const Mesh* mesh;
+		DirectX::XMFLOAT4X4 world;
+		// UNTESTED_BOX if the instance came from visibilityCache.
+		UINT box;
+		// Bounding radius over distance to the eye.
+		float size;
+	};
+	SoftwareOcclusion occlusion;
+	std::vector<OccluderCandidate> occluderCandidates;
+	std::vector<UINT> occluderBoxes;
+
+	struct DrawItem {
+		const SimpleModel* model;
+		const Mesh* mesh;
+		int modelIndex;
+		// Mesh locations offset by where the model's block is in the GeometryPool.
+		INT baseVertexLocation;
+		// Level of detail picked for the mesh, and its indices' location in units of the mesh's indexFormat.
+		UINT lod;
+		UINT indexCount;
+		UINT startIndexLocation;
+		D3D12_GPU_DESCRIPTOR_HANDLE textureTable;
+		D3D12_SHADING_RATE shadingRate;
+		// Instance groups draw 'model's buffers once per transform in groupTransforms starting at this offset.
+		UINT groupTransformOffset = NOT_GROUPED;
+		UINT groupInstanceCount = 0;
+	};
+	struct InstanceGroupMember {
+		// Members only share a draw if they're at the same level of detail too.
+		UINT geometryId;
+		UINT depthBucket;
+		DrawItem draw;
+	};
+	std::vector<DrawItem> draws;
+	std::vector<SortItem> drawOrder;
+	std::vector<SortItem> drawOrderScratch;
+	std::vector<std::shared_ptr<SimpleModel>> drawModelRefs;
+	std::vector<InstanceGroupMember> groupMembers;
+	std::vector<DirectX::XMFLOAT4X4A> groupTransformData;
+	std::unique_ptr<DX12StructuredBuffer> groupTransforms;
+
+	// Keyed by the texture each textureToDescriptor entry gets (nullptr for the stage's default),
+	// the weak_ptrs catch a texture being freed and another one reusing its address.
+	struct TextureTable {
+		std::vector<std::weak_ptr<DX12Texture>> textures;
+		std::vector<DX12Descriptor> descriptors;
+	};
+	std::map<std::vector<DX12Texture*>, TextureTable> textureTables;
+
+	// Only created if the stage's root signature can be fully driven by IndirectDrawCommands.
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> commandSignature = nullptr;
+	std::unique_ptr<DX12StructuredBuffer> indirectArguments;
+	IndirectDrawCommandBuilder indirectBuilder;
 };
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "OcclusionBuffer.h"
+
+// Relative rounding error allowed for in the depth plane, a handful of float epsilons.
+#define OCCLUSION_GUARD_EPSILON 1e-6f
+
+OcclusionBuffer::OcclusionBuffer(UINT width, UINT height, UINT tileSize, UINT bandHeight) {
+	this->width = width;
+	this->height = height;
+	this->tileSize = tileSize;
+	this->bandHeight = bandHeight;
+	tilesX = width / tileSize;
+	depth.resize(width * height, 1.0f);
+	tileMaxDepth.resize(tilesX * (height / tileSize), 1.0f);
+}
+
+void OcclusionBuffer::clearTriangles() {
+	triangles.clear();
+}
+
+void OcclusionBuffer::addTriangle(const float x[3], const float y[3], const float z[3]) {
+	// Past this the float to int conversions below aren't defined, and rounding is bigger than a pixel. Dropping occluders is always safe.
+	const float limit = 1e7f;
+	for (int i = 0; i < 3; i++) {
+		if (!(std::abs(x[i]) < limit && std::abs(y[i]) < limit)) {
+			return;
+		}
+	}
+	Triangle tri;
+	tri.minX = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+	tri.maxX = std::min((int)width - 1, (int)std::ceil(std::max({ x[0], x[1], x[2] })));
+	tri.minY = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+	tri.maxY = std::min((int)height - 1, (int)std::ceil(std::max({ y[0], y[1], y[2] })));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+		return;
+	}
+
+	// Edge i runs from vertex i to the next one and is 0 on that edge, at the vertex opposite it's twice the triangle's area.
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		tri.edgeA[i] = y[i] - y[j];
+		tri.edgeB[i] = x[j] - x[i];
+		tri.edgeC[i] = x[i] * y[j] - y[i] * x[j];
+	}
+	float area = tri.edgeA[0] * x[2] + tri.edgeB[0] * y[2] + tri.edgeC[0];
+	if (std::abs(area) < 1e-6f) {
+		return;
+	}
+	// Either winding is fine, flip so the inside is always where all edges are positive.
+	if (area < 0.0f) {
+		area = -area;
+		for (int i = 0; i < 3; i++) {
+			tri.edgeA[i] = -tri.edgeA[i];
+			tri.edgeB[i] = -tri.edgeB[i];
+			tri.edgeC[i] = -tri.edgeC[i];
+		}
+	}
+	// Each edge divided by the area is the barycentric weight of the vertex opposite it.
+	const float invArea = 1.0f / area;
+	tri.depthA = (tri.edgeA[1] * z[0] + tri.edgeA[2] * z[1] + tri.edgeA[0] * z[2]) * invArea;
+	tri.depthB = (tri.edgeB[1] * z[0] + tri.edgeB[2] * z[1] + tri.edgeB[0] * z[2]) * invArea;
+	tri.depthC = (tri.edgeC[1] * z[0] + tri.edgeC[2] * z[1] + tri.edgeC[0] * z[2]) * invArea;
+
+	// Pixels are tested at their center. Edges aren't pulled in for rounding, a triangle sharing an edge gets the exact negation
+	// of it so one of the two always covers the pixel, and a center wrongly covered by rounding is still a pixel away from the
+	// next one out, which isRectOccluded's border checks. A linear function changes by at most half of |A| + |B| from the center
+	// to a corner, so depth pushed out by that (and a guard for its rounding) is the farthest the triangle gets in the pixel.
+	const float extentX = (float)width;
+	const float extentY = (float)height;
+	tri.depthC += 0.5f * (std::abs(tri.depthA) + std::abs(tri.depthB))
+		+ OCCLUSION_GUARD_EPSILON * (std::abs(tri.depthA) * extentX + std::abs(tri.depthB) * extentY + std::abs(tri.depthC));
+	triangles.push_back(tri);
+}
+
+void OcclusionBuffer::rasterizeBand(UINT band) {
+	const int rowStart = band * bandHeight;
+	const int rowEnd = rowStart + bandHeight;
+	std::fill(depth.begin() + rowStart * width, depth.begin() + rowEnd * width, 1.0f);
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (const auto& tri : triangles) {
+		if (tri.maxY < rowStart || tri.minY >= rowEnd) {
+			continue;
+		}
+		const __m128 edgeA0 = _mm_set1_ps(tri.edgeA[0]);
+		const __m128 edgeA1 = _mm_set1_ps(tri.edgeA[1]);
+		const __m128 edgeA2 = _mm_set1_ps(tri.edgeA[2]);
+		const __m128 depthA = _mm_set1_ps(tri.depthA);
+		// The buffer width is a multiple of 4, so starting on a multiple of 4 means a group never runs off the row.
+		const int startX = tri.minX & ~3;
+		const int y1 = std::min(tri.maxY, rowEnd - 1);
+		for (int y = std::max(tri.minY, rowStart); y <= y1; y++) {
+			const float pixelY = (float)y + 0.5f;
+			const __m128 rowEdge0 = _mm_set1_ps(tri.edgeB[0] * pixelY + tri.edgeC[0]);
+			const __m128 rowEdge1 = _mm_set1_ps(tri.edgeB[1] * pixelY + tri.edgeC[1]);
+			const __m128 rowEdge2 = _mm_set1_ps(tri.edgeB[2] * pixelY + tri.edgeC[2]);
+			const __m128 rowDepth = _mm_set1_ps(tri.depthB * pixelY + tri.depthC);
+			float* row = &depth[y * width];
+			for (int x = startX; x <= tri.maxX; x += 4) {
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 covered = _mm_and_ps(
+					_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, pixelX), rowEdge0), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, pixelX), rowEdge1), zero)),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, pixelX), rowEdge2), zero));
+				if (_mm_movemask_ps(covered) == 0) {
+					continue;
+				}
+				__m128 current = _mm_loadu_ps(&row[x]);
+				__m128 closest = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(depthA, pixelX), rowDepth));
+				_mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(covered, closest), _mm_andnot_ps(covered, current)));
+			}
+		}
+	}
+
+	// Band height is a multiple of the tile size, so the tiles of a band are only ever written by that band.
+	for (UINT tileY = rowStart / tileSize; tileY < rowEnd / tileSize; tileY++) {
+		for (UINT tileX = 0; tileX < tilesX; tileX++) {
+			__m128 tileMax = _mm_setzero_ps();
+			for (UINT y = tileY * tileSize; y < (tileY + 1) * tileSize; y++) {
+				const float* row = &depth[y * width + tileX * tileSize];
+				for (UINT x = 0; x < tileSize; x += 4) {
+					tileMax = _mm_max_ps(tileMax, _mm_loadu_ps(&row[x]));
+				}
+			}
+			tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(1, 0, 3, 2)));
+			tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(2, 3, 0, 1)));
+			tileMaxDepth[tileY * tilesX + tileX] = _mm_cvtss_f32(tileMax);
+		}
+	}
+}
+
+bool OcclusionBuffer::isRectOccluded(float minX, float maxX, float minY, float maxY, float nearestDepth) const {
+	// Also refuses NaNs.
+	if (!(maxX >= 0.0f && minX < (float)width && maxY >= 0.0f && minY < (float)height)) {
+		return false;
+	}
+	// Every pixel the rectangle touches, grown by a pixel for partly covered ones, has to have something in front of the box's nearest point.
+	const int x0 = std::max(0, (int)std::floor(std::max(minX, 0.0f)) - 1);
+	const int x1 = std::min((int)width - 1, (int)std::floor(std::min(maxX, (float)width)) + 1);
+	const int y0 = std::max(0, (int)std::floor(std::max(minY, 0.0f)) - 1);
+	const int y1 = std::min((int)height - 1, (int)std::floor(std::min(maxY, (float)height)) + 1);
+	const int tile = (int)tileSize;
+	for (int tileY = y0 / tile; tileY <= y1 / tile; tileY++) {
+		for (int tileX = x0 / tile; tileX <= x1 / tile; tileX++) {
+			if (tileMaxDepth[tileY * tilesX + tileX] < nearestDepth) {
+				continue;
+			}
+			const int pixelY1 = std::min(y1, (tileY + 1) * tile - 1);
+			const int pixelX1 = std::min(x1, (tileX + 1) * tile - 1);
+			for (int y = std::max(y0, tileY * tile); y <= pixelY1; y++) {
+				for (int x = std::max(x0, tileX * tile); x <= pixelX1; x++) {
+					if (depth[y * width + x] >= nearestDepth) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+UINT OcclusionBuffer::getWidth() const {
+	return width;
+}
+
+UINT OcclusionBuffer::getHeight() const {
+	return height;
+}
+
+UINT OcclusionBuffer::getBandCount() const {
+	return height / bandHeight;
+}
+
+UINT OcclusionBuffer::getTriangleCount() const {
+	return (UINT)triangles.size();
+}
+
+float OcclusionBuffer::getDepth(UINT x, UINT y) const {
+	return depth[y * width + x];
+}
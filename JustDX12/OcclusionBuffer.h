@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the rasterizer can be built and checked off Windows too.
+typedef unsigned int UINT;
+#endif
+
+// Screen space half of SoftwareOcclusion: the depth buffer, its per tile farthest depth and the occluder triangles
+// rasterized into it, without the projection or the ThreadPool. Pixels are y down, depth goes from 0 at the near plane to 1.
+// Results are conservative, a box is only occluded if it's really hidden: triangles write the pixels whose centers they cover
+// with the farthest depth they reach anywhere in the pixel, and boxes are tested against a one pixel border around every
+// pixel they touch. An occluder edge crossing a pixel the box shows through always leaves a neighbouring pixel center
+// outside that occluder, so partly covered pixels (or centers covered by float rounding) can't hide anything.
+// Shared edges inside a mesh leave no gaps, since one of the two triangles always covers the pixel center.
+// What's left is a gap between separate occluders narrower than a pixel, with pixel centers covered on both sides,
+// which is treated as closed, and a mesh folding inside a pixel, which takes the depth of the triangle covering its center.
+class OcclusionBuffer {
+public:
+	// 'width' has to be a multiple of 4, both sizes multiples of 'tileSize', and the height a multiple of 'bandHeight',
+	// itself a multiple of 'tileSize'.
+	OcclusionBuffer(UINT width, UINT height, UINT tileSize, UINT bandHeight);
+
+	void clearTriangles();
+	// Vertices in pixels with their depth. Triangles that are degenerate or entirely outside the buffer are dropped.
+	void addTriangle(const float x[3], const float y[3], const float z[3]);
+	// Clears the band's rows and rasterizes every triangle into them. Bands share no pixels or tiles, so they can run in parallel.
+	void rasterizeBand(UINT band);
+	// True if every pixel the rectangle (in pixels) touches, and the ones around them, have something in front of 'nearestDepth'.
+	bool isRectOccluded(float minX, float maxX, float minY, float maxY, float nearestDepth) const;
+
+	UINT getWidth() const;
+	UINT getHeight() const;
+	UINT getBandCount() const;
+	UINT getTriangleCount() const;
+	float getDepth(UINT x, UINT y) const;
+
+private:
+	// Edge functions and depth plane in pixel space, set up once when the triangle is added so bands only evaluate them.
+	struct Triangle {
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+	};
+
+	UINT width;
+	UINT height;
+	UINT tileSize;
+	UINT bandHeight;
+	UINT tilesX;
+
+	std::vector<Triangle> triangles;
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+};
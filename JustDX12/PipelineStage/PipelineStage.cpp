@@ -257,6 +257,15 @@ void PipelineStage::buildShaders(std::vector<ShaderDesc> shaderDescs) {
 }
 
 void PipelineStage::buildInputLayout() {
+#ifdef COMPACT_VERTICES
+	// Matches CompactVertex, the vertex shader has to decode it (see COMPACT_VERTICES in Common.hlsl).
+	inputLayout = {
+		{"POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
+		{"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
+		{"TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
+		{"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA}
+	};
+#else
 	inputLayout = {
 		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
 		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
@@ -264,6 +273,7 @@ void PipelineStage::buildInputLayout() {
 		{"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0 , 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA},
 		{"BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0 , 44, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA}
 	};
+#endif
 }
 
 void PipelineStage::buildPSO() {
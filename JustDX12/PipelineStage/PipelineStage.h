@@ -1,5 +1,4 @@
 #pragma once
-#define NOMINMAX
 #include <vector>
 #include <wrl.h>
 #include <d3d12.h>
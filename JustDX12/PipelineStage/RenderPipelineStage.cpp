@@ -34,6 +34,9 @@ void RenderPipelineStage::setup(PipeLineStageDesc stageDesc) {
 			else if (iter->slot == renderStageDesc.perMeshTextureSlot) {
 				iter = rootParameterDescs[i].erase(iter);
 			}
+			else if (iter->slot == renderStageDesc.instanceCountSlot) {
+				iter = rootParameterDescs[i].erase(iter);
+			}
 			else {
 				iter++;
 			}
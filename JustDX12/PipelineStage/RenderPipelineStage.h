@@ -27,12 +27,18 @@ struct RenderPipelineDesc {
 	// If set to true, the resource specified by 'VrsTextureName' will be bound (assuming VRS tier 2 support)
 	bool supportsVRS = false;
 	std::string VrsTextureName = "VRS";
-	// What root parameter 'slot' does the HLSL shader expect PerObject transform data to be in?
+	// What root parameter 'slot' does the HLSL shader expect PerObject transform data to be in? (root SRV, StructuredBuffer<float4x4>)
 	int perObjTransformCBSlot = -1;
 	// What root parameter 'slot' does the HLSL shader expect PerMesh transform data to be in?
 	// Used in combination with PerObject transform to find a final toWorld transform
 	// Not used in meshlets.
 	int perMeshTransformCBSlot = -1;
+	// What root parameter 'slot' does the HLSL shader expect the instance counts to be in? (2 root constants: PerObject count, PerMesh count)
+	// Needed since the transform StructuredBuffers are bound as root SRVs, which don't know their own size.
+	int instanceCountSlot = -1;
+	// What root parameter 'slot' does the HLSL shader expect the mesh's position dequantization to be in? (8 root constants: offset, scale as float4s)
+	// Only needed for COMPACT_VERTICES, whose positions are relative to each mesh's bounds.
+	int vertexDequantizeSlot = -1;
 	// What root parameter 'slot' does the HLSL shader expect the SRV range associated with textures to be in?
 	int perMeshTextureSlot = -1;
 };
@@ -49,8 +55,12 @@ public:
 	// Data associated with culling
 	// TODO: give a better interface to this data
 	DirectX::BoundingFrustum frustrum;
+	// Untransposed, matches frustrum (so also frozen along with it).
+	DirectX::XMFLOAT4X4 viewProj = {};
 	bool frustrumCull = false;
 	DirectX::XMFLOAT3 eyePos = {};
+	// Pixels covered by one unit at a distance of one unit along the view direction (projection's y scale * half the height).
+	float pixelsPerUnit = 1.0f;
 	bool VRS = false;
 	bool occlusionCull = true;
 protected:
@@ -0,0 +1,43 @@
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "RadixSort.h"
+
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+	const size_t count = items.size();
+	if (count < 2) {
+		return;
+	}
+	scratch.resize(count);
+
+	// Histograms for every byte in a single read of the keys.
+	std::array<std::array<UINT, 256>, 8> histograms = {};
+	for (const auto& item : items) {
+		for (int byte = 0; byte < 8; byte++) {
+			histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	SortItem* source = items.data();
+	SortItem* destination = scratch.data();
+	for (int byte = 0; byte < 8; byte++) {
+		auto& histogram = histograms[byte];
+		if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count) {
+			continue;
+		}
+		UINT offset = 0;
+		for (auto& bucket : histogram) {
+			UINT bucketSize = bucket;
+			bucket = offset;
+			offset += bucketSize;
+		}
+		for (size_t i = 0; i < count; i++) {
+			destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+	if (source != items.data()) {
+		items.swap(scratch);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// Only plain integers are needed, so the sort can be built and checked off Windows too.
+#include <cstdint>
+typedef unsigned int UINT;
+typedef std::uint64_t UINT64;
+#endif
+
+struct SortItem {
+	UINT64 key;
+	UINT value;
+};
+
+// Stable LSD radix sort on the key, a byte at a time. Bytes that are the same in every key are skipped,
+// so keys that only use a few of their bits cost a few passes. 'scratch' is only there so its memory gets reused.
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
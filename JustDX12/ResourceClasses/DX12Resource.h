@@ -1,5 +1,4 @@
 #pragma once
-#define NOMINMAX
 #include <wrl.h>
 #include <d3d12.h>
 #include <d3dx12.h>
@@ -49,7 +49,10 @@ void RtRenderPipelineStage::rebuildRtData(std::vector<std::shared_ptr<SimpleMode
 	std::vector<DescriptorJob> vertexJobVec;
 	std::vector<DescriptorJob> transformJobVec;
 	UINT index = 0;
+	GeometryPool& geometryPool = GeometryPool::getInstance();
 	for (auto& model : RtModels) {
+		UINT vertexOffset = model->getVertexOffset();
+		UINT indexOffset = model->getIndexOffset();
 		for (auto& mesh : model->meshes) {
 			for (UINT i = 0; i < mesh.getInstanceCount(); i++) {
 				std::vector<DescriptorJob> meshJobs = buildMeshTexturesDescriptorJobs(&mesh);
@@ -57,16 +60,16 @@ void RtRenderPipelineStage::rebuildRtData(std::vector<std::shared_ptr<SimpleMode
 
 				DescriptorJob bufferJob;
 				bufferJob.autoDesc = false;
-				bufferJob.view.srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+				// Typed in the mesh's index format, so shaders read 16 and 32 bit indices the same way.
+				bufferJob.view.srvDesc.Format = mesh.indexFormat;
 				bufferJob.view.srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 				bufferJob.view.srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-				bufferJob.view.srvDesc.Buffer.FirstElement = mesh.startIndexLocation / 3;
+				bufferJob.view.srvDesc.Buffer.FirstElement = mesh.getPoolStartIndexLocation(indexOffset);
 				bufferJob.view.srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-				// Since we're using triangle list format, it's more efficient to read 3 values at once.
-				bufferJob.view.srvDesc.Buffer.NumElements = mesh.indexCount / 3;
-				bufferJob.view.srvDesc.Buffer.StructureByteStride = 12;
+				bufferJob.view.srvDesc.Buffer.NumElements = mesh.indexCount;
+				bufferJob.view.srvDesc.Buffer.StructureByteStride = 0;
 				bufferJob.directBinding = true;
-				bufferJob.directBindingTarget = model->indexBuffer.get();
+				bufferJob.directBindingTarget = geometryPool.getIndexResource();
 				bufferJob.type = DESCRIPTOR_TYPE_SRV;
 				bufferJob.usage = DESCRIPTOR_USAGE_SYSTEM_DEFINED;
 				indexJobVec.push_back(bufferJob);
@@ -74,19 +77,19 @@ void RtRenderPipelineStage::rebuildRtData(std::vector<std::shared_ptr<SimpleMode
 				bufferJob.view.srvDesc.Format = DXGI_FORMAT_UNKNOWN;
 				bufferJob.view.srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 				bufferJob.view.srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-				bufferJob.view.srvDesc.Buffer.FirstElement = mesh.baseVertexLocation;
+				bufferJob.view.srvDesc.Buffer.FirstElement = vertexOffset + mesh.baseVertexLocation;
 				bufferJob.view.srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 				bufferJob.view.srvDesc.Buffer.NumElements = mesh.vertexCount;
 				bufferJob.view.srvDesc.Buffer.StructureByteStride = model->vertexByteStride;
-				bufferJob.directBindingTarget = model->vertexBuffer.get();
+				bufferJob.directBindingTarget = geometryPool.getVertexResource();
 				vertexJobVec.push_back(bufferJob);
 
-				// Each instance needs a CBV since we have a transform associated with each mesh
+				// Each instance needs an SRV since we have a transform associated with each mesh
 				// For now, this is fine, but should either refactor to not be super wasteful, or refactor to remove submesh instancing.
 				bufferJob.view.srvDesc.Format = DXGI_FORMAT_UNKNOWN;
 				bufferJob.view.srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 				bufferJob.view.srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-				bufferJob.view.srvDesc.Buffer.FirstElement = i;
+				bufferJob.view.srvDesc.Buffer.FirstElement = mesh.getTransformOffset() + i;
 				bufferJob.view.srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 				bufferJob.view.srvDesc.Buffer.NumElements = 1;
 				bufferJob.view.srvDesc.Buffer.StructureByteStride = sizeof(DirectX::XMFLOAT4X4);
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#include "SceneBVH.h"
+
+SceneBVH& SceneBVH::getInstance() {
+	static SceneBVH instance;
+	return instance;
+}
+
+BVHNodeHandle SceneBVH::insert(const DirectX::BoundingBox& box, const Model* model, UINT instance) {
+	std::unique_lock<std::shared_mutex> lk(treeLock);
+	return tree.insert(toAABB(box), model, instance);
+}
+
+void SceneBVH::remove(BVHNodeHandle leaf) {
+	std::unique_lock<std::shared_mutex> lk(treeLock);
+	tree.remove(leaf);
+}
+
+void SceneBVH::move(BVHNodeHandle leaf, const DirectX::BoundingBox& box) {
+	std::unique_lock<std::shared_mutex> lk(treeLock);
+	tree.move(leaf, toAABB(box));
+}
+
+void SceneBVH::query(const DirectX::BoundingFrustum& frustum, std::vector<SceneBVHResult>& results) {
+	DirectX::XMVECTOR planeVectors[6];
+	frustum.GetPlanes(&planeVectors[0], &planeVectors[1], &planeVectors[2], &planeVectors[3], &planeVectors[4], &planeVectors[5]);
+	std::array<std::array<float, 4>, 6> planes;
+	for (int i = 0; i < 6; i++) {
+		DirectX::XMFLOAT4 plane;
+		DirectX::XMStoreFloat4(&plane, planeVectors[i]);
+		planes[i] = { plane.x, plane.y, plane.z, plane.w };
+	}
+
+	std::shared_lock<std::shared_mutex> lk(treeLock);
+	tree.query(planes, results);
+}
+
+static bool modelOrder(const SceneBVHResult& a, const SceneBVHResult& b) {
+	return std::less<const Model*>()(a.model, b.model);
+}
+
+void SceneBVH::groupByModel(std::vector<SceneBVHResult>& results) {
+	std::sort(results.begin(), results.end(), modelOrder);
+}
+
+std::span<const SceneBVHResult> SceneBVH::findInstances(const std::vector<SceneBVHResult>& results, const Model* model) {
+	auto range = std::equal_range(results.begin(), results.end(), SceneBVHResult{ model, 0, false }, modelOrder);
+	return std::span<const SceneBVHResult>(range.first, range.second);
+}
+
+UINT SceneBVH::getLeafCount() {
+	std::shared_lock<std::shared_mutex> lk(treeLock);
+	return tree.getLeafCount();
+}
+
+int SceneBVH::getHeight() {
+	std::shared_lock<std::shared_mutex> lk(treeLock);
+	return tree.getHeight();
+}
+
+BVHTree::AABB SceneBVH::toAABB(const DirectX::BoundingBox& box) {
+	BVHTree::AABB result;
+	result.minimum = { box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z };
+	result.maximum = { box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z };
+	return result;
+}
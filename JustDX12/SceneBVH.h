@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <span>
+#include <vector>
+#include <shared_mutex>
+#include <DirectXCollision.h>
+
+#include "BVHTree.h"
+#include "Settings.h"
+
+// Singleton dynamic AABB tree over the world space bounds of every loaded model instance.
+// The tree itself is BVHTree, this converts DirectXMath bounds and frustums for it and lets the loader threads
+// change it while the stages query it.
+class SceneBVH {
+private:
+	SceneBVH() = default;
+	SceneBVH(SceneBVH const&) = delete;
+	void operator=(SceneBVH const&) = delete;
+
+public:
+	static SceneBVH& getInstance();
+
+	BVHNodeHandle insert(const DirectX::BoundingBox& box, const Model* model, UINT instance);
+	void remove(BVHNodeHandle leaf);
+	// Updates the bounds of 'leaf', only touches the tree if the new box escaped the fattened one.
+	void move(BVHNodeHandle leaf, const DirectX::BoundingBox& box);
+
+	// Clears 'results' and fills it with every instance whose bounds touch the frustum.
+	void query(const DirectX::BoundingFrustum& frustum, std::vector<SceneBVHResult>& results);
+	// Sorts query results so the instances of each model are next to each other, needed by findInstances.
+	static void groupByModel(std::vector<SceneBVHResult>& results);
+	// Visible instances of 'model' in results that went through groupByModel, empty if it was culled.
+	static std::span<const SceneBVHResult> findInstances(const std::vector<SceneBVHResult>& results, const Model* model);
+
+	UINT getLeafCount();
+	int getHeight();
+
+private:
+	static BVHTree::AABB toAABB(const DirectX::BoundingBox& box);
+
+	std::shared_mutex treeLock;
+
+	BVHTree tree{ BVH_FAT_MARGIN };
+};
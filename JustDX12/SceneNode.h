@@ -15,6 +15,9 @@ public:
 	const SceneNode* findNode(std::string name) const;
 
 	DirectX::XMFLOAT4X4 getFullTransform() const;
+	const std::vector<std::unique_ptr<SceneNode>>& getChildren() const {
+		return children;
+	}
 
 	std::string name;
 	DirectX::XMFLOAT4X4 transform;
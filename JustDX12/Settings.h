@@ -15,7 +15,90 @@
 #define GPU_DEBUG true
 
 #define MAX_LIGHTS 10
-#define MAX_INSTANCES 15
+// Starting size (in transforms) of the TransformArena GPU buffers, they grow as needed.
+#define INITIAL_TRANSFORM_ARENA_CAPACITY 1024
+// Starting size (in draws) of the per frame ExecuteIndirect argument buffers, they grow as needed.
+#define INITIAL_INDIRECT_DRAW_CAPACITY 1024
+// Starting size (in transforms) of the per frame buffers holding the world transforms of automatically instanced meshes.
+#define INITIAL_INSTANCE_GROUP_CAPACITY 1024
+// Starting size of the GeometryPool buffers (in vertices and 32 bit index words), it never compacts below this.
+#define GEOMETRY_POOL_INITIAL_VERTICES (1u << 18)
+#define GEOMETRY_POOL_INITIAL_INDICES (3u << 18)
+// SimpleModel meshes with at most 65536 vertices get 16 bit indices in the GeometryPool.
+#define SHORT_INDICES true
+// Stores SimpleModel vertices in the GeometryPool as CompactVertex (quantized position, octahedral normal and tangent, half UVs).
+#define COMPACT_VERTICES
+
+// Saves each imported SimpleModel next to its source with MODEL_CACHE_EXTENSION added, later loads use it instead of assimp
+// as long as the source and the import settings haven't changed since.
+#define CACHE_IMPORTED_MODELS true
+#define MODEL_CACHE_EXTENSION ".cache"
+
+// Reorders each SimpleModel mesh's triangles and vertices at import for the post transform cache and less overdraw.
+#define OPTIMIZE_MESH_ORDER true
+// Welds SimpleModel vertices at import whose attributes all match to within these (per component), before OPTIMIZE_MESH_ORDER runs.
+#define WELD_VERTICES true
+#define WELD_POSITION_EPSILON 1e-5f
+#define WELD_NORMAL_EPSILON 1e-3f
+#define WELD_TANGENT_EPSILON 1e-3f
+#define WELD_TEXCOORD_EPSILON 1e-5f
+// Entries in the FIFO vertex cache the mesh optimizer targets and reports ACMR/ATVR against.
+#define VERTEX_CACHE_SIZE 16
+// Logs what welding, OPTIMIZE_MESH_ORDER (measured ACMR/ATVR), the LODs and index packing did to each imported SimpleModel.
+#define LOG_MODEL_IMPORT_STATS false
+// How far above the mesh's ACMR a triangle cluster's can be before it stops being split for overdraw ordering.
+#define OVERDRAW_CLUSTER_THRESHOLD 1.05f
+// Levels of detail SimpleModel builds per mesh at import (counting the full one), each aiming for MESH_LOD_REDUCTION of the last's triangles.
+#define MESH_LOD_COUNT 4
+#define MESH_LOD_REDUCTION 0.5f
+// A level keeping more than this fraction of the last one's triangles isn't worth its indices and ends the chain.
+#define MESH_LOD_MIN_REDUCTION 0.85f
+// Cost of normal and UV differences when simplifying, in units of the mesh's bounding radius per unit of difference.
+#define MESH_LOD_NORMAL_WEIGHT 0.05f
+#define MESH_LOD_TEXCOORD_WEIGHT 0.05f
+// Most a coarser level's error can cover on screen (pixels) before ModelRenderPipelineStage falls back to a finer one.
+#define MESH_LOD_PIXEL_ERROR 1.0f
+// Limits for meshlets built from .obj files when a MeshletModel has no cooked .bin, neither can be more than MESHLET_GROUP_SIZE.
+#define MESHLET_MAX_VERTICES 32
+#define MESHLET_MAX_PRIMITIVES 32
+// How much built meshlets favour triangles facing the same way over sharing vertices, higher gives fewer degenerate normal cones.
+#define MESHLET_CONE_WEIGHT 0.5f
+// Views around each built mesh its meshlet backface cull rate is estimated from.
+#define MESHLET_CULL_VIEW_SAMPLES 64
+// Builds a cluster LOD hierarchy for built meshlets, stored in the file next to the full detail meshlets.
+#define MESHLET_BUILD_LODS true
+// Clusters simplified together per group when building the hierarchy, bigger groups give the simplifier more room.
+#define MESHLET_LOD_GROUP_SIZE 4
+// Writes meshlets built at load time next to the .obj as the .bin the MeshletModel asked for, so the next load skips building.
+#define SAVE_BUILT_MESHLETS true
+// Saves built meshlets as a chunked file with delta coded indices and meshlets and bit packed primitives.
+#define COMPRESS_BUILT_MESHLETS true
+// Also stores their vertices as 16 bit per component, lossy, so the next load won't match this one exactly.
+#define QUANTIZE_BUILT_MESHLETS false
+// Alignment of each mesh buffer in a MeshletUploadBatch's staging buffer.
+#define MESHLET_UPLOAD_ALIGNMENT 16
+// Hardware limit on amplification shader groups in a single DispatchMesh.
+#define MAX_AS_DISPATCH_GROUPS (1u << 22)
+// How much (as a fraction of its size) a SceneBVH leaf's box is grown by, so small movements don't restructure the tree.
+#define BVH_FAT_MARGIN 0.1f
+// Size of the CPU occlusion depth buffer, the width has to be a multiple of 4 and both have to be multiples of the tile size.
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+#define OCCLUSION_TILE_SIZE 8
+// Rows rasterized by each ThreadPool task, has to be a multiple of the tile size.
+#define OCCLUSION_BAND_HEIGHT 16
+// Most occluder triangles rasterized in a frame.
+#define OCCLUSION_TRIANGLE_BUDGET 32768
+// Meshes smaller than this (bounding radius over distance) aren't worth rasterizing as occluders.
+#define OCCLUSION_MIN_OCCLUDER_SIZE 0.1f
+// Frames a cached visible result is trusted for before the instance is due to be tested again.
+#define VISIBILITY_REVALIDATION_AGE 16
+// Most model instances revalidated in a single frame.
+#define VISIBILITY_REVALIDATION_BUDGET 64
+// How far the camera can move (in world units) or turn (in degrees) from where cached visible results were tested before
+// they all have to be tested again.
+#define VISIBILITY_VIEW_MAX_MOVE 100.0f
+#define VISIBILITY_VIEW_MAX_TURN 2.0f
 
 #define MOVE_SPEED 3000.0f
 #define RUN_MULTIPLIER 4.0f
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cfloat>
+#include <memory>
+
+#include "SoftwareOcclusion.h"
+#include "ThreadPool.h"
+#include "Tasks/Task.h"
+
+constexpr UINT occlusionBandCount = OCCLUSION_BUFFER_HEIGHT / OCCLUSION_BAND_HEIGHT;
+
+class RasterBandTask : public Task {
+public:
+	RasterBandTask(std::shared_ptr<SoftwareOcclusion::RasterJob> job) : Task() {
+		this->job = job;
+	}
+	void execute() override {
+		SoftwareOcclusion::rasterizeBands(*job);
+	}
+	~RasterBandTask() override = default;
+private:
+	std::shared_ptr<SoftwareOcclusion::RasterJob> job;
+};
+
+SoftwareOcclusion::SoftwareOcclusion() : buffer(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT, OCCLUSION_TILE_SIZE, OCCLUSION_BAND_HEIGHT) {
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixIdentity());
+}
+
+void SoftwareOcclusion::beginFrame(DirectX::FXMMATRIX viewProj) {
+	DirectX::XMStoreFloat4x4(&this->viewProj, viewProj);
+	buffer.clearTriangles();
+	triangleBudget = OCCLUSION_TRIANGLE_BUDGET;
+}
+
+bool SoftwareOcclusion::addOccluder(std::span<const DirectX::XMFLOAT3> positions, std::span<const UINT> indices, DirectX::FXMMATRIX world) {
+	const UINT triangleCount = (UINT)indices.size() / 3;
+	if (triangleCount > triangleBudget) {
+		return false;
+	}
+	triangleBudget -= triangleCount;
+
+	DirectX::XMMATRIX worldViewProj = DirectX::XMMatrixMultiply(world, DirectX::XMLoadFloat4x4(&viewProj));
+	clipPositions.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++) {
+		DirectX::XMStoreFloat4(&clipPositions[i], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[i]), worldViewProj));
+	}
+	for (UINT i = 0; i < triangleCount; i++) {
+		setupTriangle(clipPositions[indices[i * 3]], clipPositions[indices[i * 3 + 1]], clipPositions[indices[i * 3 + 2]]);
+	}
+	return true;
+}
+
+void SoftwareOcclusion::rasterize() {
+	auto job = std::make_shared<RasterJob>();
+	job->occlusion = this;
+	// The stage thread takes bands too, so a ThreadPool that's busy loading models only makes this slower, never stuck.
+	for (UINT i = 1; i < occlusionBandCount; i++) {
+		ThreadPool::enqueue(new RasterBandTask(job));
+	}
+	rasterizeBands(*job);
+
+	UINT done = job->bandsDone.load();
+	while (done < occlusionBandCount) {
+		job->bandsDone.wait(done);
+		done = job->bandsDone.load();
+	}
+}
+
+bool SoftwareOcclusion::isOccluded(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world) const {
+	DirectX::XMMATRIX worldViewProj = DirectX::XMMatrixMultiply(world, DirectX::XMLoadFloat4x4(&viewProj));
+	DirectX::XMFLOAT3 corners[DirectX::BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float nearestDepth = FLT_MAX;
+	for (const auto& corner : corners) {
+		DirectX::XMFLOAT4 clip;
+		DirectX::XMStoreFloat4(&clip, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&corner), worldViewProj));
+		if (clip.z < 0.0f) {
+			return false;
+		}
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+		float y = (0.5f - clip.y * invW * 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::min(nearestDepth, clip.z * invW);
+	}
+
+	return buffer.isRectOccluded(minX, maxX, minY, maxY, nearestDepth);
+}
+
+UINT SoftwareOcclusion::getTriangleCount() const {
+	return buffer.getTriangleCount();
+}
+
+void SoftwareOcclusion::rasterizeBands(RasterJob& job) {
+	UINT band;
+	while ((band = job.nextBand.fetch_add(1)) < occlusionBandCount) {
+		job.occlusion->buffer.rasterizeBand(band);
+		if (job.bandsDone.fetch_add(1) + 1 == occlusionBandCount) {
+			job.bandsDone.notify_all();
+		}
+	}
+}
+
+void SoftwareOcclusion::setupTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2) {
+	// Clipping isn't worth it for occluders, anything touching the near plane is just dropped.
+	if (v0.z < 0.0f || v1.z < 0.0f || v2.z < 0.0f) {
+		return;
+	}
+	const DirectX::XMFLOAT4* clip[3] = { &v0, &v1, &v2 };
+	float x[3];
+	float y[3];
+	float z[3];
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / clip[i]->w;
+		x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+		y[i] = (0.5f - clip[i]->y * invW * 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+		z[i] = clip[i]->z * invW;
+	}
+
+	buffer.addTriangle(x, y, z);
+}
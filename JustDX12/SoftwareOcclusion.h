@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <span>
+#include <vector>
+#include <DirectXCollision.h>
+
+#include "OcclusionBuffer.h"
+#include "Settings.h"
+
+// Low resolution CPU depth buffer that a few large occluders get rasterized into each frame,
+// so bounding boxes hidden behind them can be thrown out before any draws are recorded.
+// This projects occluders and boxes, the OcclusionBuffer rasterizes them: its bands of rows are rasterized in parallel
+// on the ThreadPool, testing coverage for 4 pixels at a time with SSE, and every tile keeps the farthest depth in it
+// so most box tests never have to look at single pixels. Box tests are conservative apart from sub-pixel gaps between
+// separate occluders (see OcclusionBuffer).
+class SoftwareOcclusion {
+public:
+	SoftwareOcclusion();
+
+	// Drops last frame's occluders, viewProj is the (untransposed) matrix boxes and occluders get projected with.
+	void beginFrame(DirectX::FXMMATRIX viewProj);
+	// Queues every triangle of an occluder, indices are relative to 'positions'.
+	// Returns false without adding anything if the triangles don't fit in what's left of the frame's budget.
+	bool addOccluder(std::span<const DirectX::XMFLOAT3> positions, std::span<const UINT> indices, DirectX::FXMMATRIX world);
+	// Rasterizes all queued occluders, blocks until every band is done.
+	void rasterize();
+	// True if the local box, moved into world space by 'world', is entirely behind the rasterized occluders.
+	// Boxes that cross the near plane are never occluded.
+	bool isOccluded(const DirectX::BoundingBox& box, DirectX::FXMMATRIX world) const;
+
+	UINT getTriangleCount() const;
+
+private:
+	// Shared between the stage thread and the band tasks, tasks that only start after the frame is done
+	// find no band left to claim and never touch the SoftwareOcclusion they point to.
+	struct RasterJob {
+		SoftwareOcclusion* occlusion;
+		std::atomic<UINT> nextBand = 0;
+		std::atomic<UINT> bandsDone = 0;
+	};
+	friend class RasterBandTask;
+
+	static void rasterizeBands(RasterJob& job);
+	void setupTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2);
+
+	DirectX::XMFLOAT4X4 viewProj;
+	UINT triangleBudget = 0;
+
+	std::vector<DirectX::XMFLOAT4> clipPositions;
+	OcclusionBuffer buffer;
+};
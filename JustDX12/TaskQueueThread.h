@@ -3,7 +3,6 @@
 #include <queue>
 #include <thread>
 #include <condition_variable>
-#define NOMINMAX
 
 // Base class that represents a CPU thread that runs through a list of enqueued commands
 // An implementation similar to the Command pattern (though a little different)
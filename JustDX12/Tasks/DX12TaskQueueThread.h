@@ -3,7 +3,6 @@
 #include <queue>
 #include <thread>
 #include <condition_variable>
-#define NOMINMAX
 #include <wrl.h>
 #include <d3d12.h>
 #include "FrameResource.h"
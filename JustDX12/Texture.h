@@ -1,5 +1,4 @@
 #pragma once
-#define NOMINMAX
 #include <string>
 #include <wrl.h>
 
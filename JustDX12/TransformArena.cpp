@@ -0,0 +1,100 @@
+#include "TransformArena.h"
+#include "DX12App.h"
+
+TransformArena::TransformArena(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice) {
+	gpuBuffer = std::make_unique<DX12StructuredBuffer>((UINT)sizeof(DirectX::XMFLOAT4X4A), INITIAL_TRANSFORM_ARENA_CAPACITY, d3dDevice.Get());
+}
+
+TransformArena& TransformArena::getInstance() {
+	static TransformArena instance(DX12App::getDevice());
+	return instance;
+}
+
+void TransformArena::destroyAll() {
+	auto& instance = TransformArena::getInstance();
+	std::lock_guard<std::mutex> lk(instance.arenaLock);
+	instance.gpuBuffer.reset();
+}
+
+TransformHandle TransformArena::allocate(UINT count) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	return slots.allocate(count);
+}
+
+void TransformArena::release(TransformHandle handle) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	slots.release(handle);
+}
+
+void TransformArena::resize(TransformHandle handle, UINT count) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	slots.resize(handle, count);
+}
+
+UINT TransformArena::getCount(TransformHandle handle) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	return slots.getCount(handle);
+}
+
+DirectX::XMFLOAT4X4 TransformArena::get(TransformHandle handle, UINT index) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	return slots.get(handle, index);
+}
+
+void TransformArena::set(TransformHandle handle, UINT index, const DirectX::XMFLOAT4X4& transform) {
+	DirectX::XMFLOAT4X4A aligned;
+	DirectX::XMStoreFloat4x4A(&aligned, DirectX::XMLoadFloat4x4(&transform));
+	std::lock_guard<std::mutex> lk(arenaLock);
+	slots.set(handle, index, aligned);
+}
+
+UINT TransformArena::getOffset(TransformHandle handle) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	return slots.getOffset(handle);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS TransformArena::getGPUVirtualAddress(TransformHandle handle, UINT frameIndex) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	// The block could have been allocated or moved since this frame's submitUpdates, so before the GPU gets pointed at it
+	// the frame's buffer has to cover it and hold its transforms.
+	UINT offset = slots.getOffset(handle);
+	uploadSlots(frameIndex, offset, (size_t)offset + slots.getCount(handle));
+	return gpuBuffer->get(frameIndex)->GetGPUVirtualAddress() + sizeof(DirectX::XMFLOAT4X4A) * (UINT64)offset;
+}
+
+DX12Resource* TransformArena::getResourceForFrame(UINT frameIndex) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	// Descriptors get built from this and any block's offset, so the buffer has to cover the whole arena.
+	uploadSlots(frameIndex, 0, 0);
+	return gpuBuffer->getDX12Resource(frameIndex);
+}
+
+void TransformArena::submitUpdates(UINT frameIndex) {
+	std::lock_guard<std::mutex> lk(arenaLock);
+	uploadSlots(frameIndex, 0, slots.size());
+}
+
+UINT64 TransformArena::getBufferGeneration() const {
+	return bufferGeneration;
+}
+
+void TransformArena::uploadSlots(UINT frameIndex, size_t first, size_t end) {
+	if (gpuBuffer == nullptr || slots.size() == 0) {
+		return;
+	}
+	const BYTE* src = reinterpret_cast<const BYTE*>(slots.data());
+	const size_t stride = sizeof(DirectX::XMFLOAT4X4A);
+
+	if (gpuBuffer->reserve(frameIndex, (UINT)slots.size())) {
+		// Fresh buffer has nothing in it, so the whole arena goes up.
+		memcpy(gpuBuffer->getMappedData(frameIndex), src, slots.size() * stride);
+		slots.clearDirty(frameIndex);
+		bufferGeneration++;
+		return;
+	}
+
+	BYTE* dest = gpuBuffer->getMappedData(frameIndex);
+	slots.takeDirty(frameIndex, first, end, [&](size_t runStart, size_t runLength) {
+		memcpy(dest + runStart * stride, src + runStart * stride, runLength * stride);
+	});
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <DirectXMath.h>
+
+#include "DX12StructuredBuffer.h"
+#include "TransformSlots.h"
+#include "Settings.h"
+
+// Singleton holding every instance transform in the program in one contiguous, 16 byte aligned array
+// Each TransformData owns a block of slots through a handle, writes flag their slot in a per frame dirty bitset,
+// so the per frame upload is a single linear pass over the bitset copying runs of dirty slots into that frame's GPU buffer.
+// All GPU buffers are upload heap StructuredBuffer<float4x4>s, blocks are bound by offsetting into them.
+// The slots and dirty tracking themselves are in TransformSlots, this adds the GPU buffers and the locking.
+class TransformArena {
+private:
+	TransformArena(Microsoft::WRL::ComPtr<ID3D12Device5> d3dDevice);
+	TransformArena(TransformArena const&) = delete;
+	void operator=(TransformArena const&) = delete;
+
+public:
+	static TransformArena& getInstance();
+	// Releases the GPU buffers, has to be called before ResourceDecay::destroyAll().
+	static void destroyAll();
+
+	TransformHandle allocate(UINT count);
+	void release(TransformHandle handle);
+	// Changes the amount of slots in use by 'handle', the block moves if it can't grow in place.
+	// New slots are set to Identity.
+	void resize(TransformHandle handle, UINT count);
+
+	UINT getCount(TransformHandle handle);
+	DirectX::XMFLOAT4X4 get(TransformHandle handle, UINT index);
+	void set(TransformHandle handle, UINT index, const DirectX::XMFLOAT4X4& transform);
+
+	// Index of the first transform of 'handle' in the GPU buffers, for building SRVs into the shared buffer.
+	UINT getOffset(TransformHandle handle);
+	// Both of these make sure the GPU buffer of frame 'frameIndex' is big enough for everything allocated so far, and the address
+	// also gets the block's pending writes uploaded, so blocks added after submitUpdates can be bound in the same frame.
+	D3D12_GPU_VIRTUAL_ADDRESS getGPUVirtualAddress(TransformHandle handle, UINT frameIndex);
+	DX12Resource* getResourceForFrame(UINT frameIndex);
+
+	// Streams every transform dirtied since frame 'frameIndex' was last submitted into that frame's GPU buffer.
+	void submitUpdates(UINT frameIndex);
+	// Incremented whenever a GPU buffer is replaced, anyone holding descriptors into the buffers needs to rebuild them.
+	UINT64 getBufferGeneration() const;
+
+private:
+	// Grows the GPU buffer of frame 'frameIndex' to the arena's size, then copies the dirty slots in [first, end) into it.
+	// Has to be called with arenaLock held, so the arena can't grow or move blocks in between.
+	void uploadSlots(UINT frameIndex, size_t first, size_t end);
+
+	// Held across anything that grows the arena and every upload, so a GPU buffer is never sized for an older arena.
+	std::mutex arenaLock;
+
+	TransformSlots slots{ CPU_FRAME_COUNT, INITIAL_TRANSFORM_ARENA_CAPACITY };
+
+	std::unique_ptr<DX12StructuredBuffer> gpuBuffer;
+	std::atomic<UINT64> bufferGeneration = 0;
+};
@@ -1,53 +1,65 @@
 #pragma once
-#include "DX12ConstantBuffer.h"
-#include "ConstantBufferTypes.h"
+#include "TransformArena.h"
 
+// Per instance transforms for anything that can be instanced (Models and the Meshes inside them)
+// The transforms themselves live in the TransformArena, this just owns a handle to a block of them.
+// Shaders see them as a StructuredBuffer<float4x4> starting at this block, the instance count comes in separately (root constants).
 class TransformData {
 public:
-	TransformData(ID3D12Device5* device) {
-		PerObjectConstants initData;
-		constantBuffer = std::make_unique<DX12ConstantBuffer>(&initData, device);
+	TransformData() {
+		handle = TransformArena::getInstance().allocate(0);
 	}
-	void bindTransformToRoot(int slot, UINT frameIndex, ID3D12GraphicsCommandList* cmdList) {
+	TransformData(const TransformData&) = delete;
+	TransformData& operator=(const TransformData&) = delete;
+	TransformData(TransformData&& other) noexcept {
+		handle = other.handle;
+		other.handle = INVALID_TRANSFORM_HANDLE;
+	}
+	TransformData& operator=(TransformData&& other) noexcept {
+		if (this != &other) {
+			releaseHandle();
+			handle = other.handle;
+			other.handle = INVALID_TRANSFORM_HANDLE;
+		}
+		return *this;
+	}
+	virtual ~TransformData() {
+		releaseHandle();
+	}
+	void bindTransformToRoot(int slot, UINT frameIndex, ID3D12GraphicsCommandList* cmdList) const {
 		if (slot >= 0) {
-			cmdList->SetGraphicsRootConstantBufferView(slot, constantBuffer->get(frameIndex)->GetGPUVirtualAddress());
+			cmdList->SetGraphicsRootShaderResourceView(slot, TransformArena::getInstance().getGPUVirtualAddress(handle, frameIndex));
 		}
 	}
 	DX12Resource* getResourceForFrame(UINT frameIndex) const {
-		return constantBuffer->getDX12Resource(frameIndex);
+		return TransformArena::getInstance().getResourceForFrame(frameIndex);
+	}
+	// Element offset of this object's first transform in the resource returned by getResourceForFrame.
+	UINT getTransformOffset() const {
+		return TransformArena::getInstance().getOffset(handle);
 	}
 	D3D12_GPU_VIRTUAL_ADDRESS getFrameTransformVirtualAddress(UINT instance, UINT frameIndex) const {
-		return constantBuffer->get(frameIndex)->GetGPUVirtualAddress() + offsetof(PerObjectConstants::PerObjectConstantsStruct, World[instance]);
+		return TransformArena::getInstance().getGPUVirtualAddress(handle, frameIndex) + sizeof(DirectX::XMFLOAT4X4A) * (UINT64)instance;
 	}
 	UINT getInstanceCount() const {
-		return transform.data.instanceCount;
+		return TransformArena::getInstance().getCount(handle);
 	}
 	virtual void setInstanceCount(UINT count) {
-		transform.data.instanceCount = count;
-		dirtyFrames = CPU_FRAME_COUNT;
+		TransformArena::getInstance().resize(handle, count);
 	}
 	DirectX::XMFLOAT4X4 getTransform(UINT instance) const {
-		return transform.data.World[instance];
+		return TransformArena::getInstance().get(handle, instance);
 	}
 	virtual void setTransform(UINT index, DirectX::XMFLOAT4X4 newTransform) {
-		transform.data.World[index] = newTransform;
-		dirtyFrames = CPU_FRAME_COUNT;
+		TransformArena::getInstance().set(handle, index, newTransform);
 	}
-	void submitUpdates(UINT index) {
-		if (dirtyFrames > 0) {
-			constantBuffer->prepareUpdateBuffer(&transform);
-			constantBuffer->updateBuffer(index);
-		}
-		dirtyFrames--;
-	}
-	void submitUpdatesAll() {
-		for (UINT i = 0; i < CPU_FRAME_COUNT; i++) {
-			submitUpdates(i);
+private:
+	void releaseHandle() {
+		if (handle != INVALID_TRANSFORM_HANDLE) {
+			TransformArena::getInstance().release(handle);
+			handle = INVALID_TRANSFORM_HANDLE;
 		}
 	}
-private:
-	UINT dirtyFrames = 0;
-	PerObjectConstants transform;
-	std::unique_ptr<DX12ConstantBuffer> constantBuffer;
-};
 
+	TransformHandle handle = INVALID_TRANSFORM_HANDLE;
+};
@@ -0,0 +1,144 @@
+#include <algorithm>
+
+#include "TransformSlots.h"
+
+TransformSlots::TransformSlots(UINT frameCount, UINT initialCapacity) : dirtyBits(frameCount) {
+	transforms.reserve(initialCapacity);
+}
+
+TransformHandle TransformSlots::allocate(UINT count) {
+	Block block;
+	block.capacity = count;
+	block.count = count;
+	block.offset = count > 0 ? allocateRange(count) : 0;
+	setIdentity(block.offset, count);
+	markDirty(block.offset, count);
+
+	TransformHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		blocks[handle] = block;
+	}
+	else {
+		handle = (TransformHandle)blocks.size();
+		blocks.push_back(block);
+	}
+	return handle;
+}
+
+void TransformSlots::release(TransformHandle handle) {
+	Block& block = blocks[handle];
+	if (block.capacity > 0) {
+		releaseRange(block.offset, block.capacity);
+	}
+	block = Block();
+	freeHandles.push_back(handle);
+}
+
+void TransformSlots::resize(TransformHandle handle, UINT count) {
+	Block& block = blocks[handle];
+	if (count > block.capacity) {
+		// Doubling so instance counts creeping up one at a time don't move the block every time.
+		UINT newCapacity = std::max(count, block.capacity * 2);
+		UINT newOffset = allocateRange(newCapacity);
+		std::copy(transforms.begin() + block.offset, transforms.begin() + block.offset + block.count, transforms.begin() + newOffset);
+		if (block.capacity > 0) {
+			releaseRange(block.offset, block.capacity);
+		}
+		block.offset = newOffset;
+		block.capacity = newCapacity;
+		// Block moved, so the old slots are meaningless to the GPU copies.
+		markDirty(block.offset, block.count);
+	}
+	if (count > block.count) {
+		setIdentity((size_t)block.offset + block.count, count - block.count);
+		markDirty(block.offset + block.count, count - block.count);
+	}
+	block.count = count;
+}
+
+UINT TransformSlots::getCount(TransformHandle handle) const {
+	return blocks[handle].count;
+}
+
+UINT TransformSlots::getOffset(TransformHandle handle) const {
+	return blocks[handle].offset;
+}
+
+const DirectX::XMFLOAT4X4A& TransformSlots::get(TransformHandle handle, UINT index) const {
+	return transforms[(size_t)blocks[handle].offset + index];
+}
+
+void TransformSlots::set(TransformHandle handle, UINT index, const DirectX::XMFLOAT4X4A& transform) {
+	UINT slot = blocks[handle].offset + index;
+	transforms[slot] = transform;
+	markDirty(slot, 1);
+}
+
+const DirectX::XMFLOAT4X4A* TransformSlots::data() const {
+	return transforms.data();
+}
+
+size_t TransformSlots::size() const {
+	return transforms.size();
+}
+
+void TransformSlots::clearDirty(UINT frameIndex) {
+	std::fill(dirtyBits[frameIndex].begin(), dirtyBits[frameIndex].end(), 0);
+}
+
+UINT TransformSlots::allocateRange(UINT capacity) {
+	for (auto iter = freeRanges.begin(); iter != freeRanges.end(); iter++) {
+		if (iter->capacity >= capacity) {
+			UINT offset = iter->offset;
+			iter->offset += capacity;
+			iter->capacity -= capacity;
+			if (iter->capacity == 0) {
+				freeRanges.erase(iter);
+			}
+			return offset;
+		}
+	}
+	// Nothing free is big enough, so grow the arena.
+	UINT offset = (UINT)transforms.size();
+	transforms.resize((size_t)offset + capacity);
+	for (auto& frameDirtyBits : dirtyBits) {
+		frameDirtyBits.resize((transforms.size() + 63) / 64, 0);
+	}
+	return offset;
+}
+
+void TransformSlots::releaseRange(UINT offset, UINT capacity) {
+	auto iter = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const FreeRange& range, UINT value) { return range.offset < value; });
+	iter = freeRanges.insert(iter, { offset, capacity });
+	// Merge with the following range, then the preceding one.
+	auto next = iter + 1;
+	if (next != freeRanges.end() && iter->offset + iter->capacity == next->offset) {
+		iter->capacity += next->capacity;
+		freeRanges.erase(next);
+	}
+	if (iter != freeRanges.begin()) {
+		auto prev = iter - 1;
+		if (prev->offset + prev->capacity == iter->offset) {
+			prev->capacity += iter->capacity;
+			freeRanges.erase(iter);
+		}
+	}
+}
+
+void TransformSlots::setIdentity(size_t first, size_t count) {
+	DirectX::XMFLOAT4X4A identity = {};
+	for (int i = 0; i < 4; i++) {
+		identity.m[i][i] = 1.0f;
+	}
+	std::fill(transforms.begin() + first, transforms.begin() + first + count, identity);
+}
+
+void TransformSlots::markDirty(UINT first, UINT count) {
+	for (UINT slot = first; slot < first + count; slot++) {
+		for (auto& frameDirtyBits : dirtyBits) {
+			frameDirtyBits[slot / 64] |= 1ull << (slot % 64);
+		}
+	}
+}
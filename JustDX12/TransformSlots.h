@@ -0,0 +1,121 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#include <DirectXMath.h>
+#else
+#include <cstdint>
+// Only plain integers and the matrix layout are needed, so the slot bookkeeping can be built and checked off Windows too.
+typedef unsigned int UINT;
+typedef std::uint64_t UINT64;
+namespace DirectX {
+	struct alignas(16) XMFLOAT4X4A {
+		float m[4][4];
+	};
+}
+#endif
+
+// Stable reference to a block of transforms in the TransformArena.
+// The block may move inside the arena when it grows, the handle stays valid until it's freed.
+typedef UINT TransformHandle;
+#define INVALID_TRANSFORM_HANDLE UINT_MAX
+
+// The CPU half of the TransformArena (which adds the GPU buffers and locking): one contiguous array of transforms handed out
+// in blocks, with first fit reuse of freed ranges, and a dirty bitset per frame so each frame's upload only walks what changed.
+// Transforms stay one whole matrix per slot, the layout shaders read them in from StructuredBuffer<float4x4>, so a run of
+// dirty slots is a single copy into the GPU buffer.
+class TransformSlots {
+public:
+	TransformSlots(UINT frameCount, UINT initialCapacity);
+
+	// New slots are set to Identity and dirty in every frame.
+	TransformHandle allocate(UINT count);
+	void release(TransformHandle handle);
+	// Changes the amount of slots in use by 'handle', the block moves if it can't grow in place.
+	// New slots are set to Identity.
+	void resize(TransformHandle handle, UINT count);
+
+	UINT getCount(TransformHandle handle) const;
+	// Index of the first transform of 'handle' in the array.
+	UINT getOffset(TransformHandle handle) const;
+	const DirectX::XMFLOAT4X4A& get(TransformHandle handle, UINT index) const;
+	void set(TransformHandle handle, UINT index, const DirectX::XMFLOAT4X4A& transform);
+
+	// Every slot, in use or not, the GPU buffers hold a copy of the whole array.
+	const DirectX::XMFLOAT4X4A* data() const;
+	size_t size() const;
+
+	// Calls copyRun(firstSlot, slotCount) for every run of slots in [first, end) dirtied since frame 'frameIndex' last took
+	// them, and clears their bits. One linear pass over the bitset, neighbouring dirty slots are coalesced into one run.
+	template<typename CopyRun>
+	void takeDirty(UINT frameIndex, size_t first, size_t end, CopyRun&& copyRun);
+	// Clears every dirty bit of frame 'frameIndex', for when its GPU buffer was just given the whole array.
+	void clearDirty(UINT frameIndex);
+
+private:
+	struct Block {
+		UINT offset = 0;
+		UINT count = 0;
+		UINT capacity = 0;
+	};
+	struct FreeRange {
+		UINT offset;
+		UINT capacity;
+	};
+
+	UINT allocateRange(UINT capacity);
+	void releaseRange(UINT offset, UINT capacity);
+	void setIdentity(size_t first, size_t count);
+	void markDirty(UINT first, UINT count);
+
+	std::vector<DirectX::XMFLOAT4X4A> transforms;
+	std::vector<Block> blocks;
+	std::vector<TransformHandle> freeHandles;
+	// Kept sorted by offset so neighbours can be merged on release.
+	std::vector<FreeRange> freeRanges;
+
+	// One bit per slot per frame, since each frame has its own GPU copy that needs to see the write.
+	std::vector<std::vector<UINT64>> dirtyBits;
+};
+
+template<typename CopyRun>
+void TransformSlots::takeDirty(UINT frameIndex, size_t first, size_t end, CopyRun&& copyRun) {
+	end = std::min(end, transforms.size());
+	if (first >= end) {
+		return;
+	}
+	std::vector<UINT64>& dirty = dirtyBits[frameIndex];
+	size_t runStart = 0;
+	size_t runLength = 0;
+	for (size_t word = first / 64; word < (end + 63) / 64; word++) {
+		// Only the bits inside [first, end) of the words at either end.
+		UINT64 mask = ~0ull;
+		if (word == first / 64) {
+			mask &= ~0ull << (first % 64);
+		}
+		if (word == (end - 1) / 64 && end % 64 != 0) {
+			mask &= ~0ull >> (64 - end % 64);
+		}
+		UINT64 bits = dirty[word] & mask;
+		dirty[word] &= ~mask;
+		while (bits != 0) {
+			size_t slot = word * 64 + std::countr_zero(bits);
+			bits &= bits - 1;
+			if (runLength > 0 && slot == runStart + runLength) {
+				runLength++;
+				continue;
+			}
+			if (runLength > 0) {
+				copyRun(runStart, runLength);
+			}
+			runStart = slot;
+			runLength = 1;
+		}
+	}
+	if (runLength > 0) {
+		copyRun(runStart, runLength);
+	}
+}
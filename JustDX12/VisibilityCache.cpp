@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "VisibilityCache.h"
+#include "DX12Helper.h"
+
+#define NEVER_VALIDATED UINT_MAX
+
+void VisibilityCache::addModel() {
+	models.emplace_back();
+}
+
+void VisibilityCache::removeModel(UINT model) {
+	models.erase(models.begin() + model);
+	// Whatever it was hiding might be visible now.
+	epoch++;
+}
+
+void VisibilityCache::beginFrame(const DirectX::XMFLOAT4X4& viewProj, const DirectX::BoundingFrustum& frustum, bool occlusion) {
+	frame++;
+	revalidationBudget = VISIBILITY_REVALIDATION_BUDGET;
+	if (memcmp(&viewProj, &lastViewProj, sizeof(DirectX::XMFLOAT4X4)) != 0 || occlusion != lastOcclusion) {
+		epoch++;
+		lastViewProj = viewProj;
+		lastOcclusion = occlusion;
+	}
+	if (!isNearAnchor(frustum)) {
+		viewEpoch++;
+		anchorView = frustum;
+	}
+}
+
+void VisibilityCache::checkModel(UINT model, UINT transformVersion, UINT instanceCount, UINT meshCount) {
+	ModelVisibility& entry = models[model];
+	if (entry.transformVersion == transformVersion && entry.instanceCount == instanceCount && entry.meshCount == meshCount) {
+		return;
+	}
+	entry.transformVersion = transformVersion;
+	entry.instanceCount = instanceCount;
+	entry.meshCount = meshCount;
+	entry.wordsPerInstance = DivRoundUp(meshCount, 64);
+	entry.epochs.assign(instanceCount, NEVER_VALIDATED);
+	entry.viewEpochs.assign(instanceCount, NEVER_VALIDATED);
+	entry.validatedFrames.assign(instanceCount, 0);
+	entry.meshBits.assign((size_t)instanceCount * entry.wordsPerInstance, 0);
+	// A model that moved could have been hiding something.
+	epoch++;
+}
+
+VisibilityCache::INSTANCE_STATE VisibilityCache::classifyInstance(UINT model, UINT instance) {
+	ModelVisibility& entry = models[model];
+	if (instance >= entry.instanceCount) {
+		return INSTANCE_STATE_TEST_ALL;
+	}
+	INSTANCE_STATE state = INSTANCE_STATE_TRUSTED;
+	if (entry.epochs[instance] == NEVER_VALIDATED || entry.viewEpochs[instance] != viewEpoch) {
+		// Not worth any budget, anything visible from too far away is as good as nothing cached.
+		state = INSTANCE_STATE_TEST_ALL;
+		entry.validatedFrames[instance] = frame;
+	}
+	else if (frame - entry.validatedFrames[instance] >= VISIBILITY_REVALIDATION_AGE && revalidationBudget > 0) {
+		revalidationBudget--;
+		state = INSTANCE_STATE_TEST_ALL;
+		entry.validatedFrames[instance] = frame;
+	}
+	else if (entry.epochs[instance] != epoch) {
+		const UINT64* bits = &entry.meshBits[(size_t)instance * entry.wordsPerInstance];
+		for (UINT word = 0; word < entry.wordsPerInstance; word++) {
+			UINT meshesInWord = std::min(64u, entry.meshCount - word * 64);
+			UINT64 usedBits = meshesInWord == 64 ? ~0ull : (1ull << meshesInWord) - 1;
+			if ((bits[word] & usedBits) != usedBits) {
+				state = INSTANCE_STATE_TEST_HIDDEN;
+				break;
+			}
+		}
+	}
+	entry.epochs[instance] = epoch;
+	if (state == INSTANCE_STATE_TEST_ALL) {
+		entry.viewEpochs[instance] = viewEpoch;
+	}
+	return state;
+}
+
+bool VisibilityCache::isVisible(UINT model, UINT instance, UINT mesh) const {
+	const ModelVisibility& entry = models[model];
+	if (instance >= entry.instanceCount) {
+		return true;
+	}
+	return (entry.meshBits[(size_t)instance * entry.wordsPerInstance + mesh / 64] >> (mesh % 64)) & 1;
+}
+
+void VisibilityCache::setVisible(UINT model, UINT instance, UINT mesh, bool visible) {
+	ModelVisibility& entry = models[model];
+	if (instance >= entry.instanceCount) {
+		return;
+	}
+	UINT64& word = entry.meshBits[(size_t)instance * entry.wordsPerInstance + mesh / 64];
+	if (visible) {
+		word |= 1ull << (mesh % 64);
+	}
+	else {
+		word &= ~(1ull << (mesh % 64));
+	}
+}
+
+void VisibilityCache::addVisibleMeshes(UINT model, UINT instance, std::vector<UINT64>& meshBits) const {
+	const ModelVisibility& entry = models[model];
+	if (instance >= entry.instanceCount) {
+		return;
+	}
+	const UINT64* bits = &entry.meshBits[(size_t)instance * entry.wordsPerInstance];
+	for (UINT word = 0; word < entry.wordsPerInstance && word < meshBits.size(); word++) {
+		meshBits[word] |= bits[word];
+	}
+}
+
+bool VisibilityCache::isNearAnchor(const DirectX::BoundingFrustum& frustum) const {
+	// Zooming or resizing changes what's in view without the camera moving.
+	if (frustum.RightSlope != anchorView.RightSlope || frustum.LeftSlope != anchorView.LeftSlope || frustum.TopSlope != anchorView.TopSlope
+		|| frustum.BottomSlope != anchorView.BottomSlope || frustum.Near != anchorView.Near || frustum.Far != anchorView.Far) {
+		return false;
+	}
+	DirectX::XMVECTOR moved = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&frustum.Origin), DirectX::XMLoadFloat3(&anchorView.Origin));
+	if (DirectX::XMVectorGetX(DirectX::XMVector3Length(moved)) > VISIBILITY_VIEW_MAX_MOVE) {
+		return false;
+	}
+	// Unit quaternions q and -q are the same rotation, the angle between two is 2 * acos(|dot|).
+	DirectX::XMVECTOR dot = DirectX::XMQuaternionDot(DirectX::XMLoadFloat4(&frustum.Orientation), DirectX::XMLoadFloat4(&anchorView.Orientation));
+	return fabsf(DirectX::XMVectorGetX(dot)) >= cosf(DirectX::XMConvertToRadians(VISIBILITY_VIEW_MAX_TURN) * 0.5f);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include "Settings.h"
+
+// Per model instance, per mesh visibility kept from earlier frames, so the cull only tests what could have changed.
+// Visible results are trusted (drawing something hidden only costs the draw) until the instance gets revalidated,
+// which happens to at most VISIBILITY_REVALIDATION_BUDGET instances a frame, or the view moves too far for them.
+// They're all tested from within VISIBILITY_VIEW_MAX_MOVE and VISIBILITY_VIEW_MAX_TURN of an anchor view, once the camera
+// gets farther than that from it (or the projection changes) every instance is tested again and the current view is the new anchor.
+// Hidden results are only trusted while nothing that could reveal them changed, the camera moving, a model moving or
+// being removed, or the culling settings changing all start a new epoch.
+// Models are indexed the same as the owning stage's renderObjects.
+class VisibilityCache {
+public:
+	enum INSTANCE_STATE {
+		// Every result of the instance can be used as is.
+		INSTANCE_STATE_TRUSTED,
+		// Visible results can be used, hidden ones have to be tested again.
+		INSTANCE_STATE_TEST_HIDDEN,
+		// Nothing cached (or it's being revalidated), every mesh has to be tested.
+		INSTANCE_STATE_TEST_ALL
+	};
+
+	void addModel();
+	void removeModel(UINT model);
+
+	// Starts a new epoch if the view or the kind of culling done changed since last frame, and a new anchor view if
+	// 'frustum' is too far from the last one.
+	void beginFrame(const DirectX::XMFLOAT4X4& viewProj, const DirectX::BoundingFrustum& frustum, bool occlusion);
+	// Has to be called for every live model before any instance gets classified, drops the model's results if it changed.
+	void checkModel(UINT model, UINT transformVersion, UINT instanceCount, UINT meshCount);
+	// Only call once per instance per frame, the instance counts as validated this frame once this returns.
+	// Instances the model didn't have when it was checked are always tested and never cached.
+	INSTANCE_STATE classifyInstance(UINT model, UINT instance);
+
+	bool isVisible(UINT model, UINT instance, UINT mesh) const;
+	void setVisible(UINT model, UINT instance, UINT mesh, bool visible);
+	// ORs the instance's visible meshes into 'meshBits' (one bit per mesh).
+	void addVisibleMeshes(UINT model, UINT instance, std::vector<UINT64>& meshBits) const;
+
+private:
+	struct ModelVisibility {
+		// Starts out as something no model has, so the first checkModel always resets it.
+		UINT transformVersion = UINT_MAX;
+		UINT instanceCount = 0;
+		UINT meshCount = 0;
+		UINT wordsPerInstance = 0;
+		std::vector<UINT> epochs;
+		// Anchor view each instance was last tested against.
+		std::vector<UINT> viewEpochs;
+		std::vector<UINT> validatedFrames;
+		// wordsPerInstance words for each instance, one bit per mesh.
+		std::vector<UINT64> meshBits;
+	};
+
+	bool isNearAnchor(const DirectX::BoundingFrustum& frustum) const;
+
+	std::vector<ModelVisibility> models;
+
+	DirectX::XMFLOAT4X4 lastViewProj = {};
+	bool lastOcclusion = false;
+	UINT epoch = 0;
+	DirectX::BoundingFrustum anchorView;
+	UINT viewEpoch = 0;
+	UINT frame = 0;
+	UINT revalidationBudget = 0;
+};
@@ -11,11 +11,11 @@ int2 clampEdges(int2 index, int2 resolution) {
 	return clamp(index, int2(0, 0), resolution - int2(1, 1));
 }
 
-struct PerObject
+// Transforms themselves are in StructuredBuffer<float4x4>s, root SRVs can't report their size so the counts come in as root constants.
+struct InstanceCounts
 {
-	float4x4 world[15];
-	uint instanceCount;
-	float3 padding;
+	uint objectInstanceCount;
+	uint meshInstanceCount;
 };
 
 struct PerPass
@@ -64,6 +64,45 @@ struct SSAOSettings {
 	float4 lightPos;
 };
 
+#ifdef COMPACT_VERTICES
+// CompactVertex as the input assembler sees it, w of PosQ is the bitangent's sign.
+struct VertexIn
+{
+	float4 PosQ : POSITION;
+	float2 NormalOct : NORMAL;
+	float2 TangentOct : TANGENT;
+	float2 TexC : TEXCOORD;
+};
+
+// CompactVertex read straight out of a StructuredBuffer, where nothing converts the formats.
+struct CompactVertex
+{
+	uint2 pos;
+	uint normal;
+	uint tangent;
+	uint texC;
+};
+
+// CompactVertex positions are in [-1, 1] across the mesh's bounds: posL = positionOffset + pos * positionScale.
+struct VertexDequantize
+{
+	float4 positionOffset;
+	float4 positionScale;
+};
+
+float3 OctDecode(float2 e) {
+	float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.x += v.x >= 0.0f ? -t : t;
+	v.y += v.y >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+float2 UnpackSnorm16x2(uint packed) {
+	int2 values = int2(int(packed << 16) >> 16, int(packed) >> 16);
+	return max(float2(values) / 32767.0f, -1.0f);
+}
+#else
 struct VertexIn
 {
 	float2 TexC : TEXCOORD;
@@ -72,6 +111,7 @@ struct VertexIn
 	float3 TangentL : TANGENT;
 	float3 BiNormalL : BINORMAL;
 };
+#endif
 
 struct LiteVertexIn
 {
@@ -1,9 +1,13 @@
 #include "Common.hlsl"
 
-ConstantBuffer<PerObject> PerObjectBuffer : register(b0);
-ConstantBuffer<PerObject> PerMeshBuffer : register(b1);
+StructuredBuffer<float4x4> PerObjectTransforms : register(t0, space1);
+StructuredBuffer<float4x4> PerMeshTransforms : register(t1, space1);
 
-ConstantBuffer<PerPass> PerPass : register(b2);
+ConstantBuffer<PerPass> PerPass : register(b0);
+ConstantBuffer<InstanceCounts> InstanceCounts : register(b1);
+#ifdef COMPACT_VERTICES
+ConstantBuffer<VertexDequantize> VertexDequantize : register(b2);
+#endif
 
 Texture2D gDiffuseMap : register(t0);
 Texture2D gSpecularMap : register(t1);
@@ -16,16 +20,28 @@ VertexOut VS(VertexIn vin, uint instance : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut) 0.0f;
 
-	uint meshID = instance % PerMeshBuffer.instanceCount;
-	uint objID = instance / PerMeshBuffer.instanceCount;
+	uint meshID = instance % InstanceCounts.meshInstanceCount;
+	uint objID = instance / InstanceCounts.meshInstanceCount;
 
-	float4x4 toWorld = mul(PerMeshBuffer.world[meshID], PerObjectBuffer.world[objID]);
+	float4x4 toWorld = mul(PerMeshTransforms[meshID], PerObjectTransforms[objID]);
+
+#ifdef COMPACT_VERTICES
+	float3 posL = VertexDequantize.positionOffset.xyz + vin.PosQ.xyz * VertexDequantize.positionScale.xyz;
+	float3 normalL = OctDecode(vin.NormalOct);
+	float3 tangentL = OctDecode(vin.TangentOct);
+	float3 biNormalL = cross(normalL, tangentL) * vin.PosQ.w;
+#else
+	float3 posL = vin.PosL;
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentL;
+	float3 biNormalL = vin.BiNormalL;
+#endif
     
-	vout.PosW = mul(float4(vin.PosL, 1.0f), toWorld).xyz;
+	vout.PosW = mul(float4(posL, 1.0f), toWorld).xyz;
     
-	vout.NormalW = normalize(mul(vin.NormalL, (float3x3) toWorld));
-	vout.TangentW = normalize(mul(vin.TangentL, (float3x3) toWorld));
-	vout.BiNormalW = normalize(mul(vin.BiNormalL, (float3x3) toWorld));
+	vout.NormalW = normalize(mul(normalL, (float3x3) toWorld));
+	vout.TangentW = normalize(mul(tangentL, (float3x3) toWorld));
+	vout.BiNormalW = normalize(mul(biNormalL, (float3x3) toWorld));
     
 	vout.PosH = mul(float4(vout.PosW, 1.0f), PerPass.ViewProj);
     
@@ -29,8 +29,13 @@ RaytracingAccelerationStructure TLAS : register(t6);
 
 StructuredBuffer<MatrixStruct> transforms[] : register(t0, space4);
 
-Buffer<uint3> indexBuffers[] : register(t0,space1);
+// Typed views in each mesh's index format (R16_UINT or R32_UINT), use loadTriangle.
+Buffer<uint> indexBuffers[] : register(t0,space1);
+#ifdef COMPACT_VERTICES
+StructuredBuffer<CompactVertex> vertexBuffers[] : register(t0,space2);
+#else
 StructuredBuffer<VertexIn> vertexBuffers[] : register(t0,space2);
+#endif
 // Texture order is diffuse,spec(packed),normal,emissive
 Texture2D textures[] : register(t0,space3);
 
@@ -105,17 +110,39 @@ float3 normalFromBary(float2 uvCoord, float3 normal0, float3 normal1, float3 nor
 	return normal0 + uvCoord.x * (normal1 - normal0) + uvCoord.y * (normal2 - normal0);
 }
 
+uint3 loadTriangle(uint instanceID, uint primitive) {
+	uint first = primitive * 3;
+	return uint3(indexBuffers[instanceID].Load(first), indexBuffers[instanceID].Load(first + 1), indexBuffers[instanceID].Load(first + 2));
+}
+
+float2 loadTexCoord(uint instanceID, uint vertex) {
+#ifdef COMPACT_VERTICES
+	uint texC = vertexBuffers[instanceID].Load(vertex).texC;
+	return f16tof32(uint2(texC, texC >> 16));
+#else
+	return vertexBuffers[instanceID].Load(vertex).TexC;
+#endif
+}
+
+float3 loadNormal(uint instanceID, uint vertex) {
+#ifdef COMPACT_VERTICES
+	return OctDecode(UnpackSnorm16x2(vertexBuffers[instanceID].Load(vertex).normal));
+#else
+	return vertexBuffers[instanceID].Load(vertex).NormalL;
+#endif
+}
+
 float2 getUvCoord(uint instanceID, uint3 primitive, float2 uvCoord) {
-	float2 texCoord0 = vertexBuffers[instanceID].Load(primitive.x).TexC;
-	float2 texCoord1 = vertexBuffers[instanceID].Load(primitive.y).TexC;
-	float2 texCoord2 = vertexBuffers[instanceID].Load(primitive.z).TexC;
+	float2 texCoord0 = loadTexCoord(instanceID, primitive.x);
+	float2 texCoord1 = loadTexCoord(instanceID, primitive.y);
+	float2 texCoord2 = loadTexCoord(instanceID, primitive.z);
 	return texCoordFromBary(uvCoord, texCoord0, texCoord1, texCoord2);
 }
 
 float3 getNormal(uint instanceID, uint3 primitive, float2 uvCoord) {
-	float3 normal0 = vertexBuffers[instanceID].Load(primitive.x).NormalL;
-	float3 normal1 = vertexBuffers[instanceID].Load(primitive.y).NormalL;
-	float3 normal2 = vertexBuffers[instanceID].Load(primitive.z).NormalL;
+	float3 normal0 = loadNormal(instanceID, primitive.x);
+	float3 normal1 = loadNormal(instanceID, primitive.y);
+	float3 normal2 = loadNormal(instanceID, primitive.z);
 	return normalFromBary(uvCoord, normal0, normal1, normal2);
 }
 
@@ -123,7 +150,7 @@ void proceedQueryUntilHitCommited(RayQuery<RAY_FLAG_NONE> query) {
 	while (query.Proceed()) {
 		uint instanceID = query.CandidateInstanceID() + query.CandidateGeometryIndex();
 		float2 uvCoord = query.CandidateTriangleBarycentrics();
-		uint3 primitive = uint3(indexBuffers[instanceID].Load(query.CandidatePrimitiveIndex()));
+		uint3 primitive = loadTriangle(instanceID, query.CandidatePrimitiveIndex());
 		float2 texCoord = getUvCoord(instanceID, primitive, uvCoord);
 		if (textures[instanceID * 4 + 0].Sample(gsamLinear, texCoord).w > 0.3f) {
 			query.CommitNonOpaqueTriangleHit();
@@ -204,7 +231,7 @@ LightingData reflectionContrib(float3 F0, float3 albedo, float roughness, float
 
 	if (query.CommittedStatus() == COMMITTED_TRIANGLE_HIT) {
 		uint instanceID = query.CommittedInstanceID() + query.CommittedGeometryIndex();
-		uint3 primitive = uint3(indexBuffers[instanceID].Load(query.CommittedPrimitiveIndex()));
+		uint3 primitive = loadTriangle(instanceID, query.CommittedPrimitiveIndex());
 		float2 uvCoord = query.CommittedTriangleBarycentrics();
 		float2 texCoord = getUvCoord(instanceID, primitive, uvCoord);
 		// Now do the lighting from this reflection
@@ -1,8 +1,9 @@
 #include "MeshletCommon.hlsl"
 
-ConstantBuffer<PerObject> PerObject : register(b1);
+StructuredBuffer<float4x4> PerObjectTransforms : register(t0, space1);
 
-ConstantBuffer<PerPass> PerPass : register(b2);
+ConstantBuffer<PerPass> PerPass : register(b1);
+ConstantBuffer<MeshletInstances> MeshletInstances : register(b2);
 
 // Have to start a bit later because the MeshletCommon uses all the other registers.
 Texture2D gDiffuseMap : register(t5);
@@ -13,13 +14,45 @@ SamplerState anisoWrap : register(s4);
 // The groupshared payload data to export to dispatched mesh shader threadgroups
 groupshared Payload s_Payload;
 
+// Planes are pulled straight out of ViewProj, so the test is against whatever camera is rendering this pass.
+bool IsInFrustum(float3 center, float radius)
+{
+	float4x4 vp = transpose(PerPass.ViewProj);
+	float4 planes[6] =
+	{
+		vp[3] + vp[0],
+		vp[3] - vp[0],
+		vp[3] + vp[1],
+		vp[3] - vp[1],
+		vp[2],
+		vp[3] - vp[2]
+	};
+	
+	[unroll]
+	for (uint i = 0; i < 6; i++)
+	{
+		if (dot(float4(center, 1.0f), planes[i]) < -radius * length(planes[i].xyz))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 bool IsVisible(CullData c, float4x4 world, float3 viewPos)
 {
+	// Instances can be scaled, so the sphere grows with the largest axis scale.
+	float scale = sqrt(max(dot(world[0].xyz, world[0].xyz), max(dot(world[1].xyz, world[1].xyz), dot(world[2].xyz, world[2].xyz))));
+	if (!IsInFrustum(mul(float4(c.BoundingSphere.xyz, 1), world).xyz, c.BoundingSphere.w * scale))
+	{
+		return false;
+	}
+	
 	if (PerPass.meshletCull == 0)
 	{
 		return true;
 	}
-	// Hopefully generating more aggressive culling data makes this less often
+	// Rare for meshlets built at load time, see ComputeMeshletCullData in MeshletBuilder.cpp.
 	if (IsConeDegenerate(c))
 	{
 		return true;
@@ -48,18 +81,22 @@ bool IsVisible(CullData c, float4x4 world, float3 viewPos)
 }
 
 [NumThreads(GROUP_SIZE, 1, 1)]
-void AS(uint gtid : SV_GroupThreadID, uint dtid : SV_DispatchThreadID, uint gid : SV_GroupID)
+void AS(uint gtid : SV_GroupThreadID, uint3 dtid : SV_DispatchThreadID, uint3 gid : SV_GroupID)
 {
 	bool visible = false;
+	uint instance = MeshletInstances.BaseInstance + gid.y;
 
-	if (dtid < MeshInfo.MeshletCount)
+	if (dtid.x < MeshInfo.MeshletCount && instance < MeshletInstances.InstanceCount)
 	{
-		visible = IsVisible(MeshletCullData[dtid], PerObject.world[0], PerPass.EyePosW);
+		visible = IsVisible(MeshletCullData[dtid.x], PerObjectTransforms[instance], PerPass.EyePosW);
 	}
 	
 	if (visible) {
 		uint index = WavePrefixCountBits(visible);
-		s_Payload.MeshletIndices[index] = dtid;
+		s_Payload.MeshletIndices[index] = dtid.x;
+	}
+	if (gtid == 0) {
+		s_Payload.instanceID = instance;
 	}
 	
 	uint visibleCount = WaveActiveCountBits(visible);
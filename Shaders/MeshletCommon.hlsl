@@ -26,6 +26,14 @@ struct Payload
     uint MeshletIndices[GROUP_SIZE];
 };
 
+// Root constants for instanced dispatches, each row of amplification groups (SV_GroupID.y) is one instance.
+// Huge instance counts are split across dispatches, BaseInstance is the first instance of the current one.
+struct MeshletInstances
+{
+    uint InstanceCount;
+    uint BaseInstance;
+};
+
 // Slight variation from Microsoft here, not using their resource binding style.
 ConstantBuffer<MeshInfo>    MeshInfo            : register(b0);
 StructuredBuffer<Vertex>    Vertices            : register(t0);
@@ -1,8 +1,8 @@
 #include "MeshletCommon.hlsl"
 
-ConstantBuffer<PerObject> PerObject : register(b1);
+StructuredBuffer<float4x4> PerObjectTransforms : register(t0, space1);
 
-ConstantBuffer<PerPass> PerPass : register(b2);
+ConstantBuffer<PerPass> PerPass : register(b1);
 
 // Have to start a bit later because the MeshletCommon uses all the other registers.
 Texture2D gDiffuseMap : register(t5);
@@ -40,17 +40,18 @@ uint3 GetPrimitive(Meshlet m, uint index) {
 }
 
 // Different 'VertexOut' than the one in sample.
-VertexOut GetVertexAttributes(uint meshletIndex, uint vertexIndex) {
+VertexOut GetVertexAttributes(uint meshletIndex, uint vertexIndex, uint instanceID) {
 	Vertex v = Vertices[vertexIndex];
+	float4x4 world = PerObjectTransforms[instanceID];
 	
-	float4 pos = mul(float4(v.Position,1.0f), PerObject.world[0]);//mul(float4(v.Position, 1.0f), PerObject.world);
+	float4 pos = mul(float4(v.Position,1.0f), world);
 	
 	VertexOut vout;
 	vout.PosW = pos.xyz;
 	vout.PosH = mul(pos, PerPass.ViewProj);
-	vout.NormalW = normalize(mul(-v.Normal, (float3x3) PerObject.world[0]));
-	vout.BiNormalW = normalize(mul(v.Bitangent, (float3x3) PerObject.world[0]));
-	vout.TangentW = normalize(mul(v.Tangent, (float3x3) PerObject.world[0]));
+	vout.NormalW = normalize(mul(-v.Normal, (float3x3) world));
+	vout.BiNormalW = normalize(mul(v.Bitangent, (float3x3) world));
+	vout.TangentW = normalize(mul(v.Tangent, (float3x3) world));
 	vout.TexC = v.Texcoord;
 	
 	return vout;
@@ -77,7 +78,7 @@ void MS(uint gtid : SV_GroupThreadID,
 	
 	if (gtid < m.VertCount) {
 		uint vertexIndex = GetVertexIndex(m, gtid);
-		verts[gtid] = GetVertexAttributes(gid, vertexIndex);
+		verts[gtid] = GetVertexAttributes(gid, vertexIndex, payload.instanceID);
 	}
 	
 	if (gtid < m.PrimCount) {
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BVHTree.h"
+#include "CullTestScene.h"
+
+// Frustum queries on a synthetic scene of model instances, through the BVH and the flat loop over every instance it replaced.
+// Instances are boxes of 2 to 80 units scattered through a cube 10000 across, the view sees a few percent of them. Each frame
+// moves 1% of the instances a little and 0.1% of them somewhere else. Run with the instance count to use.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static BVHTree::AABB randomBox(std::mt19937& random) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	BVHTree::AABB box;
+	for (int axis = 0; axis < 3; axis++) {
+		const float center = unit(random) * 5000.0f;
+		const float extent = 1.0f + (unit(random) + 1.0f) * 20.0f;
+		box.minimum[axis] = center - extent;
+		box.maximum[axis] = center + extent;
+	}
+	return box;
+}
+
+static bool isOutside(const BVHTree::AABB& box, const std::array<std::array<float, 4>, 6>& planes) {
+	for (const auto& plane : planes) {
+		float distance = plane[3];
+		float radius = 0.0f;
+		for (int axis = 0; axis < 3; axis++) {
+			distance += plane[axis] * (box.maximum[axis] + box.minimum[axis]) * 0.5f;
+			radius += std::abs(plane[axis]) * (box.maximum[axis] - box.minimum[axis]) * 0.5f;
+		}
+		if (distance > radius) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv) {
+	const UINT instanceCount = argc > 1 ? (UINT)std::stoul(argv[1]) : 100000;
+	const int frames = 50;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<BVHTree::AABB> boxes(instanceCount);
+	for (BVHTree::AABB& box : boxes) {
+		box = randomBox(random);
+	}
+
+	BVHTree tree(0.1f);
+	std::vector<BVHNodeHandle> handles(instanceCount);
+	auto start = std::chrono::steady_clock::now();
+	for (UINT i = 0; i < instanceCount; i++) {
+		handles[i] = tree.insert(boxes[i], nullptr, i);
+	}
+	const double buildSeconds = secondsSince(start);
+
+	double moveSeconds = 0.0;
+	double treeSeconds = 0.0;
+	double warmSeconds = 0.0;
+	double flatSeconds = 0.0;
+	size_t treeVisible = 0;
+	size_t flatVisible = 0;
+	size_t fullyInside = 0;
+	std::vector<SceneBVHResult> results;
+	std::vector<SceneBVHResult> flatResults;
+	for (int frame = 0; frame < frames; frame++) {
+		start = std::chrono::steady_clock::now();
+		for (UINT moved = 0; moved < instanceCount / 100; moved++) {
+			const UINT i = random() % instanceCount;
+			const float offset[3] = { unit(random), unit(random), unit(random) };
+			for (int axis = 0; axis < 3; axis++) {
+				boxes[i].minimum[axis] += offset[axis];
+				boxes[i].maximum[axis] += offset[axis];
+			}
+			tree.move(handles[i], boxes[i]);
+		}
+		for (UINT moved = 0; moved < instanceCount / 1000; moved++) {
+			const UINT i = random() % instanceCount;
+			boxes[i] = randomBox(random);
+			tree.move(handles[i], boxes[i]);
+		}
+		moveSeconds += secondsSince(start);
+
+		// The camera flies through the middle of the scene.
+		const float eye[3] = { -2000.0f + frame * 80.0f, 300.0f, -5000.0f + frame * 40.0f };
+		auto planes = MakeFrustumPlanes(eye, 0.41f, 1.0f, 4000.0f);
+
+		start = std::chrono::steady_clock::now();
+		tree.query(planes, results);
+		treeSeconds += secondsSince(start);
+		treeVisible += results.size();
+		// Again straight away, with the nodes it touched still in cache. The first query is the one a frame pays for, the
+		// moves and everything else since the last frame have pushed the tree out by then.
+		start = std::chrono::steady_clock::now();
+		tree.query(planes, results);
+		warmSeconds += secondsSince(start);
+		for (const SceneBVHResult& result : results) {
+			fullyInside += result.fullyInside;
+		}
+
+		start = std::chrono::steady_clock::now();
+		flatResults.clear();
+		for (UINT i = 0; i < instanceCount; i++) {
+			if (!isOutside(boxes[i], planes)) {
+				flatResults.push_back({ nullptr, i, false });
+			}
+		}
+		flatSeconds += secondsSince(start);
+		flatVisible += flatResults.size();
+	}
+
+	std::printf("%u instances, tree %d high, %.1f visible a frame (flat loop %.1f), %.0f%% of them accepted without testing\n", instanceCount,
+		tree.getHeight(), (double)treeVisible / frames, (double)flatVisible / frames, 100.0 * fullyInside / std::max<size_t>(treeVisible, 1));
+	std::printf("build          %7.2fms (%5.0fns an insert)\n", buildSeconds * 1000.0, buildSeconds * 1e9 / instanceCount);
+	std::printf("moves          %7.3fms a frame (%u small, %u far)\n", moveSeconds * 1000.0 / frames, instanceCount / 100, instanceCount / 1000);
+	std::printf("tree query     %7.3fms a frame (%.3fms run again in cache)\n", treeSeconds * 1000.0 / frames, warmSeconds * 1000.0 / frames);
+	std::printf("flat loop      %7.3fms a frame, %.1fx the tree query, %.1fx with the moves\n", flatSeconds * 1000.0 / frames,
+		flatSeconds / treeSeconds, flatSeconds / (treeSeconds + moveSeconds));
+	return 0;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BVHTree.h"
+#include "CullTestScene.h"
+#include "TestCheck.h"
+
+// The tree against a flat list of the same boxes, through random inserts, moves and removes. Models are never looked at by
+// the tree, so instances are identified by their instance number alone.
+
+struct ReferenceLeaf {
+	BVHNodeHandle handle;
+	BVHTree::AABB box;
+	bool alive;
+};
+
+static BVHTree::AABB randomBox(std::mt19937& random, float range) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	BVHTree::AABB box;
+	for (int axis = 0; axis < 3; axis++) {
+		const float center = unit(random) * range;
+		const float extent = 1.0f + (unit(random) + 1.0f) * 20.0f;
+		box.minimum[axis] = center - extent;
+		box.maximum[axis] = center + extent;
+	}
+	return box;
+}
+
+static bool outside(const BVHTree::AABB& box, const std::array<std::array<float, 4>, 6>& planes) {
+	for (const auto& plane : planes) {
+		float distance = plane[3];
+		float radius = 0.0f;
+		for (int axis = 0; axis < 3; axis++) {
+			distance += plane[axis] * (box.maximum[axis] + box.minimum[axis]) * 0.5f;
+			radius += std::abs(plane[axis]) * (box.maximum[axis] - box.minimum[axis]) * 0.5f;
+		}
+		if (distance > radius) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Every corner of 'box' is on the inside of every plane, allowing for float rounding.
+static bool inside(const BVHTree::AABB& box, const std::array<std::array<float, 4>, 6>& planes) {
+	for (int corner = 0; corner < 8; corner++) {
+		for (const auto& plane : planes) {
+			double distance = plane[3];
+			for (int axis = 0; axis < 3; axis++) {
+				distance += (double)plane[axis] * ((corner >> axis) & 1 ? box.maximum[axis] : box.minimum[axis]);
+			}
+			if (distance > 1e-3) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Queries from a spread of views and compares against testing every live box. Returns false on the first mismatch.
+static bool matchesReference(const BVHTree& tree, const std::vector<ReferenceLeaf>& leaves, std::mt19937& random) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<SceneBVHResult> results;
+	for (int view = 0; view < 8; view++) {
+		const float eye[3] = { unit(random) * 500.0f, unit(random) * 500.0f, -1200.0f + unit(random) * 500.0f };
+		const auto planes = MakeFrustumPlanes(eye, 0.3f + (unit(random) + 1.0f) * 0.5f, 1.0f, 1000.0f + (unit(random) + 1.0f) * 1000.0f);
+		tree.query(planes, results);
+
+		std::vector<UINT> found;
+		for (const SceneBVHResult& result : results) {
+			found.push_back(result.instance);
+			if (result.fullyInside && !inside(leaves[result.instance].box, planes)) {
+				std::printf("instance %u was accepted as fully inside but isn't\n", result.instance);
+				return false;
+			}
+		}
+		std::vector<UINT> expected;
+		for (UINT i = 0; i < leaves.size(); i++) {
+			if (leaves[i].alive && !outside(leaves[i].box, planes)) {
+				expected.push_back(i);
+			}
+		}
+		std::sort(found.begin(), found.end());
+		if (found != expected) {
+			std::printf("query found %zu instances, expected %zu\n", found.size(), expected.size());
+			return false;
+		}
+	}
+	return true;
+}
+
+// A balanced tree is at most about 1.44 log2(n) high, this allows a bit more.
+static bool balanced(const BVHTree& tree) {
+	return tree.getLeafCount() < 2 || tree.getHeight() <= 2 * (int)std::ceil(std::log2((double)tree.getLeafCount())) + 1;
+}
+
+static void testAgainstReference() {
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	BVHTree tree(0.1f);
+	std::vector<ReferenceLeaf> leaves;
+	for (UINT i = 0; i < 5000; i++) {
+		BVHTree::AABB box = randomBox(random, 1500.0f);
+		leaves.push_back({ tree.insert(box, nullptr, i), box, true });
+	}
+	CHECK(tree.getLeafCount() == 5000);
+	CHECK(balanced(tree));
+	CHECK(matchesReference(tree, leaves, random));
+
+	for (int round = 0; round < 20; round++) {
+		for (UINT i = 0; i < leaves.size(); i++) {
+			ReferenceLeaf& leaf = leaves[i];
+			const UINT action = random() % 100;
+			if (!leaf.alive) {
+				if (action < 30) {
+					leaf.box = randomBox(random, 1500.0f);
+					leaf.handle = tree.insert(leaf.box, nullptr, i);
+					leaf.alive = true;
+				}
+				continue;
+			}
+			if (action < 10) {
+				// Small moves that mostly stay inside the fat box.
+				const float offset[3] = { unit(random), unit(random), unit(random) };
+				for (int axis = 0; axis < 3; axis++) {
+					leaf.box.minimum[axis] += offset[axis];
+					leaf.box.maximum[axis] += offset[axis];
+				}
+				tree.move(leaf.handle, leaf.box);
+			}
+			else if (action < 14) {
+				leaf.box = randomBox(random, 1500.0f);
+				tree.move(leaf.handle, leaf.box);
+			}
+			else if (action < 16) {
+				// Shrinking in place, which has to drop the old fat box.
+				for (int axis = 0; axis < 3; axis++) {
+					const float center = (leaf.box.minimum[axis] + leaf.box.maximum[axis]) * 0.5f;
+					leaf.box.minimum[axis] = center - 0.5f;
+					leaf.box.maximum[axis] = center + 0.5f;
+				}
+				tree.move(leaf.handle, leaf.box);
+			}
+			else if (action < 20) {
+				tree.remove(leaf.handle);
+				leaf.alive = false;
+			}
+		}
+		const UINT alive = (UINT)std::count_if(leaves.begin(), leaves.end(), [](const ReferenceLeaf& leaf) { return leaf.alive; });
+		CHECK(tree.getLeafCount() == alive);
+		CHECK(balanced(tree));
+		CHECK(matchesReference(tree, leaves, random));
+	}
+
+	// Removing everything leaves an empty tree that still answers queries and takes new leaves.
+	for (ReferenceLeaf& leaf : leaves) {
+		if (leaf.alive) {
+			tree.remove(leaf.handle);
+			leaf.alive = false;
+		}
+	}
+	CHECK(tree.getLeafCount() == 0 && tree.getHeight() == 0);
+	CHECK(matchesReference(tree, leaves, random));
+	leaves[7].box = randomBox(random, 10.0f);
+	leaves[7].handle = tree.insert(leaves[7].box, nullptr, 7);
+	leaves[7].alive = true;
+	CHECK(matchesReference(tree, leaves, random));
+}
+
+static void testSortedInserts() {
+	// Boxes arriving in order along a line make the cheapest place for each new one the far end of the tree, so without
+	// rotations this degenerates into a list.
+	BVHTree tree(0.1f);
+	std::vector<BVHNodeHandle> handles;
+	for (UINT i = 0; i < 4096; i++) {
+		const float x = i * 10.0f;
+		handles.push_back(tree.insert({ { x, 0.0f, 0.0f }, { x + 5.0f, 5.0f, 5.0f } }, nullptr, i));
+	}
+	std::printf("4096 sorted inserts give a tree %d high\n", tree.getHeight());
+	CHECK(balanced(tree));
+	// Taking out one end leaves the other side much deeper.
+	for (UINT i = 0; i < 3500; i++) {
+		tree.remove(handles[i]);
+	}
+	CHECK(balanced(tree));
+}
+
+static void testFullyInside() {
+	// A cluster well inside the view comes back whole without testing its leaves, the one straddling the edge doesn't.
+	std::mt19937 random(2);
+	BVHTree tree(0.1f);
+	std::vector<ReferenceLeaf> leaves;
+	for (UINT i = 0; i < 200; i++) {
+		BVHTree::AABB box = randomBox(random, 40.0f);
+		for (int axis = 0; axis < 3; axis++) {
+			const float shift = axis == 2 ? 500.0f : 0.0f;
+			box.minimum[axis] = box.minimum[axis] * 0.2f + shift;
+			box.maximum[axis] = box.maximum[axis] * 0.2f + shift;
+		}
+		if (i >= 100) {
+			box.minimum[0] += 2000.0f;
+			box.maximum[0] += 2000.0f;
+		}
+		leaves.push_back({ tree.insert(box, nullptr, i), box, true });
+	}
+	const float eye[3] = { 0.0f, 0.0f, 0.0f };
+	const auto planes = MakeFrustumPlanes(eye, 1.0f, 1.0f, 1000.0f);
+	std::vector<SceneBVHResult> results;
+	tree.query(planes, results);
+	UINT fullyInside = 0;
+	for (const SceneBVHResult& result : results) {
+		CHECK(result.instance < 100);
+		fullyInside += result.fullyInside;
+	}
+	CHECK(results.size() == 100);
+	CHECK(fullyInside == 100);
+	CHECK(matchesReference(tree, leaves, random));
+}
+
+int main() {
+	testAgainstReference();
+	testSortedInserts();
+	testFullyInside();
+	if (testFailures == 0) {
+		std::printf("All BVH tree checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BoxCullBatch.h"
+#include "CullTestScene.h"
+
+// Frustum culling a frame's mesh boxes, the way drawModels did before BoundingBoxBatch against the batch.
+// The old path is rebuilt here as plain scalar code: a fresh vector of world boxes per model, each box's 8 corners transformed
+// and re-enclosed (what BoundingBox::Transform does), then tested against the planes one box at a time. The DirectXCollision
+// calls themselves need Windows, so this times the same work rather than the same code. Run with the box count to use.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct WorldBox {
+	float center[3];
+	float extents[3];
+};
+
+struct LocalBox {
+	float center[3];
+	float extents[3];
+	float world[4][4];
+};
+
+static WorldBox transformBox(const LocalBox& box) {
+	float minimum[3] = { 1e30f, 1e30f, 1e30f };
+	float maximum[3] = { -1e30f, -1e30f, -1e30f };
+	for (int corner = 0; corner < 8; corner++) {
+		const float local[3] = { box.center[0] + ((corner & 1) ? box.extents[0] : -box.extents[0]),
+			box.center[1] + ((corner & 2) ? box.extents[1] : -box.extents[1]), box.center[2] + ((corner & 4) ? box.extents[2] : -box.extents[2]) };
+		for (int column = 0; column < 3; column++) {
+			const float world = local[0] * box.world[0][column] + local[1] * box.world[1][column] + local[2] * box.world[2][column] + box.world[3][column];
+			minimum[column] = std::min(minimum[column], world);
+			maximum[column] = std::max(maximum[column], world);
+		}
+	}
+	return { { (minimum[0] + maximum[0]) * 0.5f, (minimum[1] + maximum[1]) * 0.5f, (minimum[2] + maximum[2]) * 0.5f },
+		{ (maximum[0] - minimum[0]) * 0.5f, (maximum[1] - minimum[1]) * 0.5f, (maximum[2] - minimum[2]) * 0.5f } };
+}
+
+static bool isOutside(const WorldBox& box, const std::array<std::array<float, 4>, 6>& planes) {
+	for (const auto& plane : planes) {
+		const float distance = plane[0] * box.center[0] + plane[1] * box.center[1] + plane[2] * box.center[2] + plane[3];
+		const float radius = std::abs(plane[0]) * box.extents[0] + std::abs(plane[1]) * box.extents[1] + std::abs(plane[2]) * box.extents[2];
+		if (distance > radius) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv) {
+	const UINT boxCount = argc > 1 ? (UINT)std::stoul(argv[1]) : 100000;
+	const UINT boxesPerModel = 8;
+	const int runs = 20;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<LocalBox> boxes(boxCount);
+	for (LocalBox& box : boxes) {
+		for (int axis = 0; axis < 3; axis++) {
+			box.center[axis] = (unit(random) - 0.5f) * 10.0f;
+			box.extents[axis] = 0.5f + unit(random) * 20.0f;
+		}
+		MakeRandomTransform(random, 3000.0f, box.world);
+	}
+	const float eye[3] = { 0.0f, 0.0f, -1000.0f };
+	const auto planes = MakeFrustumPlanes(eye, 0.41f, 1.0f, 4000.0f);
+
+	double scalarSeconds = 1e30;
+	UINT scalarVisible = 0;
+	std::vector<bool> scalarResults(boxCount);
+	for (int run = 0; run < runs; run++) {
+		auto start = std::chrono::steady_clock::now();
+		scalarVisible = 0;
+		for (UINT first = 0; first < boxCount; first += boxesPerModel) {
+			const UINT count = std::min(boxesPerModel, boxCount - first);
+			std::vector<WorldBox> worldBoxes;
+			for (UINT i = first; i < first + count; i++) {
+				worldBoxes.push_back(transformBox(boxes[i]));
+			}
+			for (UINT i = 0; i < count; i++) {
+				const bool visible = !isOutside(worldBoxes[i], planes);
+				scalarResults[first + i] = visible;
+				scalarVisible += visible;
+			}
+		}
+		scalarSeconds = std::min(scalarSeconds, secondsSince(start));
+	}
+
+	BoxCullBatch batch;
+	double fillSeconds = 1e30;
+	double cullSeconds = 1e30;
+	for (int run = 0; run < runs; run++) {
+		auto start = std::chrono::steady_clock::now();
+		batch.clear();
+		for (const LocalBox& box : boxes) {
+			batch.add(box.center, box.extents, box.world);
+		}
+		fillSeconds = std::min(fillSeconds, secondsSince(start));
+		start = std::chrono::steady_clock::now();
+		batch.cull(planes);
+		cullSeconds = std::min(cullSeconds, secondsSince(start));
+	}
+	UINT batchVisible = 0;
+	UINT disagreements = 0;
+	for (UINT i = 0; i < boxCount; i++) {
+		batchVisible += batch.isVisible(i);
+		disagreements += batch.isVisible(i) != scalarResults[i];
+	}
+
+	std::printf("%u boxes, %u visible (batch %u, %u differ by rounding), best of %d runs\n", boxCount, scalarVisible, batchVisible, disagreements, runs);
+	std::printf("scalar per box %7.3fms (%5.1fns a box)\n", scalarSeconds * 1000.0, scalarSeconds * 1e9 / boxCount);
+	std::printf("batch fill     %7.3fms (%5.1fns a box)\n", fillSeconds * 1000.0, fillSeconds * 1e9 / boxCount);
+	std::printf("batch cull     %7.3fms (%5.1fns a box), %.1fx the scalar path with the fill\n", cullSeconds * 1000.0, cullSeconds * 1e9 / boxCount,
+		scalarSeconds / (fillSeconds + cullSeconds));
+	return 0;
+}
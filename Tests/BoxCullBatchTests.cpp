@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BoxCullBatch.h"
+#include "CullTestScene.h"
+#include "TestCheck.h"
+
+struct TestBox {
+	float center[3];
+	float extents[3];
+	float world[4][4];
+};
+
+static std::vector<TestBox> makeBoxes(UINT seed, UINT count) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<TestBox> boxes(count);
+	for (TestBox& box : boxes) {
+		for (int axis = 0; axis < 3; axis++) {
+			box.center[axis] = (unit(random) - 0.5f) * 10.0f;
+			box.extents[axis] = 0.5f + unit(random) * 20.0f;
+		}
+		MakeRandomTransform(random, 400.0f, box.world);
+	}
+	return boxes;
+}
+
+static void fill(BoxCullBatch& batch, const std::vector<TestBox>& boxes) {
+	batch.clear();
+	for (const TestBox& box : boxes) {
+		batch.add(box.center, box.extents, box.world);
+	}
+}
+
+// How far in front of 'plane' the world box enclosing 'box' is (positive is outside), in double precision.
+static double outsideBy(const TestBox& box, const std::array<float, 4>& plane) {
+	double distance = plane[3];
+	double radius = 0.0;
+	for (int column = 0; column < 3; column++) {
+		double center = box.world[3][column];
+		double extent = 0.0;
+		for (int row = 0; row < 3; row++) {
+			center += (double)box.center[row] * box.world[row][column];
+			extent += (double)box.extents[row] * std::abs(box.world[row][column]);
+		}
+		distance += center * plane[column];
+		radius += extent * std::abs(plane[column]);
+	}
+	return distance - radius;
+}
+
+static void testAgainstReference() {
+	// Not a multiple of 4 or 64, so the padded lanes and the last visibility word both get used.
+	const std::vector<TestBox> boxes = makeBoxes(1, 4099);
+	const float eye[3] = { 0.0f, 0.0f, -300.0f };
+	const auto planes = MakeFrustumPlanes(eye, 0.6f, 1.0f, 600.0f);
+	BoxCullBatch batch;
+	fill(batch, boxes);
+	batch.cull(planes);
+	CHECK(batch.size() == boxes.size());
+
+	UINT visible = 0;
+	UINT mismatches = 0;
+	for (UINT i = 0; i < boxes.size(); i++) {
+		double outside = -1e30;
+		for (const auto& plane : planes) {
+			outside = std::max(outside, outsideBy(boxes[i], plane));
+		}
+		visible += batch.isVisible(i);
+		// Only boxes within float rounding of a plane can go either way.
+		if (std::abs(outside) > 1e-3 && batch.isVisible(i) != (outside <= 0.0)) {
+			mismatches++;
+		}
+	}
+	std::printf("%u of %zu boxes visible, %u disagree with the reference\n", visible, boxes.size(), mismatches);
+	CHECK(mismatches == 0);
+	// Both outcomes are common enough to mean something.
+	CHECK(visible * 10 > boxes.size() && visible * 10 < boxes.size() * 9);
+
+	// Same batch culled again gives the same bits, the padding from the first cull doesn't leak into them.
+	std::vector<bool> first(boxes.size());
+	for (UINT i = 0; i < boxes.size(); i++) {
+		first[i] = batch.isVisible(i);
+	}
+	batch.cull(planes);
+	bool same = true;
+	for (UINT i = 0; i < boxes.size(); i++) {
+		same = same && batch.isVisible(i) == first[i];
+	}
+	CHECK(same);
+
+	// Boxes added after a cull land at the index add() returns, not after anything cull() did to the arrays.
+	BoxCullBatch grown;
+	std::vector<TestBox> firstHalf(boxes.begin(), boxes.begin() + 1001);
+	fill(grown, firstHalf);
+	grown.cull(planes);
+	for (UINT i = 1001; i < boxes.size(); i++) {
+		CHECK(grown.add(boxes[i].center, boxes[i].extents, boxes[i].world) == i);
+	}
+	grown.cull(planes);
+	same = grown.size() == boxes.size();
+	for (UINT i = 0; i < boxes.size(); i++) {
+		same = same && grown.isVisible(i) == first[i];
+	}
+	CHECK(same);
+}
+
+static void testConservative() {
+	// Any point of the rotated box inside the frustum keeps it visible, whatever the enclosing box does.
+	const std::vector<TestBox> boxes = makeBoxes(2, 2000);
+	const float eye[3] = { 0.0f, 0.0f, -300.0f };
+	const auto planes = MakeFrustumPlanes(eye, 0.6f, 1.0f, 600.0f);
+	BoxCullBatch batch;
+	fill(batch, boxes);
+	batch.cull(planes);
+	UINT wronglyCulled = 0;
+	for (UINT i = 0; i < boxes.size(); i++) {
+		if (batch.isVisible(i)) {
+			continue;
+		}
+		const TestBox& box = boxes[i];
+		for (int sample = 0; sample < 27; sample++) {
+			const float local[3] = { box.center[0] + box.extents[0] * (sample % 3 - 1), box.center[1] + box.extents[1] * (sample / 3 % 3 - 1),
+				box.center[2] + box.extents[2] * (sample / 9 - 1) };
+			bool inside = true;
+			for (const auto& plane : planes) {
+				double distance = plane[3];
+				for (int column = 0; column < 3; column++) {
+					double world = box.world[3][column];
+					for (int row = 0; row < 3; row++) {
+						world += (double)local[row] * box.world[row][column];
+					}
+					distance += world * plane[column];
+				}
+				inside = inside && distance < -1e-3;
+			}
+			wronglyCulled += inside;
+		}
+	}
+	CHECK(wronglyCulled == 0);
+}
+
+static void testBits() {
+	const std::vector<TestBox> boxes = makeBoxes(3, 333);
+	const float eye[3] = { 0.0f, 0.0f, -300.0f };
+	BoxCullBatch batch;
+	fill(batch, boxes);
+	batch.cull(MakeFrustumPlanes(eye, 0.6f, 1.0f, 600.0f));
+
+	// Ranges crossing word boundaries, single boxes and empty ranges all agree with checking bit by bit.
+	std::mt19937 random(4);
+	bool agrees = true;
+	for (int i = 0; i < 5000; i++) {
+		const UINT first = random() % (batch.size() + 1);
+		const UINT count = random() % (batch.size() - first + 1);
+		bool expected = false;
+		for (UINT box = first; box < first + count; box++) {
+			expected = expected || batch.isVisible(box);
+		}
+		agrees = agrees && batch.anyVisible(first, count) == expected;
+	}
+	CHECK(agrees);
+
+	for (UINT i = 0; i < batch.size(); i++) {
+		batch.hide(i);
+	}
+	CHECK(!batch.anyVisible(0, batch.size()));
+
+	// Getting a box back gives what was added, with the constant column filled in.
+	float center[3];
+	float extents[3];
+	float world[4][4];
+	batch.getBox(100, center, extents, world);
+	CHECK(center[1] == boxes[100].center[1] && extents[2] == boxes[100].extents[2]);
+	CHECK(world[3][2] == boxes[100].world[3][2] && world[1][0] == boxes[100].world[1][0]);
+	CHECK(world[0][3] == 0.0f && world[3][3] == 1.0f);
+
+	// An empty batch culls to nothing.
+	batch.clear();
+	batch.cull(MakeFrustumPlanes(eye, 0.6f, 1.0f, 600.0f));
+	CHECK(batch.size() == 0 && !batch.anyVisible(0, 0));
+}
+
+int main() {
+	testAgainstReference();
+	testConservative();
+	testBits();
+	if (testFailures == 0) {
+		std::printf("All box cull batch checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <random>
+
+// Outward facing (normal, distance) planes of a perspective view from 'eye' looking down +z, with the given
+// tangent of the half field of view, the way BoundingFrustum::GetPlanes returns them.
+inline std::array<std::array<float, 4>, 6> MakeFrustumPlanes(const float eye[3], float tanHalfFov, float nearZ, float farZ) {
+	auto plane = [&](float x, float y, float z, const float point[3]) {
+		const float length = std::sqrt(x * x + y * y + z * z);
+		x /= length;
+		y /= length;
+		z /= length;
+		return std::array<float, 4>{ x, y, z, -(x * point[0] + y * point[1] + z * point[2]) };
+	};
+	const float nearPoint[3] = { eye[0], eye[1], eye[2] + nearZ };
+	const float farPoint[3] = { eye[0], eye[1], eye[2] + farZ };
+	return {
+		plane(0.0f, 0.0f, -1.0f, nearPoint),
+		plane(0.0f, 0.0f, 1.0f, farPoint),
+		plane(1.0f, 0.0f, -tanHalfFov, eye),
+		plane(-1.0f, 0.0f, -tanHalfFov, eye),
+		plane(0.0f, 1.0f, -tanHalfFov, eye),
+		plane(0.0f, -1.0f, -tanHalfFov, eye),
+	};
+}
+
+// Random row vector affine transform: rotation about a random axis, uniform scale and translation inside 'range'.
+inline void MakeRandomTransform(std::mt19937& random, float range, float world[4][4]) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	float axis[3] = { unit(random), unit(random), unit(random) };
+	const float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) + 1e-6f;
+	for (float& a : axis) {
+		a /= length;
+	}
+	const float angle = unit(random) * 3.14159265f;
+	const float scale = 1.5f + unit(random);
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+	const float t = 1.0f - c;
+	const float rotation[3][3] = {
+		{ t * axis[0] * axis[0] + c, t * axis[0] * axis[1] + s * axis[2], t * axis[0] * axis[2] - s * axis[1] },
+		{ t * axis[0] * axis[1] - s * axis[2], t * axis[1] * axis[1] + c, t * axis[1] * axis[2] + s * axis[0] },
+		{ t * axis[0] * axis[2] + s * axis[1], t * axis[1] * axis[2] - s * axis[0], t * axis[2] * axis[2] + c },
+	};
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 3; column++) {
+			world[row][column] = rotation[row][column] * scale;
+		}
+		world[row][3] = 0.0f;
+	}
+	world[3][0] = unit(random) * range;
+	world[3][1] = unit(random) * range;
+	world[3][2] = unit(random) * range;
+	world[3][3] = 1.0f;
+}
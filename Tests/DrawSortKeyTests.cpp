@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "DrawSortKey.h"
+#include "RadixSort.h"
+#include "TestCheck.h"
+
+// Draw sort keys and the bind tracking recordDraws does with them. Every field has to come back out of its own bits,
+// keys have to order by shading rate, then table, then depth, then model, and a draw list sorted on them with RadixSort
+// has to bind each shading rate once and each table once per rate. Replaying the same scene in load order gives the
+// number of binds sorting saves, and the object binds it costs by spreading each model's meshes across its tables.
+
+struct TestDraw {
+	UINT32 shadingRate;
+	UINT64 textureTable;
+	UINT32 depthBucket;
+	UINT32 model;
+	UINT32 indexFormat;
+	UINT32 meshInstanceCount;
+};
+
+struct BindCounts {
+	UINT32 shadingRates = 0;
+	UINT32 textureTables = 0;
+	UINT32 indexFormats = 0;
+	UINT32 objects = 0;
+	UINT32 meshInstanceCounts = 0;
+};
+
+// The binds recordDraws makes for 'order', with every slot in use and per draw shading rates supported.
+static BindCounts countBinds(const std::vector<TestDraw>& draws, const std::vector<SortItem>& order) {
+	DrawBindState bound;
+	BindCounts counts;
+	for (const SortItem& item : order) {
+		const TestDraw& draw = draws[item.value];
+		counts.objects += bound.setObject(&draws[0] + draw.model);
+		counts.meshInstanceCounts += bound.setMeshInstanceCount(draw.meshInstanceCount);
+		counts.shadingRates += bound.setShadingRate(draw.shadingRate);
+		counts.textureTables += bound.setTextureTable(draw.textureTable);
+		counts.indexFormats += bound.setIndexFormat(draw.indexFormat);
+	}
+	return counts;
+}
+
+// One more than the number of neighbours in 'order' that differ in 'field', what elision should come down to.
+template <typename Field>
+static UINT32 countRuns(const std::vector<TestDraw>& draws, const std::vector<SortItem>& order, Field field) {
+	UINT32 runs = 0;
+	for (size_t i = 0; i < order.size(); i++) {
+		runs += i == 0 || field(draws[order[i].value]) != field(draws[order[i - 1].value]);
+	}
+	return runs;
+}
+
+static void testFields() {
+	const UINT64 key = MakeDrawSortKey(0x9, 0xABCDE, 0x1234, 0x56789A);
+	CHECK(((key >> DRAW_KEY_PIPELINE_SHIFT) & DRAW_KEY_PIPELINE_MASK) == 0x9);
+	CHECK(((key >> DRAW_KEY_TEXTURE_SHIFT) & DRAW_KEY_TEXTURE_MASK) == 0xABCDE);
+	CHECK(((key >> DRAW_KEY_DEPTH_SHIFT) & DRAW_KEY_DEPTH_MASK) == 0x1234);
+	CHECK((key & DRAW_KEY_MODEL_MASK) == 0x56789A);
+	CHECK(key == 0x9ABCDE123456789Aull);
+
+	// The fields fill the key without overlapping.
+	CHECK(MakeDrawSortKey(0xF, DRAW_KEY_TEXTURE_MASK, DRAW_KEY_DEPTH_MASK, DRAW_KEY_MODEL_MASK) == ~0ull);
+	CHECK(MakeDrawSortKey(0xF, 0, 0, 0) == DRAW_KEY_PIPELINE_MASK << DRAW_KEY_PIPELINE_SHIFT);
+	CHECK(MakeDrawSortKey(0, DRAW_KEY_TEXTURE_MASK, 0, 0) == DRAW_KEY_TEXTURE_MASK << DRAW_KEY_TEXTURE_SHIFT);
+	CHECK(MakeDrawSortKey(0, 0, DRAW_KEY_DEPTH_MASK, 0) == DRAW_KEY_DEPTH_MASK << DRAW_KEY_DEPTH_SHIFT);
+
+	// Too wide a value wraps within its own field.
+	CHECK(MakeDrawSortKey(0x10, 0, 0, 0) == 0);
+	CHECK(MakeDrawSortKey(0, DRAW_KEY_TEXTURE_MASK + 2, 0, 0) == 1ull << DRAW_KEY_TEXTURE_SHIFT);
+	CHECK(MakeDrawSortKey(0, 0, (UINT32)DRAW_KEY_DEPTH_MASK + 3, 0) == 2ull << DRAW_KEY_DEPTH_SHIFT);
+	CHECK(MakeDrawSortKey(0, 0, 0, (UINT32)DRAW_KEY_MODEL_MASK + 4) == 3);
+}
+
+static void testOrder() {
+	std::mt19937 random(7);
+	for (int i = 0; i < 10000; i++) {
+		// Small ranges so ties in the upper fields come up often.
+		UINT32 a[4], b[4];
+		for (int field = 0; field < 4; field++) {
+			a[field] = random() % 4;
+			b[field] = random() % 4;
+		}
+		const bool keyLess = MakeDrawSortKey(a[0], a[1], a[2], a[3]) < MakeDrawSortKey(b[0], b[1], b[2], b[3]);
+		CHECK(keyLess == (std::tie(a[0], a[1], a[2], a[3]) < std::tie(b[0], b[1], b[2], b[3])));
+	}
+}
+
+static void testBindState() {
+	DrawBindState bound;
+	int models[2];
+	// Everything binds the first time, even values that match the starting state.
+	CHECK(bound.setShadingRate(0));
+	CHECK(!bound.setShadingRate(0));
+	CHECK(bound.setShadingRate(2));
+	CHECK(bound.setTextureTable(64));
+	CHECK(!bound.setTextureTable(64));
+	CHECK(bound.setIndexFormat(42));
+	CHECK(!bound.setIndexFormat(42));
+	CHECK(bound.setObject(&models[0]));
+	CHECK(!bound.setObject(&models[0]));
+	CHECK(bound.setObject(&models[1]));
+	CHECK(bound.setMeshInstanceCount(1));
+	CHECK(!bound.setMeshInstanceCount(1));
+	CHECK(bound.setDequantize(&models[0]));
+	CHECK(!bound.setDequantize(&models[0]));
+
+	// A group leaves no object bound and a mesh instance count of 1.
+	CHECK(bound.setMeshInstanceCount(3));
+	bound.setGroup();
+	CHECK(bound.setObject(&models[1]));
+	CHECK(!bound.setMeshInstanceCount(1));
+	CHECK(!bound.setTextureTable(64));
+}
+
+// 4000 draws over 300 models, each with its own depth and a table out of 60, a third of the tables drawn at a coarser rate.
+static void testScene() {
+	std::mt19937 random(11);
+	std::vector<TestDraw> draws;
+	std::vector<SortItem> loadOrder;
+	for (UINT32 model = 0; model < 300; model++) {
+		const UINT32 meshes = 1 + random() % 25;
+		const UINT32 depthBucket = random() % DRAW_KEY_DEPTH_MASK;
+		const UINT32 indexFormat = model % 5 == 0 ? 42 : 57;
+		for (UINT32 mesh = 0; mesh < meshes && draws.size() < 4000; mesh++) {
+			TestDraw draw;
+			draw.textureTable = 1 + random() % 60;
+			draw.shadingRate = draw.textureTable % 3 == 0 ? 5 : 0;
+			draw.depthBucket = depthBucket;
+			draw.model = model;
+			draw.indexFormat = indexFormat;
+			draw.meshInstanceCount = mesh % 4 == 0 ? 3 : 1;
+			loadOrder.push_back({ MakeDrawSortKey(draw.shadingRate, draw.textureTable, draw.depthBucket, draw.model), (UINT)draws.size() });
+			draws.push_back(draw);
+		}
+	}
+
+	std::vector<SortItem> sorted = loadOrder, scratch;
+	RadixSort(sorted, scratch);
+	std::vector<SortItem> expected = loadOrder;
+	std::stable_sort(expected.begin(), expected.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+	CHECK(sorted.size() == expected.size());
+	for (size_t i = 0; i < sorted.size() && i < expected.size(); i++) {
+		CHECK(sorted[i].key == expected[i].key && sorted[i].value == expected[i].value);
+	}
+
+	std::set<UINT32> rates;
+	std::set<std::pair<UINT32, UINT64>> rateTables;
+	for (const TestDraw& draw : draws) {
+		rates.insert(draw.shadingRate);
+		rateTables.insert({ draw.shadingRate, draw.textureTable });
+	}
+
+	std::printf("%-10s %8s %8s %8s %8s %10s\n", "order", "rates", "tables", "indices", "objects", "instances");
+	for (const auto* order : { &loadOrder, &sorted }) {
+		const BindCounts counts = countBinds(draws, *order);
+		std::printf("%-10s %8u %8u %8u %8u %10u\n", order == &sorted ? "sorted" : "load", counts.shadingRates, counts.textureTables,
+			counts.indexFormats, counts.objects, counts.meshInstanceCounts);
+		// Elision binds exactly when a value differs from the draw before.
+		CHECK(counts.shadingRates == countRuns(draws, *order, [](const TestDraw& d) { return d.shadingRate; }));
+		CHECK(counts.textureTables == countRuns(draws, *order, [](const TestDraw& d) { return d.textureTable; }));
+		CHECK(counts.indexFormats == countRuns(draws, *order, [](const TestDraw& d) { return d.indexFormat; }));
+		CHECK(counts.objects == countRuns(draws, *order, [](const TestDraw& d) { return d.model; }));
+		CHECK(counts.meshInstanceCounts == countRuns(draws, *order, [](const TestDraw& d) { return d.meshInstanceCount; }));
+	}
+
+	const BindCounts load = countBinds(draws, loadOrder);
+	const BindCounts sortedCounts = countBinds(draws, sorted);
+	CHECK(sortedCounts.shadingRates == rates.size());
+	CHECK(sortedCounts.textureTables <= rateTables.size());
+	CHECK(load.textureTables > 10 * sortedCounts.textureTables);
+	CHECK(load.shadingRates > 10 * sortedCounts.shadingRates);
+}
+
+int main() {
+	testFields();
+	testOrder();
+	testBindState();
+	testScene();
+	if (testFailures == 0) {
+		std::printf("All draw sort key checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "IndirectDrawBuilder.h"
+
+// CPU cost per frame of packing the draw list into the ExecuteIndirect argument stream. Run with the draw count and
+// the average number of draws sharing a texture table, defaults are about a large Sponza style scene.
+
+// Same size and fields as IndirectDrawCommand with COMPACT_VERTICES, as plain integers.
+struct BenchmarkCommand {
+	UINT64 vertexBuffer;
+	UINT32 vertexSize;
+	UINT32 vertexStride;
+	UINT64 indexBuffer;
+	UINT32 indexSize;
+	UINT32 indexFormat;
+	UINT64 objectTransforms;
+	UINT64 meshTransforms;
+	UINT32 instanceCounts[2];
+	float vertexDequantize[8];
+	UINT32 draw[5];
+};
+
+struct BenchmarkDraw {
+	UINT64 textureTable;
+	UINT32 shadingRate;
+	UINT32 indexCount;
+	UINT32 startIndex;
+	UINT32 baseVertex;
+	UINT64 transforms;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	const UINT32 drawCount = argc > 1 ? (UINT32)std::stoul(argv[1]) : 20000;
+	const UINT32 drawsPerTable = argc > 2 ? std::max(1u, (UINT32)std::stoul(argv[2])) : 8;
+	const int frames = 200;
+
+	// Already sorted by table then rate, like drawOrder.
+	std::vector<BenchmarkDraw> draws(drawCount);
+	UINT32 seed = 12345;
+	for (UINT32 i = 0; i < drawCount; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		draws[i] = { 0x1000ull + 0x40ull * (i / drawsPerTable), (i / drawsPerTable) % 4 == 0 ? 1u : 0u, 3 * (seed >> 20), i * 36, i * 24, 0x100000ull + 64ull * i };
+	}
+
+	IndirectDrawBuilder<BenchmarkCommand> builder;
+	double best = 1e30;
+	double total = 0.0;
+	size_t runCount = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		auto start = std::chrono::steady_clock::now();
+		builder.clear();
+		for (const BenchmarkDraw& draw : draws) {
+			BenchmarkCommand command = {};
+			command.vertexBuffer = 0x200000;
+			command.vertexSize = 1 << 26;
+			command.vertexStride = 24;
+			command.indexBuffer = 0x300000;
+			command.indexSize = 1 << 24;
+			command.objectTransforms = draw.transforms;
+			command.meshTransforms = draw.transforms + 64;
+			command.instanceCounts[0] = 1;
+			command.instanceCounts[1] = 1;
+			command.draw[0] = draw.indexCount;
+			command.draw[1] = 1;
+			command.draw[2] = draw.startIndex;
+			command.draw[3] = draw.baseVertex;
+			builder.addDraw(command, draw.textureTable, draw.shadingRate);
+		}
+		const double seconds = secondsSince(start);
+		best = std::min(best, seconds);
+		total += seconds;
+		runCount = builder.getRuns().size();
+	}
+
+	const double mb = drawCount * sizeof(BenchmarkCommand) / (1024.0 * 1024.0);
+	std::printf("%u draws in %zu runs, %.2fMB of %zu byte commands a frame\n", drawCount, runCount, mb, sizeof(BenchmarkCommand));
+	std::printf("best %.3fms (%.1fns a draw, %.0fMB/s), average %.3fms over %d frames\n", best * 1000.0, best * 1e9 / drawCount,
+		mb / best, total * 1000.0 / frames, frames);
+	return 0;
+}
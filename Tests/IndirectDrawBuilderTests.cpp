@@ -0,0 +1,141 @@
+#include <cstdio>
+#include <cstring>
+
+#include "IndirectDrawBuilder.h"
+#include "TestCheck.h"
+
+// Stands in for IndirectDrawCommand, the builder only copies its bytes.
+struct TestCommand {
+	UINT32 drawIndex;
+	UINT32 indexCount;
+	UINT64 transforms;
+};
+
+struct TestDraw {
+	UINT64 textureTable;
+	UINT32 shadingRate;
+};
+
+static TestCommand commandFor(UINT32 i) {
+	return { i, 3 * (i + 1), 0x10000ull * i + 0x40 };
+}
+
+static void build(IndirectDrawBuilder<TestCommand>& builder, const TestDraw* draws, UINT32 count) {
+	builder.clear();
+	for (UINT32 i = 0; i < count; i++) {
+		builder.addDraw(commandFor(i), draws[i].textureTable, draws[i].shadingRate);
+	}
+}
+
+// Runs cover every command once, in order, each one has the table and rate of all the draws in it,
+// and neighbouring runs differ in one of them, or they'd have been a single ExecuteIndirect.
+static bool runsMatch(const IndirectDrawBuilder<TestCommand>& builder, const TestDraw* draws, UINT32 count) {
+	const auto& runs = builder.getRuns();
+	UINT32 next = 0;
+	for (size_t r = 0; r < runs.size(); r++) {
+		const auto& run = runs[r];
+		if (run.firstCommand != next || run.commandCount == 0) {
+			return false;
+		}
+		for (UINT32 i = run.firstCommand; i < run.firstCommand + run.commandCount; i++) {
+			if (i >= count || draws[i].textureTable != run.textureTable || draws[i].shadingRate != run.shadingRate) {
+				return false;
+			}
+		}
+		if (r > 0 && runs[r - 1].textureTable == run.textureTable && runs[r - 1].shadingRate == run.shadingRate) {
+			return false;
+		}
+		next += run.commandCount;
+	}
+	return next == count;
+}
+
+static bool commandsMatch(const IndirectDrawBuilder<TestCommand>& builder, UINT32 count) {
+	const auto& commands = builder.getCommands();
+	if (commands.size() != count) {
+		return false;
+	}
+	for (UINT32 i = 0; i < count; i++) {
+		const TestCommand expected = commandFor(i);
+		if (std::memcmp(&commands[i], &expected, sizeof(TestCommand)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void testEmpty() {
+	IndirectDrawBuilder<TestCommand> builder;
+	CHECK(builder.getCommands().empty());
+	CHECK(builder.getRuns().empty());
+}
+
+static void testRuns() {
+	// Sorted by table then rate, like the draw list, plus a table that comes back after another one, which
+	// has to be a run of its own since the stream can't go back.
+	const TestDraw draws[] = {
+		{ 0x1000, 0 }, { 0x1000, 0 }, { 0x1000, 0 },
+		{ 0x1000, 1 },
+		{ 0x2000, 1 }, { 0x2000, 1 },
+		{ 0x1000, 1 },
+		{ 0x3000, 0 },
+		// Same rate as the last draw and a table that only differs in its top bits.
+		{ 0x3000 | (1ull << 40), 0 },
+	};
+	const UINT32 count = sizeof(draws) / sizeof(draws[0]);
+	IndirectDrawBuilder<TestCommand> builder;
+	build(builder, draws, count);
+	CHECK(builder.getRuns().size() == 6);
+	CHECK(runsMatch(builder, draws, count));
+	CHECK(commandsMatch(builder, count));
+	CHECK(builder.getRuns()[0].commandCount == 3);
+	CHECK(builder.getRuns()[2].firstCommand == 4 && builder.getRuns()[2].commandCount == 2);
+}
+
+static void testSingleRun() {
+	TestDraw draws[64];
+	for (auto& draw : draws) {
+		draw = { 0x4000, 2 };
+	}
+	IndirectDrawBuilder<TestCommand> builder;
+	build(builder, draws, 64);
+	CHECK(builder.getRuns().size() == 1);
+	CHECK(runsMatch(builder, draws, 64));
+	CHECK(commandsMatch(builder, 64));
+}
+
+static void testRebuild() {
+	// The builder is cleared and refilled every frame, nothing from the last frame can leak into the next one.
+	TestDraw draws[200];
+	UINT32 seed = 12345;
+	IndirectDrawBuilder<TestCommand> builder;
+	for (UINT32 frame = 0; frame < 20; frame++) {
+		const UINT32 count = frame % 5 == 4 ? 0 : 1 + frame * 9;
+		UINT64 table = 0x1000;
+		UINT32 rate = 0;
+		for (UINT32 i = 0; i < count; i++) {
+			seed = seed * 1664525u + 1013904223u;
+			if ((seed >> 28) == 0) {
+				table += 0x40;
+			}
+			if ((seed >> 24 & 0xf) == 0) {
+				rate ^= 1;
+			}
+			draws[i] = { table, rate };
+		}
+		build(builder, draws, count);
+		CHECK(runsMatch(builder, draws, count));
+		CHECK(commandsMatch(builder, count));
+	}
+}
+
+int main() {
+	testEmpty();
+	testRuns();
+	testSingleRun();
+	testRebuild();
+	if (testFailures == 0) {
+		std::printf("All indirect draw builder checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "ModelLoading/MeshSimplifier.h"
+#include "MeshletTestMesh.h"
+#include "TestCheck.h"
+
+// LOD chains of an open grid and a closed sphere, built the way SimpleModel builds them for every mesh it imports.
+// Each level has to land on its triangle target, keep every index in range and leave the grid's border exactly where it
+// was: locked vertices can't collapse, so the border edges of every level are the original border edges.
+
+// Settings.h's MESH_LOD_* values, it pulls in d3d12 so they're repeated here.
+static const UINT LOD_COUNT = 4;
+static const float LOD_REDUCTION = 0.5f;
+static const float LOD_MIN_REDUCTION = 0.85f;
+static const float LOD_NORMAL_WEIGHT = 0.05f;
+static const float LOD_TEXCOORD_WEIGHT = 0.05f;
+
+// Directed edges with no triangle going the other way.
+static std::set<std::pair<UINT, UINT>> openEdges(const std::vector<UINT>& indices) {
+	std::map<std::pair<UINT, UINT>, int> uses;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		for (int corner = 0; corner < 3; corner++) {
+			uses[{ indices[i + corner], indices[i + (corner + 1) % 3] }]++;
+		}
+	}
+	std::set<std::pair<UINT, UINT>> open;
+	for (const auto& edge : uses) {
+		if (uses.find({ edge.first.second, edge.first.first }) == uses.end()) {
+			open.insert(edge.first);
+		}
+	}
+	return open;
+}
+
+// Everything one mesh's LOD chain is built from, set up the way SimpleModel::buildMeshLods does it.
+struct LodInput {
+	const MeshletMeshData& mesh;
+	std::vector<bool> locked;
+	std::vector<float> attributes;
+	UINT attributeCount = 0;
+
+	LodInput(const MeshletMeshData& mesh, float radius, bool withAttributes) : mesh(mesh) {
+		if (withAttributes) {
+			attributeCount = 5;
+			for (const MeshletVertex& vertex : mesh.vertices) {
+				attributes.insert(attributes.end(), { vertex.normal.x * LOD_NORMAL_WEIGHT * radius, vertex.normal.y * LOD_NORMAL_WEIGHT * radius,
+					vertex.normal.z * LOD_NORMAL_WEIGHT * radius, vertex.texCoord.x * LOD_TEXCOORD_WEIGHT * radius, vertex.texCoord.y * LOD_TEXCOORD_WEIGHT * radius });
+			}
+		}
+		locked.assign(mesh.vertices.size(), false);
+		LockBorderVertices(mesh.indices.data(), (UINT)mesh.indices.size(), locked);
+	}
+
+	UINT simplify(std::vector<UINT>& indices, UINT targetIndexCount, float& error) const {
+		return SimplifyMesh(&mesh.vertices[0].position, sizeof(MeshletVertex), (UINT)mesh.vertices.size(), indices.data(), (UINT)indices.size(),
+			targetIndexCount, locked, error, attributes.data(), attributeCount);
+	}
+
+	std::vector<MeshLod> build() const {
+		return BuildMeshLods(&mesh.vertices[0].position, sizeof(MeshletVertex), (UINT)mesh.vertices.size(), mesh.indices.data(), (UINT)mesh.indices.size(),
+			LOD_COUNT - 1, LOD_REDUCTION, LOD_MIN_REDUCTION, locked, attributes.data(), attributeCount);
+	}
+};
+
+static void checkLevels(const char* name, const LodInput& input, const std::vector<MeshLod>& lods) {
+	CHECK(!lods.empty());
+	std::vector<UINT> lastIndices = input.mesh.indices;
+	float lastError = 0.0f;
+	for (const MeshLod& lod : lods) {
+		const UINT lastCount = (UINT)lastIndices.size();
+		const UINT count = (UINT)lod.indices.size();
+		const UINT target = (UINT)(lastCount / 3 * LOD_REDUCTION) * 3;
+		std::printf("%s: %u -> %u indices (target %u), error %f\n", name, lastCount, count, target, lod.error);
+		CHECK(count % 3 == 0);
+		CHECK(count > 0 && count <= target);
+		// Every collapse takes out at most a handful of triangles, so simplification stops right at the target.
+		CHECK(count + 6 * 3 >= target);
+		for (size_t i = 0; i + 2 < lod.indices.size(); i += 3) {
+			const UINT a = lod.indices[i], b = lod.indices[i + 1], c = lod.indices[i + 2];
+			CHECK(a < input.mesh.vertices.size() && b < input.mesh.vertices.size() && c < input.mesh.vertices.size());
+			CHECK(a != b && b != c && c != a);
+		}
+
+		// Each level is one SimplifyMesh step from the last, and its error is the sum of every step so far.
+		float stepError = 0.0f;
+		lastIndices.resize(input.simplify(lastIndices, target, stepError));
+		CHECK(lastIndices == lod.indices);
+		CHECK(stepError >= 0.0f && lod.error == lastError + stepError);
+		lastError = lod.error;
+	}
+}
+
+static void testGrid(bool withAttributes) {
+	const MeshletMeshData mesh = MakeGridMesh(41, 41);
+	const LodInput input(mesh, 7.1f, withAttributes);
+	const std::vector<MeshLod> lods = input.build();
+	checkLevels(withAttributes ? "grid with attributes" : "grid", input, lods);
+	CHECK(lods.size() == LOD_COUNT - 1);
+
+	// 160 border vertices are locked, each LOD has to keep the same 160 border edges between them.
+	UINT lockedCount = 0;
+	for (bool isLocked : input.locked) {
+		lockedCount += isLocked;
+	}
+	CHECK(lockedCount == 4 * 40);
+	const std::set<std::pair<UINT, UINT>> border = openEdges(mesh.indices);
+	CHECK(border.size() == 4 * 40);
+	for (const MeshLod& lod : lods) {
+		CHECK(openEdges(lod.indices) == border);
+	}
+}
+
+static void testSphere() {
+	const MeshletMeshData mesh = MakeSphereMesh(24, 48, 2.0f);
+	const LodInput input(mesh, 2.0f, true);
+	const std::vector<MeshLod> lods = input.build();
+	checkLevels("sphere", input, lods);
+	CHECK(lods.size() == LOD_COUNT - 1);
+	// Nothing to lock on a closed mesh, and it has to stay closed.
+	for (bool isLocked : input.locked) {
+		CHECK(!isLocked);
+	}
+	for (const MeshLod& lod : lods) {
+		CHECK(openEdges(lod.indices).empty());
+	}
+}
+
+// A grid of a single row of cells is all border, nothing can collapse so there's no level worth keeping.
+static void testAllLocked() {
+	const MeshletMeshData mesh = MakeGridMesh(40, 2);
+	CHECK(LodInput(mesh, 5.0f, true).build().empty());
+}
+
+int main() {
+	testGrid(false);
+	testGrid(true);
+	testSphere();
+	testAllLocked();
+	if (testFailures == 0) {
+		std::printf("All mesh simplifier checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ModelLoading/MeshletBuilder.h"
+#include "ModelLoading/MeshletFile.h"
+#include "MeshletTestMesh.h"
+#include "TestCheck.h"
+
+// Meshlets built from closed and open meshes at a range of limits, checked for the limits, for every triangle landing in
+// exactly one meshlet, and for the tables the loader indexes with. Then built meshes go through WriteMeshletFile and back
+// through ParseMeshletFile.
+
+// Every meshlet is inside the limits and its tables, and the meshlets hold exactly the mesh's triangles.
+static void checkMeshlets(const MeshletMeshData& mesh, UINT maxVertices, UINT maxPrimitives) {
+	UINT32 vertOffset = 0;
+	UINT32 primOffset = 0;
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		CHECK(meshlet.VertCount >= 1 && meshlet.VertCount <= maxVertices);
+		CHECK(meshlet.PrimCount >= 1 && meshlet.PrimCount <= maxPrimitives);
+		// Packed back to back, in order.
+		CHECK(meshlet.VertOffset == vertOffset && meshlet.PrimOffset == primOffset);
+		vertOffset += meshlet.VertCount;
+		primOffset += meshlet.PrimCount;
+
+		std::vector<bool> used(meshlet.VertCount, false);
+		for (UINT32 i = 0; i < meshlet.PrimCount && meshlet.PrimOffset + i < mesh.primitiveIndices.size(); i++) {
+			const PackedTriangle& triangle = mesh.primitiveIndices[meshlet.PrimOffset + i];
+			for (UINT32 local : { (UINT32)triangle.i0, (UINT32)triangle.i1, (UINT32)triangle.i2 }) {
+				CHECK(local < meshlet.VertCount);
+				if (local < meshlet.VertCount) {
+					used[local] = true;
+				}
+			}
+		}
+		// No meshlet carries a vertex it doesn't use, or the same vertex twice.
+		std::vector<UINT32> vertices;
+		for (UINT32 i = 0; i < meshlet.VertCount && meshlet.VertOffset + i < mesh.uniqueVertexIndices.size(); i++) {
+			CHECK(used[i]);
+			vertices.push_back(mesh.uniqueVertexIndices[meshlet.VertOffset + i]);
+			CHECK(vertices.back() < mesh.vertices.size());
+		}
+		std::sort(vertices.begin(), vertices.end());
+		CHECK(std::adjacent_find(vertices.begin(), vertices.end()) == vertices.end());
+	}
+	CHECK(vertOffset == mesh.uniqueVertexIndices.size());
+	CHECK(primOffset == mesh.primitiveIndices.size());
+	if (vertOffset == mesh.uniqueVertexIndices.size() && primOffset == mesh.primitiveIndices.size()) {
+		CHECK(MeshletTriangles(mesh.meshlets, mesh.uniqueVertexIndices, mesh.primitiveIndices) == IndexTriangles(mesh.indices));
+	}
+}
+
+static void testLimits() {
+	const UINT limits[][2] = { { 32, 32 }, { 64, 126 }, { 3, 1 }, { 4, 64 }, { 64, 2 }, { 255, 512 }, { 1024, 1 } };
+	for (const auto& limit : limits) {
+		for (float coneWeight : { 0.0f, 0.5f, 4.0f }) {
+			MeshletMeshData sphere = MakeSphereMesh(24, 32, 2.0f);
+			BuildMeshlets(sphere, limit[0], limit[1], coneWeight);
+			checkMeshlets(sphere, limit[0], limit[1]);
+
+			MeshletMeshData grid = MakeGridMesh(23, 17);
+			BuildMeshlets(grid, limit[0], limit[1], coneWeight);
+			checkMeshlets(grid, limit[0], limit[1]);
+		}
+	}
+
+	// Full meshlets shouldn't be left mostly empty, on a grid nearly every meshlet should reach one of the limits.
+	MeshletMeshData grid = MakeGridMesh(33, 33);
+	BuildMeshlets(grid, 64, 126, 0.5f);
+	UINT full = 0;
+	for (const Meshlet& meshlet : grid.meshlets) {
+		full += meshlet.VertCount > 64 - 3 || meshlet.PrimCount == 126;
+	}
+	CHECK(full + 2 >= grid.meshlets.size());
+}
+
+// Degenerate triangles (repeated vertices) and a mesh with no triangles.
+static void testDegenerate() {
+	MeshletMeshData mesh = MakeGridMesh(5, 5);
+	mesh.indices.insert(mesh.indices.end(), { 3, 3, 7, 9, 9, 9 });
+	BuildMeshlets(mesh, 3, 4, 0.5f);
+	checkMeshlets(mesh, 3, 4);
+
+	// A repeated vertex only takes one slot, so both of these fit in 3.
+	MeshletMeshData repeated = MakeGridMesh(3, 3);
+	repeated.indices = { 0, 0, 1, 2, 2, 1 };
+	BuildMeshlets(repeated, 3, 4, 0.5f);
+	checkMeshlets(repeated, 3, 4);
+	CHECK(repeated.meshlets.size() == 1);
+
+	MeshletMeshData empty = MakeGridMesh(3, 3);
+	empty.indices.clear();
+	BuildMeshlets(empty, 32, 32, 0.5f);
+	CHECK(empty.meshlets.empty() && empty.primitiveIndices.empty() && empty.uniqueVertexIndices.empty());
+}
+
+static bool throwsOnLimits(UINT maxVertices, UINT maxPrimitives) {
+	MeshletMeshData mesh = MakeGridMesh(3, 3);
+	try {
+		BuildMeshlets(mesh, maxVertices, maxPrimitives, 0.5f);
+	}
+	catch (const char*) {
+		return true;
+	}
+	return false;
+}
+
+static void testLimitsOutOfRange() {
+	CHECK(throwsOnLimits(2, 32));
+	CHECK(throwsOnLimits(1025, 32));
+	CHECK(throwsOnLimits(32, 0));
+	CHECK(!throwsOnLimits(1024, 1));
+}
+
+// The tables of mesh 'index' in 'view' are the ones 'mesh' was written with.
+static void checkWrittenMesh(const MeshletFileView& view, UINT32 index, const MeshletMeshData& mesh) {
+	const MeshHeader& header = view.meshes[index];
+	const UINT32 indexSize = mesh.indexSize();
+	CHECK(view.accessors[header.Indices].Size == indexSize && view.accessors[header.UniqueVertexIndices].Size == indexSize);
+
+	auto readIndices = [&](UINT32 accessor) {
+		std::vector<UINT32> indices(view.accessors[accessor].Count);
+		const UINT8* bytes = view.viewBytes(accessor).data();
+		for (size_t i = 0; i < indices.size(); i++) {
+			if (indexSize == 2) {
+				UINT16 index;
+				std::memcpy(&index, bytes + i * 2, 2);
+				indices[i] = index;
+			}
+			else {
+				std::memcpy(&indices[i], bytes + i * 4, 4);
+			}
+		}
+		return indices;
+	};
+	CHECK(readIndices(header.Indices) == mesh.indices);
+	CHECK(readIndices(header.UniqueVertexIndices) == mesh.uniqueVertexIndices);
+
+	auto meshlets = view.elements<Meshlet>(header.Meshlets);
+	CHECK(meshlets.size() == mesh.meshlets.size() && std::memcmp(meshlets.data(), mesh.meshlets.data(), meshlets.size_bytes()) == 0);
+	auto primitives = view.elements<PackedTriangle>(header.PrimitiveIndices);
+	CHECK(primitives.size() == mesh.primitiveIndices.size() && std::memcmp(primitives.data(), mesh.primitiveIndices.data(), primitives.size_bytes()) == 0);
+	auto cullData = view.elements<CullData>(header.CullData);
+	CHECK(cullData.size() == mesh.cullData.size() && std::memcmp(cullData.data(), mesh.cullData.data(), cullData.size_bytes()) == 0);
+
+	const Accessor& positions = view.accessors[header.Attributes[Attribute::Position]];
+	const Accessor& texCoords = view.accessors[header.Attributes[Attribute::TexCoord]];
+	CHECK(positions.Count == mesh.vertices.size());
+	for (size_t v = 0; v < mesh.vertices.size() && v < positions.Count; v++) {
+		const UINT8* vertex = view.viewBytes(header.Attributes[Attribute::Position]).data() + v * positions.Stride;
+		CHECK(std::memcmp(vertex + positions.Offset, &mesh.vertices[v].position, 12) == 0);
+		CHECK(std::memcmp(vertex + texCoords.Offset, &mesh.vertices[v].texCoord, 8) == 0);
+	}
+	CHECK(view.lodHeaders[index].Meshlets == UINT32(-1) && view.lodHeaders[index].ClusterLods == UINT32(-1));
+}
+
+static void testWriteAndParse() {
+	// The loader only takes meshlets that fit MESHLET_GROUP_SIZE, the last mesh needs 32 bit indices.
+	std::vector<MeshletMeshData> meshes = { MakeSphereMesh(16, 20, 1.0f), MakeGridMesh(9, 7), MakeGridMesh(260, 260) };
+	for (MeshletMeshData& mesh : meshes) {
+		BuildMeshlets(mesh, MESHLET_GROUP_SIZE, MESHLET_GROUP_SIZE, 0.5f);
+		ComputeMeshletCullData(mesh);
+	}
+	CHECK(meshes[0].indexSize() == 2 && meshes[2].indexSize() == 4);
+
+	std::ostringstream stream;
+	WriteMeshletFile(stream, meshes);
+	const std::string written = stream.str();
+	// Copied into a vector so the parse sees it 4 byte aligned, like a mapping.
+	std::vector<UINT8> bytes(written.begin(), written.end());
+	MeshletFileView view;
+	std::string error;
+	CHECK(ParseMeshletFile(bytes, view, error));
+	if (!error.empty()) {
+		std::printf("%s\n", error.c_str());
+		return;
+	}
+	CHECK(view.header->Version == FILE_VERSION_CLUSTER_LOD);
+	CHECK(view.meshes.size() == meshes.size());
+	for (UINT32 i = 0; i < meshes.size() && i < view.meshes.size(); i++) {
+		checkWrittenMesh(view, i, meshes[i]);
+	}
+
+	// Meshlets past MESHLET_GROUP_SIZE are written as asked, the parse is what turns them away.
+	std::vector<MeshletMeshData> large = { MakeGridMesh(9, 7) };
+	BuildMeshlets(large[0], 64, 126, 0.5f);
+	ComputeMeshletCullData(large[0]);
+	std::ostringstream largeStream;
+	WriteMeshletFile(largeStream, large);
+	const std::string largeWritten = largeStream.str();
+	std::vector<UINT8> largeBytes(largeWritten.begin(), largeWritten.end());
+	CHECK(!ParseMeshletFile(largeBytes, view, error));
+}
+
+int main() {
+	testLimits();
+	testDegenerate();
+	testLimitsOutOfRange();
+	testWriteAndParse();
+	if (testFailures == 0) {
+		std::printf("All meshlet builder checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "ModelLoading/MeshletCompression.h"
+#include "ModelLoading/MeshletFile.h"
+#include "MeshletTestFile.h"
+
+// Load throughput of the meshlet file versions: reading a file from disk and getting it to where MeshletModel can point
+// its meshes into it. Version 1 files are only parsed, chunked files also decode every chunk. Run with the file count
+// and grid size to use, defaults give a file of about 60MB. Repeated reads come from the OS file cache, so this measures
+// the CPU side of loading, not the disk.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<UINT8> readFile(const std::filesystem::path& path) {
+	std::ifstream input(path, std::ios::binary | std::ios::ate);
+	std::vector<UINT8> bytes((size_t)input.tellg());
+	input.seekg(0);
+	input.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	return bytes;
+}
+
+static void writeFile(const std::filesystem::path& path, const std::vector<UINT8>& bytes) {
+	std::ofstream output(path, std::ios::binary);
+	output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static std::vector<UINT8> compress(const std::vector<UINT8>& file, bool quantize, double& seconds) {
+	std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+	std::string error;
+	auto start = std::chrono::steady_clock::now();
+	if (!CompressMeshletFile(file, stream, quantize, error)) {
+		std::printf("couldn't compress: %s\n", error.c_str());
+		std::exit(1);
+	}
+	seconds = secondsSince(start);
+	std::string bytes = stream.str();
+	return std::vector<UINT8>(bytes.begin(), bytes.end());
+}
+
+// Fastest of 'runs' loads of the file at 'path', in seconds.
+static double loadFile(const std::filesystem::path& path, int runs) {
+	double best = 1e30;
+	for (int run = 0; run < runs; run++) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<UINT8> bytes = readFile(path);
+		MeshletFileView view;
+		std::string error;
+		if (!ParseMeshletFile(bytes, view, error)) {
+			std::printf("couldn't parse %s: %s\n", path.string().c_str(), error.c_str());
+			std::exit(1);
+		}
+		std::vector<std::vector<UINT8>> meshBuffers(view.chunks.size());
+		for (UINT32 i = 0; i < view.chunks.size(); i++) {
+			MeshletFileView meshView;
+			if (!DecodeMeshletChunk(view.chunkBytes(i), view.chunks[i].DecodedSize, meshBuffers[i], error)
+				|| !ParseMeshletFile(meshBuffers[i], meshView, error)) {
+				std::printf("couldn't decode %s: %s\n", path.string().c_str(), error.c_str());
+				std::exit(1);
+			}
+		}
+		best = std::min(best, secondsSince(start));
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	const UINT32 meshCount = argc > 1 ? (UINT32)std::stoul(argv[1]) : 8;
+	const UINT32 gridSize = argc > 2 ? (UINT32)std::stoul(argv[2]) : 350;
+	const int runs = 5;
+
+	TestMeshletFile file;
+	for (UINT32 i = 0; i < meshCount; i++) {
+		AddGridMesh(file, gridSize, gridSize);
+	}
+	std::vector<UINT8> original = file.bytes();
+	double losslessSeconds;
+	double quantizedSeconds;
+	std::vector<UINT8> lossless = compress(original, false, losslessSeconds);
+	std::vector<UINT8> quantized = compress(original, true, quantizedSeconds);
+
+	const std::filesystem::path dir = std::filesystem::temp_directory_path();
+	const std::filesystem::path paths[] = { dir / "meshlet_benchmark_v1.bin", dir / "meshlet_benchmark_lossless.bin", dir / "meshlet_benchmark_quantized.bin" };
+	writeFile(paths[0], original);
+	writeFile(paths[1], lossless);
+	writeFile(paths[2], quantized);
+
+	const double mb = original.size() / (1024.0 * 1024.0);
+	std::printf("%u meshes of %ux%u vertices, %.1fMB as version 1, best of %d loads\n", meshCount, gridSize, gridSize, mb, runs);
+	std::printf("compressing: lossless %.0fMB/s, quantized %.0fMB/s\n", mb / losslessSeconds, mb / quantizedSeconds);
+	const char* names[] = { "version 1", "lossless", "quantized" };
+	const size_t sizes[] = { original.size(), lossless.size(), quantized.size() };
+	for (int i = 0; i < 3; i++) {
+		const double seconds = loadFile(paths[i], runs);
+		std::printf("%-10s %6.1fMB (%3.0f%%) loads in %7.2fms, %6.0fMB/s of meshes\n", names[i], sizes[i] / (1024.0 * 1024.0),
+			100.0 * sizes[i] / original.size(), seconds * 1000.0, mb / seconds);
+		std::filesystem::remove(paths[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "ModelLoading/MeshletCompression.h"
+#include "ModelLoading/MeshletFile.h"
+#include "MeshletTestFile.h"
+#include "TestCheck.h"
+
+static std::vector<UINT8> compress(const std::vector<UINT8>& file, bool quantize) {
+	std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+	std::string error;
+	CHECK(CompressMeshletFile(file, stream, quantize, error));
+	std::string bytes = stream.str();
+	return std::vector<UINT8>(bytes.begin(), bytes.end());
+}
+
+// Decodes every chunk of 'compressed' and parses it as the single mesh file it holds.
+static bool decodeAll(const std::vector<UINT8>& compressed, std::vector<std::vector<UINT8>>& decoded, std::vector<MeshletFileView>& views) {
+	MeshletFileView view;
+	std::string error;
+	if (!ParseMeshletFile(compressed, view, error) || view.header->Version != FILE_VERSION_CHUNKED) {
+		std::printf("compressed file doesn't parse: %s\n", error.c_str());
+		return false;
+	}
+	decoded.resize(view.chunks.size());
+	views.resize(view.chunks.size());
+	for (UINT32 i = 0; i < view.chunks.size(); i++) {
+		if (!DecodeMeshletChunk(view.chunkBytes(i), view.chunks[i].DecodedSize, decoded[i], error) || !ParseMeshletFile(decoded[i], views[i], error)) {
+			std::printf("chunk %u doesn't decode: %s\n", i, error.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+// Codec each BufferView of the chunk was stored with, in BufferView order.
+static std::vector<UINT32> chunkCodecs(std::span<const UINT8> chunk) {
+	FileHeader header;
+	std::memcpy(&header, chunk.data(), sizeof(header));
+	const size_t tablesSize = sizeof(FileHeader) + sizeof(MeshHeader) + sizeof(MeshLodHeader)
+		+ header.AccessorCount * sizeof(Accessor) + header.BufferViewCount * sizeof(BufferView);
+	std::vector<UINT32> codecs(header.BufferViewCount);
+	for (UINT32 i = 0; i < header.BufferViewCount; i++) {
+		StreamHeader stream;
+		std::memcpy(&stream, chunk.data() + tablesSize + i * sizeof(StreamHeader), sizeof(stream));
+		codecs[i] = stream.Codec;
+	}
+	return codecs;
+}
+
+static UINT32 codecOf(const MeshletFileView& view, std::span<const UINT8> chunk, UINT32 accessor) {
+	return chunkCodecs(chunk)[view.accessors[accessor].BufferView];
+}
+
+// Both accessors' whole BufferViews hold the same bytes.
+static bool sameBytes(const MeshletFileView& a, UINT32 accessorA, const MeshletFileView& b, UINT32 accessorB) {
+	std::span<const UINT8> bytesA = a.viewBytes(accessorA);
+	std::span<const UINT8> bytesB = b.viewBytes(accessorB);
+	return bytesA.size() == bytesB.size() && std::memcmp(bytesA.data(), bytesB.data(), bytesA.size()) == 0;
+}
+
+static TestMeshletFile twoMeshFile() {
+	TestMeshletFile file;
+	AddGridMesh(file, 40, 30);
+	AddGridMesh(file, 300, 250);
+	return file;
+}
+
+static void testLosslessRoundTrip() {
+	std::vector<UINT8> original = twoMeshFile().bytes();
+	MeshletFileView source;
+	std::string error;
+	CHECK(ParseMeshletFile(original, source, error));
+
+	std::vector<UINT8> compressed = compress(original, false);
+	CHECK(compressed.size() < original.size());
+	std::vector<std::vector<UINT8>> decoded;
+	std::vector<MeshletFileView> views;
+	CHECK(decodeAll(compressed, decoded, views));
+	CHECK(views.size() == source.meshes.size());
+	if (views.size() != source.meshes.size()) {
+		return;
+	}
+
+	MeshletFileView compressedView;
+	ParseMeshletFile(compressed, compressedView, error);
+	for (UINT32 i = 0; i < views.size(); i++) {
+		const MeshHeader& from = source.meshes[i];
+		const MeshHeader& to = views[i].meshes[0];
+		std::span<const UINT8> chunk = compressedView.chunkBytes(i);
+
+		// Each codec is used, or this isn't testing its round trip.
+		CHECK(codecOf(views[i], chunk, to.Indices) == STREAM_CODEC_WORD_DELTA);
+		CHECK(codecOf(views[i], chunk, to.Meshlets) == STREAM_CODEC_WORD_DELTA);
+		CHECK(codecOf(views[i], chunk, to.UniqueVertexIndices) == STREAM_CODEC_WORD_DELTA);
+		CHECK(codecOf(views[i], chunk, to.PrimitiveIndices) == STREAM_CODEC_TRIANGLES);
+		CHECK(codecOf(views[i], chunk, to.Attributes[Attribute::Position]) == STREAM_CODEC_RAW);
+		CHECK(codecOf(views[i], chunk, to.CullData) == STREAM_CODEC_RAW);
+
+		CHECK(sameBytes(source, from.Indices, views[i], to.Indices));
+		CHECK(sameBytes(source, from.IndexSubsets, views[i], to.IndexSubsets));
+		for (UINT32 j = 0; j < Attribute::Count; j++) {
+			CHECK(sameBytes(source, from.Attributes[j], views[i], to.Attributes[j]));
+			CHECK(views[i].accessors[to.Attributes[j]].Offset == source.accessors[from.Attributes[j]].Offset);
+		}
+		CHECK(sameBytes(source, from.Meshlets, views[i], to.Meshlets));
+		CHECK(sameBytes(source, from.MeshletSubsets, views[i], to.MeshletSubsets));
+		CHECK(sameBytes(source, from.UniqueVertexIndices, views[i], to.UniqueVertexIndices));
+		CHECK(sameBytes(source, from.PrimitiveIndices, views[i], to.PrimitiveIndices));
+		CHECK(sameBytes(source, from.CullData, views[i], to.CullData));
+	}
+
+	// Compressing is deterministic, the same file always gives the same bytes.
+	CHECK(compress(original, false) == compressed);
+}
+
+static void testQuantizedBound() {
+	std::vector<UINT8> original = twoMeshFile().bytes();
+	MeshletFileView source;
+	std::string error;
+	CHECK(ParseMeshletFile(original, source, error));
+
+	std::vector<UINT8> compressed = compress(original, true);
+	std::vector<std::vector<UINT8>> decoded;
+	std::vector<MeshletFileView> views;
+	CHECK(decodeAll(compressed, decoded, views));
+	if (views.size() != source.meshes.size()) {
+		CHECK(views.size() == source.meshes.size());
+		return;
+	}
+
+	MeshletFileView compressedView;
+	ParseMeshletFile(compressed, compressedView, error);
+	for (UINT32 i = 0; i < views.size(); i++) {
+		const MeshHeader& from = source.meshes[i];
+		const MeshHeader& to = views[i].meshes[0];
+		CHECK(codecOf(views[i], compressedView.chunkBytes(i), to.Attributes[Attribute::Position]) == STREAM_CODEC_QUANTIZED);
+
+		// Every float of the interleaved vertices is quantized to 16 bits over its own component's range, so it's at most
+		// half a step off, plus the float rounding of reconstructing it from the range.
+		const UINT32 stride = source.accessors[from.Attributes[Attribute::Position]].Stride / sizeof(FLOAT);
+		std::span<const UINT8> sourceBytes = source.viewBytes(from.Attributes[Attribute::Position]);
+		std::span<const UINT8> decodedBytes = views[i].viewBytes(to.Attributes[Attribute::Position]);
+		CHECK(sourceBytes.size() == decodedBytes.size());
+		const size_t count = sourceBytes.size() / (stride * sizeof(FLOAT));
+		const FLOAT* expected = reinterpret_cast<const FLOAT*>(sourceBytes.data());
+		const FLOAT* actual = reinterpret_cast<const FLOAT*>(decodedBytes.data());
+		double worst = 0.0;
+		for (UINT32 c = 0; c < stride; c++) {
+			FLOAT minimum = expected[c];
+			FLOAT maximum = expected[c];
+			for (size_t v = 0; v < count; v++) {
+				minimum = std::min(minimum, expected[v * stride + c]);
+				maximum = std::max(maximum, expected[v * stride + c]);
+			}
+			const double bound = (maximum - minimum) / 65535.0 * 0.5 + 1e-6 * std::max(std::abs(minimum), std::abs(maximum));
+			for (size_t v = 0; v < count; v++) {
+				const double difference = std::abs((double)actual[v * stride + c] - expected[v * stride + c]);
+				worst = std::max(worst, difference / std::max(bound, 1e-12));
+			}
+		}
+		std::printf("mesh %u quantized vertices are off by at most %.2f of the bound\n", i, worst);
+		CHECK(worst <= 1.0);
+
+		// Everything but the vertices is still lossless.
+		CHECK(sameBytes(source, from.Indices, views[i], to.Indices));
+		CHECK(sameBytes(source, from.PrimitiveIndices, views[i], to.PrimitiveIndices));
+		CHECK(sameBytes(source, from.Meshlets, views[i], to.Meshlets));
+	}
+}
+
+static void testDamagedChunks() {
+	std::vector<UINT8> compressed = compress(twoMeshFile().bytes(), false);
+	MeshletFileView view;
+	std::string error;
+	CHECK(ParseMeshletFile(compressed, view, error));
+	std::vector<UINT8> chunk(view.chunkBytes(0).begin(), view.chunkBytes(0).end());
+	std::vector<UINT8> decoded;
+
+	// Chunks cut short anywhere fail, never decode past their end. Every cut through the tables, then a spread of them
+	// through the streams, each of which decodes everything before it first.
+	FileHeader header;
+	std::memcpy(&header, chunk.data(), sizeof(header));
+	const size_t tablesSize = sizeof(FileHeader) + sizeof(MeshHeader) + sizeof(MeshLodHeader) + header.AccessorCount * sizeof(Accessor)
+		+ header.BufferViewCount * (sizeof(BufferView) + sizeof(StreamHeader));
+	for (size_t size = 0; size < chunk.size(); size += size < tablesSize ? 1 : 61) {
+		CHECK(!DecodeMeshletChunk(std::span<const UINT8>(chunk).first(size), view.chunks[0].DecodedSize, decoded, error));
+	}
+	CHECK(!DecodeMeshletChunk(chunk, view.chunks[0].DecodedSize + 4, decoded, error));
+
+	// Flipped bytes either fail to decode or decode to something ParseMeshletFile checks.
+	for (size_t i = 0; i < chunk.size(); i += 31) {
+		std::vector<UINT8> damaged = chunk;
+		damaged[i] ^= 0x5a;
+		MeshletFileView decodedView;
+		if (DecodeMeshletChunk(damaged, view.chunks[0].DecodedSize, decoded, error)) {
+			ParseMeshletFile(decoded, decodedView, error);
+		}
+	}
+}
+
+int main() {
+	testLosslessRoundTrip();
+	testQuantizedBound();
+	testDamagedChunks();
+	if (testFailures == 0) {
+		std::printf("All meshlet compression checks passed\n");
+	}
+	return testFailures;
+}
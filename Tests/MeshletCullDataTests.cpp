@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ModelLoading/MeshletBuilder.h"
+#include "MeshletTestMesh.h"
+#include "TestCheck.h"
+
+// ComputeMeshletCullData's spheres and cones against the meshlets they were built for: every vertex has to be inside the
+// sphere, every triangle normal inside the cone the shader dequantizes, and the shader's test may only cull a meshlet
+// from where all of its triangles face away. Meshes are a sphere, a wavy grid and a sphere with its vertices pushed
+// around at random, so cones range from tight to degenerate.
+
+struct Float3 {
+	float x, y, z;
+};
+
+static Float3 subtract(const DirectX::XMFLOAT3& a, const Float3& b) {
+	return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static float dot(const Float3& a, const Float3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Float3 normalize(const Float3& v) {
+	const float length = std::sqrt(dot(v, v));
+	return { v.x / length, v.y / length, v.z / length };
+}
+
+// Unit face normal, zero length for degenerate triangles.
+static Float3 faceNormal(const DirectX::XMFLOAT3& p0, const DirectX::XMFLOAT3& p1, const DirectX::XMFLOAT3& p2) {
+	const Float3 a = subtract(p1, { p0.x, p0.y, p0.z });
+	const Float3 b = subtract(p2, { p0.x, p0.y, p0.z });
+	const Float3 normal = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	const float length = std::sqrt(dot(normal, normal));
+	return length > 0.0f ? Float3{ normal.x / length, normal.y / length, normal.z / length } : Float3{ 0.0f, 0.0f, 0.0f };
+}
+
+// Axis UnpackCone in MeshletAS.hlsl gets from the bytes, not normalized.
+static Float3 unpackAxis(const CullData& cull) {
+	return { cull.NormalCone[0] / 255.0f * 2.0f - 1.0f, cull.NormalCone[1] / 255.0f * 2.0f - 1.0f, cull.NormalCone[2] / 255.0f * 2.0f - 1.0f };
+}
+
+static MeshletMeshData noisySphere() {
+	MeshletMeshData mesh = MakeSphereMesh(20, 28, 3.0f);
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> offset(-0.15f, 0.15f);
+	for (MeshletVertex& vertex : mesh.vertices) {
+		vertex.position = { vertex.position.x + offset(random), vertex.position.y + offset(random), vertex.position.z + offset(random) };
+	}
+	return mesh;
+}
+
+static std::vector<MeshletMeshData> builtMeshes(UINT maxVertices, UINT maxPrimitives) {
+	std::vector<MeshletMeshData> meshes = { MakeSphereMesh(24, 32, 2.0f), MakeGridMesh(25, 19), noisySphere() };
+	for (MeshletMeshData& mesh : meshes) {
+		BuildMeshlets(mesh, maxVertices, maxPrimitives, 0.5f);
+		ComputeMeshletCullData(mesh);
+	}
+	return meshes;
+}
+
+static void testSpheres(const MeshletMeshData& mesh) {
+	CHECK(mesh.cullData.size() == mesh.meshlets.size());
+	for (size_t m = 0; m < mesh.meshlets.size() && m < mesh.cullData.size(); m++) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		const DirectX::XMFLOAT4& sphere = mesh.cullData[m].BoundingSphere;
+		const Float3 center = { sphere.x, sphere.y, sphere.z };
+		float widest = 0.0f;
+		for (UINT32 i = 0; i < meshlet.VertCount; i++) {
+			const DirectX::XMFLOAT3& position = mesh.vertices[mesh.uniqueVertexIndices[meshlet.VertOffset + i]].position;
+			const Float3 offset = subtract(position, center);
+			CHECK(std::sqrt(dot(offset, offset)) <= sphere.w);
+			for (UINT32 j = 0; j < i; j++) {
+				const DirectX::XMFLOAT3& other = mesh.vertices[mesh.uniqueVertexIndices[meshlet.VertOffset + j]].position;
+				const Float3 pair = subtract(position, { other.x, other.y, other.z });
+				widest = std::max(widest, std::sqrt(dot(pair, pair)));
+			}
+		}
+		// Minimal, the smallest sphere around points 'widest' apart is at most Jung's bound of widest * sqrt(3/8).
+		CHECK(sphere.w <= widest * 0.6124f * 1.0001f + 1e-6f);
+	}
+}
+
+static void testCones(const MeshletMeshData& mesh, UINT& tightCones) {
+	for (size_t m = 0; m < mesh.meshlets.size() && m < mesh.cullData.size(); m++) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		const CullData& cull = mesh.cullData[m];
+		if (cull.NormalCone[3] == 0xFF) {
+			continue;
+		}
+		tightCones++;
+		// The cutoff is sin of the cone's half angle, so every normal is within cos of it along the axis the shader sees.
+		const Float3 axis = normalize(unpackAxis(cull));
+		const float cutoff = cull.NormalCone[3] / 255.0f;
+		const float minDot = std::sqrt(std::max(1.0f - cutoff * cutoff, 0.0f));
+		for (UINT32 i = 0; i < meshlet.PrimCount; i++) {
+			const PackedTriangle& triangle = mesh.primitiveIndices[meshlet.PrimOffset + i];
+			auto position = [&](UINT32 local) -> const DirectX::XMFLOAT3& { return mesh.vertices[mesh.uniqueVertexIndices[meshlet.VertOffset + local]].position; };
+			const Float3 normal = faceNormal(position(triangle.i0), position(triangle.i1), position(triangle.i2));
+			if (dot(normal, normal) == 0.0f) {
+				continue;
+			}
+			if (dot(normal, axis) < minDot - 1e-5f) {
+				std::printf("meshlet %zu: normal %f below the cone's %f\n", m, dot(normal, axis), minDot);
+				testFailures++;
+			}
+		}
+	}
+}
+
+// The shader's IsVisible test from views all around the mesh, a culled meshlet can't have a triangle facing the view.
+static void testCulling(const MeshletMeshData& mesh, UINT& culled) {
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (UINT view = 0; view < 300; view++) {
+		const float distance = view % 3 == 0 ? 2.5f : 12.0f;
+		const Float3 viewPos = normalize({ unit(random), unit(random), unit(random) });
+		const Float3 eye = { viewPos.x * distance, viewPos.y * distance, viewPos.z * distance };
+		for (size_t m = 0; m < mesh.meshlets.size(); m++) {
+			const Meshlet& meshlet = mesh.meshlets[m];
+			const CullData& cull = mesh.cullData[m];
+			if (cull.NormalCone[3] == 0xFF) {
+				continue;
+			}
+			const Float3 axis = unpackAxis(cull);
+			const Float3 apex = { cull.BoundingSphere.x - axis.x * cull.ApexOffset, cull.BoundingSphere.y - axis.y * cull.ApexOffset,
+				cull.BoundingSphere.z - axis.z * cull.ApexOffset };
+			const Float3 toView = normalize(subtract({ eye.x, eye.y, eye.z }, apex));
+			const Float3 unitAxis = normalize(axis);
+			if (!(-dot(toView, unitAxis) > cull.NormalCone[3] / 255.0f)) {
+				continue;
+			}
+			culled++;
+			for (UINT32 i = 0; i < meshlet.PrimCount; i++) {
+				const PackedTriangle& triangle = mesh.primitiveIndices[meshlet.PrimOffset + i];
+				auto position = [&](UINT32 local) -> const DirectX::XMFLOAT3& { return mesh.vertices[mesh.uniqueVertexIndices[meshlet.VertOffset + local]].position; };
+				const Float3 normal = faceNormal(position(triangle.i0), position(triangle.i1), position(triangle.i2));
+				const Float3 toEye = subtract({ eye.x, eye.y, eye.z }, { position(triangle.i0).x, position(triangle.i0).y, position(triangle.i0).z });
+				if (dot(normal, toEye) > 1e-4f) {
+					std::printf("meshlet %zu culled from (%f %f %f) with triangle %u facing it\n", m, eye.x, eye.y, eye.z, i);
+					testFailures++;
+					return;
+				}
+			}
+		}
+	}
+}
+
+static void testMeasure() {
+	MeshletMeshData sphere = MakeSphereMesh(24, 32, 2.0f);
+	BuildMeshlets(sphere, 32, 32, 0.5f);
+	ComputeMeshletCullData(sphere);
+	MeshletCullStats stats = MeasureMeshletCulling(sphere, 64);
+	CHECK(stats.meshlets == sphere.meshlets.size());
+	CHECK(stats.meshletTests == 64ull * sphere.meshlets.size());
+	CHECK(stats.triangleTests == 64ull * sphere.indices.size() / 3);
+	// Seen from outside a sphere, roughly half of it faces away, and the cones should find a good part of that. Only the
+	// odd meshlet seeded from leftover triangles spreads far enough to be degenerate.
+	CHECK(stats.degenerateCones <= stats.meshlets / 10);
+	CHECK(stats.meshletCullRate() > 0.2f && stats.meshletCullRate() < 0.5f);
+
+	// A nearly flat grid's cones are all close to its normal, so views below it cull nearly everything and views above
+	// nothing, about half overall.
+	MeshletMeshData grid = MakeGridMesh(25, 19);
+	BuildMeshlets(grid, 32, 32, 0.5f);
+	ComputeMeshletCullData(grid);
+	const float gridRate = MeasureMeshletCulling(grid, 64).meshletCullRate();
+	CHECK(gridRate > 0.4f && gridRate <= 0.5f);
+}
+
+int main() {
+	UINT tightCones = 0;
+	UINT culled = 0;
+	for (UINT limit : { 8u, 32u, 64u }) {
+		for (const MeshletMeshData& mesh : builtMeshes(limit, limit)) {
+			testSpheres(mesh);
+			testCones(mesh, tightCones);
+			testCulling(mesh, culled);
+		}
+	}
+	// Otherwise the cone checks checked nothing.
+	CHECK(tightCones > 100 && culled > 1000);
+	testMeasure();
+	if (testFailures == 0) {
+		std::printf("All meshlet cull data checks passed\n");
+	}
+	return testFailures;
+}
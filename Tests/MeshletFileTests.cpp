@@ -0,0 +1,236 @@
+#include <cstring>
+#include <string>
+
+#include "ModelLoading/MeshletFile.h"
+#include "MeshletTestFile.h"
+#include "TestCheck.h"
+
+static TestMeshletFile gridFile() {
+	TestMeshletFile file;
+	AddGridMesh(file, 9, 7);
+	return file;
+}
+
+static bool parses(const std::vector<UINT8>& bytes, std::string& error) {
+	MeshletFileView view;
+	return ParseMeshletFile(bytes, view, error);
+}
+
+// The file is rejected, and for the reason the test broke it for.
+static bool failsWith(const TestMeshletFile& file, const char* reason) {
+	std::string error;
+	if (parses(file.bytes(), error)) {
+		return false;
+	}
+	if (error.find(reason) == std::string::npos) {
+		std::printf("expected \"%s\", got \"%s\"\n", reason, error.c_str());
+		return false;
+	}
+	return true;
+}
+
+template <typename T>
+static T* elementsOf(TestMeshletFile& file, UINT32 accessor) {
+	return reinterpret_cast<T*>(file.buffer.data() + file.bufferViews[file.accessors[accessor].BufferView].Offset);
+}
+
+static void testValidFile() {
+	TestMeshletFile file = gridFile();
+	std::vector<UINT8> bytes = file.bytes();
+	MeshletFileView view;
+	std::string error;
+	CHECK(ParseMeshletFile(bytes, view, error));
+	CHECK(error.empty());
+	CHECK(view.meshes.size() == 1);
+	CHECK(view.lodHeaders.size() == 1 && view.lodHeaders[0].ClusterLods == UINT32(-1));
+
+	// Attributes read at their accessor's offset inside the stride give back the vertices, whatever the Attribute order.
+	std::vector<TestVertex> vertices;
+	std::vector<UINT32> indices;
+	MakeGrid(9, 7, vertices, indices);
+	const MeshHeader& mesh = view.meshes[0];
+	for (UINT32 v = 0; v < vertices.size(); v++) {
+		auto attribute = [&](UINT32 type) {
+			const Accessor& accessor = view.accessors[mesh.Attributes[type]];
+			return view.viewBytes(mesh.Attributes[type]).data() + (size_t)v * accessor.Stride + accessor.Offset;
+		};
+		CHECK(std::memcmp(attribute(Attribute::Position), vertices[v].position, 12) == 0);
+		CHECK(std::memcmp(attribute(Attribute::Normal), vertices[v].normal, 12) == 0);
+		CHECK(std::memcmp(attribute(Attribute::TexCoord), vertices[v].texCoord, 8) == 0);
+		CHECK(std::memcmp(attribute(Attribute::Tangent), vertices[v].tangent, 12) == 0);
+		CHECK(std::memcmp(attribute(Attribute::Bitangent), vertices[v].bitangent, 12) == 0);
+	}
+}
+
+static void testHeader() {
+	TestMeshletFile file = gridFile();
+	file.header.Prolog = 0x4c48534d;
+	CHECK(failsWith(file, "not a meshlet file"));
+
+	file = gridFile();
+	file.header.Version = CURRENT_FILE_VERSION + 1;
+	CHECK(failsWith(file, "newer than this loader"));
+
+	// Parsed in place, so a misaligned start is refused rather than read unaligned.
+	std::vector<UINT8> bytes = gridFile().bytes();
+	std::vector<UINT8> shifted(bytes.size() + 1);
+	std::memcpy(shifted.data() + 1, bytes.data(), bytes.size());
+	MeshletFileView view;
+	std::string error;
+	CHECK(!ParseMeshletFile(std::span<const UINT8>(shifted).subspan(1), view, error));
+}
+
+static void testTruncated() {
+	std::vector<UINT8> bytes = gridFile().bytes();
+	std::string error;
+	for (size_t size = 0; size < bytes.size(); size++) {
+		CHECK(!parses(std::vector<UINT8>(bytes.begin(), bytes.begin() + size), error));
+	}
+	std::vector<UINT8> longer = bytes;
+	longer.resize(bytes.size() + 4);
+	CHECK(!parses(longer, error));
+}
+
+static void testOverlapping() {
+	// Normals moved onto the positions.
+	TestMeshletFile file = gridFile();
+	file.accessors[file.meshes[0].Attributes[Attribute::Normal]].Offset = 4;
+	CHECK(failsWith(file, "overlap"));
+
+	// Tangents and bitangents swapped into each other's bytes by a bad writer.
+	file = gridFile();
+	file.accessors[file.meshes[0].Attributes[Attribute::Bitangent]].Offset = file.accessors[file.meshes[0].Attributes[Attribute::Tangent]].Offset + 8;
+	CHECK(failsWith(file, "overlap"));
+
+	// Attributes sharing a stream but not its stride.
+	file = gridFile();
+	file.accessors[file.meshes[0].Attributes[Attribute::TexCoord]].Stride += 4;
+	CHECK(failsWith(file, "different strides"));
+}
+
+static void testOutOfRangeAccessors() {
+	// Texcoords starting 4 bytes before the end of the stride read into the next vertex.
+	TestMeshletFile file = gridFile();
+	Accessor& texCoord = file.accessors[file.meshes[0].Attributes[Attribute::TexCoord]];
+	texCoord.Offset = texCoord.Stride - 4;
+	CHECK(failsWith(file, "doesn't match the vertex layout"));
+
+	file = gridFile();
+	file.accessors[file.meshes[0].Attributes[Attribute::Normal]].Offset = UINT32(-8);
+	CHECK(failsWith(file, "doesn't match the vertex layout"));
+
+	file = gridFile();
+	file.accessors[file.meshes[0].Attributes[Attribute::Normal]].Size = 16;
+	CHECK(failsWith(file, "doesn't match the vertex layout"));
+
+	file = gridFile();
+	file.meshes[0].Attributes[Attribute::Normal] = (UINT32)file.accessors.size();
+	CHECK(failsWith(file, "attribute accessor is missing"));
+
+	file = gridFile();
+	file.meshes[0].Meshlets = UINT32(-2);
+	CHECK(failsWith(file, "meshlet accessor is missing"));
+
+	file = gridFile();
+	file.accessors[file.meshes[0].Indices].BufferView = (UINT32)file.bufferViews.size();
+	CHECK(failsWith(file, "missing buffer view"));
+
+	file = gridFile();
+	file.accessors[file.meshes[0].Indices].Count++;
+	CHECK(failsWith(file, "past the end of its buffer view"));
+
+	file = gridFile();
+	file.bufferViews.back().Size += 8;
+	CHECK(failsWith(file, "past the end of the buffer"));
+}
+
+static void testIndices() {
+	TestMeshletFile file = gridFile();
+	elementsOf<UINT16>(file, file.meshes[0].Indices)[5] = 9 * 7;
+	CHECK(failsWith(file, "index buffer has an index past"));
+
+	file = gridFile();
+	elementsOf<UINT16>(file, file.meshes[0].UniqueVertexIndices)[0] = 9 * 7;
+	CHECK(failsWith(file, "past the mesh's vertices"));
+
+	file = gridFile();
+	elementsOf<Subset>(file, file.meshes[0].IndexSubsets)[0].Count++;
+	CHECK(failsWith(file, "subset is empty or out of range"));
+}
+
+static void testMeshlets() {
+	// MeshletMS writes a meshlet's vertices and primitives into arrays of MESHLET_GROUP_SIZE.
+	TestMeshletFile file = gridFile();
+	Meshlet& meshlet = elementsOf<Meshlet>(file, file.meshes[0].Meshlets)[0];
+	meshlet.VertCount = MESHLET_GROUP_SIZE + 1;
+	CHECK(failsWith(file, "larger than MeshletMS can output"));
+
+	file = gridFile();
+	elementsOf<Meshlet>(file, file.meshes[0].Meshlets)[0].PrimCount = MESHLET_GROUP_SIZE + 1;
+	CHECK(failsWith(file, "larger than MeshletMS can output"));
+
+	file = gridFile();
+	elementsOf<Meshlet>(file, file.meshes[0].Meshlets)[0].VertCount = 0;
+	CHECK(failsWith(file, "larger than MeshletMS can output"));
+
+	file = gridFile();
+	UINT32 meshletCount = file.accessors[file.meshes[0].Meshlets].Count;
+	elementsOf<Meshlet>(file, file.meshes[0].Meshlets)[meshletCount - 1].PrimOffset++;
+	CHECK(failsWith(file, "meshlet that's out of range"));
+
+	file = gridFile();
+	const Meshlet first = elementsOf<Meshlet>(file, file.meshes[0].Meshlets)[0];
+	elementsOf<PackedTriangle>(file, file.meshes[0].PrimitiveIndices)[0].i2 = first.VertCount;
+	CHECK(failsWith(file, "primitive past its meshlet's vertices"));
+
+	file = gridFile();
+	file.accessors[file.meshes[0].CullData].Count--;
+	CHECK(failsWith(file, "cull data count"));
+}
+
+static void testChunkTable() {
+	TestMeshletFile source = gridFile();
+	std::vector<UINT8> chunk = source.bytes();
+	FileHeader header = { MESHLET_FILE_PROLOG, FILE_VERSION_CHUNKED, 1, 0, 0, (UINT32)chunk.size() };
+	MeshChunk entry = { sizeof(FileHeader) + sizeof(MeshChunk), (UINT32)chunk.size(), (UINT32)chunk.size() };
+	auto chunked = [&]() {
+		std::vector<UINT8> bytes(sizeof(header) + sizeof(entry));
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		std::memcpy(bytes.data() + sizeof(header), &entry, sizeof(entry));
+		bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+		return bytes;
+	};
+	std::string error;
+	MeshletFileView view;
+	std::vector<UINT8> bytes = chunked();
+	CHECK(ParseMeshletFile(bytes, view, error));
+	CHECK(view.chunks.size() == 1 && view.chunkBytes(0).size() == chunk.size());
+
+	entry.Size++;
+	CHECK(!parses(chunked(), error));
+	entry.Size--;
+	// Chunks can't overlap the tables in front of them.
+	entry.Offset = sizeof(FileHeader);
+	CHECK(!parses(chunked(), error));
+	entry.Offset = sizeof(FileHeader) + sizeof(MeshChunk);
+	header.BufferSize--;
+	CHECK(!parses(chunked(), error));
+	header.BufferSize++;
+	header.AccessorCount = 1;
+	CHECK(!parses(chunked(), error));
+}
+
+int main() {
+	testValidFile();
+	testHeader();
+	testTruncated();
+	testOverlapping();
+	testOutOfRangeAccessors();
+	testIndices();
+	testMeshlets();
+	testChunkTable();
+	if (testFailures == 0) {
+		std::printf("All meshlet file checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ModelLoading/MeshletHierarchy.h"
+#include "MeshletTestMesh.h"
+#include "TestCheck.h"
+
+// Cluster hierarchies of a closed sphere and an open grid. Errors and bounds have to grow from every cluster to its parent
+// group, and the cut SelectClusterCut picks for any view has to cover the surface exactly once. Without cracks every edge
+// of the cut's triangles is used as often one way as the other, except the grid's own border which simplification keeps
+// locked, and without overlaps no triangle is drawn twice. A cluster drawn along with its parent shows up as edges
+// inside the group with nothing on their other side.
+// Edges aren't required to have exactly two triangles: the simplifier can fold a triangle back over one of a neighbouring
+// group's made from the same three locked vertices, which leaves a zero area fin but no hole.
+
+static MeshletMeshData buildHierarchy(MeshletMeshData mesh) {
+	BuildMeshlets(mesh, 32, 32, 0.5f);
+	ComputeMeshletCullData(mesh);
+	BuildMeshletHierarchy(mesh, 32, 32, 4, 0.5f);
+	return mesh;
+}
+
+static bool sameSphere(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b) {
+	return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static float centerDistance(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b) {
+	return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+static void checkTables(const MeshletMeshData& mesh) {
+	CHECK(mesh.clusterLods.size() == mesh.meshlets.size() + mesh.lodMeshlets.size());
+	CHECK(mesh.lodCullData.size() == mesh.lodMeshlets.size());
+	for (const Meshlet& meshlet : mesh.lodMeshlets) {
+		CHECK(meshlet.VertCount <= 32 && meshlet.PrimCount <= 32);
+		CHECK(meshlet.VertOffset + meshlet.VertCount <= mesh.lodUniqueVertexIndices.size());
+		CHECK(meshlet.PrimOffset + meshlet.PrimCount <= mesh.lodPrimitiveIndices.size());
+	}
+	for (UINT32 vertex : mesh.lodUniqueVertexIndices) {
+		CHECK(vertex < mesh.vertices.size());
+	}
+}
+
+// Every cluster's error and bounds are inside its parent's, and the parent is a real group of coarser clusters.
+static void checkMonotonic(const MeshletMeshData& mesh) {
+	const std::vector<ClusterLod>& lods = mesh.clusterLods;
+	UINT roots = 0;
+	UINT32 topLevel = 0;
+	for (size_t c = 0; c < lods.size(); c++) {
+		const ClusterLod& lod = lods[c];
+		topLevel = std::max(topLevel, lod.Level);
+		CHECK((lod.Level == 0) == (c < mesh.meshlets.size()));
+		CHECK((lod.Error == 0.0f) == (lod.Level == 0));
+		if (lod.ParentError == FLT_MAX) {
+			roots++;
+			continue;
+		}
+		CHECK(lod.ParentError >= lod.Error);
+		CHECK(centerDistance(lod.LodBounds, lod.ParentLodBounds) + lod.LodBounds.w <= lod.ParentLodBounds.w * 1.0001f + 1e-5f);
+		// Full detail clusters bound their own meshlet.
+		if (lod.Level == 0) {
+			CHECK(sameSphere(lod.LodBounds, mesh.cullData[c].BoundingSphere));
+		}
+		bool parentFound = false;
+		for (const ClusterLod& parent : lods) {
+			if (parent.Level > lod.Level && parent.Error == lod.ParentError && sameSphere(parent.LodBounds, lod.ParentLodBounds)) {
+				parentFound = true;
+				break;
+			}
+		}
+		CHECK(parentFound);
+	}
+	// It simplified at all, and stopped with a handful of roots.
+	CHECK(topLevel >= 3);
+	CHECK(roots >= 1 && roots < mesh.meshlets.size() / 4);
+}
+
+// Triangles of cluster 'cluster' in mesh vertex indices, full detail meshlets first like SelectClusterCut numbers them.
+static void addClusterTriangles(const MeshletMeshData& mesh, UINT32 cluster, std::vector<std::array<UINT32, 3>>& triangles) {
+	const bool lod = cluster >= mesh.meshlets.size();
+	const Meshlet& meshlet = lod ? mesh.lodMeshlets[cluster - mesh.meshlets.size()] : mesh.meshlets[cluster];
+	const std::vector<UINT32>& unique = lod ? mesh.lodUniqueVertexIndices : mesh.uniqueVertexIndices;
+	const std::vector<PackedTriangle>& primitives = lod ? mesh.lodPrimitiveIndices : mesh.primitiveIndices;
+	for (UINT32 i = 0; i < meshlet.PrimCount; i++) {
+		const PackedTriangle& triangle = primitives[meshlet.PrimOffset + i];
+		triangles.push_back({ unique[meshlet.VertOffset + triangle.i0], unique[meshlet.VertOffset + triangle.i1], unique[meshlet.VertOffset + triangle.i2] });
+	}
+}
+
+// How many times each directed edge is used.
+static std::map<std::pair<UINT32, UINT32>, UINT> directedEdges(const std::vector<std::array<UINT32, 3>>& triangles) {
+	std::map<std::pair<UINT32, UINT32>, UINT> edges;
+	for (const auto& triangle : triangles) {
+		for (UINT k = 0; k < 3; k++) {
+			edges[{ triangle[k], triangle[(k + 1) % 3] }]++;
+		}
+	}
+	return edges;
+}
+
+static void checkCuts(const MeshletMeshData& mesh, float viewDistance) {
+	// Edges of the full detail mesh without a reverse, border edges are locked so every cut has to keep exactly these.
+	const auto fullEdges = directedEdges(IndexTriangles(mesh.indices));
+	std::map<std::pair<UINT32, UINT32>, UINT> openEdges;
+	for (const auto& [edge, count] : fullEdges) {
+		if (fullEdges.count({ edge.second, edge.first }) == 0) {
+			openEdges[edge] = count;
+		}
+	}
+	const std::vector<UINT32> roots = SelectClusterCut(mesh.clusterLods.data(), (UINT32)mesh.clusterLods.size(), { 0.0f, 0.0f, 1e6f }, FLT_MAX / 2.0f);
+	CHECK(!roots.empty());
+
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	UINT coarserCuts = 0;
+	for (UINT view = 0; view < 40; view++) {
+		DirectX::XMFLOAT3 viewPos = { unit(random), unit(random), unit(random) };
+		const float length = std::sqrt(viewPos.x * viewPos.x + viewPos.y * viewPos.y + viewPos.z * viewPos.z);
+		const float distance = viewDistance * (1.0f + 10.0f * (view % 4));
+		viewPos = { viewPos.x / length * distance, viewPos.y / length * distance, viewPos.z / length * distance };
+		for (float threshold : { 0.0f, 1e-4f, 1e-3f, 1e-2f, 1e-1f, FLT_MAX / 2.0f }) {
+			const std::vector<UINT32> cut = SelectClusterCut(mesh.clusterLods.data(), (UINT32)mesh.clusterLods.size(), viewPos, threshold);
+			std::vector<std::array<UINT32, 3>> triangles;
+			bool coarser = false;
+			for (UINT32 cluster : cut) {
+				CHECK(cluster < mesh.clusterLods.size());
+				coarser = coarser || cluster >= mesh.meshlets.size();
+				addClusterTriangles(mesh, cluster, triangles);
+			}
+			coarserCuts += coarser;
+			if (threshold == 0.0f) {
+				// Full detail is exactly the meshlets.
+				CHECK(cut.size() == mesh.meshlets.size() && !coarser);
+			}
+
+			UINT wrong = 0;
+			const auto edges = directedEdges(triangles);
+			for (const auto& [edge, count] : edges) {
+				const auto reverse = edges.find({ edge.second, edge.first });
+				const UINT reverseCount = reverse == edges.end() ? 0 : reverse->second;
+				wrong += openEdges.count(edge) > 0 ? count != 1 || reverseCount != 0 : count != reverseCount;
+			}
+			// Open edges of the full mesh can't go missing from a cut either.
+			for (const auto& [edge, count] : openEdges) {
+				wrong += edges.count(edge) == 0;
+			}
+			std::vector<std::array<UINT32, 3>> sorted;
+			for (const auto& triangle : triangles) {
+				sorted.push_back(CanonicalTriangle(triangle[0], triangle[1], triangle[2]));
+			}
+			std::sort(sorted.begin(), sorted.end());
+			wrong += std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end();
+			if (wrong > 0) {
+				std::printf("view %u threshold %g: %u of %zu edges cracked or triangles overlapping in a cut of %zu clusters\n", view, threshold, wrong,
+					edges.size(), cut.size());
+				testFailures++;
+				return;
+			}
+		}
+	}
+	// Otherwise only the full detail and root cuts were checked.
+	CHECK(coarserCuts > 80);
+}
+
+int main() {
+	const MeshletMeshData sphere = buildHierarchy(MakeSphereMesh(48, 64, 2.0f));
+	checkTables(sphere);
+	checkMonotonic(sphere);
+	checkCuts(sphere, 3.0f);
+
+	const MeshletMeshData grid = buildHierarchy(MakeGridMesh(65, 49));
+	checkTables(grid);
+	checkMonotonic(grid);
+	checkCuts(grid, 7.0f);
+	if (testFailures == 0) {
+		std::printf("All meshlet hierarchy checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "ModelLoading/MeshletFormat.h"
+
+// Vertex layout of the files MeshletBuilder writes, MeshletVertex without the DirectXMath types.
+struct TestVertex {
+	FLOAT position[3];
+	FLOAT normal[3];
+	FLOAT tangent[3];
+	FLOAT bitangent[3];
+	FLOAT texCoord[2];
+};
+
+// A FILE_VERSION_CLUSTER_LOD file kept as separate tables, so a test can break any part of it before writing it out.
+struct TestMeshletFile {
+	FileHeader header = { MESHLET_FILE_PROLOG, FILE_VERSION_CLUSTER_LOD, 0, 0, 0, 0 };
+	std::vector<MeshHeader> meshes;
+	std::vector<MeshLodHeader> lodHeaders;
+	std::vector<Accessor> accessors;
+	std::vector<BufferView> bufferViews;
+	std::vector<UINT8> buffer;
+
+	// Appends a BufferView holding 'size' bytes of 'data', padded so the next one stays 4 byte aligned.
+	UINT32 addView(const void* data, size_t size) {
+		bufferViews.push_back({ (UINT32)buffer.size(), (UINT32)size });
+		const UINT8* bytes = static_cast<const UINT8*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+		buffer.resize((buffer.size() + 3) & ~size_t(3), 0);
+		return (UINT32)bufferViews.size() - 1;
+	}
+
+	UINT32 addAccessor(UINT32 view, UINT32 offset, UINT32 size, UINT32 stride, UINT32 count) {
+		accessors.push_back({ view, offset, size, stride, count });
+		return (UINT32)accessors.size() - 1;
+	}
+
+	template <typename T>
+	UINT32 addElements(const std::vector<T>& elements) {
+		UINT32 view = addView(elements.data(), elements.size() * sizeof(T));
+		return addAccessor(view, 0, sizeof(T), sizeof(T), (UINT32)elements.size());
+	}
+
+	std::vector<UINT8> bytes() const {
+		FileHeader written = header;
+		written.MeshCount = (UINT32)meshes.size();
+		written.AccessorCount = (UINT32)accessors.size();
+		written.BufferViewCount = (UINT32)bufferViews.size();
+		written.BufferSize = (UINT32)buffer.size();
+		std::vector<UINT8> file;
+		append(file, &written, sizeof(written));
+		append(file, meshes.data(), meshes.size() * sizeof(MeshHeader));
+		append(file, lodHeaders.data(), lodHeaders.size() * sizeof(MeshLodHeader));
+		append(file, accessors.data(), accessors.size() * sizeof(Accessor));
+		append(file, bufferViews.data(), bufferViews.size() * sizeof(BufferView));
+		append(file, buffer.data(), buffer.size());
+		return file;
+	}
+
+private:
+	static void append(std::vector<UINT8>& file, const void* data, size_t size) {
+		const UINT8* bytes = static_cast<const UINT8*>(data);
+		file.insert(file.end(), bytes, bytes + size);
+	}
+};
+
+// A width x height grid of vertices on a wavy surface, two triangles per cell.
+inline void MakeGrid(UINT32 width, UINT32 height, std::vector<TestVertex>& vertices, std::vector<UINT32>& indices) {
+	for (UINT32 y = 0; y < height; y++) {
+		for (UINT32 x = 0; x < width; x++) {
+			const FLOAT u = (FLOAT)x / (width - 1);
+			const FLOAT v = (FLOAT)y / (height - 1);
+			const FLOAT h = 0.25f * std::sin(6.0f * u) * std::cos(4.0f * v);
+			vertices.push_back({ { u * 10.0f - 5.0f, h, v * 10.0f - 5.0f }, { -h, 1.0f, 0.5f * h }, { 1.0f, 0.0f, h },
+				{ 0.0f, -h, 1.0f }, { u * 2.0f, v * 3.0f } });
+		}
+	}
+	for (UINT32 y = 0; y + 1 < height; y++) {
+		for (UINT32 x = 0; x + 1 < width; x++) {
+			const UINT32 i = y * width + x;
+			indices.insert(indices.end(), { i, i + width, i + 1, i + 1, i + width, i + width + 1 });
+		}
+	}
+}
+
+// Meshlets over the (non degenerate) triangles of 'indices' in order, each closed once the next triangle would take it past 'maxVertices' or 'maxPrimitives'.
+inline void MakeMeshlets(const std::vector<UINT32>& indices, UINT32 maxVertices, UINT32 maxPrimitives,
+	std::vector<Meshlet>& meshlets, std::vector<UINT32>& uniqueIndices, std::vector<PackedTriangle>& primitives) {
+	Meshlet current = {};
+	auto localIndex = [&](UINT32 index) {
+		for (UINT32 i = 0; i < current.VertCount; i++) {
+			if (uniqueIndices[current.VertOffset + i] == index) {
+				return i;
+			}
+		}
+		return UINT32(-1);
+	};
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		UINT32 newVertices = 0;
+		for (size_t k = 0; k < 3; k++) {
+			newVertices += localIndex(indices[t + k]) == UINT32(-1) ? 1 : 0;
+		}
+		if (current.VertCount + newVertices > maxVertices || current.PrimCount + 1 > maxPrimitives) {
+			meshlets.push_back(current);
+			current = { 0, (UINT32)uniqueIndices.size(), 0, (UINT32)primitives.size() };
+		}
+		UINT32 local[3];
+		for (size_t k = 0; k < 3; k++) {
+			local[k] = localIndex(indices[t + k]);
+			if (local[k] == UINT32(-1)) {
+				uniqueIndices.push_back(indices[t + k]);
+				local[k] = current.VertCount++;
+			}
+		}
+		PackedTriangle triangle = {};
+		triangle.i0 = local[0];
+		triangle.i1 = local[1];
+		triangle.i2 = local[2];
+		primitives.push_back(triangle);
+		current.PrimCount++;
+	}
+	if (current.PrimCount > 0) {
+		meshlets.push_back(current);
+	}
+}
+
+// Adds a mesh over the grid to 'file', with interleaved vertices laid out like MeshletBuilder writes them.
+inline void AddGridMesh(TestMeshletFile& file, UINT32 width, UINT32 height) {
+	std::vector<TestVertex> vertices;
+	std::vector<UINT32> indices;
+	MakeGrid(width, height, vertices, indices);
+
+	std::vector<Meshlet> meshlets;
+	std::vector<UINT32> uniqueIndices;
+	std::vector<PackedTriangle> primitives;
+	MakeMeshlets(indices, MESHLET_GROUP_SIZE, MESHLET_GROUP_SIZE, meshlets, uniqueIndices, primitives);
+
+	MeshHeader mesh = {};
+	const UINT32 vertexView = file.addView(vertices.data(), vertices.size() * sizeof(TestVertex));
+	const UINT32 vertexCount = (UINT32)vertices.size();
+	mesh.Attributes[Attribute::Position] = file.addAccessor(vertexView, offsetof(TestVertex, position), 12, sizeof(TestVertex), vertexCount);
+	mesh.Attributes[Attribute::Normal] = file.addAccessor(vertexView, offsetof(TestVertex, normal), 12, sizeof(TestVertex), vertexCount);
+	mesh.Attributes[Attribute::TexCoord] = file.addAccessor(vertexView, offsetof(TestVertex, texCoord), 8, sizeof(TestVertex), vertexCount);
+	mesh.Attributes[Attribute::Tangent] = file.addAccessor(vertexView, offsetof(TestVertex, tangent), 12, sizeof(TestVertex), vertexCount);
+	mesh.Attributes[Attribute::Bitangent] = file.addAccessor(vertexView, offsetof(TestVertex, bitangent), 12, sizeof(TestVertex), vertexCount);
+
+	// 16 bit indices whenever they fit, like the builder.
+	if (vertexCount <= 0xffff) {
+		mesh.Indices = file.addElements(std::vector<UINT16>(indices.begin(), indices.end()));
+		mesh.UniqueVertexIndices = file.addElements(std::vector<UINT16>(uniqueIndices.begin(), uniqueIndices.end()));
+	}
+	else {
+		mesh.Indices = file.addElements(indices);
+		mesh.UniqueVertexIndices = file.addElements(uniqueIndices);
+	}
+	mesh.IndexSubsets = file.addElements(std::vector<Subset>{ { 0, (UINT32)indices.size() } });
+	mesh.Meshlets = file.addElements(meshlets);
+	mesh.MeshletSubsets = file.addElements(std::vector<Subset>{ { 0, (UINT32)meshlets.size() } });
+	mesh.PrimitiveIndices = file.addElements(primitives);
+
+	std::vector<CullData> cullData(meshlets.size());
+	for (size_t i = 0; i < cullData.size(); i++) {
+		cullData[i].BoundingSphere = { (FLOAT)i, 0.5f, -(FLOAT)i, 1.0f };
+		cullData[i].NormalCone[0] = (UINT8)i;
+		cullData[i].NormalCone[1] = 255;
+		cullData[i].NormalCone[2] = 127;
+		cullData[i].NormalCone[3] = 64;
+		cullData[i].ApexOffset = 0.25f * i;
+	}
+	mesh.CullData = file.addElements(cullData);
+
+	file.meshes.push_back(mesh);
+	file.lodHeaders.push_back({ UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1), UINT32(-1) });
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "ModelLoading/MeshletBuilder.h"
+
+// Meshes for the tests of MeshletBuilder and the code that builds on its meshlets. Triangles are counter clockwise seen
+// from outside, the winding of the .obj files meshlets are built from.
+
+// Closed sphere of 'rings' bands from pole to pole and 'segments' around, the poles are single vertices.
+inline MeshletMeshData MakeSphereMesh(UINT32 rings, UINT32 segments, float radius) {
+	MeshletMeshData mesh;
+	auto addVertex = [&](float x, float y, float z) {
+		MeshletVertex vertex = {};
+		vertex.position = { x * radius, y * radius, z * radius };
+		vertex.normal = { x, y, z };
+		mesh.vertices.push_back(vertex);
+	};
+	addVertex(0.0f, 1.0f, 0.0f);
+	for (UINT32 ring = 1; ring < rings; ring++) {
+		const float polar = 3.14159265f * ring / rings;
+		for (UINT32 segment = 0; segment < segments; segment++) {
+			const float azimuth = 6.28318531f * segment / segments;
+			addVertex(std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth));
+		}
+	}
+	addVertex(0.0f, -1.0f, 0.0f);
+
+	const UINT32 bottom = (UINT32)mesh.vertices.size() - 1;
+	auto ringVertex = [&](UINT32 ring, UINT32 segment) { return 1 + (ring - 1) * segments + segment % segments; };
+	for (UINT32 segment = 0; segment < segments; segment++) {
+		mesh.indices.insert(mesh.indices.end(), { 0, ringVertex(1, segment + 1), ringVertex(1, segment) });
+		mesh.indices.insert(mesh.indices.end(), { bottom, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1) });
+	}
+	for (UINT32 ring = 1; ring + 1 < rings; ring++) {
+		for (UINT32 segment = 0; segment < segments; segment++) {
+			const UINT32 a = ringVertex(ring, segment);
+			const UINT32 b = ringVertex(ring, segment + 1);
+			const UINT32 c = ringVertex(ring + 1, segment);
+			const UINT32 d = ringVertex(ring + 1, segment + 1);
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+		}
+	}
+	return mesh;
+}
+
+// Open width x height grid of vertices on a wavy surface 10 units across, two triangles per cell, facing up.
+inline MeshletMeshData MakeGridMesh(UINT32 width, UINT32 height) {
+	MeshletMeshData mesh;
+	for (UINT32 y = 0; y < height; y++) {
+		for (UINT32 x = 0; x < width; x++) {
+			const float u = (float)x / (width - 1);
+			const float v = (float)y / (height - 1);
+			MeshletVertex vertex = {};
+			vertex.position = { u * 10.0f - 5.0f, 0.25f * std::sin(6.0f * u) * std::cos(4.0f * v), v * 10.0f - 5.0f };
+			vertex.normal = { 0.0f, 1.0f, 0.0f };
+			vertex.texCoord = { u, v };
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (UINT32 y = 0; y + 1 < height; y++) {
+		for (UINT32 x = 0; x + 1 < width; x++) {
+			const UINT32 i = y * width + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + width, i + 1, i + 1, i + width, i + width + 1 });
+		}
+	}
+	return mesh;
+}
+
+// A triangle by its mesh vertex indices, rotated so the smallest comes first so the same triangle always compares equal.
+inline std::array<UINT32, 3> CanonicalTriangle(UINT32 a, UINT32 b, UINT32 c) {
+	if (b < a && b <= c) {
+		return { b, c, a };
+	}
+	if (c < a && c < b) {
+		return { c, a, b };
+	}
+	return { a, b, c };
+}
+
+// Triangles of 'meshlets' in mesh vertex indices, sorted.
+inline std::vector<std::array<UINT32, 3>> MeshletTriangles(const std::vector<Meshlet>& meshlets, const std::vector<UINT32>& uniqueVertexIndices,
+	const std::vector<PackedTriangle>& primitiveIndices) {
+	std::vector<std::array<UINT32, 3>> triangles;
+	for (const Meshlet& meshlet : meshlets) {
+		for (UINT32 i = 0; i < meshlet.PrimCount; i++) {
+			const PackedTriangle& triangle = primitiveIndices[meshlet.PrimOffset + i];
+			triangles.push_back(CanonicalTriangle(uniqueVertexIndices[meshlet.VertOffset + triangle.i0],
+				uniqueVertexIndices[meshlet.VertOffset + triangle.i1], uniqueVertexIndices[meshlet.VertOffset + triangle.i2]));
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// Triangles of 'indices' in mesh vertex indices, sorted.
+inline std::vector<std::array<UINT32, 3>> IndexTriangles(const std::vector<UINT32>& indices) {
+	std::vector<std::array<UINT32, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		triangles.push_back(CanonicalTriangle(indices[i], indices[i + 1], indices[i + 2]));
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+#include <string>
+
+#include "ModelLoading/ModelCache.h"
+
+// Cache of a model with 'meshCount' meshes, each a gridSize x gridSize grid with one LOD at every other triangle, all
+// instanced on a chain of nodes under the root, plus one light. Filled the way SimpleModel::process fills it.
+inline ModelCacheData MakeTestModelCache(UINT32 meshCount, UINT32 gridSize) {
+	ModelCacheData data;
+	data.nodes.push_back({ UINT32(-1), data.addString("root"), {}, 0, 0 });
+	for (UINT32 mesh = 0; mesh < meshCount; mesh++) {
+		CachedMesh cached = {};
+		cached.TypeFlags = mesh % 2 == 0 ? 0u : 1u;
+		cached.BaseVertexLocation = (UINT32)data.vertices.size();
+		cached.StartIndexLocation = (UINT32)data.indices.size();
+		cached.VertexCount = gridSize * gridSize;
+		for (UINT32 y = 0; y < gridSize; y++) {
+			for (UINT32 x = 0; x < gridSize; x++) {
+				const float u = (float)x / (gridSize - 1);
+				const float v = (float)y / (gridSize - 1);
+				data.vertices.push_back({ { u, v }, { u * 10.0f, 0.2f * std::sin(u * 7.0f), v * 10.0f + mesh }, { 0.0f, 1.0f, 0.0f },
+					{ 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } });
+			}
+		}
+		for (UINT32 y = 0; y + 1 < gridSize; y++) {
+			for (UINT32 x = 0; x + 1 < gridSize; x++) {
+				const UINT32 i = y * gridSize + x;
+				data.indices.insert(data.indices.end(), { i, i + gridSize, i + 1, i + 1, i + gridSize, i + gridSize + 1 });
+			}
+		}
+		cached.IndexCount = (UINT32)data.indices.size() - cached.StartIndexLocation;
+		cached.BoundsCenter = { 5.0f, 0.0f, 5.0f + mesh };
+		cached.BoundsExtents = { 5.0f, 0.2f, 5.0f };
+		if (cached.TypeFlags != 0) {
+			cached.Textures[0] = data.addString("diffuse" + std::to_string(mesh) + ".png");
+		}
+
+		cached.FirstLod = (UINT32)data.lods.size();
+		cached.LodCount = 1;
+		const UINT32 lodStart = (UINT32)data.indices.size();
+		for (UINT32 i = cached.StartIndexLocation; i < cached.StartIndexLocation + cached.IndexCount; i += 6) {
+			data.indices.insert(data.indices.end(), { data.indices[i], data.indices[i + 1], data.indices[i + 2] });
+		}
+		data.lods.push_back({ (UINT32)data.indices.size() - lodStart, lodStart, 0.01f });
+		data.meshes.push_back(cached);
+
+		DirectX::XMFLOAT4X4 transform = {};
+		transform.m[0][0] = transform.m[1][1] = transform.m[2][2] = transform.m[3][3] = 1.0f;
+		transform.m[3][1] = (float)mesh;
+		data.nodes.push_back({ (UINT32)data.nodes.size() - 1, data.addString("node" + std::to_string(mesh)), transform, (UINT32)data.nodeMeshes.size(), 1 });
+		data.nodeMeshes.push_back(mesh);
+	}
+	CachedLight light = {};
+	light.Type = 1;
+	light.Name = data.addString("sun");
+	light.Direction = { 0.0f, -1.0f, 0.0f };
+	light.ColorDiffuse = { 1.0f, 1.0f, 1.0f };
+	data.lights.push_back(light);
+	return data;
+}
@@ -0,0 +1,293 @@
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ModelLoading/ModelCache.h"
+#include "ModelCacheTestData.h"
+#include "TestCheck.h"
+
+static std::vector<UINT8> write(const ModelCacheData& data, const ModelCacheHeader& stamp = {}) {
+	std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+	CHECK(WriteModelCache(stream, stamp, data));
+	std::string bytes = stream.str();
+	return std::vector<UINT8>(bytes.begin(), bytes.end());
+}
+
+// The file is rejected, and for the reason the test broke it for.
+static bool failsWith(const std::vector<UINT8>& bytes, const char* reason) {
+	ModelCacheView view;
+	std::string error;
+	if (ParseModelCache(bytes, view, error)) {
+		return false;
+	}
+	if (error.find(reason) == std::string::npos) {
+		std::printf("expected \"%s\", got \"%s\"\n", reason, error.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool failsWith(const ModelCacheData& data, const char* reason) {
+	return failsWith(write(data), reason);
+}
+
+static ModelCacheHeader headerOf(const std::vector<UINT8>& bytes) {
+	ModelCacheHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	return header;
+}
+
+static void testRoundTrip() {
+	const ModelCacheData data = MakeTestModelCache(3, 9);
+	ModelCacheHeader stamp = {};
+	stamp.SourceSize = 1234;
+	stamp.SourceWriteTime = 5678;
+	stamp.SourceHash = 0x1122334455667788ull;
+	stamp.SettingsHash = 42;
+	// Counts in the stamp are ignored, the data's are written.
+	stamp.MeshCount = 99;
+	std::vector<UINT8> bytes = write(data, stamp);
+
+	ModelCacheView view;
+	std::string error;
+	CHECK(ParseModelCache(bytes, view, error));
+	CHECK(error.empty());
+	if (!view.header) {
+		return;
+	}
+	CHECK(view.header->SourceSize == 1234 && view.header->SourceWriteTime == 5678);
+	CHECK(view.header->SourceHash == stamp.SourceHash && view.header->SettingsHash == 42);
+	CHECK(view.meshes.size() == 3 && view.header->MeshCount == 3);
+	CHECK(view.lods.size() == data.lods.size() && view.nodes.size() == 4 && view.nodeMeshes.size() == 3 && view.lights.size() == 1);
+	CHECK(std::memcmp(view.meshes.data(), data.meshes.data(), view.meshes.size_bytes()) == 0);
+	CHECK(std::memcmp(view.lods.data(), data.lods.data(), view.lods.size_bytes()) == 0);
+	CHECK(std::memcmp(view.nodes.data(), data.nodes.data(), view.nodes.size_bytes()) == 0);
+	CHECK(view.vertices.size() == data.vertices.size() && std::memcmp(view.vertices.data(), data.vertices.data(), view.vertices.size_bytes()) == 0);
+	CHECK(view.indices.size() == data.indices.size() && std::memcmp(view.indices.data(), data.indices.data(), view.indices.size_bytes()) == 0);
+	CHECK(view.string(view.nodes[2].Name) == "node1");
+	CHECK(view.string(view.meshes[1].Textures[0]) == "diffuse1.png");
+	CHECK(view.string(view.lights[0].Name) == "sun");
+
+	// A model with no geometry at all is still a cache, as long as it has its root.
+	ModelCacheData empty;
+	empty.nodes.push_back({ UINT32(-1), {}, {}, 0, 0 });
+	bytes = write(empty);
+	CHECK(ParseModelCache(bytes, view, error));
+}
+
+static void testHeader() {
+	const std::vector<UINT8> bytes = write(MakeTestModelCache(2, 5));
+
+	std::vector<UINT8> damaged = bytes;
+	damaged[offsetof(ModelCacheHeader, Prolog)] ^= 1;
+	CHECK(failsWith(damaged, "not a model cache"));
+
+	damaged = bytes;
+	ModelCacheHeader header = headerOf(bytes);
+	header.Version = MODEL_CACHE_VERSION + 1;
+	std::memcpy(damaged.data(), &header, sizeof(header));
+	CHECK(failsWith(damaged, "isn't the current one"));
+
+	// Parsed in place, so a misaligned start is refused rather than read unaligned.
+	std::vector<UINT8> shifted(bytes.size() + 1);
+	std::memcpy(shifted.data() + 1, bytes.data(), bytes.size());
+	ModelCacheView view;
+	std::string error;
+	CHECK(!ParseModelCache(std::span<const UINT8>(shifted).subspan(1), view, error));
+}
+
+static void testTruncated() {
+	const std::vector<UINT8> bytes = write(MakeTestModelCache(2, 5));
+	ModelCacheView view;
+	std::string error;
+	for (size_t size = 0; size < bytes.size(); size++) {
+		CHECK(!ParseModelCache(std::vector<UINT8>(bytes.begin(), bytes.begin() + size), view, error));
+	}
+	std::vector<UINT8> longer = bytes;
+	longer.resize(bytes.size() + 4);
+	CHECK(failsWith(longer, "bytes but the file has"));
+
+	// Counts that only add up past 32 bits still don't match the file.
+	std::vector<UINT8> huge = bytes;
+	ModelCacheHeader header = headerOf(bytes);
+	header.VertexCount = UINT32(-1);
+	std::memcpy(huge.data(), &header, sizeof(header));
+	CHECK(failsWith(huge, "bytes but the file has"));
+}
+
+static void testMeshes() {
+	ModelCacheData data = MakeTestModelCache(2, 5);
+	data.indices[data.meshes[1].StartIndexLocation + 4] = data.meshes[1].VertexCount;
+	CHECK(failsWith(data, "mesh 1: indices are out of range"));
+
+	data = MakeTestModelCache(2, 5);
+	data.meshes[0].IndexCount = (UINT32)data.indices.size() + 1;
+	CHECK(failsWith(data, "mesh 0: indices are out of range"));
+
+	data = MakeTestModelCache(2, 5);
+	data.meshes[1].VertexCount++;
+	CHECK(failsWith(data, "mesh 1: vertices are out of range"));
+
+	data = MakeTestModelCache(2, 5);
+	data.indices[data.lods[data.meshes[0].FirstLod].StartIndexLocation] = UINT32(-1);
+	CHECK(failsWith(data, "mesh 0: LOD indices are out of range"));
+
+	data = MakeTestModelCache(2, 5);
+	data.meshes[1].FirstLod = (UINT32)data.lods.size();
+	CHECK(failsWith(data, "mesh 1: LODs are out of range"));
+
+	data = MakeTestModelCache(2, 5);
+	data.meshes[1].Textures[0].Size = (UINT32)data.strings.size();
+	CHECK(failsWith(data, "mesh 1: texture name is out of range"));
+}
+
+static void testNodes() {
+	ModelCacheData data = MakeTestModelCache(3, 5);
+	data.nodes[2].Parent = 2;
+	CHECK(failsWith(data, "node 2 is out of range"));
+
+	data = MakeTestModelCache(3, 5);
+	data.nodes[2].Parent = 3;
+	CHECK(failsWith(data, "node 2 is out of range"));
+
+	data = MakeTestModelCache(3, 5);
+	data.nodes[1].Name = { (UINT32)data.strings.size(), 1 };
+	CHECK(failsWith(data, "node 1 is out of range"));
+
+	// Offset and size that each fit but wrap around 32 bits together.
+	data = MakeTestModelCache(3, 5);
+	data.nodes[1].Name = { 4, UINT32(-2) };
+	CHECK(failsWith(data, "node 1 is out of range"));
+
+	data = MakeTestModelCache(3, 5);
+	data.nodes[3].MeshCount = 2;
+	CHECK(failsWith(data, "node 3 is out of range"));
+
+	data = MakeTestModelCache(3, 5);
+	data.nodes[0].Parent = 0;
+	CHECK(failsWith(data, "root node is missing"));
+
+	data = MakeTestModelCache(3, 5);
+	data.nodeMeshes[1] = 3;
+	CHECK(failsWith(data, "instances a missing mesh"));
+
+	data = MakeTestModelCache(3, 5);
+	data.lights[0].Name.Offset = (UINT32)data.strings.size();
+	CHECK(failsWith(data, "light name is out of range"));
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& contents) {
+	std::ofstream output(path, std::ios::binary);
+	output.write(contents.data(), contents.size());
+}
+
+static std::vector<UINT8> readFile(const std::filesystem::path& path) {
+	std::ifstream input(path, std::ios::binary | std::ios::ate);
+	std::vector<UINT8> bytes((size_t)input.tellg());
+	input.seekg(0);
+	input.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	return bytes;
+}
+
+static void testSourceStamp() {
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "model_cache_tests";
+	std::filesystem::create_directories(dir);
+	const std::string source = (dir / "model.obj").string();
+	writeFile(source, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+
+	ModelCacheHeader stamp = {};
+	stamp.SettingsHash = 7;
+	CHECK(StampModelCache(source, stamp));
+	CHECK(stamp.SourceSize == 32);
+	UINT64 writeTime = 0;
+	CHECK(ModelCacheMatches(stamp, source, 7, writeTime));
+	CHECK(writeTime == stamp.SourceWriteTime);
+
+	CHECK(!ModelCacheMatches(stamp, source, 8, writeTime));
+
+	// Touched but the same bytes: still current through the hash, with the new write time to restamp with.
+	const auto touched = std::filesystem::last_write_time(source) + std::chrono::seconds(10);
+	std::filesystem::last_write_time(source, touched);
+	CHECK(ModelCacheMatches(stamp, source, 7, writeTime));
+	CHECK(writeTime != stamp.SourceWriteTime);
+
+	// Same size, different bytes and write time.
+	writeFile(source, "v 0 0 0\nv 2 0 0\nv 0 1 0\nf 1 2 3\n");
+	std::filesystem::last_write_time(source, touched + std::chrono::seconds(10));
+	CHECK(!ModelCacheMatches(stamp, source, 7, writeTime));
+
+	// Different bytes behind an unchanged write time are trusted, that's what the write time is for.
+	std::filesystem::last_write_time(source, std::filesystem::file_time_type(std::filesystem::file_time_type::duration(stamp.SourceWriteTime)));
+	CHECK(ModelCacheMatches(stamp, source, 7, writeTime));
+
+	writeFile(source, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n\n");
+	CHECK(!ModelCacheMatches(stamp, source, 7, writeTime));
+
+	std::filesystem::remove(source);
+	CHECK(!ModelCacheMatches(stamp, source, 7, writeTime));
+	CHECK(!StampModelCache(source, stamp));
+	std::filesystem::remove_all(dir);
+}
+
+static void testSaveAndRestamp() {
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "model_cache_restamp_tests";
+	std::filesystem::create_directories(dir);
+	const std::string cachePath = (dir / "model.obj.mdlc").string();
+	const ModelCacheData data = MakeTestModelCache(2, 5);
+	ModelCacheHeader stamp = {};
+	stamp.SourceWriteTime = 100;
+
+	CHECK(SaveModelCache(cachePath, stamp, data));
+	const std::vector<UINT8> saved = readFile(cachePath);
+	CHECK(saved == write(data, stamp));
+	// Only the renamed cache is left behind.
+	CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 1);
+
+	const ModelCacheHeader mapped = headerOf(saved);
+	CHECK(RestampModelCache(cachePath, mapped, 200));
+	std::vector<UINT8> restamped = readFile(cachePath);
+	ModelCacheView view;
+	std::string error;
+	CHECK(ParseModelCache(restamped, view, error));
+	CHECK(view.header && view.header->SourceWriteTime == 200);
+	// Nothing but the write time changed.
+	CHECK(restamped.size() == saved.size());
+	CHECK(std::memcmp(restamped.data() + sizeof(ModelCacheHeader), saved.data() + sizeof(ModelCacheHeader), saved.size() - sizeof(ModelCacheHeader)) == 0);
+
+	// Another load saved over the cache after this one mapped it, the newer cache is kept as it is.
+	ModelCacheHeader newer = stamp;
+	newer.SourceWriteTime = 300;
+	CHECK(SaveModelCache(cachePath, newer, MakeTestModelCache(3, 4)));
+	const std::vector<UINT8> replaced = readFile(cachePath);
+	CHECK(RestampModelCache(cachePath, mapped, 400));
+	CHECK(readFile(cachePath) == replaced);
+
+	// Deleted since it was mapped.
+	std::filesystem::remove(cachePath);
+	CHECK(!RestampModelCache(cachePath, mapped, 400));
+	CHECK(!std::filesystem::exists(cachePath));
+
+	// Cut short, so there's no header to compare.
+	writeFile(cachePath, "MDLC");
+	CHECK(!RestampModelCache(cachePath, mapped, 400));
+	std::filesystem::remove_all(dir);
+}
+
+int main() {
+	testRoundTrip();
+	testHeader();
+	testTruncated();
+	testMeshes();
+	testNodes();
+	testSourceStamp();
+	testSaveAndRestamp();
+	if (testFailures == 0) {
+		std::printf("All model cache checks passed\n");
+	}
+	return testFailures;
+}
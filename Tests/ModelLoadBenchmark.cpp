@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ModelLoading/GeometryPacking.h"
+#include "ModelLoading/MappedFile.h"
+#include "ModelLoading/ModelCache.h"
+#include "ModelLoading/VertexCompression.h"
+#include "ModelCacheTestData.h"
+
+// Wall clock time of loading a burst of SimpleModels from their ModelCaches, the CPU side of what the ModelLoader's
+// ModelLoadTask and ModelCacheSetupTask do: mapping and parsing the cache, then copying the geometry out of it, hashing
+// each mesh, compressing the vertices and packing the indices the way SimpleModel::prepareGeometry does. Each model is
+// one task, run on one thread and then spread over every hardware thread the way the ThreadPool spreads them.
+// Not timed: SimpleModel's meshes, scene nodes and texture requests (those need d3d12.h) and the batched GPU upload.
+// Run with the model count and the grid size of each of a model's 4 meshes, repeated loads come from the OS file cache.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct LoadedModel {
+	std::vector<UINT64> meshHashes;
+	std::vector<CompactVertex> vertices;
+	std::vector<UINT8> indexData;
+};
+
+static bool loadModel(const std::string& cachePath, LoadedModel& loaded) {
+	MappedFile file;
+	ModelCacheView cache;
+	std::string error;
+	if (!file.open(cachePath) || !ParseModelCache(file.bytes(), cache, error)) {
+		std::printf("couldn't load %s: %s\n", cachePath.c_str(), error.c_str());
+		return false;
+	}
+	// Same copies processCache makes before handing the geometry to prepareGeometry.
+	std::vector<Vertex> vertices(cache.vertices.begin(), cache.vertices.end());
+	std::vector<UINT32> indices(cache.indices.begin(), cache.indices.end());
+
+	loaded.meshHashes.clear();
+	loaded.vertices.resize(vertices.size());
+	loaded.indexData.clear();
+	for (const CachedMesh& mesh : cache.meshes) {
+		loaded.meshHashes.push_back(HashMeshGeometry(vertices.data() + mesh.BaseVertexLocation, mesh.VertexCount,
+			indices.data() + mesh.StartIndexLocation, mesh.IndexCount));
+		DirectX::XMFLOAT3 positionOffset;
+		DirectX::XMFLOAT3 positionScale;
+		SetPositionQuantization(mesh.BoundsCenter, mesh.BoundsExtents, positionOffset, positionScale);
+		for (UINT i = 0; i < mesh.VertexCount; i++) {
+			loaded.vertices[mesh.BaseVertexLocation + i] = CompressVertex(vertices[mesh.BaseVertexLocation + i], positionOffset, positionScale);
+		}
+		const UINT indexSize = PoolIndexSize(mesh.VertexCount, true);
+		AppendPackedIndices(indices.data() + mesh.StartIndexLocation, mesh.IndexCount, indexSize, loaded.indexData);
+		for (const CachedLod& lod : cache.lods.subspan(mesh.FirstLod, mesh.LodCount)) {
+			AppendPackedIndices(indices.data() + lod.StartIndexLocation, lod.IndexCount, indexSize, loaded.indexData);
+		}
+	}
+	PadPackedIndices(loaded.indexData);
+	return true;
+}
+
+// Fastest of 'runs' loads of every model, with each model's load as one task taken by the next free of 'threadCount' threads.
+static double loadAll(const std::vector<std::string>& paths, std::vector<LoadedModel>& models, UINT threadCount, int runs) {
+	double best = 1e30;
+	for (int run = 0; run < runs; run++) {
+		auto start = std::chrono::steady_clock::now();
+		std::atomic<size_t> next = 0;
+		auto worker = [&]() {
+			for (size_t i = next++; i < paths.size(); i = next++) {
+				if (!loadModel(paths[i], models[i])) {
+					std::exit(1);
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for (UINT i = 1; i < threadCount; i++) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		best = std::min(best, secondsSince(start));
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	const UINT32 modelCount = argc > 1 ? (UINT32)std::stoul(argv[1]) : 32;
+	const UINT32 gridSize = argc > 2 ? (UINT32)std::stoul(argv[2]) : 160;
+	const UINT threadCount = std::max(1u, std::thread::hardware_concurrency());
+	const int runs = 5;
+
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "model_load_benchmark";
+	std::filesystem::create_directories(dir);
+	std::vector<std::string> paths;
+	UINT64 totalBytes = 0;
+	for (UINT32 i = 0; i < modelCount; i++) {
+		paths.push_back((dir / ("model" + std::to_string(i) + ".obj.mdlc")).string());
+		if (!SaveModelCache(paths.back(), {}, MakeTestModelCache(4, gridSize))) {
+			std::printf("couldn't write %s\n", paths.back().c_str());
+			return 1;
+		}
+		totalBytes += std::filesystem::file_size(paths.back());
+	}
+
+	std::vector<LoadedModel> sequential(modelCount);
+	std::vector<LoadedModel> parallel(modelCount);
+	const double oneThread = loadAll(paths, sequential, 1, runs);
+	const double allThreads = loadAll(paths, parallel, threadCount, runs);
+	bool same = true;
+	for (UINT32 i = 0; i < modelCount; i++) {
+		same = same && sequential[i].meshHashes == parallel[i].meshHashes && sequential[i].indexData == parallel[i].indexData;
+	}
+
+	const double mb = totalBytes / (1024.0 * 1024.0);
+	std::printf("%u models of 4 %ux%u meshes, %.1fMB of caches, best of %d loads%s\n", modelCount, gridSize, gridSize, mb, runs,
+		same ? "" : ", THREADED LOADS DIFFER");
+	std::printf("1 thread    %8.2fms (%6.0fMB/s, %.2fms a model)\n", oneThread * 1000.0, mb / oneThread, oneThread * 1000.0 / modelCount);
+	std::printf("%2u threads  %8.2fms (%6.0fMB/s), %.1fx one thread\n", threadCount, allThreads * 1000.0, mb / allThreads, oneThread / allThreads);
+	std::filesystem::remove_all(dir);
+	return same ? 0 : 1;
+}
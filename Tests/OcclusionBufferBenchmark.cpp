@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "OcclusionBuffer.h"
+#include "OcclusionTestScene.h"
+
+// Cost of a frame of the CPU occlusion rasterizer at the Settings.h defaults: setting up the occluder triangles, rasterizing
+// every band on one thread (SoftwareOcclusion spreads them over the ThreadPool), then testing boxes against the result.
+// Run with the number of occluder grids to use, each is about 60 triangles plus 4 loose ones.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	const int gridCount = argc > 1 ? std::stoi(argv[1]) : 300;
+	const UINT width = 256;
+	const UINT height = 128;
+	const int boxCount = 10000;
+	const int runs = 20;
+
+	const std::vector<TestTriangle> triangles = MakeOccluderScene(1, (float)width, (float)height, gridCount, gridCount * 4, false);
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<float> boxes;
+	for (int i = 0; i < boxCount; i++) {
+		const float sizeX = 0.5f + unit(random) * unit(random) * 60.0f;
+		const float sizeY = 0.5f + unit(random) * unit(random) * 40.0f;
+		const float minX = unit(random) * (width - sizeX);
+		const float minY = unit(random) * (height - sizeY);
+		boxes.insert(boxes.end(), { minX, minX + sizeX, minY, minY + sizeY, unit(random) });
+	}
+
+	OcclusionBuffer buffer(width, height, 8, 16);
+	double setupSeconds = 1e30;
+	double rasterSeconds = 1e30;
+	double testSeconds = 1e30;
+	int occluded = 0;
+	for (int run = 0; run < runs; run++) {
+		auto start = std::chrono::steady_clock::now();
+		buffer.clearTriangles();
+		for (const TestTriangle& triangle : triangles) {
+			buffer.addTriangle(triangle.x, triangle.y, triangle.z);
+		}
+		setupSeconds = std::min(setupSeconds, secondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		for (UINT band = 0; band < buffer.getBandCount(); band++) {
+			buffer.rasterizeBand(band);
+		}
+		rasterSeconds = std::min(rasterSeconds, secondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		occluded = 0;
+		for (size_t i = 0; i < boxes.size(); i += 5) {
+			occluded += buffer.isRectOccluded(boxes[i], boxes[i + 1], boxes[i + 2], boxes[i + 3], boxes[i + 4]);
+		}
+		testSeconds = std::min(testSeconds, secondsSince(start));
+	}
+
+	std::printf("%zu triangles (%u kept) into %ux%u in %u bands, best of %d runs\n", triangles.size(), buffer.getTriangleCount(), width, height,
+		buffer.getBandCount(), runs);
+	std::printf("setup %.3fms, rasterize %.3fms, %d box tests %.3fms (%.0fns each, %d occluded)\n", setupSeconds * 1000.0, rasterSeconds * 1000.0,
+		boxCount, testSeconds * 1000.0, testSeconds * 1e9 / boxCount, occluded);
+	return 0;
+}
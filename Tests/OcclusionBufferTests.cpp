@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "OcclusionBuffer.h"
+#include "OcclusionTestScene.h"
+#include "TestCheck.h"
+
+// Same layout as the Settings.h defaults.
+static const UINT width = 256;
+static const UINT height = 128;
+static const UINT tileSize = 8;
+static const UINT bandHeight = 16;
+// Depth is sampled on a 5x5 grid across every pixel, edges and corners included, for the reference images.
+static const int samplesPerAxis = 5;
+
+static void rasterize(OcclusionBuffer& buffer, const std::vector<TestTriangle>& triangles, bool reverseBands = false) {
+	buffer.clearTriangles();
+	for (const TestTriangle& triangle : triangles) {
+		buffer.addTriangle(triangle.x, triangle.y, triangle.z);
+	}
+	for (UINT i = 0; i < buffer.getBandCount(); i++) {
+		buffer.rasterizeBand(reverseBands ? buffer.getBandCount() - 1 - i : i);
+	}
+}
+
+// Exact (double precision) depth of the nearest triangle covering each point, 1 where nothing does.
+struct ReferenceDepth {
+	std::vector<double> samples;
+	// Center sampled like the OcclusionBuffer, with the farthest depth the covering triangle reaches in the pixel.
+	std::vector<double> pixels;
+
+	explicit ReferenceDepth(const std::vector<TestTriangle>& triangles) {
+		const int sampleWidth = width * (samplesPerAxis - 1) + 1;
+		const int sampleHeight = height * (samplesPerAxis - 1) + 1;
+		samples.assign((size_t)sampleWidth * sampleHeight, 1.0);
+		pixels.assign((size_t)width * height, 1.0);
+		for (const TestTriangle& tri : triangles) {
+			double x[3] = { tri.x[0], tri.x[1], tri.x[2] };
+			double y[3] = { tri.y[0], tri.y[1], tri.y[2] };
+			double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (std::abs(area) < 1e-6) {
+				continue;
+			}
+			// Depth as a plane, and a point's barycentrics.
+			auto weights = [&](double px, double py, double w[3]) {
+				for (int i = 0; i < 3; i++) {
+					int j = (i + 1) % 3;
+					int k = (i + 2) % 3;
+					w[i] = ((x[k] - x[j]) * (py - y[j]) - (px - x[j]) * (y[k] - y[j])) / area;
+				}
+			};
+			auto depthAt = [&](const double w[3]) { return w[0] * tri.z[0] + w[1] * tri.z[1] + w[2] * tri.z[2]; };
+			double origin[3];
+			double stepX[3];
+			double stepY[3];
+			weights(0.0, 0.0, origin);
+			weights(1.0, 0.0, stepX);
+			weights(0.0, 1.0, stepY);
+			const double depthX = depthAt(stepX) - depthAt(origin);
+			const double depthY = depthAt(stepY) - depthAt(origin);
+
+			const int x0 = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+			const int x1 = std::min((int)width - 1, (int)std::floor(std::max({ x[0], x[1], x[2] })));
+			const int y0 = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+			const int y1 = std::min((int)height - 1, (int)std::floor(std::max({ y[0], y[1], y[2] })));
+			for (int py = y0; py <= y1; py++) {
+				for (int px = x0; px <= x1; px++) {
+					for (int sy = 0; sy < samplesPerAxis; sy++) {
+						for (int sx = 0; sx < samplesPerAxis; sx++) {
+							double w[3];
+							weights(px + (double)sx / (samplesPerAxis - 1), py + (double)sy / (samplesPerAxis - 1), w);
+							if (w[0] >= 0.0 && w[1] >= 0.0 && w[2] >= 0.0) {
+								double& sample = samples[(size_t)(py * (samplesPerAxis - 1) + sy) * sampleWidth + px * (samplesPerAxis - 1) + sx];
+								sample = std::min(sample, depthAt(w));
+							}
+						}
+					}
+					double w[3];
+					weights(px + 0.5, py + 0.5, w);
+					if (w[0] >= 0.0 && w[1] >= 0.0 && w[2] >= 0.0) {
+						double& pixel = pixels[py * width + px];
+						pixel = std::min(pixel, depthAt(w) + 0.5 * (std::abs(depthX) + std::abs(depthY)));
+					}
+				}
+			}
+		}
+	}
+
+	// Farthest depth any sample inside the rectangle (in pixels) sees.
+	double farthestIn(float minX, float maxX, float minY, float maxY) const {
+		const int sampleWidth = width * (samplesPerAxis - 1) + 1;
+		const int scale = samplesPerAxis - 1;
+		const int sx0 = std::max(0, (int)std::ceil(minX * scale));
+		const int sx1 = std::min(sampleWidth - 1, (int)std::floor(maxX * scale));
+		const int sy0 = std::max(0, (int)std::ceil(minY * scale));
+		const int sy1 = std::min((int)(height * scale), (int)std::floor(maxY * scale));
+		double farthest = 0.0;
+		for (int sy = sy0; sy <= sy1; sy++) {
+			for (int sx = sx0; sx <= sx1; sx++) {
+				farthest = std::max(farthest, samples[(size_t)sy * sampleWidth + sx]);
+			}
+		}
+		return farthest;
+	}
+};
+
+static void testSeams() {
+	// A full screen quad and a tessellated grid: every pixel inside a mesh is covered by one of its triangles,
+	// whichever way the diagonals go.
+	std::vector<TestTriangle> triangles;
+	AddOccluderGrid(triangles, 0.0f, 0.0f, (float)width, (float)height, 1, 1, 0.5f, 0.5f);
+	OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+	rasterize(buffer, triangles);
+	UINT unwritten = 0;
+	for (UINT y = 0; y < height; y++) {
+		for (UINT x = 0; x < width; x++) {
+			unwritten += !(buffer.getDepth(x, y) < 0.5001f);
+		}
+	}
+	CHECK(unwritten == 0);
+	CHECK(buffer.isRectOccluded(10.0f, 200.0f, 5.0f, 100.0f, 0.51f));
+	CHECK(!buffer.isRectOccluded(10.0f, 200.0f, 5.0f, 100.0f, 0.49f));
+
+	triangles.clear();
+	AddOccluderGrid(triangles, 13.3f, 7.7f, 201.1f, 97.9f, 17, 11, 0.3f, 0.6f);
+	rasterize(buffer, triangles);
+	unwritten = 0;
+	for (UINT y = 9; y < 104; y++) {
+		for (UINT x = 15; x < 213; x++) {
+			unwritten += !(buffer.getDepth(x, y) < 1.0f);
+		}
+	}
+	CHECK(unwritten == 0);
+	// Behind the grid's farthest point, and anywhere in front of it.
+	CHECK(buffer.isRectOccluded(20.0f, 200.0f, 12.0f, 100.0f, 0.61f));
+	CHECK(!buffer.isRectOccluded(20.0f, 200.0f, 12.0f, 100.0f, 0.29f));
+}
+
+static void testSilhouettes() {
+	// A box showing a sliver past the occluder's edge, narrower than a pixel, is still visible.
+	std::vector<TestTriangle> triangles;
+	AddOccluderGrid(triangles, 40.0f, 30.0f, 100.4f, 60.0f, 3, 2, 0.2f, 0.2f);
+	OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+	rasterize(buffer, triangles);
+	CHECK(buffer.isRectOccluded(45.0f, 135.0f, 35.0f, 85.0f, 0.3f));
+	for (float sliver : { 0.05f, 0.3f, 0.6f, 0.9f }) {
+		CHECK(!buffer.isRectOccluded(100.0f, 140.4f + sliver, 35.0f, 85.0f, 0.3f));
+		CHECK(!buffer.isRectOccluded(45.0f, 135.0f, 30.0f - sliver, 85.0f, 0.3f));
+	}
+	// Including inside a pixel whose center the occluder covers.
+	triangles.clear();
+	AddOccluderGrid(triangles, 40.3f, 30.3f, 100.4f, 60.4f, 3, 2, 0.2f, 0.2f);
+	rasterize(buffer, triangles);
+	CHECK(buffer.getDepth(140, 90) < 0.3f);
+	CHECK(buffer.isRectOccluded(45.0f, 139.9f, 35.0f, 89.9f, 0.3f));
+	CHECK(!buffer.isRectOccluded(45.0f, 140.8f, 35.0f, 89.9f, 0.3f));
+	CHECK(!buffer.isRectOccluded(45.0f, 139.9f, 35.0f, 90.8f, 0.3f));
+	CHECK(!buffer.isRectOccluded(40.1f, 139.9f, 35.0f, 89.9f, 0.3f));
+	CHECK(!buffer.isRectOccluded(45.0f, 139.9f, 30.1f, 89.9f, 0.3f));
+	// A box poking in front of a tilted occluder anywhere in a pixel isn't hidden by the depth at the pixel's center.
+	triangles.clear();
+	AddOccluderGrid(triangles, 0.0f, 0.0f, (float)width, (float)height, 1, 1, 0.1f, 0.9f);
+	rasterize(buffer, triangles);
+	const ReferenceDepth reference(triangles);
+	for (UINT x = 0; x + 1 < width; x += 7) {
+		const float nearest = (float)reference.farthestIn((float)x, x + 1.0f, 60.0f, 61.0f) - 1e-4f;
+		CHECK(!buffer.isRectOccluded((float)x, x + 1.0f, 60.0f, 61.0f, nearest));
+	}
+}
+
+static void testAgainstReference() {
+	UINT compared = 0;
+	UINT mismatches = 0;
+	for (UINT seed = 1; seed <= 6; seed++) {
+		const std::vector<TestTriangle> triangles = MakeOccluderScene(seed, (float)width, (float)height, 12, 60, false);
+		OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+		rasterize(buffer, triangles);
+		const ReferenceDepth reference(triangles);
+
+		// Image diff against the double precision rasterization, only pixel centers float rounding puts on the other side
+		// of an edge should differ.
+		for (UINT y = 0; y < height; y++) {
+			for (UINT x = 0; x < width; x++) {
+				compared++;
+				mismatches += std::abs(buffer.getDepth(x, y) - std::min(reference.pixels[y * width + x], 1.0)) > 1e-3;
+			}
+		}
+
+		// Bands only touch their own rows, the order they run in doesn't matter.
+		OcclusionBuffer reversed(width, height, tileSize, bandHeight);
+		rasterize(reversed, triangles, true);
+		bool sameImage = true;
+		for (UINT y = 0; y < height; y++) {
+			for (UINT x = 0; x < width; x++) {
+				sameImage = sameImage && reversed.getDepth(x, y) == buffer.getDepth(x, y);
+			}
+		}
+		CHECK(sameImage);
+	}
+	std::printf("%u of %u pixels differ from the reference\n", mismatches, compared);
+	CHECK(mismatches * 100000 < compared);
+}
+
+static void testConservative() {
+	UINT tested = 0;
+	UINT occluded = 0;
+	UINT wronglyOccluded = 0;
+	for (UINT seed = 1; seed <= 6; seed++) {
+		// Overlapping and tilted occluders, just without the sub-pixel gaps between them the header documents as closed.
+		const std::vector<TestTriangle> triangles = MakeOccluderScene(seed, (float)width, (float)height, 14, 0, true);
+		OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+		rasterize(buffer, triangles);
+		const ReferenceDepth reference(triangles);
+
+		// Boxes are only occluded if every point of them is behind something.
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (int i = 0; i < 4000; i++) {
+			const float sizeX = 0.2f + unit(random) * unit(random) * 60.0f;
+			const float sizeY = 0.2f + unit(random) * unit(random) * 40.0f;
+			const float minX = unit(random) * (width - sizeX);
+			const float minY = unit(random) * (height - sizeY);
+			const float nearestDepth = unit(random);
+			tested++;
+			if (!buffer.isRectOccluded(minX, minX + sizeX, minY, minY + sizeY, nearestDepth)) {
+				continue;
+			}
+			occluded++;
+			wronglyOccluded += reference.farthestIn(minX, minX + sizeX, minY, minY + sizeY) >= nearestDepth;
+		}
+	}
+	std::printf("%u of %u boxes occluded, %u of them wrongly\n", occluded, tested, wronglyOccluded);
+	CHECK(wronglyOccluded == 0);
+	// Conservative, but not so much that nothing gets culled.
+	CHECK(occluded * 10 > tested);
+}
+
+static void testReuse() {
+	// Nothing from the last frame's occluders, pixels or tiles, is left behind once every band is rasterized again.
+	OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+	std::vector<TestTriangle> triangles;
+	AddOccluderGrid(triangles, 0.0f, 0.0f, (float)width, (float)height, 4, 4, 0.1f, 0.2f);
+	rasterize(buffer, triangles);
+	CHECK(buffer.isRectOccluded(0.0f, 255.0f, 0.0f, 127.0f, 0.5f));
+	triangles.clear();
+	AddOccluderGrid(triangles, 0.0f, 0.0f, 128.0f, 64.0f, 4, 4, 0.1f, 0.2f);
+	rasterize(buffer, triangles);
+	CHECK(buffer.getTriangleCount() == triangles.size());
+	CHECK(buffer.isRectOccluded(0.0f, 126.0f, 0.0f, 62.0f, 0.5f));
+	bool cleared = true;
+	for (UINT y = 0; y < height; y++) {
+		for (UINT x = 0; x < width; x++) {
+			cleared = cleared && ((x < 128 && y < 64) || buffer.getDepth(x, y) == 1.0f);
+		}
+	}
+	for (float y = 0.0f; y < height; y += 4.0f) {
+		for (float x = 0.0f; x < width; x += 4.0f) {
+			cleared = cleared && ((x < 130.0f && y < 66.0f) || !buffer.isRectOccluded(x, x + 1.0f, y, y + 1.0f, 0.5f));
+		}
+	}
+	CHECK(cleared);
+}
+
+static void testOutside() {
+	OcclusionBuffer buffer(width, height, tileSize, bandHeight);
+	std::vector<TestTriangle> triangles;
+	AddOccluderGrid(triangles, -1000.0f, -1000.0f, 3000.0f, 3000.0f, 1, 1, 0.5f, 0.5f);
+	// Triangles too far out to rasterize are dropped rather than overflowing.
+	triangles.push_back({ { -1e9f, 1e9f, 0.0f }, { 0.0f, 0.0f, 1e9f }, { 0.1f, 0.1f, 0.1f } });
+	rasterize(buffer, triangles);
+	CHECK(buffer.getTriangleCount() == 2);
+	CHECK(buffer.isRectOccluded(-50.0f, 300.0f, -50.0f, 200.0f, 0.6f));
+	// Entirely off the buffer, or not a number, is never occluded.
+	CHECK(!buffer.isRectOccluded(300.0f, 400.0f, 10.0f, 20.0f, 0.6f));
+	CHECK(!buffer.isRectOccluded(NAN, 10.0f, 10.0f, 20.0f, 0.6f));
+}
+
+int main() {
+	testSeams();
+	testSilhouettes();
+	testAgainstReference();
+	testConservative();
+	testReuse();
+	testOutside();
+	if (testFailures == 0) {
+		std::printf("All occlusion buffer checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "OcclusionBuffer.h"
+
+// An occluder triangle already in the OcclusionBuffer's pixel space.
+struct TestTriangle {
+	float x[3];
+	float y[3];
+	float z[3];
+};
+
+// A watertight grid of 'columns' x 'rows' quads, two triangles each, over the rectangle at ('left', 'top') of the given size,
+// with depth varying smoothly from 'nearDepth' to 'farDepth' and the diagonal flipping every other quad, the way a mesh's would.
+inline void AddOccluderGrid(std::vector<TestTriangle>& triangles, float left, float top, float width, float height,
+	int columns, int rows, float nearDepth, float farDepth) {
+	auto vertexX = [&](int column) { return left + width * column / columns; };
+	auto vertexY = [&](int row) { return top + height * row / rows; };
+	auto vertexZ = [&](int column, int row) {
+		const float u = (float)column / columns;
+		const float v = (float)row / rows;
+		return nearDepth + (farDepth - nearDepth) * (0.5f * u + 0.3f * v + 0.2f * u * v);
+	};
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < columns; column++) {
+			const float x0 = vertexX(column);
+			const float x1 = vertexX(column + 1);
+			const float y0 = vertexY(row);
+			const float y1 = vertexY(row + 1);
+			const float z00 = vertexZ(column, row);
+			const float z10 = vertexZ(column + 1, row);
+			const float z01 = vertexZ(column, row + 1);
+			const float z11 = vertexZ(column + 1, row + 1);
+			if ((row + column) % 2 == 0) {
+				triangles.push_back({ { x0, x1, x1 }, { y0, y0, y1 }, { z00, z10, z11 } });
+				triangles.push_back({ { x0, x1, x0 }, { y0, y1, y1 }, { z00, z11, z01 } });
+			}
+			else {
+				triangles.push_back({ { x0, x1, x0 }, { y0, y0, y1 }, { z00, z10, z01 } });
+				triangles.push_back({ { x1, x1, x0 }, { y0, y1, y1 }, { z10, z11, z01 } });
+			}
+		}
+	}
+}
+
+// Grids of different sizes and tessellations scattered over (and past the edges of) a buffer of the given size,
+// plus loose triangles, some of them slivers. 'snapToPixels' puts the grids' outlines a whole number of pixels apart (still
+// crossing pixels at a random offset), so separate grids either touch or leave at least a pixel between them, never the
+// sub-pixel gaps OcclusionBuffer treats as closed.
+inline std::vector<TestTriangle> MakeOccluderScene(UINT seed, float bufferWidth, float bufferHeight, int gridCount, int looseCount,
+	bool snapToPixels) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float offset = unit(random);
+	auto snapSize = [&](float value) { return snapToPixels ? std::round(value) : value; };
+	auto snap = [&](float value) { return snapToPixels ? std::round(value) + offset : value; };
+	std::vector<TestTriangle> triangles;
+	for (int i = 0; i < gridCount; i++) {
+		const float width = snapSize(bufferWidth * (0.05f + 0.4f * unit(random)));
+		const float height = snapSize(bufferHeight * (0.05f + 0.4f * unit(random)));
+		const float left = snap(-0.1f * bufferWidth + unit(random) * bufferWidth);
+		const float top = snap(-0.1f * bufferHeight + unit(random) * bufferHeight);
+		const float nearDepth = 0.1f + 0.8f * unit(random);
+		const float farDepth = std::min(0.999f, nearDepth + 0.1f * unit(random));
+		AddOccluderGrid(triangles, left, top, width, height, 1 + (int)(unit(random) * 12), 1 + (int)(unit(random) * 8), nearDepth, farDepth);
+	}
+	for (int i = 0; i < looseCount; i++) {
+		TestTriangle triangle;
+		const float centerX = unit(random) * bufferWidth;
+		const float centerY = unit(random) * bufferHeight;
+		const float size = 1.0f + unit(random) * 40.0f;
+		for (int v = 0; v < 3; v++) {
+			triangle.x[v] = centerX + (unit(random) - 0.5f) * size * (v == 2 ? 0.1f : 1.0f);
+			triangle.y[v] = centerY + (unit(random) - 0.5f) * size;
+			triangle.z[v] = 0.05f + 0.9f * unit(random);
+		}
+		triangles.push_back(triangle);
+	}
+	return triangles;
+}
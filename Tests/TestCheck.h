@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+
+// Counts failed checks instead of stopping at the first, main returns the count so ctest sees any of them.
+inline int testFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TransformSlots.h"
+
+// Per frame cost of the TransformArena's CPU side from 1 up to 100k instances: writing the transforms that changed and
+// copying the dirty runs into the frame's buffer, against copying the whole array every frame. Instances are in blocks of
+// up to 16 like instanced models, the buffer is a plain array standing in for the mapped upload heap. Each count is timed
+// with every instance moving, 10% moving (scattered) and none moving, and with 10% of the blocks freed and allocated again.
+// Run with the largest instance count to use.
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const UINT FRAME_COUNT = 3;
+static const UINT BLOCK_SIZE = 16;
+
+static DirectX::XMFLOAT4X4A makeTransform(float x) {
+	DirectX::XMFLOAT4X4A transform = {};
+	for (int i = 0; i < 4; i++) {
+		transform.m[i][i] = 1.0f;
+	}
+	transform.m[3][0] = x;
+	return transform;
+}
+
+struct Scene {
+	TransformSlots slots{ FRAME_COUNT, 1024 };
+	std::vector<TransformHandle> handles;
+	std::vector<std::vector<DirectX::XMFLOAT4X4A>> buffers{ FRAME_COUNT };
+	UINT frame = 0;
+
+	// One frame's upload, growing the frame's buffer (and sending everything) when the arena outgrew it.
+	void upload() {
+		std::vector<DirectX::XMFLOAT4X4A>& buffer = buffers[frame];
+		if (buffer.size() < slots.size()) {
+			buffer.resize(slots.size() * 2);
+			std::memcpy(buffer.data(), slots.data(), slots.size() * sizeof(DirectX::XMFLOAT4X4A));
+			slots.clearDirty(frame);
+		}
+		else {
+			slots.takeDirty(frame, 0, slots.size(), [&](size_t runStart, size_t runLength) {
+				std::memcpy(buffer.data() + runStart, slots.data() + runStart, runLength * sizeof(DirectX::XMFLOAT4X4A));
+			});
+		}
+		frame = (frame + 1) % FRAME_COUNT;
+	}
+};
+
+// Best per instance time of 'frames' frames of 'update' followed by the upload, in nanoseconds.
+template<typename Update>
+static double timeFrames(Scene& scene, UINT instanceCount, int frames, Update update) {
+	double best = 1e30;
+	for (int i = 0; i < frames; i++) {
+		auto start = std::chrono::steady_clock::now();
+		update();
+		scene.upload();
+		best = std::min(best, secondsSince(start));
+	}
+	return best * 1e9 / instanceCount;
+}
+
+int main(int argc, char** argv) {
+	const UINT maxInstances = argc > 1 ? (UINT)std::stoul(argv[1]) : 100000;
+	const int frames = 30;
+
+	std::printf("%10s %12s %12s %12s %12s %12s   (ns an instance a frame)\n", "instances", "all moving", "10% moving", "static", "10% churn", "copy all");
+	for (UINT instanceCount = 1; instanceCount <= maxInstances; instanceCount *= 10) {
+		std::mt19937 random(1);
+		Scene scene;
+		for (UINT placed = 0; placed < instanceCount; placed += BLOCK_SIZE) {
+			scene.handles.push_back(scene.slots.allocate(std::min(BLOCK_SIZE, instanceCount - placed)));
+		}
+		for (UINT i = 0; i < FRAME_COUNT; i++) {
+			scene.upload();
+		}
+
+		// Every slot written and uploaded, as when everything moves.
+		float x = 0.0f;
+		const double allMoving = timeFrames(scene, instanceCount, frames, [&]() {
+			for (TransformHandle handle : scene.handles) {
+				for (UINT i = 0; i < scene.slots.getCount(handle); i++) {
+					scene.slots.set(handle, i, makeTransform(x++));
+				}
+			}
+		});
+
+		// A random tenth of the instances, so dirty runs are mostly single slots.
+		std::vector<std::pair<TransformHandle, UINT>> moving;
+		for (TransformHandle handle : scene.handles) {
+			for (UINT i = 0; i < scene.slots.getCount(handle); i++) {
+				if (random() % 10 == 0) {
+					moving.push_back({ handle, i });
+				}
+			}
+		}
+		const double someMoving = timeFrames(scene, instanceCount, frames, [&]() {
+			for (auto [handle, i] : moving) {
+				scene.slots.set(handle, i, makeTransform(x++));
+			}
+		});
+
+		// Nothing changed, which is only the walk over the bitset.
+		const double none = timeFrames(scene, instanceCount, frames, []() {});
+
+		// A tenth of the blocks freed and allocated again, as when models are loaded and unloaded.
+		const size_t churnCount = std::max<size_t>(1, scene.handles.size() / 10);
+		const double churn = timeFrames(scene, instanceCount, frames, [&]() {
+			for (size_t i = 0; i < churnCount; i++) {
+				const size_t index = random() % scene.handles.size();
+				const UINT count = scene.slots.getCount(scene.handles[index]);
+				scene.slots.release(scene.handles[index]);
+				scene.handles[index] = scene.slots.allocate(count);
+			}
+		});
+
+		// Copying the whole array every frame, what uploading every block in full costs.
+		std::vector<DirectX::XMFLOAT4X4A> full(scene.slots.size());
+		const double copyAll = timeFrames(scene, instanceCount, frames, [&]() {
+			std::memcpy(full.data(), scene.slots.data(), scene.slots.size() * sizeof(DirectX::XMFLOAT4X4A));
+		});
+
+		std::printf("%10u %12.2f %12.2f %12.2f %12.2f %12.2f\n", instanceCount, allMoving, someMoving, none, churn, copyAll);
+	}
+	return 0;
+}
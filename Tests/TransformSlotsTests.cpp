@@ -0,0 +1,250 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "TransformSlots.h"
+#include "TestCheck.h"
+
+// The TransformArena's slot bookkeeping, through allocating, freeing and resizing blocks, and the dirty runs each frame's
+// upload copies. The random test keeps a copy of the array per frame the way the GPU buffers do, and checks every copy
+// matches after its frame's upload.
+
+static const UINT FRAME_COUNT = 3;
+
+static DirectX::XMFLOAT4X4A makeTransform(float value) {
+	DirectX::XMFLOAT4X4A transform = {};
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 4; column++) {
+			transform.m[row][column] = value + row * 4 + column;
+		}
+	}
+	return transform;
+}
+
+static bool same(const DirectX::XMFLOAT4X4A& a, const DirectX::XMFLOAT4X4A& b) {
+	return std::memcmp(a.m, b.m, sizeof(a.m)) == 0;
+}
+
+static bool isIdentity(const DirectX::XMFLOAT4X4A& transform) {
+	DirectX::XMFLOAT4X4A identity = {};
+	for (int i = 0; i < 4; i++) {
+		identity.m[i][i] = 1.0f;
+	}
+	return same(transform, identity);
+}
+
+static std::vector<std::pair<size_t, size_t>> takeRuns(TransformSlots& slots, UINT frameIndex, size_t first, size_t end) {
+	std::vector<std::pair<size_t, size_t>> runs;
+	slots.takeDirty(frameIndex, first, end, [&](size_t runStart, size_t runLength) { runs.push_back({ runStart, runLength }); });
+	return runs;
+}
+
+static std::vector<std::pair<size_t, size_t>> takeAll(TransformSlots& slots, UINT frameIndex) {
+	return takeRuns(slots, frameIndex, 0, slots.size());
+}
+
+static void testAllocate() {
+	TransformSlots slots(FRAME_COUNT, 16);
+	TransformHandle a = slots.allocate(3);
+	TransformHandle b = slots.allocate(5);
+	TransformHandle empty = slots.allocate(0);
+	CHECK(a != b && b != empty && a != empty);
+	CHECK(slots.getOffset(a) == 0 && slots.getCount(a) == 3);
+	CHECK(slots.getOffset(b) == 3 && slots.getCount(b) == 5);
+	CHECK(slots.getCount(empty) == 0);
+	CHECK(slots.size() == 8);
+	for (UINT i = 0; i < 5; i++) {
+		CHECK(isIdentity(slots.get(b, i)));
+	}
+
+	// New slots go up in every frame, as one run since the blocks are next to each other.
+	for (UINT frame = 0; frame < FRAME_COUNT; frame++) {
+		auto runs = takeAll(slots, frame);
+		CHECK(runs.size() == 1 && runs[0] == std::make_pair(size_t(0), size_t(8)));
+		CHECK(takeAll(slots, frame).empty());
+	}
+
+	slots.set(b, 2, makeTransform(10.0f));
+	CHECK(same(slots.get(b, 2), makeTransform(10.0f)));
+	CHECK(same(slots.data()[5], makeTransform(10.0f)));
+	CHECK(isIdentity(slots.get(b, 1)) && isIdentity(slots.get(b, 3)));
+}
+
+static void testReuse() {
+	TransformSlots slots(FRAME_COUNT, 16);
+	TransformHandle a = slots.allocate(4);
+	TransformHandle b = slots.allocate(4);
+	TransformHandle c = slots.allocate(4);
+	slots.set(b, 0, makeTransform(1.0f));
+
+	// The freed handle and range are both handed out again, and the reused slots are back to Identity.
+	slots.release(b);
+	TransformHandle d = slots.allocate(2);
+	CHECK(d == b);
+	CHECK(slots.getOffset(d) == 4);
+	CHECK(isIdentity(slots.get(d, 0)));
+	CHECK(slots.size() == 12);
+
+	// What's left of b's range merges with a's and c's once they're freed too, so a block of all 3 fits without growing.
+	slots.release(a);
+	slots.release(c);
+	slots.release(d);
+	TransformHandle e = slots.allocate(12);
+	CHECK(slots.getOffset(e) == 0);
+	CHECK(slots.size() == 12);
+
+	// Nothing free is big enough, so the arena grows past the end.
+	TransformHandle f = slots.allocate(1);
+	CHECK(slots.getOffset(f) == 12);
+	CHECK(slots.size() == 13);
+}
+
+static void testResize() {
+	TransformSlots slots(FRAME_COUNT, 16);
+	TransformHandle a = slots.allocate(2);
+	TransformHandle b = slots.allocate(2);
+	slots.set(a, 0, makeTransform(1.0f));
+	slots.set(a, 1, makeTransform(2.0f));
+	for (UINT frame = 0; frame < FRAME_COUNT; frame++) {
+		takeAll(slots, frame);
+	}
+
+	// b is in the way, so a moves to the end with double the capacity, keeping its transforms.
+	slots.resize(a, 3);
+	CHECK(slots.getOffset(a) == 4 && slots.getCount(a) == 3);
+	CHECK(same(slots.get(a, 0), makeTransform(1.0f)) && same(slots.get(a, 1), makeTransform(2.0f)));
+	CHECK(isIdentity(slots.get(a, 2)));
+	CHECK(slots.size() == 8);
+	auto runs = takeAll(slots, 0);
+	CHECK(runs.size() == 1 && runs[0] == std::make_pair(size_t(4), size_t(3)));
+
+	// Growing into the spare capacity stays put and only dirties the new slot, shrinking dirties nothing.
+	slots.resize(a, 4);
+	CHECK(slots.getOffset(a) == 4 && isIdentity(slots.get(a, 3)));
+	runs = takeAll(slots, 0);
+	CHECK(runs.size() == 1 && runs[0] == std::make_pair(size_t(7), size_t(1)));
+	slots.resize(a, 1);
+	CHECK(slots.getOffset(a) == 4 && slots.getCount(a) == 1);
+	CHECK(takeAll(slots, 0).empty());
+
+	// a's old range is free again.
+	TransformHandle c = slots.allocate(2);
+	CHECK(slots.getOffset(c) == 0);
+	CHECK(slots.getOffset(b) == 2);
+}
+
+static void testDirtyRuns() {
+	TransformSlots slots(FRAME_COUNT, 256);
+	TransformHandle a = slots.allocate(200);
+	for (UINT frame = 0; frame < FRAME_COUNT; frame++) {
+		takeAll(slots, frame);
+	}
+
+	// Neighbours coalesce, gaps split runs, including across the bitset's 64 bit words.
+	for (UINT slot : { 3u, 4u, 5u, 7u, 62u, 63u, 64u, 65u, 199u }) {
+		slots.set(a, slot, makeTransform((float)slot));
+	}
+	auto runs = takeAll(slots, 0);
+	CHECK(runs.size() == 4);
+	CHECK(runs.size() == 4 && runs[0] == std::make_pair(size_t(3), size_t(3)) && runs[1] == std::make_pair(size_t(7), size_t(1))
+		&& runs[2] == std::make_pair(size_t(62), size_t(4)) && runs[3] == std::make_pair(size_t(199), size_t(1)));
+	CHECK(takeAll(slots, 0).empty());
+
+	// Other frames still have their own bits, and only the part of [first, end) gets taken.
+	runs = takeRuns(slots, 1, 5, 63);
+	CHECK(runs.size() == 3 && runs[0] == std::make_pair(size_t(5), size_t(1)) && runs[1] == std::make_pair(size_t(7), size_t(1))
+		&& runs[2] == std::make_pair(size_t(62), size_t(1)));
+	runs = takeAll(slots, 1);
+	CHECK(runs.size() == 3 && runs[0] == std::make_pair(size_t(3), size_t(2)) && runs[1] == std::make_pair(size_t(63), size_t(3))
+		&& runs[2] == std::make_pair(size_t(199), size_t(1)));
+
+	// Writes after a frame's upload show up in its next one, clearDirty drops everything for a frame.
+	slots.set(a, 100, makeTransform(0.0f));
+	runs = takeAll(slots, 0);
+	CHECK(runs.size() == 1 && runs[0] == std::make_pair(size_t(100), size_t(1)));
+	slots.clearDirty(2);
+	CHECK(takeAll(slots, 2).empty());
+	CHECK(takeRuns(slots, 1, 150, 1000).empty());
+}
+
+// Random allocations, frees, resizes and writes, with each frame's upload copying its runs into that frame's copy of the array.
+static void testRandomFrames() {
+	std::mt19937 random(7);
+	TransformSlots slots(FRAME_COUNT, 64);
+	std::vector<TransformHandle> live;
+	std::vector<std::vector<DirectX::XMFLOAT4X4A>> gpuCopies(FRAME_COUNT);
+	float nextValue = 100.0f;
+
+	for (UINT step = 0; step < 3000; step++) {
+		const UINT frame = step % FRAME_COUNT;
+		const UINT operations = random() % 8;
+		for (UINT op = 0; op < operations; op++) {
+			const UINT kind = random() % 10;
+			if (live.empty() || kind < 2) {
+				live.push_back(slots.allocate(random() % 20));
+			}
+			else if (kind < 3) {
+				const size_t index = random() % live.size();
+				slots.release(live[index]);
+				live.erase(live.begin() + index);
+			}
+			else if (kind < 5) {
+				slots.resize(live[random() % live.size()], random() % 40);
+			}
+			else {
+				const TransformHandle handle = live[random() % live.size()];
+				if (slots.getCount(handle) > 0) {
+					slots.set(handle, random() % slots.getCount(handle), makeTransform(nextValue));
+					nextValue += 16.0f;
+				}
+			}
+		}
+
+		// Like the arena, a copy that's too small is replaced with the whole array instead of taking runs.
+		std::vector<DirectX::XMFLOAT4X4A>& copy = gpuCopies[frame];
+		if (copy.size() < slots.size()) {
+			copy.assign(slots.data(), slots.data() + slots.size());
+			slots.clearDirty(frame);
+		}
+		else {
+			slots.takeDirty(frame, 0, slots.size(), [&](size_t runStart, size_t runLength) {
+				CHECK(runStart + runLength <= slots.size());
+				std::memcpy(copy.data() + runStart, slots.data() + runStart, runLength * sizeof(DirectX::XMFLOAT4X4A));
+			});
+		}
+
+		// Only slots in live blocks have to match, freed ones are garbage to the GPU.
+		for (TransformHandle handle : live) {
+			for (UINT i = 0; i < slots.getCount(handle); i++) {
+				if (!same(copy[slots.getOffset(handle) + i], slots.get(handle, i))) {
+					std::printf("frame %u step %u: handle %u slot %u wasn't uploaded\n", frame, step, handle, i);
+					testFailures++;
+					return;
+				}
+			}
+		}
+	}
+
+	// Blocks never overlap.
+	std::vector<int> owner(slots.size(), -1);
+	for (TransformHandle handle : live) {
+		for (UINT i = 0; i < slots.getCount(handle); i++) {
+			CHECK(owner[slots.getOffset(handle) + i] == -1);
+			owner[slots.getOffset(handle) + i] = (int)handle;
+		}
+	}
+}
+
+int main() {
+	testAllocate();
+	testReuse();
+	testResize();
+	testDirtyRuns();
+	testRandomFrames();
+	if (testFailures == 0) {
+		std::printf("All transform slot checks passed\n");
+	}
+	return testFailures;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ModelLoading/VertexCompression.h"
+#include "TestCheck.h"
+
+static const float pi = 3.14159265358979f;
+
+static float dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Vertex vertexAt(const DirectX::XMFLOAT3& pos) {
+	return { { 0.5f, 0.5f }, pos, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+}
+
+// Compresses 'vertices' the way SimpleModel::compressVertices does, fitting the quantization to their bounds,
+// and checks the round trip against CompressionErrorBound. Returns the worst error as a fraction of the bound.
+static VertexCompressionError compressWithinBound(const std::vector<Vertex>& vertices) {
+	DirectX::XMFLOAT3 minimum = vertices[0].pos;
+	DirectX::XMFLOAT3 maximum = vertices[0].pos;
+	float maxTexC = 0.0f;
+	for (const Vertex& vertex : vertices) {
+		minimum = { std::min(minimum.x, vertex.pos.x), std::min(minimum.y, vertex.pos.y), std::min(minimum.z, vertex.pos.z) };
+		maximum = { std::max(maximum.x, vertex.pos.x), std::max(maximum.y, vertex.pos.y), std::max(maximum.z, vertex.pos.z) };
+		maxTexC = std::max({ maxTexC, std::abs(vertex.texC.x), std::abs(vertex.texC.y) });
+	}
+	DirectX::XMFLOAT3 center = { (minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f };
+	DirectX::XMFLOAT3 extents = { (maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f };
+	DirectX::XMFLOAT3 positionOffset;
+	DirectX::XMFLOAT3 positionScale;
+	SetPositionQuantization(center, extents, positionOffset, positionScale);
+
+	std::vector<CompactVertex> compressed(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		compressed[i] = CompressVertex(vertices[i], positionOffset, positionScale);
+	}
+	VertexCompressionError error = MeasureCompressionError(vertices.data(), compressed.data(), (UINT)vertices.size(), positionOffset, positionScale);
+	VertexCompressionError bound = CompressionErrorBound(positionOffset, positionScale, maxTexC);
+	CHECK(error.within(bound));
+	auto fraction = [](float value, float limit) { return limit > 0.0f ? value / limit : 0.0f; };
+	return { fraction(error.position, bound.position), fraction(error.normal, bound.normal), fraction(error.tangent, bound.tangent),
+		fraction(error.texC, bound.texC) };
+}
+
+static void testPositions() {
+	std::mt19937 random(1);
+	// Boxes of different sizes, far from the origin, and flat on an axis (a plane, where that axis' scale is made up).
+	struct Box {
+		DirectX::XMFLOAT3 center;
+		DirectX::XMFLOAT3 extents;
+	};
+	const Box boxes[] = {
+		{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
+		{ { 250.0f, -40.0f, 3.0f }, { 1200.0f, 35.0f, 0.01f } },
+		{ { 20000.0f, 15000.0f, -30000.0f }, { 5.0f, 5.0f, 5.0f } },
+		{ { 1.0f, 2.0f, 3.0f }, { 10.0f, 0.0f, 10.0f } },
+		{ { 0.0f, 0.0f, 0.0f }, { 1e-3f, 1e-3f, 1e-3f } },
+	};
+	float worst = 0.0f;
+	for (const Box& box : boxes) {
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Vertex> vertices;
+		// The corners, so the bounds are exactly the box, then points inside it.
+		for (int corner = 0; corner < 8; corner++) {
+			vertices.push_back(vertexAt({ box.center.x + (corner & 1 ? box.extents.x : -box.extents.x),
+				box.center.y + (corner & 2 ? box.extents.y : -box.extents.y), box.center.z + (corner & 4 ? box.extents.z : -box.extents.z) }));
+		}
+		for (int i = 0; i < 20000; i++) {
+			vertices.push_back(vertexAt({ box.center.x + unit(random) * box.extents.x, box.center.y + unit(random) * box.extents.y,
+				box.center.z + unit(random) * box.extents.z }));
+		}
+		worst = std::max(worst, compressWithinBound(vertices).position);
+	}
+	std::printf("positions are off by at most %.2f of the bound\n", worst);
+	// A bound far above the real error wouldn't catch a quantization bug.
+	CHECK(worst > 0.25f);
+}
+
+static void testUnitVectors() {
+	// A Fibonacci sweep of the sphere, plus the axes and the octahedron's fold lines where the encoding is least regular.
+	std::vector<DirectX::XMFLOAT3> directions;
+	const UINT count = 200000;
+	for (UINT i = 0; i < count; i++) {
+		float z = 1.0f - 2.0f * (i + 0.5f) / count;
+		float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		float angle = pi * (3.0f - std::sqrt(5.0f)) * i;
+		directions.push_back({ r * std::cos(angle), r * std::sin(angle), z });
+	}
+	for (int axis = 0; axis < 6; axis++) {
+		float sign = axis & 1 ? -1.0f : 1.0f;
+		directions.push_back({ axis / 2 == 0 ? sign : 0.0f, axis / 2 == 1 ? sign : 0.0f, axis / 2 == 2 ? sign : 0.0f });
+	}
+	for (int i = 0; i <= 1000; i++) {
+		float angle = 2.0f * pi * i / 1000;
+		directions.push_back({ std::cos(angle), std::sin(angle), 0.0f });
+		directions.push_back({ std::cos(angle), std::sin(angle), -1e-4f });
+	}
+
+	std::vector<Vertex> vertices;
+	for (size_t i = 0; i < directions.size(); i++) {
+		Vertex vertex = vertexAt({ (float)i, 0.0f, 0.0f });
+		const DirectX::XMFLOAT3& n = directions[i];
+		// Normals don't have to arrive normalized, tangents are the normal turned a quarter about a skewed axis.
+		vertex.norm = { n.x * 3.0f, n.y * 3.0f, n.z * 3.0f };
+		vertex.tan = { n.y, n.z, n.x };
+		vertex.biTan = { -n.z, n.x, -n.y };
+		vertices.push_back(vertex);
+	}
+	VertexCompressionError worst = compressWithinBound(vertices);
+	std::printf("normals and tangents are off by at most %.2f and %.2f of the bound\n", worst.normal, worst.tangent);
+	CHECK(worst.normal > 0.25f);
+
+	// The bitangent's direction comes back from the stored sign, either way round.
+	DirectX::XMFLOAT3 offset = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
+	for (float handedness : { 1.0f, -1.0f }) {
+		Vertex vertex = vertexAt({ 0.0f, 0.0f, 0.0f });
+		vertex.biTan = { 0.0f, handedness, 0.0f };
+		Vertex decoded = DecompressVertex(CompressVertex(vertex, offset, scale), offset, scale);
+		CHECK(dot(decoded.biTan, vertex.biTan) > 0.999f);
+	}
+
+	// Vectors that can't be normalized still decode to unit vectors.
+	Vertex degenerate = vertexAt({ 0.0f, 0.0f, 0.0f });
+	degenerate.norm = { 0.0f, 0.0f, 0.0f };
+	degenerate.tan = { NAN, 0.0f, 0.0f };
+	Vertex decoded = DecompressVertex(CompressVertex(degenerate, offset, scale), offset, scale);
+	CHECK(std::abs(dot(decoded.norm, decoded.norm) - 1.0f) < 1e-4f);
+	CHECK(std::abs(dot(decoded.tan, decoded.tan) - 1.0f) < 1e-4f);
+}
+
+static void testTexCoords() {
+	std::mt19937 random(2);
+	// Ranges a model's UVs come in: unit, tiling, near zero (half denormals), and near the largest half.
+	const float ranges[] = { 1.0f, 100.0f, 1e-5f, 60000.0f };
+	float worst = 0.0f;
+	for (float range : ranges) {
+		std::uniform_real_distribution<float> texC(-range, range);
+		std::vector<Vertex> vertices;
+		for (int i = 0; i < 20000; i++) {
+			Vertex vertex = vertexAt({ (float)i, 0.0f, 0.0f });
+			vertex.texC = { texC(random), texC(random) };
+			vertices.push_back(vertex);
+		}
+		worst = std::max(worst, compressWithinBound(vertices).texC);
+	}
+	std::printf("texture coordinates are off by at most %.2f of the bound\n", worst);
+	CHECK(worst > 0.25f);
+
+	// Past the largest half they're clamped to it, not turned into infinity.
+	std::vector<Vertex> vertices = { vertexAt({ 0.0f, 0.0f, 0.0f }) };
+	vertices[0].texC = { 70000.0f, -1e6f };
+	compressWithinBound(vertices);
+
+	// Every finite half comes back exactly, and floats exactly between two halves go to the one with an even mantissa.
+	DirectX::XMFLOAT3 offset = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
+	CompactVertex compact = CompressVertex(vertexAt({ 0.0f, 0.0f, 0.0f }), offset, scale);
+	auto halfValue = [&](UINT bits) {
+		compact.texC[0] = (UINT16)bits;
+		return DecompressVertex(compact, offset, scale).texC.x;
+	};
+	auto toHalf = [&](float value) {
+		Vertex vertex = vertexAt({ 0.0f, 0.0f, 0.0f });
+		vertex.texC.x = value;
+		return (UINT)CompressVertex(vertex, offset, scale).texC[0];
+	};
+	UINT mismatches = 0;
+	UINT tieMismatches = 0;
+	for (UINT bits = 0; bits < 0x10000; bits++) {
+		if ((bits & 0x7fff) > 0x7bff) {
+			continue;
+		}
+		mismatches += toHalf(halfValue(bits)) != bits;
+		if ((bits & 0x7fff) < 0x7bff) {
+			const float tie = (float)(((double)halfValue(bits) + halfValue(bits + 1)) * 0.5);
+			tieMismatches += toHalf(tie) != (bits & 1 ? bits + 1 : bits);
+		}
+	}
+	CHECK(mismatches == 0);
+	CHECK(tieMismatches == 0);
+}
+
+int main() {
+	testPositions();
+	testUnitVectors();
+	testTexCoords();
+	if (testFailures == 0) {
+		std::printf("All vertex compression checks passed\n");
+	}
+	return testFailures;
+}